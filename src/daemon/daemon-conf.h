@@ -75,7 +75,8 @@ typedef struct pa_daemon_conf {
         log_time,
         flat_volumes,
         lock_memory,
-        deferred_volume;
+        deferred_volume,
+        premix_resampling;
     pa_server_type_t local_server_type;
     int exit_idle_time,
         scache_idle_time,
@@ -133,6 +134,7 @@ typedef struct pa_daemon_conf {
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
     size_t shm_size;
+    size_t shm_max_size;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
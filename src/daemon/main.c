@@ -1024,6 +1024,8 @@ int main(int argc, char *argv[]) {
         goto finish;
     }
 
+    pa_mempool_set_max_size(c->mempool, conf->shm_max_size);
+
     c->default_sample_spec = conf->default_sample_spec;
     c->alternate_sample_rate = conf->alternate_sample_rate;
     c->default_channel_map = conf->default_channel_map;
@@ -1040,6 +1042,7 @@ int main(int argc, char *argv[]) {
     c->disable_remixing = conf->disable_remixing;
     c->disable_lfe_remixing = conf->disable_lfe_remixing;
     c->deferred_volume = conf->deferred_volume;
+    c->premix_resampling = conf->premix_resampling;
     c->running_as_daemon = conf->daemonize;
     c->disallow_exit = conf->disallow_exit;
     c->flat_volumes = conf->flat_volumes;
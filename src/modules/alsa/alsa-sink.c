@@ -57,6 +57,7 @@
 
 #include "alsa-util.h"
 #include "alsa-sink.h"
+#include "alsa-telemetry.h"
 
 /* #define DEBUG_TIMING */
 
@@ -148,6 +149,9 @@ struct userdata {
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
 
+    pa_alsa_telemetry *telemetry;
+    pa_alsa_telemetry_record telemetry_record; /* Of the current IO thread iteration */
+
     pa_idxset *formats;
 
     pa_reserve_wrapper *reserve;
@@ -338,6 +342,7 @@ static void increase_watermark(struct userdata *u) {
     if (old_watermark != u->tsched_watermark) {
         pa_log_info("Increasing wakeup watermark to %0.2f ms",
                     (double) u->tsched_watermark_usec / PA_USEC_PER_MSEC);
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_WATERMARK_INC;
         return;
     }
 
@@ -356,6 +361,7 @@ static void increase_watermark(struct userdata *u) {
                     (double) new_min_latency / PA_USEC_PER_MSEC);
 
         pa_sink_set_latency_range_within_thread(u->sink, new_min_latency, u->sink->thread_info.max_latency);
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_LATENCY_INC;
     }
 
     /* When we reach this we're officially fucked! */
@@ -385,9 +391,11 @@ static void decrease_watermark(struct userdata *u) {
 
     fix_tsched_watermark(u);
 
-    if (old_watermark != u->tsched_watermark)
+    if (old_watermark != u->tsched_watermark) {
         pa_log_info("Decreasing wakeup watermark to %0.2f ms",
                     (double) u->tsched_watermark_usec / PA_USEC_PER_MSEC);
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_WATERMARK_DEC;
+    }
 
     /* We don't change the latency range*/
 
@@ -440,6 +448,8 @@ static int try_recover(struct userdata *u, const char *call, int err) {
     if (err == -ESTRPIPE)
         pa_log_debug("%s: System suspended!", call);
 
+    u->telemetry_record.flags |= PA_ALSA_TELEMETRY_RECOVER;
+
     if ((err = snd_pcm_recover(u->pcm_handle, err, 1)) < 0) {
         pa_log("%s: %s", call, pa_alsa_strerror(err));
         return -1;
@@ -471,11 +481,16 @@ static size_t check_left_to_play(struct userdata *u, size_t n_bytes, bool on_tim
         PA_DEBUG_TRAP;
 #endif
 
-        if (!u->first && !u->after_rewind)
+        if (!u->first && !u->after_rewind) {
+            u->telemetry_record.flags |= PA_ALSA_TELEMETRY_XRUN;
+
             if (pa_log_ratelimit(PA_LOG_INFO))
                 pa_log_info("Underrun!");
+        }
     }
 
+    u->telemetry_record.left = (uint32_t) left_to_play;
+
 #ifdef DEBUG_TIMING
     pa_log_debug("%0.2f ms left to play; inc threshold = %0.2f ms; dec threshold = %0.2f ms",
                  (double) pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) / PA_USEC_PER_MSEC,
@@ -660,6 +675,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
 
             u->write_count += written;
             u->since_start += written;
+            u->telemetry_record.bytes += (uint32_t) written;
 
 #ifdef DEBUG_TIMING
             pa_log_debug("Wrote %lu bytes (of possible %lu bytes)", (unsigned long) written, (unsigned long) n_bytes);
@@ -816,6 +832,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
 
             u->write_count += written;
             u->since_start += written;
+            u->telemetry_record.bytes += (uint32_t) written;
 
 /*         pa_log_debug("wrote %lu frames", (unsigned long) frames); */
 
@@ -1681,6 +1698,16 @@ static int process_rewind(struct userdata *u) {
     return 0;
 }
 
+static void push_telemetry(struct userdata *u) {
+    pa_assert(u);
+
+    if (u->use_tsched)
+        u->telemetry_record.watermark_usec = (uint32_t) u->tsched_watermark_usec;
+
+    pa_alsa_telemetry_push(u->telemetry, &u->telemetry_record);
+    pa_zero(u->telemetry_record);
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
     unsigned short revents = 0;
@@ -1713,6 +1740,9 @@ static void thread_func(void *userdata) {
             pa_usec_t sleep_usec = 0;
             bool on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
 
+            if (on_timeout)
+                u->telemetry_record.flags |= PA_ALSA_TELEMETRY_TIMEOUT;
+
             if (u->use_mmap)
                 work_done = mmap_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
             else
@@ -1775,6 +1805,7 @@ static void thread_func(void *userdata) {
 
             u->after_rewind = false;
 
+            push_telemetry(u);
         }
 
         if (u->sink->flags & PA_SINK_DEFERRED_VOLUME) {
@@ -1791,6 +1822,7 @@ static void thread_func(void *userdata) {
         if (rtpoll_sleep > 0) {
             pa_rtpoll_set_timer_relative(u->rtpoll, rtpoll_sleep);
             real_sleep = pa_rtclock_now();
+            u->telemetry_record.scheduled_usec = real_sleep + rtpoll_sleep;
         }
         else
             pa_rtpoll_set_timer_disabled(u->rtpoll);
@@ -1799,6 +1831,8 @@ static void thread_func(void *userdata) {
         if ((ret = pa_rtpoll_run(u->rtpoll)) < 0)
             goto fail;
 
+        u->telemetry_record.wakeup_usec = pa_rtclock_now();
+
         if (rtpoll_sleep > 0) {
             real_sleep = pa_rtclock_now() - real_sleep;
 #ifdef DEBUG_TIMING
@@ -1832,6 +1866,8 @@ static void thread_func(void *userdata) {
             }
 
             if (revents & ~POLLOUT) {
+                u->telemetry_record.flags |= PA_ALSA_TELEMETRY_RECOVER;
+
                 if (pa_alsa_recover_from_poll(u->pcm_handle, revents) < 0)
                     goto fail;
 
@@ -2386,6 +2422,8 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
 
     pa_alsa_dump(PA_LOG_DEBUG, u->pcm_handle);
 
+    u->telemetry = pa_alsa_telemetry_new(m->core, "sink", u->sink->index, PA_ALSA_TELEMETRY_RECORDS_DEFAULT);
+
     thread_name = pa_sprintf_malloc("alsa-sink-%s", pa_strnull(pa_proplist_gets(u->sink->proplist, "alsa.id")));
     if (!(u->thread = pa_thread_new(thread_name, thread_func, u))) {
         pa_log("Failed to create thread.");
@@ -2497,6 +2535,9 @@ static void userdata_free(struct userdata *u) {
     if (u->smoother)
         pa_smoother_free(u->smoother);
 
+    if (u->telemetry)
+        pa_alsa_telemetry_free(u->telemetry);
+
     if (u->formats)
         pa_idxset_free(u->formats, (pa_free_cb_t) pa_format_info_free);
 
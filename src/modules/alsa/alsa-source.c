@@ -52,6 +52,7 @@
 
 #include "alsa-util.h"
 #include "alsa-source.h"
+#include "alsa-telemetry.h"
 
 /* #define DEBUG_TIMING */
 
@@ -134,6 +135,9 @@ struct userdata {
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
 
+    pa_alsa_telemetry *telemetry;
+    pa_alsa_telemetry_record telemetry_record; /* Of the current IO thread iteration */
+
     pa_reserve_wrapper *reserve;
     pa_hook_slot *reserve_slot;
     pa_reserve_monitor_wrapper *monitor;
@@ -313,6 +317,7 @@ static void increase_watermark(struct userdata *u) {
     if (old_watermark != u->tsched_watermark) {
         pa_log_info("Increasing wakeup watermark to %0.2f ms",
                     (double) u->tsched_watermark_usec / PA_USEC_PER_MSEC);
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_WATERMARK_INC;
         return;
     }
 
@@ -331,6 +336,7 @@ static void increase_watermark(struct userdata *u) {
                     (double) new_min_latency / PA_USEC_PER_MSEC);
 
         pa_source_set_latency_range_within_thread(u->source, new_min_latency, u->source->thread_info.max_latency);
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_LATENCY_INC;
     }
 
     /* When we reach this we're officially fucked! */
@@ -360,9 +366,11 @@ static void decrease_watermark(struct userdata *u) {
 
     fix_tsched_watermark(u);
 
-    if (old_watermark != u->tsched_watermark)
+    if (old_watermark != u->tsched_watermark) {
         pa_log_info("Decreasing wakeup watermark to %0.2f ms",
                     (double) u->tsched_watermark_usec / PA_USEC_PER_MSEC);
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_WATERMARK_DEC;
+    }
 
     /* We don't change the latency range*/
 
@@ -415,6 +423,8 @@ static int try_recover(struct userdata *u, const char *call, int err) {
     if (err == -ESTRPIPE)
         pa_log_debug("%s: System suspended!", call);
 
+    u->telemetry_record.flags |= PA_ALSA_TELEMETRY_RECOVER;
+
     if ((err = snd_pcm_recover(u->pcm_handle, err, 1)) < 0) {
         pa_log("%s: %s", call, pa_alsa_strerror(err));
         return -1;
@@ -441,6 +451,7 @@ static size_t check_left_to_record(struct userdata *u, size_t n_bytes, bool on_t
         /* We got a dropout. What a mess! */
         left_to_record = 0;
         overrun = true;
+        u->telemetry_record.flags |= PA_ALSA_TELEMETRY_XRUN;
 
 #ifdef DEBUG_TIMING
         PA_DEBUG_TRAP;
@@ -454,6 +465,8 @@ static size_t check_left_to_record(struct userdata *u, size_t n_bytes, bool on_t
     pa_log_debug("%0.2f ms left to record", (double) pa_bytes_to_usec(left_to_record, &u->source->sample_spec) / PA_USEC_PER_MSEC);
 #endif
 
+    u->telemetry_record.left = (uint32_t) left_to_record;
+
     if (u->use_tsched) {
         bool reset_not_before = true;
 
@@ -612,6 +625,7 @@ static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
             work_done = true;
 
             u->read_count += frames * u->frame_size;
+            u->telemetry_record.bytes += (uint32_t) (frames * u->frame_size);
 
 #ifdef DEBUG_TIMING
             pa_log_debug("Read %lu bytes (of possible %lu bytes)", (unsigned long) (frames * u->frame_size), (unsigned long) n_bytes);
@@ -744,6 +758,7 @@ static int unix_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
             work_done = true;
 
             u->read_count += frames * u->frame_size;
+            u->telemetry_record.bytes += (uint32_t) (frames * u->frame_size);
 
 /*             pa_log_debug("read %lu frames", (unsigned long) frames); */
 
@@ -1426,6 +1441,16 @@ static int source_update_rate_cb(pa_source *s, uint32_t rate) {
     return -1;
 }
 
+static void push_telemetry(struct userdata *u) {
+    pa_assert(u);
+
+    if (u->use_tsched)
+        u->telemetry_record.watermark_usec = (uint32_t) u->tsched_watermark_usec;
+
+    pa_alsa_telemetry_push(u->telemetry, &u->telemetry_record);
+    pa_zero(u->telemetry_record);
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
     unsigned short revents = 0;
@@ -1453,6 +1478,9 @@ static void thread_func(void *userdata) {
             pa_usec_t sleep_usec = 0;
             bool on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
 
+            if (on_timeout)
+                u->telemetry_record.flags |= PA_ALSA_TELEMETRY_TIMEOUT;
+
             if (u->first) {
                 pa_log_info("Starting capture.");
                 snd_pcm_start(u->pcm_handle);
@@ -1492,6 +1520,8 @@ static void thread_func(void *userdata) {
                 /* We don't trust the conversion, so we wake up whatever comes first */
                 rtpoll_sleep = PA_MIN(sleep_usec, cusec);
             }
+
+            push_telemetry(u);
         }
 
         if (u->source->flags & PA_SOURCE_DEFERRED_VOLUME) {
@@ -1508,6 +1538,7 @@ static void thread_func(void *userdata) {
         if (rtpoll_sleep > 0) {
             pa_rtpoll_set_timer_relative(u->rtpoll, rtpoll_sleep);
             real_sleep = pa_rtclock_now();
+            u->telemetry_record.scheduled_usec = real_sleep + rtpoll_sleep;
         }
         else
             pa_rtpoll_set_timer_disabled(u->rtpoll);
@@ -1516,6 +1547,8 @@ static void thread_func(void *userdata) {
         if ((ret = pa_rtpoll_run(u->rtpoll)) < 0)
             goto fail;
 
+        u->telemetry_record.wakeup_usec = pa_rtclock_now();
+
         if (rtpoll_sleep > 0) {
             real_sleep = pa_rtclock_now() - real_sleep;
 #ifdef DEBUG_TIMING
@@ -1549,6 +1582,8 @@ static void thread_func(void *userdata) {
             }
 
             if (revents & ~POLLIN) {
+                u->telemetry_record.flags |= PA_ALSA_TELEMETRY_RECOVER;
+
                 if (pa_alsa_recover_from_poll(u->pcm_handle, revents) < 0)
                     goto fail;
 
@@ -2076,6 +2111,8 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
 
     pa_alsa_dump(PA_LOG_DEBUG, u->pcm_handle);
 
+    u->telemetry = pa_alsa_telemetry_new(m->core, "source", u->source->index, PA_ALSA_TELEMETRY_RECORDS_DEFAULT);
+
     thread_name = pa_sprintf_malloc("alsa-source-%s", pa_strnull(pa_proplist_gets(u->source->proplist, "alsa.id")));
     if (!(u->thread = pa_thread_new(thread_name, thread_func, u))) {
         pa_log("Failed to create thread.");
@@ -2169,6 +2206,9 @@ static void userdata_free(struct userdata *u) {
     if (u->smoother)
         pa_smoother_free(u->smoother);
 
+    if (u->telemetry)
+        pa_alsa_telemetry_free(u->telemetry);
+
     if (u->rates)
         pa_xfree(u->rates);
 
@@ -0,0 +1,313 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulse/rtclock.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#ifdef HAVE_DBUS
+#include <pulsecore/dbus-util.h>
+#include <pulsecore/protocol-dbus.h>
+#endif
+
+#include "alsa-telemetry.h"
+
+struct pa_alsa_telemetry {
+    pa_alsa_telemetry_record *records;
+    unsigned mask;
+
+    /* Number of records pushed. The IO thread fills in the slot first and
+     * increments this afterwards, so readers only look at slots that have
+     * been written completely. A slot may still be overwritten while it is
+     * being copied, that's why readers check the index again afterwards. */
+    pa_atomic_t index;
+
+    /* e.g. "sink3", for the names of dump files */
+    char *name;
+
+#ifdef HAVE_DBUS
+    pa_dbus_protocol *dbus_protocol;
+    char *dbus_path;
+#endif
+};
+
+#ifdef HAVE_DBUS
+
+#define TELEMETRY_IFACE "org.PulseAudio.Ext.AlsaTelemetry1"
+
+static void handle_get_records(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_dump_records(DBusConnection *conn, DBusMessage *msg, void *userdata);
+
+enum method_handler_index {
+    METHOD_HANDLER_GET_RECORDS,
+    METHOD_HANDLER_DUMP_RECORDS,
+    METHOD_HANDLER_MAX
+};
+
+static pa_dbus_arg_info get_records_args[] = { { "total", "u", "out" },
+                                               { "records", "a(ttuuuu)", "out" } };
+static pa_dbus_arg_info dump_records_args[] = { { "file_name", "s", "out" } };
+
+static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
+    [METHOD_HANDLER_GET_RECORDS] = {
+        .method_name = "GetRecords",
+        .arguments = get_records_args,
+        .n_arguments = sizeof(get_records_args) / sizeof(pa_dbus_arg_info),
+        .receive_cb = handle_get_records },
+    [METHOD_HANDLER_DUMP_RECORDS] = {
+        .method_name = "DumpRecords",
+        .arguments = dump_records_args,
+        .n_arguments = sizeof(dump_records_args) / sizeof(pa_dbus_arg_info),
+        .receive_cb = handle_dump_records }
+};
+
+static pa_dbus_interface_info telemetry_interface_info = {
+    .name = TELEMETRY_IFACE,
+    .method_handlers = method_handlers,
+    .n_method_handlers = METHOD_HANDLER_MAX,
+    .property_handlers = NULL,
+    .n_property_handlers = 0,
+    .get_all_properties_cb = NULL,
+    .signals = NULL,
+    .n_signals = 0
+};
+
+static void handle_get_records(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_alsa_telemetry *t = userdata;
+    pa_alsa_telemetry_record *records;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter, array_iter, struct_iter;
+    dbus_uint32_t total;
+    unsigned i, n;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(t);
+
+    records = pa_xnew(pa_alsa_telemetry_record, t->mask + 1);
+    n = pa_alsa_telemetry_get(t, records, t->mask + 1, &total);
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_append_basic(&msg_iter, DBUS_TYPE_UINT32, &total));
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "(ttuuuu)", &array_iter));
+
+    for (i = 0; i < n; i++) {
+        dbus_uint64_t wakeup = records[i].wakeup_usec, scheduled = records[i].scheduled_usec;
+        dbus_uint32_t bytes = records[i].bytes, left = records[i].left;
+        dbus_uint32_t watermark = records[i].watermark_usec, flags = records[i].flags;
+
+        pa_assert_se(dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter));
+        pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &wakeup));
+        pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &scheduled));
+        pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &bytes));
+        pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &left));
+        pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &watermark));
+        pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &flags));
+        pa_assert_se(dbus_message_iter_close_container(&array_iter, &struct_iter));
+    }
+
+    pa_assert_se(dbus_message_iter_close_container(&msg_iter, &array_iter));
+    pa_assert_se(dbus_connection_send(conn, reply, NULL));
+    dbus_message_unref(reply);
+
+    pa_xfree(records);
+}
+
+static void handle_dump_records(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_alsa_telemetry *t = userdata;
+    char *fn;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(t);
+
+    if (!(fn = pa_alsa_telemetry_dump(t))) {
+        pa_dbus_send_error(conn, msg, DBUS_ERROR_FAILED, "Failed to dump the telemetry records: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    pa_dbus_send_basic_value_reply(conn, msg, DBUS_TYPE_STRING, &fn);
+    pa_xfree(fn);
+}
+
+#endif /* HAVE_DBUS */
+
+pa_alsa_telemetry *pa_alsa_telemetry_new(pa_core *c, const char *object_name, uint32_t idx, unsigned n_records) {
+    pa_alsa_telemetry *t;
+
+    pa_assert(c);
+    pa_assert(object_name);
+    pa_assert(n_records > 0);
+
+    t = pa_xnew0(pa_alsa_telemetry, 1);
+    n_records = pa_make_power_of_two(n_records);
+    t->records = pa_xnew0(pa_alsa_telemetry_record, n_records);
+    t->mask = n_records - 1;
+    t->name = pa_sprintf_malloc("%s%u", object_name, idx);
+
+#ifdef HAVE_DBUS
+    t->dbus_protocol = pa_dbus_protocol_get(c);
+    t->dbus_path = pa_sprintf_malloc("%s/%s", PA_DBUS_CORE_OBJECT_PATH, t->name);
+
+    pa_assert_se(pa_dbus_protocol_add_interface(t->dbus_protocol, t->dbus_path, &telemetry_interface_info, t) >= 0);
+#endif
+
+    return t;
+}
+
+void pa_alsa_telemetry_free(pa_alsa_telemetry *t) {
+    pa_assert(t);
+
+#ifdef HAVE_DBUS
+    pa_assert_se(pa_dbus_protocol_remove_interface(t->dbus_protocol, t->dbus_path, telemetry_interface_info.name) >= 0);
+    pa_dbus_protocol_unref(t->dbus_protocol);
+    pa_xfree(t->dbus_path);
+#endif
+
+    pa_xfree(t->name);
+    pa_xfree(t->records);
+    pa_xfree(t);
+}
+
+void pa_alsa_telemetry_push(pa_alsa_telemetry *t, const pa_alsa_telemetry_record *r) {
+    unsigned i;
+
+    pa_assert(t);
+    pa_assert(r);
+
+    /* We are the only writer, no need to be careful here */
+    i = (unsigned) pa_atomic_load(&t->index);
+    t->records[i & t->mask] = *r;
+
+    /* Full barrier, the record must be visible before the index is */
+    pa_atomic_inc(&t->index);
+}
+
+unsigned pa_alsa_telemetry_get(pa_alsa_telemetry *t, pa_alsa_telemetry_record *r, unsigned n, uint32_t *total) {
+    unsigned begin, end, valid, i;
+
+    pa_assert(t);
+    pa_assert(r);
+
+    end = (unsigned) pa_atomic_load(&t->index);
+    n = PA_MIN(n, t->mask + 1);
+    n = PA_MIN(n, end);
+    begin = end - n;
+
+    for (i = 0; i < n; i++)
+        r[i] = t->records[(begin + i) & t->mask];
+
+    /* While we were copying, the IO thread may have pushed more records
+     * and may be busy writing the next one. Everything that is older than
+     * the ring size from that one on may have been overwritten. */
+    valid = (unsigned) pa_atomic_load(&t->index) + 1 - (t->mask + 1);
+
+    if (n > 0 && (int) (valid - begin) > 0) {
+        unsigned lost = PA_MIN(valid - begin, n);
+
+        memmove(r, r + lost, (n - lost) * sizeof(pa_alsa_telemetry_record));
+        n -= lost;
+    }
+
+    if (total)
+        *total = end;
+
+    return n;
+}
+
+char *pa_alsa_telemetry_dump(pa_alsa_telemetry *t) {
+    pa_alsa_telemetry_file_header h;
+    pa_alsa_telemetry_record *records;
+    char *fn, *r = NULL;
+    size_t l;
+    int fd, saved_errno;
+
+    pa_assert(t);
+
+    /* The file name is not up to the caller, and we never write through
+     * a file that is already there */
+    r = pa_sprintf_malloc("telemetry-%s-%llu.dump", t->name, (unsigned long long) pa_rtclock_now());
+    fn = pa_runtime_path(r);
+    pa_xfree(r);
+    r = NULL;
+
+    if (!fn)
+        return NULL;
+
+    records = pa_xnew(pa_alsa_telemetry_record, t->mask + 1);
+
+    pa_zero(h);
+    memcpy(h.magic, PA_ALSA_TELEMETRY_MAGIC, sizeof(h.magic));
+    h.version = PA_ALSA_TELEMETRY_VERSION;
+    h.record_size = sizeof(pa_alsa_telemetry_record);
+    h.n_records = pa_alsa_telemetry_get(t, records, t->mask + 1, &h.total);
+
+    if ((fd = pa_open_cloexec(fn, O_WRONLY|O_CREAT|O_EXCL
+#ifdef O_NOFOLLOW
+                              |O_NOFOLLOW
+#endif
+                              , 0600)) < 0) {
+        pa_log("Failed to open telemetry dump file '%s': %s", fn, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    errno = 0;
+    l = h.n_records * sizeof(pa_alsa_telemetry_record);
+
+    if (pa_loop_write(fd, &h, sizeof(h), NULL) != (ssize_t) sizeof(h) ||
+        pa_loop_write(fd, records, l, NULL) != (ssize_t) l) {
+        saved_errno = errno ? errno : EIO;
+        pa_log("Failed to write telemetry dump file '%s': %s", fn, pa_cstrerror(saved_errno));
+        pa_close(fd);
+        unlink(fn);
+        errno = saved_errno;
+        goto finish;
+    }
+
+    if (pa_close(fd) < 0) {
+        pa_log("Failed to close telemetry dump file '%s': %s", fn, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    pa_log_info("Dumped %u telemetry records to '%s'.", h.n_records, fn);
+    r = fn;
+    fn = NULL;
+
+finish:
+    saved_errno = errno;
+    pa_xfree(records);
+    pa_xfree(fn);
+    errno = saved_errno;
+
+    return r;
+}
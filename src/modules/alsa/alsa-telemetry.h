@@ -0,0 +1,85 @@
+#ifndef fooalsatelemetryhfoo
+#define fooalsatelemetryhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/core.h>
+
+/* A fixed size ring of the last IO thread iterations of an ALSA sink or
+ * source, to correlate dropouts with scheduling delays after the fact. The
+ * IO thread is the only writer, the main thread can read the ring at any
+ * time without locking. */
+
+#define PA_ALSA_TELEMETRY_RECORDS_DEFAULT 1024
+
+typedef enum pa_alsa_telemetry_flags {
+    PA_ALSA_TELEMETRY_TIMEOUT = 0x0001U,          /* Woken up by the timer */
+    PA_ALSA_TELEMETRY_XRUN = 0x0002U,             /* Underrun (sink) or overrun (source) detected */
+    PA_ALSA_TELEMETRY_RECOVER = 0x0004U,          /* The PCM had to be recovered */
+    PA_ALSA_TELEMETRY_WATERMARK_INC = 0x0008U,
+    PA_ALSA_TELEMETRY_WATERMARK_DEC = 0x0010U,
+    PA_ALSA_TELEMETRY_LATENCY_INC = 0x0020U       /* The watermark maxed out, min latency was raised */
+} pa_alsa_telemetry_flags_t;
+
+/* This is also the on-disk layout of the dumps, in host byte order */
+typedef struct pa_alsa_telemetry_record {
+    uint64_t wakeup_usec;       /* When the thread woke up, pa_rtclock_now() */
+    uint64_t scheduled_usec;    /* When the timer was set to wake it up, 0 if there was no timer */
+    uint32_t bytes;             /* Bytes written or read in this iteration */
+    uint32_t left;              /* Bytes left to play or record, as found by check_left_to_play/record() */
+    uint32_t watermark_usec;    /* Wakeup watermark after this iteration */
+    uint32_t flags;             /* pa_alsa_telemetry_flags_t */
+} pa_alsa_telemetry_record;
+
+typedef struct pa_alsa_telemetry pa_alsa_telemetry;
+
+/* If D-Bus support is available, this registers the
+ * org.PulseAudio.Ext.AlsaTelemetry1 interface on the D-Bus object of the
+ * device, i.e. /org/pulseaudio/core1/<object_name><idx>, where object_name
+ * is "sink" or "source" */
+pa_alsa_telemetry *pa_alsa_telemetry_new(pa_core *c, const char *object_name, uint32_t idx, unsigned n_records);
+void pa_alsa_telemetry_free(pa_alsa_telemetry *t);
+
+/* Called from the IO thread */
+void pa_alsa_telemetry_push(pa_alsa_telemetry *t, const pa_alsa_telemetry_record *r);
+
+/* Copies up to n of the most recent records to r, oldest first, and
+ * returns how many were copied. If total is not NULL it is set to the
+ * number of records pushed since creation (modulo 2^32), which tells how
+ * many were lost. */
+unsigned pa_alsa_telemetry_get(pa_alsa_telemetry *t, pa_alsa_telemetry_record *r, unsigned n, uint32_t *total);
+
+/* Writes a pa_alsa_telemetry_file_header followed by the records to a new
+ * file in the runtime directory, and returns its name, which the caller
+ * has to free. Returns NULL and sets errno on failure. */
+char *pa_alsa_telemetry_dump(pa_alsa_telemetry *t);
+
+#define PA_ALSA_TELEMETRY_MAGIC "PATLMTRY"
+#define PA_ALSA_TELEMETRY_VERSION 1
+
+typedef struct pa_alsa_telemetry_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t total;
+    uint32_t n_records;
+} pa_alsa_telemetry_file_header;
+
+#endif
@@ -37,6 +37,10 @@ static void handle_get_current_memblocks_size(DBusConnection *conn, DBusMessage
 static void handle_get_accumulated_memblocks(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_get_accumulated_memblocks_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_get_sample_cache_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_pool_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_pool_used_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_pool_used_size_max(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_pool_fallbacks(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
 static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
@@ -52,6 +56,10 @@ enum property_handler_index {
     PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS,
     PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS_SIZE,
     PROPERTY_HANDLER_SAMPLE_CACHE_SIZE,
+    PROPERTY_HANDLER_POOL_SIZE,
+    PROPERTY_HANDLER_POOL_USED_SIZE,
+    PROPERTY_HANDLER_POOL_USED_SIZE_MAX,
+    PROPERTY_HANDLER_POOL_FALLBACKS,
     PROPERTY_HANDLER_MAX
 };
 
@@ -60,7 +68,11 @@ static pa_dbus_property_handler property_handlers[PROPERTY_HANDLER_MAX] = {
     [PROPERTY_HANDLER_CURRENT_MEMBLOCKS_SIZE]     = { .property_name = "CurrentMemblocksSize",     .type = "u", .get_cb = handle_get_current_memblocks_size,     .set_cb = NULL },
     [PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS]      = { .property_name = "AccumulatedMemblocks",     .type = "u", .get_cb = handle_get_accumulated_memblocks,      .set_cb = NULL },
     [PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS_SIZE] = { .property_name = "AccumulatedMemblocksSize", .type = "u", .get_cb = handle_get_accumulated_memblocks_size, .set_cb = NULL },
-    [PROPERTY_HANDLER_SAMPLE_CACHE_SIZE]          = { .property_name = "SampleCacheSize",          .type = "u", .get_cb = handle_get_sample_cache_size,          .set_cb = NULL }
+    [PROPERTY_HANDLER_SAMPLE_CACHE_SIZE]          = { .property_name = "SampleCacheSize",          .type = "u", .get_cb = handle_get_sample_cache_size,          .set_cb = NULL },
+    [PROPERTY_HANDLER_POOL_SIZE]                  = { .property_name = "PoolSize",                 .type = "u", .get_cb = handle_get_pool_size,                  .set_cb = NULL },
+    [PROPERTY_HANDLER_POOL_USED_SIZE]             = { .property_name = "PoolUsedSize",             .type = "u", .get_cb = handle_get_pool_used_size,             .set_cb = NULL },
+    [PROPERTY_HANDLER_POOL_USED_SIZE_MAX]         = { .property_name = "PoolUsedSizeMax",          .type = "u", .get_cb = handle_get_pool_used_size_max,         .set_cb = NULL },
+    [PROPERTY_HANDLER_POOL_FALLBACKS]             = { .property_name = "PoolFallbacks",            .type = "u", .get_cb = handle_get_pool_fallbacks,             .set_cb = NULL }
 };
 
 static pa_dbus_interface_info memstats_interface_info = {
@@ -151,6 +163,70 @@ static void handle_get_sample_cache_size(DBusConnection *conn, DBusMessage *msg,
     pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &sample_cache_size);
 }
 
+static void handle_get_pool_size(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    const pa_mempool_stat *stat;
+    dbus_uint32_t pool_size;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    stat = pa_mempool_get_stat(m->core->mempool);
+
+    pool_size = pa_atomic_load(&stat->pool_size);
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &pool_size);
+}
+
+static void handle_get_pool_used_size(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    const pa_mempool_stat *stat;
+    dbus_uint32_t pool_used_size;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    stat = pa_mempool_get_stat(m->core->mempool);
+
+    pool_used_size = pa_atomic_load(&stat->pool_used_size);
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &pool_used_size);
+}
+
+static void handle_get_pool_used_size_max(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    const pa_mempool_stat *stat;
+    dbus_uint32_t pool_used_size_max;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    stat = pa_mempool_get_stat(m->core->mempool);
+
+    pool_used_size_max = pa_atomic_load(&stat->pool_used_size_max);
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &pool_used_size_max);
+}
+
+static void handle_get_pool_fallbacks(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    const pa_mempool_stat *stat;
+    dbus_uint32_t pool_fallbacks;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    stat = pa_mempool_get_stat(m->core->mempool);
+
+    pool_fallbacks = pa_atomic_load(&stat->n_fallback);
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &pool_fallbacks);
+}
+
 static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_memstats *m = userdata;
     const pa_mempool_stat *stat;
@@ -159,6 +235,10 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     dbus_uint32_t accumulated_memblocks;
     dbus_uint32_t accumulated_memblocks_size;
     dbus_uint32_t sample_cache_size;
+    dbus_uint32_t pool_size;
+    dbus_uint32_t pool_used_size;
+    dbus_uint32_t pool_used_size_max;
+    dbus_uint32_t pool_fallbacks;
     DBusMessage *reply = NULL;
     DBusMessageIter msg_iter;
     DBusMessageIter dict_iter;
@@ -174,6 +254,10 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     accumulated_memblocks = pa_atomic_load(&stat->n_accumulated);
     accumulated_memblocks_size = pa_atomic_load(&stat->accumulated_size);
     sample_cache_size = pa_scache_total_size(m->core);
+    pool_size = pa_atomic_load(&stat->pool_size);
+    pool_used_size = pa_atomic_load(&stat->pool_used_size);
+    pool_used_size_max = pa_atomic_load(&stat->pool_used_size_max);
+    pool_fallbacks = pa_atomic_load(&stat->n_fallback);
 
     pa_assert_se((reply = dbus_message_new_method_return(msg)));
 
@@ -185,6 +269,10 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS].property_name, DBUS_TYPE_UINT32, &accumulated_memblocks);
     pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS_SIZE].property_name, DBUS_TYPE_UINT32, &accumulated_memblocks_size);
     pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_CACHE_SIZE].property_name, DBUS_TYPE_UINT32, &sample_cache_size);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_POOL_SIZE].property_name, DBUS_TYPE_UINT32, &pool_size);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_POOL_USED_SIZE].property_name, DBUS_TYPE_UINT32, &pool_used_size);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_POOL_USED_SIZE_MAX].property_name, DBUS_TYPE_UINT32, &pool_used_size_max);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_POOL_FALLBACKS].property_name, DBUS_TYPE_UINT32, &pool_fallbacks);
 
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
 
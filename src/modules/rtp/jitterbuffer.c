@@ -0,0 +1,506 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sconv.h>
+
+#include "jitterbuffer.h"
+
+/* Must be a power of two. Packets more than this far ahead of or behind
+ * the next expected one make us resynchronize. */
+#define N_SLOTS 64
+
+/* Packets after a gap are held back for at least this long, and for
+ * DELAY_JITTER_FACTOR times the measured jitter if that is longer */
+#define MIN_DELAY_USEC ((pa_usec_t) (2*PA_USEC_PER_MSEC))
+#define DELAY_JITTER_FACTOR 3
+
+/* How much of the received audio is kept around for concealment, and
+ * the range of periods that are considered for repetition */
+#define HISTORY_USEC (30*PA_USEC_PER_MSEC)
+#define PERIOD_MIN_USEC (2500)
+#define PERIOD_MAX_USEC (15*PA_USEC_PER_MSEC)
+
+/* Concealment is played at full level for FADE_START_USEC, and is then
+ * faded out to silence over FADE_LENGTH_USEC */
+#define FADE_START_USEC (20*PA_USEC_PER_MSEC)
+#define FADE_LENGTH_USEC (40*PA_USEC_PER_MSEC)
+
+/* Length of the crossfade from concealment back to received audio */
+#define CROSSFADE_USEC (2500)
+
+/* Gaps longer than this are not concealed, but left to the caller */
+#define MAX_CONCEAL_USEC (PA_USEC_PER_SEC)
+
+struct slot {
+    bool valid;
+    uint32_t timestamp;
+    pa_memchunk chunk;
+};
+
+struct pa_jitter_buffer {
+    pa_mempool *pool;
+    pa_sample_spec ss;
+    size_t frame_size;
+    pa_convert_func_t to_float, from_float;
+
+    struct slot slots[N_SLOTS];
+    unsigned n_held;
+    bool synced;
+    uint16_t next_sequence;
+
+    /* The timestamp that follows the last chunk we handed out */
+    bool have_next_timestamp;
+    uint32_t next_timestamp;
+
+    /* Whether packets are held back waiting for a missing one, and since
+     * when */
+    bool in_gap;
+    pa_usec_t gap_since;
+
+    /* Interarrival jitter estimation, in timestamp units */
+    bool have_transit;
+    uint32_t last_transit;
+    double jitter;
+    pa_usec_t max_delay;
+
+    /* The last received audio, interleaved float, and its mono downmix
+     * for finding the period */
+    float *history, *mono;
+    size_t history_max, history_length;
+
+    /* Conversion buffer */
+    float *work;
+    size_t work_frames;
+
+    bool concealing;
+    size_t period, period_pos, concealed;
+    size_t period_min, period_max, fade_start, fade_length, crossfade, max_conceal;
+
+    pa_jitter_buffer_stats stats;
+};
+
+pa_jitter_buffer* pa_jitter_buffer_new(pa_mempool *pool, const pa_sample_spec *ss, pa_usec_t max_delay) {
+    pa_jitter_buffer *jb;
+
+    pa_assert(pool);
+    pa_assert(ss);
+    pa_assert(pa_sample_spec_valid(ss));
+
+    jb = pa_xnew0(pa_jitter_buffer, 1);
+    jb->pool = pool;
+    jb->ss = *ss;
+    jb->frame_size = pa_frame_size(ss);
+    pa_assert_se(jb->to_float = pa_get_convert_to_float32ne_function(ss->format));
+    pa_assert_se(jb->from_float = pa_get_convert_from_float32ne_function(ss->format));
+    jb->max_delay = PA_MAX(max_delay, MIN_DELAY_USEC);
+
+    jb->history_max = pa_usec_to_bytes(HISTORY_USEC, ss) / jb->frame_size;
+    jb->history = pa_xnew(float, jb->history_max * ss->channels);
+    jb->mono = pa_xnew(float, jb->history_max);
+
+    jb->period_min = PA_MAX(pa_usec_to_bytes(PERIOD_MIN_USEC, ss) / jb->frame_size, (size_t) 1);
+    jb->period_max = PA_MAX(pa_usec_to_bytes(PERIOD_MAX_USEC, ss) / jb->frame_size, jb->period_min);
+    jb->fade_start = pa_usec_to_bytes(FADE_START_USEC, ss) / jb->frame_size;
+    jb->fade_length = PA_MAX(pa_usec_to_bytes(FADE_LENGTH_USEC, ss) / jb->frame_size, (size_t) 1);
+    jb->crossfade = PA_MAX(pa_usec_to_bytes(CROSSFADE_USEC, ss) / jb->frame_size, (size_t) 1);
+    jb->max_conceal = pa_usec_to_bytes(MAX_CONCEAL_USEC, ss) / jb->frame_size;
+
+    return jb;
+}
+
+static void drop_held(pa_jitter_buffer *jb) {
+    unsigned i;
+
+    for (i = 0; i < N_SLOTS; i++)
+        if (jb->slots[i].valid) {
+            pa_memblock_unref(jb->slots[i].chunk.memblock);
+            jb->slots[i].valid = false;
+        }
+
+    jb->n_held = 0;
+    jb->in_gap = false;
+}
+
+/* Starts over with the next packet, keeping the jitter estimate */
+static void resync(pa_jitter_buffer *jb) {
+    drop_held(jb);
+
+    jb->synced = false;
+    jb->have_next_timestamp = false;
+    jb->concealing = false;
+    jb->history_length = 0;
+}
+
+void pa_jitter_buffer_reset(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    resync(jb);
+    jb->have_transit = false;
+}
+
+void pa_jitter_buffer_free(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    drop_held(jb);
+
+    pa_xfree(jb->history);
+    pa_xfree(jb->mono);
+    pa_xfree(jb->work);
+    pa_xfree(jb);
+}
+
+static float *work_buffer(pa_jitter_buffer *jb, size_t frames) {
+    if (jb->work_frames < frames) {
+        jb->work_frames = PA_MAX(frames, 2 * jb->work_frames);
+        jb->work = pa_xrealloc(jb->work, jb->work_frames * jb->ss.channels * sizeof(float));
+    }
+
+    return jb->work;
+}
+
+/* RFC 3550, A.8 */
+static void update_jitter(pa_jitter_buffer *jb, uint32_t timestamp, pa_usec_t now) {
+    uint32_t arrival, transit;
+    int32_t d;
+
+    arrival = (uint32_t) ((now / PA_USEC_PER_SEC) * jb->ss.rate + (now % PA_USEC_PER_SEC) * jb->ss.rate / PA_USEC_PER_SEC);
+    transit = arrival - timestamp;
+
+    if (jb->have_transit) {
+        d = (int32_t) (transit - jb->last_transit);
+        jb->jitter += (fabs((double) d) - jb->jitter) / 16.0;
+    }
+
+    jb->last_transit = transit;
+    jb->have_transit = true;
+}
+
+void pa_jitter_buffer_put(pa_jitter_buffer *jb, uint16_t sequence, uint32_t timestamp, const pa_memchunk *chunk, pa_usec_t now) {
+    struct slot *s;
+    int16_t d;
+
+    pa_assert(jb);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+    pa_assert(chunk->length % jb->frame_size == 0);
+
+    jb->stats.received++;
+    update_jitter(jb, timestamp, now);
+
+    if (!jb->synced) {
+        jb->next_sequence = sequence;
+        jb->synced = true;
+    }
+
+    d = (int16_t) (sequence - jb->next_sequence);
+
+    /* A sender that restarted or reordered badly would otherwise have all
+     * its packets dropped as late for a long time */
+    if (d >= N_SLOTS || d <= -N_SLOTS) {
+        pa_log_debug("Sequence number jumped by %i, resynchronizing.", (int) d);
+
+        resync(jb);
+        jb->next_sequence = sequence;
+        jb->synced = true;
+        d = 0;
+    }
+
+    if (d < 0) {
+        jb->stats.late++;
+        return;
+    }
+
+    s = &jb->slots[sequence & (N_SLOTS - 1)];
+
+    if (s->valid) {
+        jb->stats.duplicate++;
+        return;
+    }
+
+    s->valid = true;
+    s->timestamp = timestamp;
+    s->chunk = *chunk;
+    pa_memblock_ref(s->chunk.memblock);
+    jb->n_held++;
+
+    if (d > 0 && !jb->in_gap) {
+        jb->in_gap = true;
+        jb->gap_since = now;
+    }
+}
+
+/* Finds the period of the signal in the history by looking for the lag
+ * with the best normalized autocorrelation of the mono downmix */
+static size_t find_period(pa_jitter_buffer *jb) {
+    size_t n = jb->history_length, window, lag, best = 0, i;
+    unsigned c, channels = jb->ss.channels;
+    double best_score = 0;
+    float *mono;
+
+    window = PA_MIN(jb->period_max, n / 2);
+
+    if (window < jb->period_min)
+        return PA_MAX(n, 1U);
+
+    mono = jb->mono;
+    for (i = 0; i < n; i++) {
+        float sum = 0;
+
+        for (c = 0; c < channels; c++)
+            sum += jb->history[i * channels + c];
+
+        mono[i] = sum;
+    }
+
+    for (lag = jb->period_min; lag <= PA_MIN(jb->period_max, n - window); lag++) {
+        const float *a = mono + n - window, *b = a - lag;
+        double ab = 0, bb = 0, score;
+
+        for (i = 0; i < window; i++) {
+            ab += (double) a[i] * b[i];
+            bb += (double) b[i] * b[i];
+        }
+
+        if (bb <= 0)
+            continue;
+
+        score = ab / sqrt(bb);
+
+        if (best == 0 || score > best_score) {
+            best = lag;
+            best_score = score;
+        }
+    }
+
+    return best > 0 ? best : jb->period_min;
+}
+
+/* Writes the next frames of concealment, continuing where the last call
+ * left off */
+static void conceal_frames(pa_jitter_buffer *jb, float *d, size_t frames) {
+    unsigned c, channels = jb->ss.channels;
+    size_t i;
+
+    if (!jb->concealing) {
+        jb->concealing = true;
+        jb->period = jb->history_length > 0 ? find_period(jb) : 0;
+        jb->period_pos = 0;
+        jb->concealed = 0;
+    }
+
+    for (i = 0; i < frames; i++) {
+        float gain = 0;
+        const float *src;
+
+        if (jb->period > 0 && jb->concealed < jb->fade_start + jb->fade_length) {
+            if (jb->concealed < jb->fade_start)
+                gain = 1.0f;
+            else
+                gain = 1.0f - (float) (jb->concealed - jb->fade_start) / (float) jb->fade_length;
+        }
+
+        if (gain > 0) {
+            src = jb->history + (jb->history_length - jb->period + jb->period_pos) * channels;
+
+            for (c = 0; c < channels; c++)
+                d[c] = src[c] * gain;
+
+            jb->period_pos = (jb->period_pos + 1) % jb->period;
+        } else
+            for (c = 0; c < channels; c++)
+                d[c] = 0;
+
+        d += channels;
+        jb->concealed++;
+    }
+}
+
+static void conceal(pa_jitter_buffer *jb, size_t frames, pa_memchunk *chunk) {
+    float *f;
+    void *d;
+
+    f = work_buffer(jb, frames);
+    conceal_frames(jb, f, frames);
+
+    chunk->memblock = pa_memblock_new(jb->pool, frames * jb->frame_size);
+    chunk->index = 0;
+    chunk->length = frames * jb->frame_size;
+
+    d = pa_memblock_acquire(chunk->memblock);
+    jb->from_float(frames * jb->ss.channels, f, d);
+    pa_memblock_release(chunk->memblock);
+
+    jb->stats.concealed_frames += frames;
+}
+
+static void append_history(pa_jitter_buffer *jb, const void *d, size_t frames) {
+    unsigned channels = jb->ss.channels;
+    float *f;
+
+    if (frames > jb->history_max) {
+        d = (const uint8_t*) d + (frames - jb->history_max) * jb->frame_size;
+        frames = jb->history_max;
+    }
+
+    if (jb->history_length + frames > jb->history_max) {
+        size_t keep = jb->history_max - frames;
+
+        memmove(jb->history, jb->history + (jb->history_length - keep) * channels, keep * channels * sizeof(float));
+        jb->history_length = keep;
+    }
+
+    f = jb->history + jb->history_length * channels;
+    jb->to_float(frames * channels, d, f);
+    jb->history_length += frames;
+}
+
+/* Hands out a received packet. If we were concealing until now, the
+ * beginning of the packet is crossfaded with the continued concealment. */
+static void release(pa_jitter_buffer *jb, struct slot *s, pa_memchunk *chunk, uint32_t *timestamp) {
+    size_t frames = s->chunk.length / jb->frame_size;
+    void *dst;
+
+    *chunk = s->chunk;
+    *timestamp = s->timestamp;
+
+    if (jb->concealing) {
+        size_t n = PA_MIN(jb->crossfade, frames), i;
+        unsigned c, channels = jb->ss.channels;
+        float *f, *cf;
+        const void *src;
+
+        f = work_buffer(jb, 2 * n);
+        cf = f + n * channels;
+        conceal_frames(jb, cf, n);
+
+        chunk->memblock = pa_memblock_new(jb->pool, s->chunk.length);
+        chunk->index = 0;
+
+        src = pa_memblock_acquire_chunk(&s->chunk);
+        dst = pa_memblock_acquire(chunk->memblock);
+
+        memcpy(dst, src, s->chunk.length);
+        jb->to_float(n * channels, src, f);
+
+        for (i = 0; i < n; i++) {
+            float w = ((float) i + 0.5f) / (float) n;
+
+            for (c = 0; c < channels; c++)
+                f[i * channels + c] = w * f[i * channels + c] + (1.0f - w) * cf[i * channels + c];
+        }
+
+        jb->from_float(n * channels, f, dst);
+
+        pa_memblock_release(s->chunk.memblock);
+        pa_memblock_unref(s->chunk.memblock);
+
+        jb->concealing = false;
+    } else
+        dst = pa_memblock_acquire_chunk(chunk);
+
+    append_history(jb, dst, frames);
+    pa_memblock_release(chunk->memblock);
+
+    s->valid = false;
+    jb->n_held--;
+
+    jb->next_sequence++;
+    jb->next_timestamp = *timestamp + (uint32_t) frames;
+    jb->have_next_timestamp = true;
+}
+
+int pa_jitter_buffer_get(pa_jitter_buffer *jb, pa_usec_t now, pa_memchunk *chunk, uint32_t *timestamp) {
+    struct slot *s;
+    unsigned d;
+    int32_t frames;
+
+    pa_assert(jb);
+    pa_assert(chunk);
+    pa_assert(timestamp);
+
+    if (jb->n_held <= 0)
+        return -1;
+
+    s = &jb->slots[jb->next_sequence & (N_SLOTS - 1)];
+
+    if (!s->valid) {
+        pa_assert(jb->in_gap);
+
+        if (now < jb->gap_since + pa_jitter_buffer_get_delay(jb))
+            return -1;
+
+        /* We waited long enough, give up on the missing packets */
+        for (d = 1; d < N_SLOTS; d++) {
+            s = &jb->slots[(jb->next_sequence + d) & (N_SLOTS - 1)];
+            if (s->valid)
+                break;
+        }
+
+        pa_assert(s->valid);
+
+        jb->stats.lost += d;
+        jb->next_sequence += (uint16_t) d;
+        jb->gap_since = now;
+
+        frames = jb->have_next_timestamp ? (int32_t) (s->timestamp - jb->next_timestamp) : 0;
+
+        if (frames > 0 && (size_t) frames <= jb->max_conceal) {
+            conceal(jb, (size_t) frames, chunk);
+            *timestamp = jb->next_timestamp;
+            jb->next_timestamp += (uint32_t) frames;
+            return 0;
+        }
+    }
+
+    release(jb, s, chunk, timestamp);
+
+    /* Is there another gap right after this packet? */
+    jb->in_gap = jb->n_held > 0 && !jb->slots[jb->next_sequence & (N_SLOTS - 1)].valid;
+
+    return 0;
+}
+
+pa_usec_t pa_jitter_buffer_get_jitter(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    return (pa_usec_t) (jb->jitter * PA_USEC_PER_SEC / jb->ss.rate);
+}
+
+pa_usec_t pa_jitter_buffer_get_delay(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    return PA_CLAMP(MIN_DELAY_USEC + DELAY_JITTER_FACTOR * pa_jitter_buffer_get_jitter(jb), MIN_DELAY_USEC, jb->max_delay);
+}
+
+void pa_jitter_buffer_get_stats(pa_jitter_buffer *jb, pa_jitter_buffer_stats *stats) {
+    pa_assert(jb);
+    pa_assert(stats);
+
+    *stats = jb->stats;
+}
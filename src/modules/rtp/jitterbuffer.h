@@ -0,0 +1,73 @@
+#ifndef foojitterbufferhfoo
+#define foojitterbufferhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* Puts received RTP packets back into sequence number order. Packets are
+ * released as soon as they are in order. If a packet is missing, the ones
+ * after it are held back for a while, derived from the measured
+ * interarrival jitter. When that time has passed, the missing packet is
+ * given up on and the gap is concealed by repeating the last pitch period
+ * of the audio, fading out on longer gaps and crossfading back into the
+ * received audio. Packets arriving after their slot was played out are
+ * dropped. */
+
+typedef struct pa_jitter_buffer pa_jitter_buffer;
+
+typedef struct pa_jitter_buffer_stats {
+    uint64_t received;
+    uint64_t lost;
+    uint64_t late;
+    uint64_t duplicate;
+    uint64_t concealed_frames;
+} pa_jitter_buffer_stats;
+
+/* max_delay is the upper limit for holding back packets while waiting
+ * for a missing one */
+pa_jitter_buffer* pa_jitter_buffer_new(pa_mempool *pool, const pa_sample_spec *ss, pa_usec_t max_delay);
+void pa_jitter_buffer_free(pa_jitter_buffer *jb);
+
+/* Drops everything that is held back and starts over with the next
+ * packet, e.g. when the sink was suspended */
+void pa_jitter_buffer_reset(pa_jitter_buffer *jb);
+
+/* Hands a received packet to the jitter buffer, which takes its own
+ * reference of the memblock. now is the arrival time of the packet. */
+void pa_jitter_buffer_put(pa_jitter_buffer *jb, uint16_t sequence, uint32_t timestamp, const pa_memchunk *chunk, pa_usec_t now);
+
+/* Returns the next chunk of audio in playout order together with its RTP
+ * timestamp, which is either a received packet or concealment for lost
+ * ones. Returns a negative value if there is nothing to play out yet. The
+ * caller needs to unref the memblock. */
+int pa_jitter_buffer_get(pa_jitter_buffer *jb, pa_usec_t now, pa_memchunk *chunk, uint32_t *timestamp);
+
+/* The interarrival jitter estimate as defined in RFC 3550 */
+pa_usec_t pa_jitter_buffer_get_jitter(pa_jitter_buffer *jb);
+
+/* How long packets after a missing one are currently held back */
+pa_usec_t pa_jitter_buffer_get_delay(pa_jitter_buffer *jb);
+
+void pa_jitter_buffer_get_stats(pa_jitter_buffer *jb, pa_jitter_buffer_stats *stats);
+
+#endif
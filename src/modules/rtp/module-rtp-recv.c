@@ -56,6 +56,7 @@
 #include "module-rtp-recv-symdef.h"
 
 #include "rtp.h"
+#include "jitterbuffer.h"
 #include "sdp.h"
 #include "sap.h"
 
@@ -67,11 +68,14 @@ PA_MODULE_USAGE(
         "sink=<name of the sink> "
         "sap_address=<multicast address to listen on> "
         "latency_msec=<latency in ms> "
+        "batch_size=<number of packets per receive call> "
+        "jitter_buffer=<reorder packets and conceal lost ones?> "
 );
 
 #define SAP_PORT 9875
 #define DEFAULT_SAP_ADDRESS "224.0.0.56"
 #define DEFAULT_LATENCY_MSEC 500
+#define DEFAULT_BATCH_SIZE 1
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*40)
 #define MAX_SESSIONS 16
 #define DEATH_TIMEOUT 20
@@ -81,6 +85,8 @@ static const char* const valid_modargs[] = {
     "sink",
     "sap_address",
     "latency_msec",
+    "batch_size",
+    "jitter_buffer",
     NULL
 };
 
@@ -98,6 +104,7 @@ struct session {
     struct pa_sdp_info sdp_info;
 
     pa_rtp_context rtp_context;
+    pa_jitter_buffer *jitter_buffer;
 
     pa_rtpoll_item *rtpoll_item;
 
@@ -129,6 +136,8 @@ struct userdata {
     int n_sessions;
 
     pa_usec_t latency;
+    unsigned batch_size;
+    bool jitter_buffer;
 };
 
 static void session_free(struct session *s);
@@ -202,29 +211,42 @@ static void sink_input_suspend_within_thread(pa_sink_input* i, bool b) {
         pa_memblockq_flush_read(s->memblockq);
     else
         s->first_packet = false;
+
+    /* What was held back is outdated either way */
+    if (s->jitter_buffer)
+        pa_jitter_buffer_reset(s->jitter_buffer);
 }
 
 /* Called from I/O thread context */
-static int rtpoll_work_cb(pa_rtpoll_item *i) {
-    pa_memchunk chunk;
+static void push_chunk(struct session *s, pa_memchunk *chunk, uint32_t timestamp) {
     int64_t k, j, delta;
-    struct timeval now = { 0, 0 };
-    struct session *s;
-    struct pollfd *p;
 
-    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+    /* Check whether there was a timestamp overflow */
+    k = (int64_t) timestamp - (int64_t) s->offset;
+    j = (int64_t) 0x100000000LL - (int64_t) s->offset + (int64_t) timestamp;
 
-    p = pa_rtpoll_item_get_pollfd(i, NULL);
+    if ((k < 0 ? -k : k) < (j < 0 ? -j : j))
+        delta = k;
+    else
+        delta = j;
 
-    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
-        pa_log("poll() signalled bad revents.");
-        return -1;
+    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, true);
+
+    if (pa_memblockq_push(s->memblockq, chunk) < 0) {
+        pa_log_warn("Queue overrun");
+        pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
     }
 
-    if ((p->revents & POLLIN) == 0)
-        return 0;
+/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
 
-    p->revents = 0;
+    /* The next timestamp we expect */
+    s->offset = timestamp + (uint32_t) (chunk->length / s->rtp_context.frame_size);
+}
+
+/* Called from I/O thread context */
+static int receive_packet(struct session *s) {
+    pa_memchunk chunk;
+    struct timeval now = { 0, 0 };
 
     if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
         return 0;
@@ -250,17 +272,6 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
         }
     }
 
-    /* Check whether there was a timestamp overflow */
-    k = (int64_t) s->rtp_context.timestamp - (int64_t) s->offset;
-    j = (int64_t) 0x100000000LL - (int64_t) s->offset + (int64_t) s->rtp_context.timestamp;
-
-    if ((k < 0 ? -k : k) < (j < 0 ? -j : j))
-        delta = k;
-    else
-        delta = j;
-
-    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, true);
-
     if (now.tv_sec == 0) {
         PA_ONCE_BEGIN {
             pa_log_warn("Using artificial time instead of timestamp");
@@ -269,17 +280,20 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
     } else
         pa_rtclock_from_wallclock(&now);
 
-    if (pa_memblockq_push(s->memblockq, &chunk) < 0) {
-        pa_log_warn("Queue overrun");
-        pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, true);
-    }
-
-/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
+    if (s->jitter_buffer) {
+        uint32_t timestamp;
 
-    pa_memblock_unref(chunk.memblock);
+        pa_jitter_buffer_put(s->jitter_buffer, s->rtp_context.sequence, s->rtp_context.timestamp, &chunk, pa_timeval_load(&now));
+        pa_memblock_unref(chunk.memblock);
 
-    /* The next timestamp we expect */
-    s->offset = s->rtp_context.timestamp + (uint32_t) (chunk.length / s->rtp_context.frame_size);
+        while (pa_jitter_buffer_get(s->jitter_buffer, pa_timeval_load(&now), &chunk, &timestamp) >= 0) {
+            push_chunk(s, &chunk, timestamp);
+            pa_memblock_unref(chunk.memblock);
+        }
+    } else {
+        push_chunk(s, &chunk, s->rtp_context.timestamp);
+        pa_memblock_unref(chunk.memblock);
+    }
 
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
@@ -291,6 +305,17 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
         pa_log_debug("Updating sample rate");
 
+        if (s->jitter_buffer) {
+            pa_jitter_buffer_stats stats;
+
+            pa_jitter_buffer_get_stats(s->jitter_buffer, &stats);
+            pa_log_debug("Jitter %0.2f ms, waiting %0.2f ms for missing packets, %llu received, %llu lost, %llu late, %llu concealed frames",
+                         (double) pa_jitter_buffer_get_jitter(s->jitter_buffer) / PA_USEC_PER_MSEC,
+                         (double) pa_jitter_buffer_get_delay(s->jitter_buffer) / PA_USEC_PER_MSEC,
+                         (unsigned long long) stats.received, (unsigned long long) stats.lost,
+                         (unsigned long long) stats.late, (unsigned long long) stats.concealed_frames);
+        }
+
         wi = pa_bytes_to_usec((uint64_t) pa_memblockq_get_write_index(s->memblockq), &s->sink_input->sample_spec);
         ri = pa_bytes_to_usec((uint64_t) pa_memblockq_get_read_index(s->memblockq), &s->sink_input->sample_spec);
 
@@ -385,6 +410,35 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
     return 1;
 }
 
+/* Called from I/O thread context */
+static int rtpoll_work_cb(pa_rtpoll_item *i) {
+    struct session *s;
+    struct pollfd *p;
+    int r = 0;
+
+    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+
+    p = pa_rtpoll_item_get_pollfd(i, NULL);
+
+    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
+        pa_log("poll() signalled bad revents.");
+        return -1;
+    }
+
+    if ((p->revents & POLLIN) == 0)
+        return 0;
+
+    p->revents = 0;
+
+    /* With batched receiving one POLLIN may have brought in several
+     * packets, make sure to process all of them */
+    do
+        r |= receive_packet(s);
+    while (pa_rtp_recv_pending(&s->rtp_context));
+
+    return r;
+}
+
 /* Called from I/O thread context */
 static void sink_input_attach(pa_sink_input *i) {
     struct session *s;
@@ -587,7 +641,15 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
 
     pa_memblock_unref(silence.memblock);
 
+    /* Don't wait longer for a missing packet than half of what we keep
+     * in the queue, otherwise waiting makes us underrun */
+    if (u->jitter_buffer)
+        s->jitter_buffer = pa_jitter_buffer_new(u->module->core->mempool, &s->sdp_info.sample_spec,
+                                                (s->intended_latency - s->sink_latency) / 2);
+
     pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
+    if (pa_rtp_context_set_batch(&s->rtp_context, u->batch_size) < 0)
+        pa_log_warn("Batched receiving not supported on this platform, receiving one packet at a time.");
 
     pa_hashmap_put(s->userdata->by_origin, s->sdp_info.origin, s);
     u->n_sessions++;
@@ -621,6 +683,10 @@ static void session_free(struct session *s) {
     s->userdata->n_sessions--;
 
     pa_memblockq_free(s->memblockq);
+
+    if (s->jitter_buffer)
+        pa_jitter_buffer_free(s->jitter_buffer);
+
     pa_sdp_info_destroy(&s->sdp_info);
     pa_rtp_context_destroy(&s->rtp_context);
 
@@ -702,6 +768,8 @@ int pa__init(pa_module*m) {
     socklen_t salen;
     const char *sap_address;
     uint32_t latency_msec;
+    uint32_t batch_size = DEFAULT_BATCH_SIZE;
+    bool jitter_buffer = true;
     int fd = -1;
 
     pa_assert(m);
@@ -736,6 +804,16 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "batch_size", &batch_size) < 0 || batch_size < 1 || batch_size > PA_RTP_BATCH_MAX) {
+        pa_log("batch_size= expects a numerical argument between 1 and %u.", PA_RTP_BATCH_MAX);
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "jitter_buffer", &jitter_buffer) < 0) {
+        pa_log("jitter_buffer= expects a boolean argument.");
+        goto fail;
+    }
+
     if ((fd = mcast_socket(sa, salen)) < 0)
         goto fail;
 
@@ -744,6 +822,8 @@ int pa__init(pa_module*m) {
     u->core = m->core;
     u->sink_name = pa_xstrdup(pa_modargs_get_value(ma, "sink", NULL));
     u->latency = (pa_usec_t) latency_msec * PA_USEC_PER_MSEC;
+    u->batch_size = batch_size;
+    u->jitter_buffer = jitter_buffer;
 
     u->sap_event = m->core->mainloop->io_new(m->core->mainloop, fd, PA_IO_EVENT_INPUT, sap_event_cb, u);
     pa_sap_context_init_recv(&u->sap_context, fd);
@@ -67,11 +67,13 @@ PA_MODULE_USAGE(
         "mtu=<maximum transfer unit> "
         "loop=<loopback to local host?> "
         "ttl=<ttl value> "
+        "batch_size=<number of packets per send call> "
         "inhibit_auto_suspend=<always|never|only_with_non_monitor_sources>"
 );
 
 #define DEFAULT_PORT 46000
 #define DEFAULT_TTL 1
+#define DEFAULT_BATCH_SIZE 1
 #define SAP_PORT 9875
 #define DEFAULT_SOURCE_IP "0.0.0.0"
 #define DEFAULT_DESTINATION_IP "224.0.0.56"
@@ -91,6 +93,7 @@ static const char* const valid_modargs[] = {
     "mtu" ,
     "loop",
     "ttl",
+    "batch_size",
     "inhibit_auto_suspend",
     NULL
 };
@@ -212,6 +215,7 @@ int pa__init(pa_module*m) {
     const char *src_addr;
     uint32_t port = DEFAULT_PORT, mtu;
     uint32_t ttl = DEFAULT_TTL;
+    uint32_t batch_size = DEFAULT_BATCH_SIZE;
     sa_family_t af;
     int fd = -1, sap_fd = -1;
     pa_source *s;
@@ -302,6 +306,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "batch_size", &batch_size) < 0 || batch_size < 1 || batch_size > PA_RTP_BATCH_MAX) {
+        pa_log("batch_size= expects a numerical argument between 1 and %u.", PA_RTP_BATCH_MAX);
+        goto fail;
+    }
+
     src_addr = pa_modargs_get_value(ma, "source_ip", DEFAULT_SOURCE_IP);
 
     if (inet_pton(AF_INET, src_addr, &src_sa4.sin_addr) > 0) {
@@ -490,6 +499,8 @@ int pa__init(pa_module*m) {
     pa_xfree(n);
 
     pa_rtp_context_init_send(&u->rtp_context, fd, m->core->cookie, payload, pa_frame_size(&ss));
+    if (pa_rtp_context_set_batch(&u->rtp_context, batch_size) < 0)
+        pa_log_warn("Batched sending not supported on this platform, sending one packet at a time.");
     pa_sap_context_init_send(&u->sap_context, sap_fd, p);
 
     pa_log_info("RTP stream initialized with mtu %u on %s:%u from %s ttl=%u, SSRC=0x%08x, payload=%u, initial sequence #%u", mtu, dst_addr, port, src_addr, ttl, u->rtp_context.ssrc, payload, u->rtp_context.sequence);
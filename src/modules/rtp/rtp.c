@@ -35,6 +35,8 @@
 #include <sys/uio.h>
 #endif
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/core-error.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -54,6 +56,9 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
     c->payload = (uint8_t) (payload & 127U);
     c->frame_size = frame_size;
 
+    c->batch = 1;
+    c->batch_data = NULL;
+
     pa_memchunk_reset(&c->memchunk);
 
     return c;
@@ -61,6 +66,166 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
 
 #define MAX_IOVECS 16
 
+/* Receive buffers for batched I/O are at least this large, larger
+ * packets are dropped */
+#define BATCH_PACKET_SIZE 1500
+
+/* Room for the SCM_TIMESTAMP message in batched I/O */
+#define BATCH_AUX_SIZE 64
+
+struct rtp_packet {
+    uint32_t header[3];
+    struct iovec iov[MAX_IOVECS];
+    pa_memblock *mb[MAX_IOVECS];
+    unsigned n_iov;
+};
+
+struct pa_rtp_batch {
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+    struct mmsghdr msgs[PA_RTP_BATCH_MAX];
+#endif
+
+    /* Sending */
+    struct rtp_packet packets[PA_RTP_BATCH_MAX];
+
+    /* Receiving: the packets are stored back to back in slots of
+     * slot_size bytes in memblock, starting at index */
+    struct iovec iov[PA_RTP_BATCH_MAX];
+    uint8_t aux[PA_RTP_BATCH_MAX][BATCH_AUX_SIZE];
+    pa_memblock *memblock;
+    size_t index, slot_size;
+    unsigned n_received, next;
+};
+
+int pa_rtp_context_set_batch(pa_rtp_context *c, unsigned n) {
+    pa_assert(c);
+    pa_assert(n >= 1 && n <= PA_RTP_BATCH_MAX);
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+    if (n > 1 && !c->batch_data)
+        c->batch_data = pa_xnew0(struct pa_rtp_batch, 1);
+
+    c->batch = n;
+    return 0;
+#else
+    return n == 1 ? 0 : -1;
+#endif
+}
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+
+static int send_packets(pa_rtp_context *c, unsigned n_packets) {
+    struct pa_rtp_batch *b = c->batch_data;
+    unsigned i, j, sent = 0;
+    int ret = 0;
+
+    for (i = 0; i < n_packets; i++) {
+        struct msghdr *m = &b->msgs[i].msg_hdr;
+
+        b->packets[i].iov[0].iov_base = b->packets[i].header;
+        b->packets[i].iov[0].iov_len = sizeof(b->packets[i].header);
+
+        pa_zero(*m);
+        m->msg_iov = b->packets[i].iov;
+        m->msg_iovlen = (size_t) b->packets[i].n_iov;
+    }
+
+    while (sent < n_packets) {
+        int k;
+
+        if ((k = sendmmsg(c->fd, b->msgs + sent, n_packets - sent, MSG_DONTWAIT)) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno != EAGAIN) /* If the queue is full, just ignore it */
+                pa_log("sendmmsg() failed: %s", pa_cstrerror(errno));
+
+            ret = -1;
+            break;
+        }
+
+        sent += (unsigned) k;
+    }
+
+    for (i = 0; i < n_packets; i++)
+        for (j = 1; j < b->packets[i].n_iov; j++) {
+            pa_memblock_release(b->packets[i].mb[j]);
+            pa_memblock_unref(b->packets[i].mb[j]);
+        }
+
+    return ret;
+}
+
+/* Like the unbatched code path below, but the packets are collected
+ * and sent with one sendmmsg() call per c->batch packets */
+static int send_batched(pa_rtp_context *c, size_t size, pa_memblockq *q) {
+    struct pa_rtp_batch *b = c->batch_data;
+    struct rtp_packet *p = b->packets;
+    unsigned n_packets = 0;
+    size_t n = 0;
+
+    p->n_iov = 1;
+
+    for (;;) {
+        int r;
+        pa_memchunk chunk;
+
+        pa_memchunk_reset(&chunk);
+
+        if ((r = pa_memblockq_peek(q, &chunk)) >= 0) {
+
+            size_t k = n + chunk.length > size ? size - n : chunk.length;
+
+            pa_assert(chunk.memblock);
+
+            p->iov[p->n_iov].iov_base = pa_memblock_acquire_chunk(&chunk);
+            p->iov[p->n_iov].iov_len = k;
+            p->mb[p->n_iov] = chunk.memblock;
+            p->n_iov++;
+
+            n += k;
+            pa_memblockq_drop(q, k);
+        }
+
+        pa_assert(n % c->frame_size == 0);
+
+        if (r < 0 || n >= size || p->n_iov >= MAX_IOVECS) {
+            bool done;
+
+            if (n > 0) {
+                p->header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+                p->header[1] = htonl(c->timestamp);
+                p->header[2] = htonl(c->ssrc);
+
+                c->sequence++;
+                n_packets++;
+            }
+
+            c->timestamp += (unsigned) (n/c->frame_size);
+
+            done = r < 0 || pa_memblockq_get_length(q) < size;
+
+            if (n_packets > 0 && (done || n_packets >= c->batch)) {
+                if (send_packets(c, n_packets) < 0)
+                    return -1;
+
+                n_packets = 0;
+            }
+
+            if (done)
+                break;
+
+            n = 0;
+            p = b->packets + n_packets;
+            p->n_iov = 1;
+        }
+    }
+
+    return 0;
+}
+
+#endif
+
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
     struct iovec iov[MAX_IOVECS];
     pa_memblock* mb[MAX_IOVECS];
@@ -74,6 +239,11 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
     if (pa_memblockq_get_length(q) < size)
         return 0;
 
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+    if (c->batch > 1)
+        return send_batched(c, size, q);
+#endif
+
     for (;;) {
         int r;
         pa_memchunk chunk;
@@ -155,26 +325,219 @@ pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame
     c->fd = fd;
     c->frame_size = frame_size;
 
+    c->batch = 1;
+    c->batch_data = NULL;
+
     pa_memchunk_reset(&c->memchunk);
     return c;
 }
 
+/* Parses the RTP header of the packet of the given size that starts at
+ * chunk->index, and makes chunk point to the payload */
+static int parse_packet(pa_rtp_context *c, pa_memchunk *chunk, size_t size, struct msghdr *m, struct timeval *tstamp) {
+    struct cmsghdr *cm;
+    uint32_t header;
+    unsigned cc;
+    uint8_t *d;
+    bool found_tstamp = false;
+
+    if (size < 12) {
+        pa_log_warn("RTP packet too short.");
+        return -1;
+    }
+
+    d = pa_memblock_acquire_chunk(chunk);
+    memcpy(&header, d, sizeof(uint32_t));
+    memcpy(&c->timestamp, d + 4, sizeof(uint32_t));
+    memcpy(&c->ssrc, d + 8, sizeof(uint32_t));
+    pa_memblock_release(chunk->memblock);
+
+    header = ntohl(header);
+    c->timestamp = ntohl(c->timestamp);
+    c->ssrc = ntohl(c->ssrc);
+
+    if ((header >> 30) != 2) {
+        pa_log_warn("Unsupported RTP version.");
+        return -1;
+    }
+
+    if ((header >> 29) & 1) {
+        pa_log_warn("RTP padding not supported.");
+        return -1;
+    }
+
+    if ((header >> 28) & 1) {
+        pa_log_warn("RTP header extensions not supported.");
+        return -1;
+    }
+
+    cc = (header >> 24) & 0xF;
+    c->payload = (uint8_t) ((header >> 16) & 127U);
+    c->sequence = (uint16_t) (header & 0xFFFFU);
+
+    if (12 + cc*4 > size) {
+        pa_log_warn("RTP packet too short. (CSRC)");
+        return -1;
+    }
+
+    chunk->index += 12 + cc*4;
+    chunk->length = size - 12 + cc*4;
+
+    if (chunk->length % c->frame_size != 0) {
+        pa_log_warn("Bad RTP packet size.");
+        return -1;
+    }
+
+    for (cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR(m, cm))
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP) {
+            memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
+            found_tstamp = true;
+            break;
+        }
+
+    if (!found_tstamp) {
+        pa_log_warn("Couldn't find SCM_TIMESTAMP data in auxiliary recvmsg() data!");
+        pa_zero(*tstamp);
+    }
+
+    return 0;
+}
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+
+/* Receive up to c->batch packets with one recvmmsg() call */
+static int recv_packets(pa_rtp_context *c, pa_mempool *pool) {
+    struct pa_rtp_batch *b = c->batch_data;
+    unsigned i, n;
+    size_t slot_size;
+    uint8_t *d;
+    int size, r;
+
+    if (ioctl(c->fd, FIONREAD, &size) < 0) {
+        pa_log_warn("FIONREAD failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    /* FIONREAD only tells us about the first packet, so make room for
+     * at least a typical MTU */
+    slot_size = (size_t) PA_MAX(size, 1);
+    slot_size = PA_ALIGN(PA_MAX(slot_size, (size_t) BATCH_PACKET_SIZE));
+    n = (unsigned) PA_CLAMP(pa_mempool_block_size_max(pool) / slot_size, 1U, c->batch);
+
+    if (c->memchunk.length < n * slot_size) {
+        size_t l;
+
+        if (c->memchunk.memblock)
+            pa_memblock_unref(c->memchunk.memblock);
+
+        l = PA_MAX(n * slot_size, pa_mempool_block_size_max(pool));
+
+        c->memchunk.memblock = pa_memblock_new(pool, l);
+        c->memchunk.index = 0;
+        c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock);
+    }
+
+    d = (uint8_t*) pa_memblock_acquire_chunk(&c->memchunk);
+
+    for (i = 0; i < n; i++) {
+        struct msghdr *m = &b->msgs[i].msg_hdr;
+
+        b->iov[i].iov_base = d + i * slot_size;
+        b->iov[i].iov_len = slot_size;
+
+        pa_zero(*m);
+        m->msg_iov = &b->iov[i];
+        m->msg_iovlen = 1;
+        m->msg_control = b->aux[i];
+        m->msg_controllen = BATCH_AUX_SIZE;
+    }
+
+    r = recvmmsg(c->fd, b->msgs, n, MSG_DONTWAIT, NULL);
+    pa_memblock_release(c->memchunk.memblock);
+
+    if (r <= 0) {
+        if (r < 0 && errno != EAGAIN && errno != EINTR)
+            pa_log_warn("recvmmsg() failed: %s", pa_cstrerror(errno));
+
+        return -1;
+    }
+
+    b->memblock = pa_memblock_ref(c->memchunk.memblock);
+    b->index = c->memchunk.index;
+    b->slot_size = slot_size;
+    b->n_received = (unsigned) r;
+    b->next = 0;
+
+    c->memchunk.index += (unsigned) r * slot_size;
+    c->memchunk.length -= (unsigned) r * slot_size;
+
+    if (c->memchunk.length <= 0) {
+        pa_memblock_unref(c->memchunk.memblock);
+        pa_memchunk_reset(&c->memchunk);
+    }
+
+    return 0;
+}
+
+/* Hand out the next packet received by recv_packets() */
+static int recv_batched(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
+    struct pa_rtp_batch *b = c->batch_data;
+    struct mmsghdr *mm;
+    int r;
+
+    if (b->next >= b->n_received && recv_packets(c, pool) < 0)
+        return -1;
+
+    mm = &b->msgs[b->next];
+
+    chunk->memblock = pa_memblock_ref(b->memblock);
+    chunk->index = b->index + b->next * b->slot_size;
+    chunk->length = 0;
+
+    if (++b->next >= b->n_received) {
+        pa_memblock_unref(b->memblock);
+        b->memblock = NULL;
+    }
+
+    if (mm->msg_hdr.msg_flags & MSG_TRUNC) {
+        pa_log_warn("RTP packet too large.");
+        r = -1;
+    } else
+        r = parse_packet(c, chunk, mm->msg_len, &mm->msg_hdr, tstamp);
+
+    if (r < 0) {
+        pa_memblock_unref(chunk->memblock);
+        pa_memchunk_reset(chunk);
+    }
+
+    return r;
+}
+
+#endif
+
+bool pa_rtp_recv_pending(pa_rtp_context *c) {
+    pa_assert(c);
+
+    return c->batch_data && c->batch_data->next < c->batch_data->n_received;
+}
+
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
     int size;
     struct msghdr m;
-    struct cmsghdr *cm;
     struct iovec iov;
-    uint32_t header;
-    unsigned cc;
     ssize_t r;
     uint8_t aux[1024];
-    bool found_tstamp = false;
 
     pa_assert(c);
     pa_assert(chunk);
 
     pa_memchunk_reset(chunk);
 
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+    if (c->batch > 1)
+        return recv_batched(c, chunk, pool, tstamp);
+#endif
+
     if (ioctl(c->fd, FIONREAD, &size) < 0) {
         pa_log_warn("FIONREAD failed: %s", pa_cstrerror(errno));
         goto fail;
@@ -243,50 +606,8 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
         goto fail;
     }
 
-    if (size < 12) {
-        pa_log_warn("RTP packet too short.");
-        goto fail;
-    }
-
-    memcpy(&header, iov.iov_base, sizeof(uint32_t));
-    memcpy(&c->timestamp, (uint8_t*) iov.iov_base + 4, sizeof(uint32_t));
-    memcpy(&c->ssrc, (uint8_t*) iov.iov_base + 8, sizeof(uint32_t));
-
-    header = ntohl(header);
-    c->timestamp = ntohl(c->timestamp);
-    c->ssrc = ntohl(c->ssrc);
-
-    if ((header >> 30) != 2) {
-        pa_log_warn("Unsupported RTP version.");
-        goto fail;
-    }
-
-    if ((header >> 29) & 1) {
-        pa_log_warn("RTP padding not supported.");
-        goto fail;
-    }
-
-    if ((header >> 28) & 1) {
-        pa_log_warn("RTP header extensions not supported.");
-        goto fail;
-    }
-
-    cc = (header >> 24) & 0xF;
-    c->payload = (uint8_t) ((header >> 16) & 127U);
-    c->sequence = (uint16_t) (header & 0xFFFFU);
-
-    if (12 + cc*4 > (unsigned) size) {
-        pa_log_warn("RTP packet too short. (CSRC)");
+    if (parse_packet(c, chunk, (size_t) size, &m, tstamp) < 0)
         goto fail;
-    }
-
-    chunk->index += 12 + cc*4;
-    chunk->length = (size_t) size - 12 + cc*4;
-
-    if (chunk->length % c->frame_size != 0) {
-        pa_log_warn("Bad RTP packet size.");
-        goto fail;
-    }
 
     c->memchunk.index = chunk->index + chunk->length;
     c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock) - c->memchunk.index;
@@ -296,18 +617,6 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
         pa_memchunk_reset(&c->memchunk);
     }
 
-    for (cm = CMSG_FIRSTHDR(&m); cm; cm = CMSG_NXTHDR(&m, cm))
-        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP) {
-            memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
-            found_tstamp = true;
-            break;
-        }
-
-    if (!found_tstamp) {
-        pa_log_warn("Couldn't find SCM_TIMESTAMP data in auxiliary recvmsg() data!");
-        pa_zero(*tstamp);
-    }
-
     return 0;
 
 fail:
@@ -397,6 +706,13 @@ void pa_rtp_context_destroy(pa_rtp_context *c) {
 
     if (c->memchunk.memblock)
         pa_memblock_unref(c->memchunk.memblock);
+
+    if (c->batch_data) {
+        if (c->batch_data->memblock)
+            pa_memblock_unref(c->batch_data->memblock);
+
+        pa_xfree(c->batch_data);
+    }
 }
 
 const char* pa_rtp_format_to_string(pa_sample_format_t f) {
@@ -26,6 +26,11 @@
 #include <pulsecore/memblockq.h>
 #include <pulsecore/memchunk.h>
 
+/* Upper limit for pa_rtp_context_set_batch() */
+#define PA_RTP_BATCH_MAX 64
+
+struct pa_rtp_batch;
+
 typedef struct pa_rtp_context {
     int fd;
     uint16_t sequence;
@@ -35,6 +40,9 @@ typedef struct pa_rtp_context {
     size_t frame_size;
 
     pa_memchunk memchunk;
+
+    unsigned batch;
+    struct pa_rtp_batch *batch_data;
 } pa_rtp_context;
 
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size);
@@ -46,6 +54,16 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q);
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size);
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp);
 
+/* Send or receive up to n packets per sendmmsg()/recvmmsg() call instead of
+ * one packet per sendmsg()/recvmsg() call. n == 1 disables batching. Fails
+ * if the platform has no batched socket I/O. */
+int pa_rtp_context_set_batch(pa_rtp_context *c, unsigned n);
+
+/* In batched mode pa_rtp_recv() may receive several packets at once and
+ * return them one by one. Returns true if there are more packets that can
+ * be fetched with pa_rtp_recv() without polling the socket first. */
+bool pa_rtp_recv_pending(pa_rtp_context *c);
+
 void pa_rtp_context_destroy(pa_rtp_context *c);
 
 pa_sample_spec* pa_rtp_sample_spec_fixup(pa_sample_spec *ss);
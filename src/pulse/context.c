@@ -92,6 +92,8 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_ENABLE_SRBCHANNEL] = pa_command_enable_srbchannel,
     [PA_COMMAND_DISABLE_SRBCHANNEL] = pa_command_disable_srbchannel,
     [PA_COMMAND_REGISTER_MEMFD_SHMID] = pa_command_register_memfd_shmid,
+    [PA_COMMAND_PLAYBACK_STREAM_TIMING] = pa_command_stream_timing,
+    [PA_COMMAND_RECORD_STREAM_TIMING] = pa_command_stream_timing,
 };
 static void context_free(pa_context *c);
 
@@ -111,6 +113,8 @@ static void reset_callbacks(pa_context *c) {
 
     c->subscribe_callback = NULL;
     c->subscribe_userdata = NULL;
+    c->subscribe_state_callback = NULL;
+    c->subscribe_state_userdata = NULL;
 
     c->event_callback = NULL;
     c->event_userdata = NULL;
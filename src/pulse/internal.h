@@ -26,6 +26,7 @@
 #include <pulse/stream.h>
 #include <pulse/operation.h>
 #include <pulse/subscribe.h>
+#include <pulse/introspect.h>
 #include <pulse/ext-device-manager.h>
 #include <pulse/ext-device-restore.h>
 #include <pulse/ext-stream-restore.h>
@@ -87,6 +88,8 @@ struct pa_context {
     void *state_userdata;
     pa_context_subscribe_cb_t subscribe_callback;
     void *subscribe_userdata;
+    pa_context_subscribe_state_cb_t subscribe_state_callback;
+    void *subscribe_state_userdata;
     pa_context_event_cb_t event_callback;
     void *event_userdata;
 
@@ -165,6 +168,7 @@ struct pa_stream {
     bool corked:1;
     bool timing_info_valid:1;
     bool auto_timing_update_requested:1;
+    bool timing_push:1;
 
     uint32_t channel;
     uint32_t syncid;
@@ -260,6 +264,7 @@ void pa_command_stream_started(pa_pdispatch *pd, uint32_t command, uint32_t tag,
 void pa_command_stream_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 void pa_command_stream_buffer_attr(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+void pa_command_stream_timing(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 
 pa_operation *pa_operation_new(pa_context *c, pa_stream *s, pa_operation_cb_t callback, void *userdata);
 void pa_operation_done(pa_operation *o);
@@ -310,6 +315,22 @@ pa_tagstruct *pa_tagstruct_command(pa_context *c, uint32_t command, uint32_t *ta
 #define PA_FAIL_RETURN_NULL(context, error)     \
     PA_FAIL_RETURN_ANY(context, error, NULL)
 
+/* Storage for the object a pa_snapshot_entry points to */
+typedef union pa_snapshot_object {
+    pa_sink_info sink;
+    pa_source_info source;
+    pa_sink_input_info sink_input;
+    pa_source_output_info source_output;
+    pa_client_info client;
+    pa_module_info module;
+} pa_snapshot_object;
+
+/* Reads the object of type e->facility into o and points e to it. On
+ * success, the object has to be freed with pa_snapshot_object_free()
+ * afterwards. */
+int pa_snapshot_object_read(pa_context *c, pa_tagstruct *t, pa_snapshot_fields_t fields, pa_snapshot_object *o, pa_snapshot_entry *e);
+void pa_snapshot_object_free(pa_snapshot_object *o, pa_snapshot_entry *e);
+
 void pa_ext_device_manager_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
 void pa_ext_device_restore_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
 void pa_ext_stream_restore_command(pa_context *c, uint32_t tag, pa_tagstruct *t);
@@ -59,6 +59,11 @@ static void context_stat_callback(pa_pdispatch *pd, uint32_t command, uint32_t t
                pa_tagstruct_getu32(t, &i.memblock_allocated) < 0 ||
                pa_tagstruct_getu32(t, &i.memblock_allocated_size) < 0 ||
                pa_tagstruct_getu32(t, &i.scache_size) < 0 ||
+               (o->context->version >= 32 &&
+                (pa_tagstruct_getu32(t, &i.pool_size) < 0 ||
+                 pa_tagstruct_getu32(t, &i.pool_used_size) < 0 ||
+                 pa_tagstruct_getu32(t, &i.pool_used_size_max) < 0 ||
+                 pa_tagstruct_getu32(t, &i.pool_fallbacks) < 0)) ||
                !pa_tagstruct_eof(t)) {
         pa_context_fail(o->context, PA_ERR_PROTOCOL);
         goto finish;
@@ -133,11 +138,126 @@ pa_operation* pa_context_get_server_info(pa_context *c, pa_server_info_cb_t cb,
 
 /*** Sink Info ***/
 
+static void sink_info_free(pa_sink_info *i) {
+    uint32_t j;
+
+    if (i->formats) {
+        for (j = 0; j < i->n_formats; j++)
+            pa_format_info_free(i->formats[j]);
+        pa_xfree(i->formats);
+    }
+    if (i->ports) {
+        pa_xfree(i->ports[0]);
+        pa_xfree(i->ports);
+    }
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+/* The caller has to call sink_info_free() afterwards, even on failure */
+static int fill_sink_info(pa_context *c, pa_tagstruct *t, pa_sink_info *i, pa_snapshot_fields_t fields) {
+    bool mute = false;
+    uint32_t flags;
+    uint32_t state = PA_SINK_INVALID_STATE;
+    const char *ap = NULL;
+    uint32_t j;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->base_volume = PA_VOLUME_NORM;
+    i->n_volume_steps = PA_VOLUME_NORM+1;
+    i->card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i->monitor_source) < 0 ||
+        pa_tagstruct_gets(t, &i->monitor_source_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i->latency) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (((fields & PA_SNAPSHOT_FIELDS_PROPLIST) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+          pa_tagstruct_get_usec(t, &i->configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i->base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i->n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i->card) < 0)))
+        return -PA_ERR_PROTOCOL;
+
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_FIELDS_PORTS)) {
+        if (pa_tagstruct_getu32(t, &i->n_ports) < 0)
+            return -PA_ERR_PROTOCOL;
+
+        if (i->n_ports > 0) {
+            i->ports = pa_xnew(pa_sink_port_info*, i->n_ports+1);
+            i->ports[0] = pa_xnew(pa_sink_port_info, i->n_ports);
+
+            for (j = 0; j < i->n_ports; j++) {
+                i->ports[j] = &i->ports[0][j];
+
+                if (pa_tagstruct_gets(t, &i->ports[j]->name) < 0 ||
+                    pa_tagstruct_gets(t, &i->ports[j]->description) < 0 ||
+                    pa_tagstruct_getu32(t, &i->ports[j]->priority) < 0)
+                    return -PA_ERR_PROTOCOL;
+
+                i->ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        return -PA_ERR_PROTOCOL;
+                    i->ports[j]->available = av;
+                }
+            }
+
+            i->ports[j] = NULL;
+        }
+
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            return -PA_ERR_PROTOCOL;
+
+        if (ap) {
+            for (j = 0; j < i->n_ports; j++)
+                if (pa_streq(i->ports[j]->name, ap)) {
+                    i->active_port = i->ports[j];
+                    break;
+                }
+        }
+    }
+
+    if (c->version >= 21 && (fields & PA_SNAPSHOT_FIELDS_FORMATS)) {
+        uint8_t n_formats;
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
+            return -PA_ERR_PROTOCOL;
+
+        i->formats = pa_xnew0(pa_format_info*, n_formats);
+
+        for (j = 0; j < n_formats; j++) {
+            i->n_formats++;
+            i->formats[j] = pa_format_info_new();
+
+            if (pa_tagstruct_get_format_info(t, i->formats[j]) < 0)
+                return -PA_ERR_PROTOCOL;
+        }
+    }
+
+    i->mute = (int) mute;
+    i->flags = (pa_sink_flags_t) flags;
+    i->state = (pa_sink_state_t) state;
+
+    return 0;
+}
+
 static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
     pa_sink_info i;
-    uint32_t j;
 
     pa_assert(pd);
     pa_assert(o);
@@ -157,120 +277,15 @@ static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, u
     } else {
 
         while (!pa_tagstruct_eof(t)) {
-            bool mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap = NULL;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = false;
-            state = PA_SINK_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_source) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_source_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
-
+            if (fill_sink_info(o->context, t, &i, PA_SNAPSHOT_FIELDS_ALL) < 0)
                 goto fail;
-            }
-
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_sink_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_sink_port_info, i.n_ports);
-
-                    for (j = 0; j < i.n_ports; j++) {
-                        i.ports[j] = &i.ports[0][j];
-
-                        if (pa_tagstruct_gets(t, &i.ports[j]->name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[j]->description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[j]->priority) < 0) {
-
-                            goto fail;
-                        }
-
-                        i.ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[j]->available = av;
-                        }
-                    }
-
-                    i.ports[j] = NULL;
-                }
-
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
-
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
-                }
-            }
-
-            if (o->context->version >= 21) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
-
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
-
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
-
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
-
-            i.mute = (int) mute;
-            i.flags = (pa_sink_flags_t) flags;
-            i.state = (pa_sink_state_t) state;
 
             if (o->callback) {
                 pa_sink_info_cb_t cb = (pa_sink_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            sink_info_free(&i);
         }
     }
 
@@ -285,21 +300,8 @@ finish:
     return;
 
 fail:
-    pa_assert(i.proplist);
-
     pa_context_fail(o->context, PA_ERR_PROTOCOL);
-
-    if (i.formats) {
-        for (j = 0; j < i.n_formats; j++)
-            pa_format_info_free(i.formats[j]);
-        pa_xfree(i.formats);
-    }
-    if (i.ports) {
-        pa_xfree(i.ports[0]);
-        pa_xfree(i.ports);
-    }
-    pa_proplist_free(i.proplist);
-
+    sink_info_free(&i);
     goto finish;
 }
 
@@ -406,11 +408,126 @@ pa_operation* pa_context_set_sink_port_by_name(pa_context *c, const char *name,
 
 /*** Source info ***/
 
+static void source_info_free(pa_source_info *i) {
+    uint32_t j;
+
+    if (i->formats) {
+        for (j = 0; j < i->n_formats; j++)
+            pa_format_info_free(i->formats[j]);
+        pa_xfree(i->formats);
+    }
+    if (i->ports) {
+        pa_xfree(i->ports[0]);
+        pa_xfree(i->ports);
+    }
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+/* The caller has to call source_info_free() afterwards, even on failure */
+static int fill_source_info(pa_context *c, pa_tagstruct *t, pa_source_info *i, pa_snapshot_fields_t fields) {
+    bool mute = false;
+    uint32_t flags;
+    uint32_t state = PA_SOURCE_INVALID_STATE;
+    const char *ap = NULL;
+    uint32_t j;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->base_volume = PA_VOLUME_NORM;
+    i->n_volume_steps = PA_VOLUME_NORM+1;
+    i->card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i->monitor_of_sink) < 0 ||
+        pa_tagstruct_gets(t, &i->monitor_of_sink_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i->latency) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (((fields & PA_SNAPSHOT_FIELDS_PROPLIST) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+          pa_tagstruct_get_usec(t, &i->configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i->base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i->n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i->card) < 0)))
+        return -PA_ERR_PROTOCOL;
+
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_FIELDS_PORTS)) {
+        if (pa_tagstruct_getu32(t, &i->n_ports) < 0)
+            return -PA_ERR_PROTOCOL;
+
+        if (i->n_ports > 0) {
+            i->ports = pa_xnew(pa_source_port_info*, i->n_ports+1);
+            i->ports[0] = pa_xnew(pa_source_port_info, i->n_ports);
+
+            for (j = 0; j < i->n_ports; j++) {
+                i->ports[j] = &i->ports[0][j];
+
+                if (pa_tagstruct_gets(t, &i->ports[j]->name) < 0 ||
+                    pa_tagstruct_gets(t, &i->ports[j]->description) < 0 ||
+                    pa_tagstruct_getu32(t, &i->ports[j]->priority) < 0)
+                    return -PA_ERR_PROTOCOL;
+
+                i->ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        return -PA_ERR_PROTOCOL;
+                    i->ports[j]->available = av;
+                }
+            }
+
+            i->ports[j] = NULL;
+        }
+
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            return -PA_ERR_PROTOCOL;
+
+        if (ap) {
+            for (j = 0; j < i->n_ports; j++)
+                if (pa_streq(i->ports[j]->name, ap)) {
+                    i->active_port = i->ports[j];
+                    break;
+                }
+        }
+    }
+
+    if (c->version >= 22 && (fields & PA_SNAPSHOT_FIELDS_FORMATS)) {
+        uint8_t n_formats;
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
+            return -PA_ERR_PROTOCOL;
+
+        i->formats = pa_xnew0(pa_format_info*, n_formats);
+
+        for (j = 0; j < n_formats; j++) {
+            i->n_formats++;
+            i->formats[j] = pa_format_info_new();
+
+            if (pa_tagstruct_get_format_info(t, i->formats[j]) < 0)
+                return -PA_ERR_PROTOCOL;
+        }
+    }
+
+    i->mute = (int) mute;
+    i->flags = (pa_source_flags_t) flags;
+    i->state = (pa_source_state_t) state;
+
+    return 0;
+}
+
 static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
     pa_source_info i;
-    uint32_t j;
 
     pa_assert(pd);
     pa_assert(o);
@@ -430,120 +547,15 @@ static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command,
     } else {
 
         while (!pa_tagstruct_eof(t)) {
-            bool mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = false;
-            state = PA_SOURCE_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_of_sink) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_of_sink_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
-
+            if (fill_source_info(o->context, t, &i, PA_SNAPSHOT_FIELDS_ALL) < 0)
                 goto fail;
-            }
-
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_source_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_source_port_info, i.n_ports);
-
-                    for (j = 0; j < i.n_ports; j++) {
-                        i.ports[j] = &i.ports[0][j];
-
-                        if (pa_tagstruct_gets(t, &i.ports[j]->name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[j]->description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[j]->priority) < 0) {
-
-                            goto fail;
-                        }
-
-                        i.ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[j]->available = av;
-                        }
-                    }
-
-                    i.ports[j] = NULL;
-                }
-
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
-
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
-                }
-            }
-
-            if (o->context->version >= 22) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
-
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
-
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
-
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
-
-            i.mute = (int) mute;
-            i.flags = (pa_source_flags_t) flags;
-            i.state = (pa_source_state_t) state;
 
             if (o->callback) {
                 pa_source_info_cb_t cb = (pa_source_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            source_info_free(&i);
         }
     }
 
@@ -558,21 +570,8 @@ finish:
     return;
 
 fail:
-    pa_assert(i.proplist);
-
     pa_context_fail(o->context, PA_ERR_PROTOCOL);
-
-    if (i.formats) {
-        for (j = 0; j < i.n_formats; j++)
-            pa_format_info_free(i.formats[j]);
-        pa_xfree(i.formats);
-    }
-    if (i.ports) {
-        pa_xfree(i.ports[0]);
-        pa_xfree(i.ports);
-    }
-    pa_proplist_free(i.proplist);
-
+    source_info_free(&i);
     goto finish;
 }
 
@@ -679,6 +678,21 @@ pa_operation* pa_context_set_source_port_by_name(pa_context *c, const char *name
 
 /*** Client info ***/
 
+/* The caller has to free the proplist afterwards, even on failure */
+static int fill_client_info(pa_context *c, pa_tagstruct *t, pa_client_info *i, pa_snapshot_fields_t fields) {
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 13 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST) && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -PA_ERR_PROTOCOL;
+
+    return 0;
+}
+
 static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -700,15 +714,7 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
         while (!pa_tagstruct_eof(t)) {
             pa_client_info i;
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
-
+            if (fill_client_info(o->context, t, &i, PA_SNAPSHOT_FIELDS_ALL) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
                 pa_proplist_free(i.proplist);
                 goto finish;
@@ -1097,6 +1103,26 @@ pa_operation* pa_context_set_card_profile_by_name(pa_context *c, const char *nam
 
 /*** Module info ***/
 
+/* The caller has to free the proplist afterwards, even on failure */
+static int fill_module_info(pa_context *c, pa_tagstruct *t, pa_module_info *i, pa_snapshot_fields_t fields) {
+    bool auto_unload = false;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->argument) < 0 ||
+        pa_tagstruct_getu32(t, &i->n_used) < 0 ||
+        (c->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
+        (c->version >= 15 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST) && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -PA_ERR_PROTOCOL;
+
+    i->auto_unload = (int) auto_unload;
+
+    return 0;
+}
+
 static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1117,23 +1143,13 @@ static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command,
 
         while (!pa_tagstruct_eof(t)) {
             pa_module_info i;
-            bool auto_unload = false;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.argument) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_used) < 0 ||
-                (o->context->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
-                (o->context->version >= 15 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
+            if (fill_module_info(o->context, t, &i, PA_SNAPSHOT_FIELDS_ALL) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                pa_proplist_free(i.proplist);
                 goto finish;
             }
 
-            i.auto_unload = (int) auto_unload;
-
             if (o->callback) {
                 pa_module_info_cb_t cb = (pa_module_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
@@ -1182,6 +1198,43 @@ pa_operation* pa_context_get_module_info_list(pa_context *c, pa_module_info_cb_t
 
 /*** Sink input info ***/
 
+/* The caller has to free the proplist and format afterwards, even on
+ * failure */
+static int fill_sink_input_info(pa_context *c, pa_tagstruct *t, pa_sink_input_info *i, pa_snapshot_fields_t fields) {
+    bool mute = false, corked = false, has_volume = false, volume_writable = true;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i->client) < 0 ||
+        pa_tagstruct_getu32(t, &i->sink) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_usec(t, &i->buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i->sink_usec) < 0 ||
+        pa_tagstruct_gets(t, &i->resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
+        (c->version >= 13 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
+        (c->version >= 21 && (fields & PA_SNAPSHOT_FIELDS_FORMATS) && pa_tagstruct_get_format_info(t, i->format) < 0))
+        return -PA_ERR_PROTOCOL;
+
+    i->mute = (int) mute;
+    i->corked = (int) corked;
+    i->has_volume = (int) has_volume;
+    i->volume_writable = (int) volume_writable;
+
+    return 0;
+}
+
 static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1202,42 +1255,14 @@ static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t comm
 
         while (!pa_tagstruct_eof(t)) {
             pa_sink_input_info i;
-            bool mute = false, corked = false, has_volume = false, volume_writable = true;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.sink) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.sink_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
-                (o->context->version >= 21 && pa_tagstruct_get_format_info(t, i.format) < 0)) {
 
+            if (fill_sink_input_info(o->context, t, &i, PA_SNAPSHOT_FIELDS_ALL) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
                 pa_proplist_free(i.proplist);
                 pa_format_info_free(i.format);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
             if (o->callback) {
                 pa_sink_input_info_cb_t cb = (pa_sink_input_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
@@ -1287,6 +1312,43 @@ pa_operation* pa_context_get_sink_input_info_list(pa_context *c, void (*cb)(pa_c
 
 /*** Source output info ***/
 
+/* The caller has to free the proplist and format afterwards, even on
+ * failure */
+static int fill_source_output_info(pa_context *c, pa_tagstruct *t, pa_source_output_info *i, pa_snapshot_fields_t fields) {
+    bool mute = false, corked = false, has_volume = false, volume_writable = true;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i->client) < 0 ||
+        pa_tagstruct_getu32(t, &i->source) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_usec(t, &i->buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i->source_usec) < 0 ||
+        pa_tagstruct_gets(t, &i->resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 13 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 22 && (pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &mute) < 0 ||
+                              pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
+                              ((fields & PA_SNAPSHOT_FIELDS_FORMATS) && pa_tagstruct_get_format_info(t, i->format) < 0))))
+        return -PA_ERR_PROTOCOL;
+
+    i->mute = (int) mute;
+    i->corked = (int) corked;
+    i->has_volume = (int) has_volume;
+    i->volume_writable = (int) volume_writable;
+
+    return 0;
+}
+
 static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1307,42 +1369,14 @@ static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t c
 
         while (!pa_tagstruct_eof(t)) {
             pa_source_output_info i;
-            bool mute = false, corked = false, has_volume = false, volume_writable = true;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.source) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.source_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 22 && (pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
-                                               pa_tagstruct_get_format_info(t, i.format) < 0))) {
 
+            if (fill_source_output_info(o->context, t, &i, PA_SNAPSHOT_FIELDS_ALL) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
                 pa_proplist_free(i.proplist);
                 pa_format_info_free(i.format);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
             if (o->callback) {
                 pa_source_output_info_cb_t cb = (pa_source_output_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
@@ -1390,6 +1424,192 @@ pa_operation* pa_context_get_source_output_info_list(pa_context *c,  pa_source_o
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST, context_get_source_output_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/*** Snapshots ***/
+
+int pa_snapshot_object_read(pa_context *c, pa_tagstruct *t, pa_snapshot_fields_t fields, pa_snapshot_object *o, pa_snapshot_entry *e) {
+    int r;
+
+    pa_assert(c);
+    pa_assert(t);
+    pa_assert(o);
+    pa_assert(e);
+
+    switch (e->facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            r = fill_sink_info(c, t, &o->sink, fields);
+            e->index = o->sink.index;
+            e->sink = &o->sink;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            r = fill_source_info(c, t, &o->source, fields);
+            e->index = o->source.index;
+            e->source = &o->source;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            r = fill_sink_input_info(c, t, &o->sink_input, fields);
+            e->index = o->sink_input.index;
+            e->sink_input = &o->sink_input;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            r = fill_source_output_info(c, t, &o->source_output, fields);
+            e->index = o->source_output.index;
+            e->source_output = &o->source_output;
+            break;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            r = fill_client_info(c, t, &o->client, fields);
+            e->index = o->client.index;
+            e->client = &o->client;
+            break;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            r = fill_module_info(c, t, &o->module, fields);
+            e->index = o->module.index;
+            e->module = &o->module;
+            break;
+        default:
+            return -PA_ERR_PROTOCOL;
+    }
+
+    if (r < 0)
+        pa_snapshot_object_free(o, e);
+
+    return r;
+}
+
+void pa_snapshot_object_free(pa_snapshot_object *o, pa_snapshot_entry *e) {
+    pa_assert(o);
+    pa_assert(e);
+
+    switch (e->facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            sink_info_free(&o->sink);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            source_info_free(&o->source);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            pa_proplist_free(o->sink_input.proplist);
+            pa_format_info_free(o->sink_input.format);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            pa_proplist_free(o->source_output.proplist);
+            pa_format_info_free(o->source_output.format);
+            break;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            pa_proplist_free(o->client.proplist);
+            break;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            pa_proplist_free(o->module.proplist);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void context_get_snapshot_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    pa_snapshot_info s;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    pa_zero(s);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+        pa_snapshot_fields_t fields = (pa_snapshot_fields_t) PA_PTR_TO_UINT(o->private);
+        bool full;
+
+        if (pa_tagstruct_getu64(t, &s.generation) < 0 ||
+            pa_tagstruct_get_boolean(t, &full) < 0)
+            goto fail;
+
+        s.full = (int) full;
+
+        while (!pa_tagstruct_eof(t)) {
+            pa_snapshot_entry e;
+            pa_snapshot_object so;
+            uint32_t facility;
+            bool removed;
+
+            pa_zero(e);
+
+            if (pa_tagstruct_getu32(t, &facility) < 0 ||
+                pa_tagstruct_get_boolean(t, &removed) < 0)
+                goto fail;
+
+            e.facility = (pa_subscription_event_type_t) facility;
+            e.removed = (int) removed;
+
+            if (removed) {
+                if (pa_tagstruct_getu32(t, &e.index) < 0)
+                    goto fail;
+            } else if (pa_snapshot_object_read(o->context, t, fields, &so, &e) < 0)
+                goto fail;
+
+            if (o->callback) {
+                pa_snapshot_cb_t cb = (pa_snapshot_cb_t) o->callback;
+                cb(o->context, &s, &e, 0, o->userdata);
+            }
+
+            if (!removed)
+                pa_snapshot_object_free(&so, &e);
+        }
+    }
+
+    if (o->callback) {
+        pa_snapshot_cb_t cb = (pa_snapshot_cb_t) o->callback;
+        cb(o->context, eol < 0 ? NULL : &s, NULL, eol, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+    return;
+
+fail:
+    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+    goto finish;
+}
+
+pa_operation* pa_context_get_snapshot(pa_context *c, pa_subscription_mask_t types, pa_snapshot_fields_t fields, uint64_t since, pa_snapshot_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (types & ~(PA_SUBSCRIPTION_MASK_SINK|PA_SUBSCRIPTION_MASK_SOURCE|
+                                                PA_SUBSCRIPTION_MASK_SINK_INPUT|PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT|
+                                                PA_SUBSCRIPTION_MASK_MODULE|PA_SUBSCRIPTION_MASK_CLIENT)) == 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (fields & ~PA_SNAPSHOT_FIELDS_ALL) == 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 32, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+    o->private = PA_UINT_TO_PTR(fields);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_GET_SNAPSHOT, &tag);
+    pa_tagstruct_putu32(t, types);
+    pa_tagstruct_putu32(t, fields);
+    pa_tagstruct_putu64(t, since);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_snapshot_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 /*** Volume manipulation ***/
 
 pa_operation* pa_context_set_sink_volume_by_index(pa_context *c, uint32_t idx, const pa_cvolume *volume, pa_context_success_cb_t cb, void *userdata) {
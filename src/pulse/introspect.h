@@ -134,6 +134,15 @@
  * either pa_context_get_client_info() or pa_context_get_client_info_list().
  * The information structure is called pa_client_info.
  *
+ * \subsection snapshot_subsec Snapshots
+ *
+ * Tools that keep track of many objects can fetch sinks, sources, sink
+ * inputs, source outputs, modules and clients all at once with
+ * pa_context_get_snapshot(). Optional parts of the objects, such as
+ * property lists, can be left out. Each snapshot carries a generation
+ * counter, and passing it to the next request makes the server only send
+ * the objects that changed in between.
+ *
  * \section ctrl_sec Control
  *
  * Some parts of the server are only possible to read, but most can also be
@@ -667,6 +676,10 @@ typedef struct pa_stat_info {
     uint32_t memblock_allocated;       /**< Allocated memory blocks during the whole lifetime of the daemon. */
     uint32_t memblock_allocated_size;  /**< Total size of all memory blocks allocated during the whole lifetime of the daemon. */
     uint32_t scache_size;              /**< Total size of all sample cache entries. */
+    uint32_t pool_size;                /**< Current size of the daemon's shared memory pool, including the segments it grew by. \since 10.0 */
+    uint32_t pool_used_size;           /**< Size of the shared memory pool currently in use. \since 10.0 */
+    uint32_t pool_used_size_max;       /**< Maximum size of the shared memory pool in use during the whole lifetime of the daemon. \since 10.0 */
+    uint32_t pool_fallbacks;           /**< Number of allocations that did not fit into the shared memory pool and used heap memory instead. \since 10.0 */
 } pa_stat_info;
 
 /** Callback prototype for pa_context_stat() */
@@ -709,6 +722,83 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
 
 /** @} */
 
+/** @{ \name Snapshots */
+
+/** Optional parts of the objects in a snapshot. Leaving out what is not
+ * needed makes snapshots cheaper for both the daemon and the client. \since 10.0 */
+typedef enum pa_snapshot_fields {
+    PA_SNAPSHOT_FIELDS_NONE = 0x0000U,
+    /**< Only the fields that are always included */
+
+    PA_SNAPSHOT_FIELDS_PROPLIST = 0x0001U,
+    /**< Property lists. If not requested, the property lists are empty. */
+
+    PA_SNAPSHOT_FIELDS_PORTS = 0x0002U,
+    /**< Ports and the active port of sinks and sources */
+
+    PA_SNAPSHOT_FIELDS_FORMATS = 0x0004U,
+    /**< Formats of sinks, sources and streams. If not requested, sinks
+     * and sources have no formats, and streams have a format with the
+     * encoding PA_ENCODING_INVALID. */
+
+    PA_SNAPSHOT_FIELDS_LATENCY = 0x0008U,
+    /**< Current and configured latencies of sinks and sources, and the
+     * buffer, sink and source latencies of streams. Querying these
+     * involves the IO threads of the daemon. If not requested, they are
+     * 0. */
+
+    PA_SNAPSHOT_FIELDS_ALL = 0x000FU
+    /**< All of the above */
+} pa_snapshot_fields_t;
+
+/** \cond fulldocs */
+#define PA_SNAPSHOT_FIELDS_NONE PA_SNAPSHOT_FIELDS_NONE
+#define PA_SNAPSHOT_FIELDS_PROPLIST PA_SNAPSHOT_FIELDS_PROPLIST
+#define PA_SNAPSHOT_FIELDS_PORTS PA_SNAPSHOT_FIELDS_PORTS
+#define PA_SNAPSHOT_FIELDS_FORMATS PA_SNAPSHOT_FIELDS_FORMATS
+#define PA_SNAPSHOT_FIELDS_LATENCY PA_SNAPSHOT_FIELDS_LATENCY
+#define PA_SNAPSHOT_FIELDS_ALL PA_SNAPSHOT_FIELDS_ALL
+/** \endcond */
+
+/** Information about a snapshot as a whole. \since 10.0 */
+typedef struct pa_snapshot_info {
+    uint64_t generation;          /**< Generation of the daemon's objects this snapshot corresponds to. Pass it as since to the next pa_context_get_snapshot() call to only get what changed in between. */
+    int full;                     /**< Non-zero if this snapshot contains all objects of the requested types, zero if it only contains the ones that changed since the requested generation. */
+} pa_snapshot_info;
+
+/** An object in a snapshot. \since 10.0 */
+typedef struct pa_snapshot_entry {
+    pa_subscription_event_type_t facility;     /**< Type of the object, one of PA_SUBSCRIPTION_EVENT_SINK, ..._SOURCE, ..._SINK_INPUT, ..._SOURCE_OUTPUT, ..._MODULE and ..._CLIENT */
+    uint32_t index;                            /**< Index of the object */
+    int removed;                               /**< Non-zero if the object has been removed since the requested generation. Only happens in snapshots that are not full. All info pointers are NULL then. */
+    const pa_sink_info *sink;                  /**< The object if it is a sink, NULL otherwise */
+    const pa_source_info *source;              /**< The object if it is a source, NULL otherwise */
+    const pa_sink_input_info *sink_input;      /**< The object if it is a sink input, NULL otherwise */
+    const pa_source_output_info *source_output; /**< The object if it is a source output, NULL otherwise */
+    const pa_client_info *client;              /**< The object if it is a client, NULL otherwise */
+    const pa_module_info *module;              /**< The object if it is a module, NULL otherwise */
+} pa_snapshot_entry;
+
+/** Callback prototype for pa_context_get_snapshot(). Called once for each
+ * object in the snapshot, and a last time with e set to NULL and eol set to
+ * a positive value. If an error occurs, s and e are NULL and eol is
+ * negative. \since 10.0 */
+typedef void (*pa_snapshot_cb_t)(pa_context *c, const pa_snapshot_info *s, const pa_snapshot_entry *e, int eol, void *userdata);
+
+/** Get the sinks, sources, sink inputs, source outputs, modules and/or
+ * clients of the daemon with a single request. types selects the object
+ * types using the PA_SUBSCRIPTION_MASK_xxx values for them, fields selects
+ * the optional parts of the objects to include. If since is 0, all objects
+ * of the requested types are returned. If it is the generation of an
+ * earlier snapshot, the daemon only returns the objects that changed or
+ * were removed since then, unless it can't tell anymore, in which case
+ * it returns a full snapshot. Objects may be reported as changed even if
+ * they did not, or if they were only changed in fields that were not
+ * requested. \since 10.0 */
+pa_operation* pa_context_get_snapshot(pa_context *c, pa_subscription_mask_t types, pa_snapshot_fields_t fields, uint64_t since, pa_snapshot_cb_t cb, void *userdata);
+
+/** @} */
+
 /** \cond fulldocs */
 
 /** @{ \name Autoload Entries */
@@ -32,6 +32,10 @@
 #include <pulsecore/pipe.h>
 #endif
 
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
@@ -40,6 +44,7 @@
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/i18n.h>
+#include <pulsecore/idxset.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-error.h>
@@ -55,7 +60,12 @@ struct pa_io_event {
 
     int fd;
     pa_io_event_flags_t events;
-    struct pollfd *pollfd;
+    unsigned pollfd_idx; /* 0 if the event has no entry in the pollfd array yet */
+
+#ifdef HAVE_EPOLL
+    uint32_t epoll_idx;  /* PA_IDXSET_INVALID if the event is not in the epoll set */
+    int epoll_dup_fd;    /* If another event added fd to the epoll set already, we add this dup of it */
+#endif
 
     pa_io_event_cb_t callback;
     void *userdata;
@@ -70,8 +80,14 @@ struct pa_time_event {
 
     bool enabled:1;
     bool use_rtclock:1;
+    bool expired:1;
     pa_usec_t time;
 
+    /* Enabled events are either in the heap or, while they are being
+     * dispatched, on the list of expired events */
+    unsigned heap_idx;
+    pa_time_event *next_expired;
+
     pa_time_event_cb_t callback;
     void *userdata;
     pa_time_event_destroy_cb_t destroy_callback;
@@ -97,15 +113,40 @@ struct pa_mainloop {
     PA_LLIST_HEAD(pa_time_event, time_events);
     PA_LLIST_HEAD(pa_defer_event, defer_events);
 
+    /* Freed io and time events are moved here until the next iteration */
+    PA_LLIST_HEAD(pa_io_event, dead_io_events);
+    PA_LLIST_HEAD(pa_time_event, dead_time_events);
+
     unsigned n_enabled_defer_events, n_enabled_time_events, n_io_events;
-    unsigned io_events_please_scan, time_events_please_scan, defer_events_please_scan;
+    unsigned defer_events_please_scan;
 
+    /* The first entry is the wakeup pipe, the others belong to the io
+     * events in io_events_by_pollfd. Entries are added and removed one by
+     * one, unless another thread might be polling on the array right now,
+     * in which case it is rebuilt from scratch. */
     bool rebuild_pollfds:1;
     struct pollfd *pollfds;
+    pa_io_event **io_events_by_pollfd;
     unsigned max_pollfds, n_pollfds;
 
+    /* A binary min-heap of the enabled time events */
+    pa_time_event **time_heap;
+    unsigned max_time_heap, n_time_heap;
+
+#ifdef HAVE_EPOLL
+    /* If epoll_fd is valid, io events are added to and removed from the
+     * epoll set right away and the pollfd array is not used. The epoll
+     * data is the index of the event in epoll_io_events rather than a
+     * pointer, so that entries of freed events are recognized. */
+    int epoll_fd;
+    bool epoll_disable:1;
+    bool epoll_rebuild:1;
+    pa_idxset *epoll_io_events;
+    struct epoll_event *epoll_events;
+    unsigned max_epoll_events;
+#endif
+
     pa_usec_t prepared_timeout;
-    pa_time_event *cached_next_time_event;
 
     pa_mainloop_api api;
 
@@ -144,6 +185,236 @@ static pa_io_event_flags_t map_flags_from_libc(short flags) {
         (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
 }
 
+static void ensure_pollfds(pa_mainloop *m, unsigned n) {
+    pa_assert(m);
+
+    if (m->max_pollfds >= n)
+        return;
+
+    n *= 2;
+    m->pollfds = pa_xrealloc(m->pollfds, sizeof(struct pollfd) * n);
+    m->io_events_by_pollfd = pa_xrealloc(m->io_events_by_pollfd, sizeof(pa_io_event*) * n);
+    m->max_pollfds = n;
+}
+
+static void add_pollfd(pa_mainloop *m, pa_io_event *e) {
+    struct pollfd *p;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(e->pollfd_idx == 0);
+    pa_assert(m->n_pollfds > 0);
+
+    ensure_pollfds(m, m->n_pollfds + 1);
+
+    p = &m->pollfds[m->n_pollfds];
+    p->fd = e->fd;
+    p->events = map_flags_to_libc(e->events);
+    p->revents = 0;
+
+    m->io_events_by_pollfd[m->n_pollfds] = e;
+    e->pollfd_idx = m->n_pollfds++;
+}
+
+static void remove_pollfd(pa_mainloop *m, pa_io_event *e) {
+    unsigned last;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(e->pollfd_idx > 0);
+    pa_assert(e->pollfd_idx < m->n_pollfds);
+    pa_assert(m->io_events_by_pollfd[e->pollfd_idx] == e);
+
+    /* Move the last entry into the hole */
+    last = --m->n_pollfds;
+
+    if (e->pollfd_idx != last) {
+        m->pollfds[e->pollfd_idx] = m->pollfds[last];
+        m->io_events_by_pollfd[e->pollfd_idx] = m->io_events_by_pollfd[last];
+        m->io_events_by_pollfd[e->pollfd_idx]->pollfd_idx = e->pollfd_idx;
+    }
+
+    e->pollfd_idx = 0;
+}
+
+#ifdef HAVE_EPOLL
+
+static uint32_t map_flags_to_epoll(pa_io_event_flags_t flags) {
+    return
+        (flags & PA_IO_EVENT_INPUT ? EPOLLIN : 0) |
+        (flags & PA_IO_EVENT_OUTPUT ? EPOLLOUT : 0) |
+        (flags & PA_IO_EVENT_ERROR ? EPOLLERR : 0) |
+        (flags & PA_IO_EVENT_HANGUP ? EPOLLHUP : 0);
+}
+
+static pa_io_event_flags_t map_flags_from_epoll(uint32_t flags) {
+    return
+        (flags & EPOLLIN ? PA_IO_EVENT_INPUT : 0) |
+        (flags & EPOLLOUT ? PA_IO_EVENT_OUTPUT : 0) |
+        (flags & EPOLLERR ? PA_IO_EVENT_ERROR : 0) |
+        (flags & EPOLLHUP ? PA_IO_EVENT_HANGUP : 0);
+}
+
+static void epoll_add_io(pa_mainloop *m, pa_io_event *e) {
+    struct epoll_event ev;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(e->epoll_idx == PA_IDXSET_INVALID);
+
+    pa_assert_se(pa_idxset_put(m->epoll_io_events, e, &e->epoll_idx) >= 0);
+
+    pa_zero(ev);
+    ev.events = map_flags_to_epoll(e->events);
+    ev.data.u64 = e->epoll_idx;
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, e->fd, &ev) >= 0)
+        return;
+
+    /* An fd can only be added once, but it's fine to have more than one
+     * io event for it. The others get a dup of the fd then. */
+    if (errno == EEXIST && (e->epoll_dup_fd = fcntl(e->fd, F_DUPFD_CLOEXEC, 0)) >= 0) {
+
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, e->epoll_dup_fd, &ev) >= 0)
+            return;
+
+        pa_close(e->epoll_dup_fd);
+        e->epoll_dup_fd = -1;
+    }
+
+    /* Happens for regular files, for example */
+    pa_log_debug("Cannot use epoll for fd %i, falling back to poll(): %s", e->fd, pa_cstrerror(errno));
+
+    pa_assert_se(pa_idxset_remove_by_index(m->epoll_io_events, e->epoll_idx) == e);
+    e->epoll_idx = PA_IDXSET_INVALID;
+    m->epoll_disable = true;
+}
+
+static void epoll_modify_io(pa_mainloop *m, pa_io_event *e) {
+    struct epoll_event ev;
+
+    pa_assert(m);
+    pa_assert(e);
+
+    if (e->epoll_idx == PA_IDXSET_INVALID)
+        return;
+
+    pa_zero(ev);
+    ev.events = map_flags_to_epoll(e->events);
+    ev.data.u64 = e->epoll_idx;
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_MOD, e->epoll_dup_fd >= 0 ? e->epoll_dup_fd : e->fd, &ev) < 0) {
+        pa_log_debug("Cannot use epoll for fd %i, falling back to poll(): %s", e->fd, pa_cstrerror(errno));
+        m->epoll_disable = true;
+    }
+}
+
+/* The event stays in epoll_io_events until it is destroyed, so that
+ * results that are already pending for it are not mistaken for stale
+ * ones */
+static void epoll_remove_io(pa_mainloop *m, pa_io_event *e) {
+    pa_assert(m);
+    pa_assert(e);
+
+    if (e->epoll_idx == PA_IDXSET_INVALID)
+        return;
+
+    if (e->epoll_dup_fd >= 0) {
+        (void) epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, e->epoll_dup_fd, NULL);
+        pa_close(e->epoll_dup_fd);
+        e->epoll_dup_fd = -1;
+    } else
+        /* If the fd has been closed already, it's gone from the set
+         * anyway */
+        (void) epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+}
+
+static void epoll_init(pa_mainloop *m) {
+    struct epoll_event ev;
+
+    pa_assert(m);
+    pa_assert(m->epoll_fd < 0);
+
+    if ((m->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_warn("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.u64 = PA_IDXSET_INVALID;
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0) {
+        pa_log_warn("Failed to add wakeup pipe to epoll set: %s", pa_cstrerror(errno));
+        pa_close(m->epoll_fd);
+        m->epoll_fd = -1;
+        return;
+    }
+
+    if (!m->epoll_io_events)
+        m->epoll_io_events = pa_idxset_new(NULL, NULL);
+}
+
+/* Doesn't touch dead events, call this only when there are none */
+static void epoll_close(pa_mainloop *m) {
+    pa_io_event *e;
+
+    pa_assert(m);
+    pa_assert(!m->dead_io_events);
+
+    if (m->epoll_fd < 0)
+        return;
+
+    PA_LLIST_FOREACH(e, m->io_events) {
+        if (e->epoll_dup_fd >= 0) {
+            pa_close(e->epoll_dup_fd);
+            e->epoll_dup_fd = -1;
+        }
+
+        e->epoll_idx = PA_IDXSET_INVALID;
+    }
+
+    pa_idxset_remove_all(m->epoll_io_events, NULL);
+
+    pa_close(m->epoll_fd);
+    m->epoll_fd = -1;
+}
+
+static void epoll_prepare(pa_mainloop *m) {
+    pa_io_event *e;
+
+    pa_assert(m);
+    pa_assert(m->epoll_fd >= 0);
+
+    if (m->epoll_rebuild && !m->epoll_disable) {
+        pa_log_debug("Stale entries in the epoll set, creating a new one.");
+
+        epoll_close(m);
+        epoll_init(m);
+
+        if (m->epoll_fd < 0)
+            m->epoll_disable = true;
+        else
+            PA_LLIST_FOREACH(e, m->io_events)
+                epoll_add_io(m, e);
+    }
+
+    m->epoll_rebuild = false;
+
+    if (m->epoll_disable) {
+        epoll_close(m);
+        m->rebuild_pollfds = true;
+        return;
+    }
+
+    if (m->max_epoll_events < m->n_io_events + 1) {
+        m->max_epoll_events = (m->n_io_events + 1) * 2;
+        m->epoll_events = pa_xrealloc(m->epoll_events, sizeof(struct epoll_event) * m->max_epoll_events);
+    }
+}
+
+#endif /* HAVE_EPOLL */
+
 /* IO events */
 static pa_io_event* mainloop_io_new(
         pa_mainloop_api *a,
@@ -173,9 +444,22 @@ static pa_io_event* mainloop_io_new(
     e->userdata = userdata;
 
     PA_LLIST_PREPEND(pa_io_event, m->io_events, e);
-    m->rebuild_pollfds = true;
     m->n_io_events ++;
 
+#ifdef HAVE_EPOLL
+    e->epoll_idx = PA_IDXSET_INVALID;
+    e->epoll_dup_fd = -1;
+
+    if (m->epoll_fd >= 0)
+        epoll_add_io(m, e);
+    else
+#endif
+    /* While polling, the array may only be changed in place */
+    if (m->rebuild_pollfds || m->state == STATE_POLLING)
+        m->rebuild_pollfds = true;
+    else
+        add_pollfd(m, e);
+
     pa_mainloop_wakeup(m);
 
     return e;
@@ -190,10 +474,15 @@ static void mainloop_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
 
     e->events = events;
 
-    if (e->pollfd)
-        e->pollfd->events = map_flags_to_libc(events);
+#ifdef HAVE_EPOLL
+    if (e->mainloop->epoll_fd >= 0)
+        epoll_modify_io(e->mainloop, e);
+    else
+#endif
+    if (e->pollfd_idx > 0)
+        e->mainloop->pollfds[e->pollfd_idx].events = map_flags_to_libc(events);
     else
-        e->mainloop->rebuild_pollfds = true;
+        pa_assert(e->mainloop->rebuild_pollfds);
 
     pa_mainloop_wakeup(e->mainloop);
 }
@@ -203,10 +492,18 @@ static void mainloop_io_free(pa_io_event *e) {
     pa_assert(!e->dead);
 
     e->dead = true;
-    e->mainloop->io_events_please_scan ++;
+
+#ifdef HAVE_EPOLL
+    if (e->mainloop->epoll_fd >= 0)
+        epoll_remove_io(e->mainloop, e);
+#endif
+
+    /* The pollfd entry stays until the next iteration, so that the array
+     * doesn't change under a poll() running in another thread */
+    PA_LLIST_REMOVE(pa_io_event, e->mainloop->io_events, e);
+    PA_LLIST_PREPEND(pa_io_event, e->mainloop->dead_io_events, e);
 
     e->mainloop->n_io_events --;
-    e->mainloop->rebuild_pollfds = true;
 
     pa_mainloop_wakeup(e->mainloop);
 }
@@ -286,6 +583,84 @@ static void mainloop_defer_set_destroy(pa_defer_event *e, pa_defer_event_destroy
 }
 
 /* Time events */
+static void time_heap_up(pa_mainloop *m, unsigned i) {
+    pa_time_event *e = m->time_heap[i];
+
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+
+        if (m->time_heap[parent]->time <= e->time)
+            break;
+
+        m->time_heap[i] = m->time_heap[parent];
+        m->time_heap[i]->heap_idx = i;
+        i = parent;
+    }
+
+    m->time_heap[i] = e;
+    e->heap_idx = i;
+}
+
+static void time_heap_down(pa_mainloop *m, unsigned i) {
+    pa_time_event *e = m->time_heap[i];
+
+    for (;;) {
+        unsigned child = 2 * i + 1;
+
+        if (child >= m->n_time_heap)
+            break;
+
+        if (child + 1 < m->n_time_heap && m->time_heap[child + 1]->time < m->time_heap[child]->time)
+            child++;
+
+        if (e->time <= m->time_heap[child]->time)
+            break;
+
+        m->time_heap[i] = m->time_heap[child];
+        m->time_heap[i]->heap_idx = i;
+        i = child;
+    }
+
+    m->time_heap[i] = e;
+    e->heap_idx = i;
+}
+
+/* To be called after e->time changed */
+static void time_heap_update(pa_mainloop *m, pa_time_event *e) {
+    unsigned i = e->heap_idx;
+
+    pa_assert(i < m->n_time_heap);
+    pa_assert(m->time_heap[i] == e);
+
+    if (i > 0 && m->time_heap[(i - 1) / 2]->time > e->time)
+        time_heap_up(m, i);
+    else
+        time_heap_down(m, i);
+}
+
+static void time_heap_insert(pa_mainloop *m, pa_time_event *e) {
+    if (m->n_time_heap >= m->max_time_heap) {
+        m->max_time_heap = PA_MAX(16U, m->max_time_heap * 2);
+        m->time_heap = pa_xrealloc(m->time_heap, sizeof(pa_time_event*) * m->max_time_heap);
+    }
+
+    m->time_heap[m->n_time_heap] = e;
+    time_heap_up(m, m->n_time_heap++);
+}
+
+static void time_heap_remove(pa_mainloop *m, pa_time_event *e) {
+    unsigned i = e->heap_idx;
+
+    pa_assert(i < m->n_time_heap);
+    pa_assert(m->time_heap[i] == e);
+
+    if (i != --m->n_time_heap) {
+        m->time_heap[i] = m->time_heap[m->n_time_heap];
+        m->time_heap[i]->heap_idx = i;
+        time_heap_update(m, m->time_heap[i]);
+    }
+}
+
 static pa_usec_t make_rt(const struct timeval *tv, bool *use_rtclock) {
     struct timeval ttv;
 
@@ -333,13 +708,7 @@ static pa_time_event* mainloop_time_new(
         e->use_rtclock = use_rtclock;
 
         m->n_enabled_time_events++;
-
-        if (m->cached_next_time_event) {
-            pa_assert(m->cached_next_time_event->enabled);
-
-            if (t < m->cached_next_time_event->time)
-                m->cached_next_time_event = e;
-        }
+        time_heap_insert(m, e);
     }
 
     e->callback = callback;
@@ -354,36 +723,40 @@ static pa_time_event* mainloop_time_new(
 }
 
 static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
-    bool valid;
+    pa_mainloop *m;
     pa_usec_t t;
     bool use_rtclock = false;
 
     pa_assert(e);
     pa_assert(!e->dead);
 
+    m = e->mainloop;
     t = make_rt(tv, &use_rtclock);
 
-    valid = (t != PA_USEC_INVALID);
-    if (e->enabled && !valid) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-    } else if (!e->enabled && valid)
-        e->mainloop->n_enabled_time_events++;
-
-    if ((e->enabled = valid)) {
+    if (t != PA_USEC_INVALID) {
         e->time = t;
         e->use_rtclock = use_rtclock;
-        pa_mainloop_wakeup(e->mainloop);
-    }
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+        if (!e->enabled) {
+            m->n_enabled_time_events++;
+            e->enabled = true;
+            time_heap_insert(m, e);
+        } else if (e->expired) {
+            e->expired = false;
+            time_heap_insert(m, e);
+        } else
+            time_heap_update(m, e);
 
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        pa_assert(e->mainloop->cached_next_time_event->enabled);
+        pa_mainloop_wakeup(m);
 
-        if (t < e->mainloop->cached_next_time_event->time)
-            e->mainloop->cached_next_time_event = e;
+    } else if (e->enabled) {
+        pa_assert(m->n_enabled_time_events > 0);
+        m->n_enabled_time_events--;
+
+        if (!e->expired)
+            time_heap_remove(m, e);
+
+        e->enabled = e->expired = false;
     }
 }
 
@@ -391,17 +764,11 @@ static void mainloop_time_free(pa_time_event *e) {
     pa_assert(e);
     pa_assert(!e->dead);
 
-    e->dead = true;
-    e->mainloop->time_events_please_scan ++;
-
-    if (e->enabled) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-        e->enabled = false;
-    }
+    mainloop_time_restart(e, NULL);
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    e->dead = true;
+    PA_LLIST_REMOVE(pa_time_event, e->mainloop->time_events, e);
+    PA_LLIST_PREPEND(pa_time_event, e->mainloop->dead_time_events, e);
 
     /* no wakeup needed here. Think about it! */
 }
@@ -465,6 +832,17 @@ pa_mainloop *pa_mainloop_new(void) {
 
     m->rebuild_pollfds = true;
 
+#ifdef HAVE_EPOLL
+    m->epoll_fd = -1;
+
+    if (!getenv("PULSE_NO_EPOLL")) {
+        epoll_init(m);
+
+        if (m->epoll_fd >= 0)
+            m->rebuild_pollfds = false;
+    }
+#endif
+
     m->api = vtable;
     m->api.userdata = m;
 
@@ -476,63 +854,46 @@ pa_mainloop *pa_mainloop_new(void) {
 }
 
 static void cleanup_io_events(pa_mainloop *m, bool force) {
-    pa_io_event *e, *n;
+    pa_io_event *e;
 
-    PA_LLIST_FOREACH_SAFE(e, n, m->io_events) {
+    if (force)
+        while ((e = m->io_events))
+            mainloop_io_free(e);
 
-        if (!force && m->io_events_please_scan <= 0)
-            break;
+    while ((e = m->dead_io_events)) {
+        PA_LLIST_REMOVE(pa_io_event, m->dead_io_events, e);
 
-        if (force || e->dead) {
-            PA_LLIST_REMOVE(pa_io_event, m->io_events, e);
+        /* If the array is rebuilt anyway, there's no need to fix it up */
+        if (e->pollfd_idx > 0 && !m->rebuild_pollfds)
+            remove_pollfd(m, e);
 
-            if (e->dead) {
-                pa_assert(m->io_events_please_scan > 0);
-                m->io_events_please_scan--;
-            }
-
-            if (e->destroy_callback)
-                e->destroy_callback(&m->api, e, e->userdata);
+#ifdef HAVE_EPOLL
+        if (e->epoll_idx != PA_IDXSET_INVALID)
+            pa_assert_se(pa_idxset_remove_by_index(m->epoll_io_events, e->epoll_idx) == e);
+#endif
 
-            pa_xfree(e);
+        if (e->destroy_callback)
+            e->destroy_callback(&m->api, e, e->userdata);
 
-            m->rebuild_pollfds = true;
-        }
+        pa_xfree(e);
     }
-
-    pa_assert(m->io_events_please_scan == 0);
 }
 
 static void cleanup_time_events(pa_mainloop *m, bool force) {
-    pa_time_event *e, *n;
+    pa_time_event *e;
 
-    PA_LLIST_FOREACH_SAFE(e, n, m->time_events) {
+    if (force)
+        while ((e = m->time_events))
+            mainloop_time_free(e);
 
-        if (!force && m->time_events_please_scan <= 0)
-            break;
+    while ((e = m->dead_time_events)) {
+        PA_LLIST_REMOVE(pa_time_event, m->dead_time_events, e);
 
-        if (force || e->dead) {
-            PA_LLIST_REMOVE(pa_time_event, m->time_events, e);
-
-            if (e->dead) {
-                pa_assert(m->time_events_please_scan > 0);
-                m->time_events_please_scan--;
-            }
+        if (e->destroy_callback)
+            e->destroy_callback(&m->api, e, e->userdata);
 
-            if (!e->dead && e->enabled) {
-                pa_assert(m->n_enabled_time_events > 0);
-                m->n_enabled_time_events--;
-                e->enabled = false;
-            }
-
-            if (e->destroy_callback)
-                e->destroy_callback(&m->api, e, e->userdata);
-
-            pa_xfree(e);
-        }
+        pa_xfree(e);
     }
-
-    pa_assert(m->time_events_please_scan == 0);
 }
 
 static void cleanup_defer_events(pa_mainloop *m, bool force) {
@@ -574,7 +935,18 @@ void pa_mainloop_free(pa_mainloop *m) {
     cleanup_defer_events(m, true);
     cleanup_time_events(m, true);
 
+#ifdef HAVE_EPOLL
+    epoll_close(m);
+
+    if (m->epoll_io_events)
+        pa_idxset_free(m->epoll_io_events, NULL);
+
+    pa_xfree(m->epoll_events);
+#endif
+
     pa_xfree(m->pollfds);
+    pa_xfree(m->io_events_by_pollfd);
+    pa_xfree(m->time_heap);
 
     pa_close_pipe(m->wakeup_pipe);
 
@@ -584,10 +956,10 @@ void pa_mainloop_free(pa_mainloop *m) {
 static void scan_dead(pa_mainloop *m) {
     pa_assert(m);
 
-    if (m->io_events_please_scan)
+    if (m->dead_io_events)
         cleanup_io_events(m, false);
 
-    if (m->time_events_please_scan)
+    if (m->dead_time_events)
         cleanup_time_events(m, false);
 
     if (m->defer_events_please_scan)
@@ -595,118 +967,120 @@ static void scan_dead(pa_mainloop *m) {
 }
 
 static void rebuild_pollfds(pa_mainloop *m) {
-    pa_io_event*e;
-    struct pollfd *p;
-    unsigned l;
-
-    l = m->n_io_events + 1;
-    if (m->max_pollfds < l) {
-        l *= 2;
-        m->pollfds = pa_xrealloc(m->pollfds, sizeof(struct pollfd)*l);
-        m->max_pollfds = l;
-    }
+    pa_io_event *e;
 
-    m->n_pollfds = 0;
-    p = m->pollfds;
+    ensure_pollfds(m, m->n_io_events + 1);
 
     m->pollfds[0].fd = m->wakeup_pipe[0];
     m->pollfds[0].events = POLLIN;
     m->pollfds[0].revents = 0;
-    p++;
-    m->n_pollfds++;
-
-    PA_LLIST_FOREACH(e, m->io_events) {
-        if (e->dead) {
-            e->pollfd = NULL;
-            continue;
-        }
+    m->io_events_by_pollfd[0] = NULL;
+    m->n_pollfds = 1;
 
-        e->pollfd = p;
-        p->fd = e->fd;
-        p->events = map_flags_to_libc(e->events);
-        p->revents = 0;
+    m->rebuild_pollfds = false;
 
-        p++;
-        m->n_pollfds++;
+    PA_LLIST_FOREACH(e, m->io_events) {
+        e->pollfd_idx = 0;
+        add_pollfd(m, e);
     }
-
-    m->rebuild_pollfds = false;
 }
 
 static unsigned dispatch_pollfds(pa_mainloop *m) {
-    pa_io_event *e;
-    unsigned r = 0, k;
+    unsigned r = 0, k, i;
 
     pa_assert(m->poll_func_ret > 0);
 
     k = m->poll_func_ret;
 
-    PA_LLIST_FOREACH(e, m->io_events) {
+    /* Callbacks may add entries at the end of the array, and may
+     * reallocate it, but they never remove or move any */
+    for (i = 1; i < m->n_pollfds; i++) {
+        pa_io_event *e;
+        short revents;
 
         if (k <= 0 || m->quit)
             break;
 
-        if (e->dead || !e->pollfd || !e->pollfd->revents)
+        if (!(revents = m->pollfds[i].revents))
             continue;
 
-        pa_assert(e->pollfd->fd == e->fd);
+        m->pollfds[i].revents = 0;
+        k--;
+
+        e = m->io_events_by_pollfd[i];
+
+        if (e->dead)
+            continue;
+
+        pa_assert(m->pollfds[i].fd == e->fd);
         pa_assert(e->callback);
 
-        e->callback(&m->api, e, e->fd, map_flags_from_libc(e->pollfd->revents), e->userdata);
-        e->pollfd->revents = 0;
+        e->callback(&m->api, e, e->fd, map_flags_from_libc(revents), e->userdata);
         r++;
-        k--;
     }
 
     return r;
 }
 
-static unsigned dispatch_defer(pa_mainloop *m) {
-    pa_defer_event *e;
-    unsigned r = 0;
+#ifdef HAVE_EPOLL
+static unsigned dispatch_epoll(pa_mainloop *m) {
+    unsigned r = 0, i;
 
-    if (m->n_enabled_defer_events <= 0)
-        return 0;
+    pa_assert(m->poll_func_ret > 0);
 
-    PA_LLIST_FOREACH(e, m->defer_events) {
+    for (i = 0; i < (unsigned) m->poll_func_ret; i++) {
+        uint32_t idx = (uint32_t) m->epoll_events[i].data.u64;
+        pa_io_event *e;
 
         if (m->quit)
             break;
 
-        if (e->dead || !e->enabled)
+        /* The wakeup pipe */
+        if (idx == PA_IDXSET_INVALID)
+            continue;
+
+        /* If an fd is closed before its io event is freed, but someone
+         * else still has it open, it stays in the epoll set and we have
+         * no way of removing it. Start over with a new set then. */
+        if (!(e = pa_idxset_get_by_index(m->epoll_io_events, idx))) {
+            m->epoll_rebuild = true;
+            continue;
+        }
+
+        if (e->dead)
             continue;
 
         pa_assert(e->callback);
-        e->callback(&m->api, e, e->userdata);
+
+        e->callback(&m->api, e, e->fd, map_flags_from_epoll(m->epoll_events[i].events), e->userdata);
         r++;
     }
 
     return r;
 }
+#endif
 
-static pa_time_event* find_next_time_event(pa_mainloop *m) {
-    pa_time_event *t, *n = NULL;
-    pa_assert(m);
+static unsigned dispatch_defer(pa_mainloop *m) {
+    pa_defer_event *e;
+    unsigned r = 0;
 
-    if (m->cached_next_time_event)
-        return m->cached_next_time_event;
+    if (m->n_enabled_defer_events <= 0)
+        return 0;
 
-    PA_LLIST_FOREACH(t, m->time_events) {
+    PA_LLIST_FOREACH(e, m->defer_events) {
 
-        if (t->dead || !t->enabled)
-            continue;
+        if (m->quit)
+            break;
 
-        if (!n || t->time < n->time) {
-            n = t;
+        if (e->dead || !e->enabled)
+            continue;
 
-            /* Shortcut for time == 0 */
-            if (n->time == 0)
-                break;
-        }
+        pa_assert(e->callback);
+        e->callback(&m->api, e, e->userdata);
+        r++;
     }
 
-    m->cached_next_time_event = n;
-    return n;
+    return r;
 }
 
 static pa_usec_t calc_next_timeout(pa_mainloop *m) {
@@ -716,7 +1090,8 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     if (m->n_enabled_time_events <= 0)
         return PA_USEC_INVALID;
 
-    pa_assert_se(t = find_next_time_event(m));
+    pa_assert(m->n_time_heap > 0);
+    t = m->time_heap[0];
 
     if (t->time <= 0)
         return 0;
@@ -730,7 +1105,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
 }
 
 static unsigned dispatch_timeout(pa_mainloop *m) {
-    pa_time_event *e;
+    pa_time_event *e, *expired = NULL, **tail = &expired;
     pa_usec_t now;
     unsigned r = 0;
     pa_assert(m);
@@ -740,25 +1115,43 @@ static unsigned dispatch_timeout(pa_mainloop *m) {
 
     now = pa_rtclock_now();
 
-    PA_LLIST_FOREACH(e, m->time_events) {
+    /* Take all expired events out of the heap first, in order, so that
+     * events that are restarted from a callback with a time in the past
+     * are only dispatched in the next iteration */
+    while (m->n_time_heap > 0 && m->time_heap[0]->time <= now) {
+        e = m->time_heap[0];
+        time_heap_remove(m, e);
+
+        e->expired = true;
+        e->next_expired = NULL;
+        *tail = e;
+        tail = &e->next_expired;
+    }
 
-        if (m->quit)
-            break;
+    while ((e = expired)) {
+        struct timeval tv;
 
-        if (e->dead || !e->enabled)
+        expired = e->next_expired;
+
+        /* Restarted, disabled or freed in the meantime */
+        if (!e->expired)
             continue;
 
-        if (e->time <= now) {
-            struct timeval tv;
-            pa_assert(e->callback);
+        if (m->quit) {
+            /* Leave the event for the next iteration */
+            e->expired = false;
+            time_heap_insert(m, e);
+            continue;
+        }
 
-            /* Disable time event */
-            mainloop_time_restart(e, NULL);
+        pa_assert(e->callback);
 
-            e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+        /* Disable time event */
+        mainloop_time_restart(e, NULL);
 
-            r++;
-        }
+        e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+
+        r++;
     }
 
     return r;
@@ -789,6 +1182,11 @@ int pa_mainloop_prepare(pa_mainloop *m, int timeout) {
     clear_wakeup(m);
     scan_dead(m);
 
+#ifdef HAVE_EPOLL
+    if (m->epoll_fd >= 0)
+        epoll_prepare(m);
+#endif
+
     if (m->quit)
         goto quit;
 
@@ -840,6 +1238,13 @@ int pa_mainloop_poll(pa_mainloop *m) {
     else {
         pa_assert(!m->rebuild_pollfds);
 
+#ifdef HAVE_EPOLL
+        if (m->epoll_fd >= 0)
+            m->poll_func_ret = epoll_wait(
+                    m->epoll_fd, m->epoll_events, (int) m->max_epoll_events,
+                    usec_to_timeout(m->prepared_timeout));
+        else
+#endif
         if (m->poll_func)
             m->poll_func_ret = m->poll_func(
                     m->pollfds, m->n_pollfds,
@@ -894,8 +1299,14 @@ int pa_mainloop_dispatch(pa_mainloop *m) {
         if (m->quit)
             goto quit;
 
-        if (m->poll_func_ret > 0)
-            dispatched += dispatch_pollfds(m);
+        if (m->poll_func_ret > 0) {
+#ifdef HAVE_EPOLL
+            if (m->epoll_fd >= 0)
+                dispatched += dispatch_epoll(m);
+            else
+#endif
+                dispatched += dispatch_pollfds(m);
+        }
     }
 
     if (m->quit)
@@ -969,6 +1380,12 @@ void pa_mainloop_set_poll_func(pa_mainloop *m, pa_poll_func poll_func, void *use
 
     m->poll_func = poll_func;
     m->poll_func_userdata = userdata;
+
+#ifdef HAVE_EPOLL
+    /* The poll function wants to see the actual fds */
+    if (poll_func && m->epoll_fd >= 0)
+        m->epoll_disable = true;
+#endif
 }
 
 bool pa_mainloop_is_our_api(pa_mainloop_api *m) {
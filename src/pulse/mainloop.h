@@ -34,7 +34,9 @@ struct pollfd;
  *
  * The built-in main loop implementation is based on the poll() system call.
  * It supports the functions defined in the main loop abstraction and very
- * little else.
+ * little else. On Linux it uses epoll instead where possible, unless the
+ * environment variable PULSE_NO_EPOLL is set or a custom poll() function
+ * has been set with pa_mainloop_set_poll_func().
  *
  * The main loop is created using pa_mainloop_new() and destroyed using
  * pa_mainloop_free(). To get access to the main loop abstraction,
@@ -47,6 +47,10 @@
 #define AUTO_TIMING_INTERVAL_START_USEC (10*PA_USEC_PER_MSEC)
 #define AUTO_TIMING_INTERVAL_END_USEC (1500*PA_USEC_PER_MSEC)
 
+/* With servers that push timing updates, we ask for this interval and
+ * only poll ourselves while our interval is shorter */
+#define AUTO_TIMING_PUSH_INTERVAL_USEC (250*PA_USEC_PER_MSEC)
+
 #define SMOOTHER_ADJUST_TIME (1000*PA_USEC_PER_MSEC)
 #define SMOOTHER_HISTORY_TIME (5000*PA_USEC_PER_MSEC)
 #define SMOOTHER_MIN_HISTORY (4)
@@ -191,6 +195,7 @@ static pa_stream *pa_stream_new_with_proplist_internal(
     s->auto_timing_update_event = NULL;
     s->auto_timing_update_requested = false;
     s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
+    s->timing_push = false;
 
     reset_callbacks(s);
 
@@ -404,7 +409,12 @@ static void request_auto_timing_update(pa_stream *s, bool force) {
             if (force)
                 s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
 
-            pa_context_rttime_restart(s->context, s->auto_timing_update_event, pa_rtclock_now() + s->auto_timing_interval_usec);
+            /* After a change we poll quickly for a bit to get the
+             * smoother going, the pushed updates take over from there */
+            if (s->timing_push && s->auto_timing_interval_usec > AUTO_TIMING_PUSH_INTERVAL_USEC)
+                pa_context_rttime_restart(s->context, s->auto_timing_update_event, PA_USEC_INVALID);
+            else
+                pa_context_rttime_restart(s->context, s->auto_timing_update_event, pa_rtclock_now() + s->auto_timing_interval_usec);
 
             s->auto_timing_interval_usec = PA_MIN(AUTO_TIMING_INTERVAL_END_USEC, s->auto_timing_interval_usec*2);
         }
@@ -958,6 +968,42 @@ static void auto_timing_update_callback(pa_mainloop_api *m, pa_time_event *e, co
     pa_stream_unref(s);
 }
 
+static void timing_push_callback(pa_stream *s, int success, void *userdata) {
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    if (success)
+        return;
+
+    /* Fall back to polling */
+    s->timing_push = false;
+    request_auto_timing_update(s, true);
+}
+
+static void enable_timing_push(pa_stream *s) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(s);
+    pa_assert(s->direction == PA_STREAM_PLAYBACK || s->direction == PA_STREAM_RECORD);
+
+    o = pa_operation_new(s->context, s, (pa_operation_cb_t) timing_push_callback, NULL);
+
+    t = pa_tagstruct_command(
+            s->context,
+            (uint32_t) (s->direction == PA_STREAM_PLAYBACK ? PA_COMMAND_SET_PLAYBACK_STREAM_TIMING_PUSH : PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH),
+            &tag);
+    pa_tagstruct_putu32(t, s->channel);
+    pa_tagstruct_put_usec(t, AUTO_TIMING_PUSH_INTERVAL_USEC);
+    pa_pstream_send_tagstruct(s->context->pstream, t);
+    pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, pa_stream_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    pa_operation_unref(o);
+
+    s->timing_push = true;
+}
+
 static void create_stream_complete(pa_stream *s) {
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
@@ -973,6 +1019,9 @@ static void create_stream_complete(pa_stream *s) {
         pa_assert(!s->auto_timing_update_event);
         s->auto_timing_update_event = pa_context_rttime_new(s->context, pa_rtclock_now() + s->auto_timing_interval_usec, &auto_timing_update_callback, s);
 
+        if (s->context->version >= 32)
+            enable_timing_push(s);
+
         request_auto_timing_update(s, true);
     }
 
@@ -1789,6 +1838,42 @@ static pa_usec_t calc_time(pa_stream *s, bool ignore_transport) {
     return usec;
 }
 
+/* Update smoother if we're not corked */
+static void update_smoother(pa_stream *s) {
+    pa_timing_info *i = &s->timing_info;
+    pa_usec_t u, x;
+
+    if (!s->smoother || s->corked)
+        return;
+
+    u = x = pa_rtclock_now() - i->transport_usec;
+
+    if (s->direction == PA_STREAM_PLAYBACK && s->context->version >= 13) {
+        pa_usec_t su;
+
+        /* If we weren't playing then it will take some time
+         * until the audio will actually come out through the
+         * speakers. Since we follow that timing here, we need
+         * to try to fix this up */
+
+        su = pa_bytes_to_usec((uint64_t) i->since_underrun, &s->sample_spec);
+
+        if (su < i->sink_usec)
+            x += i->sink_usec - su;
+    }
+
+    if (!i->playing)
+        pa_smoother_pause(s->smoother, x);
+
+    /* Update the smoother */
+    if ((s->direction == PA_STREAM_PLAYBACK && !i->read_index_corrupt) ||
+        (s->direction == PA_STREAM_RECORD && !i->write_index_corrupt))
+        pa_smoother_put(s->smoother, u, calc_time(s, true));
+
+    if (i->playing)
+        pa_smoother_resume(s->smoother, x, true);
+}
+
 static void stream_get_timing_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     struct timeval local, remote, now;
@@ -1926,37 +2011,7 @@ static void stream_get_timing_info_callback(pa_pdispatch *pd, uint32_t command,
                 i->read_index -= (int64_t) pa_memblockq_get_length(o->stream->record_memblockq);
         }
 
-        /* Update smoother if we're not corked */
-        if (o->stream->smoother && !o->stream->corked) {
-            pa_usec_t u, x;
-
-            u = x = pa_rtclock_now() - i->transport_usec;
-
-            if (o->stream->direction == PA_STREAM_PLAYBACK && o->context->version >= 13) {
-                pa_usec_t su;
-
-                /* If we weren't playing then it will take some time
-                 * until the audio will actually come out through the
-                 * speakers. Since we follow that timing here, we need
-                 * to try to fix this up */
-
-                su = pa_bytes_to_usec((uint64_t) i->since_underrun, &o->stream->sample_spec);
-
-                if (su < i->sink_usec)
-                    x += i->sink_usec - su;
-            }
-
-            if (!i->playing)
-                pa_smoother_pause(o->stream->smoother, x);
-
-            /* Update the smoother */
-            if ((o->stream->direction == PA_STREAM_PLAYBACK && !i->read_index_corrupt) ||
-                (o->stream->direction == PA_STREAM_RECORD && !i->write_index_corrupt))
-                pa_smoother_put(o->stream->smoother, u, calc_time(o->stream, true));
-
-            if (i->playing)
-                pa_smoother_resume(o->stream->smoother, x, true);
-        }
+        update_smoother(o->stream);
     }
 
     o->stream->auto_timing_update_requested = false;
@@ -1975,6 +2030,107 @@ finish:
     pa_operation_unref(o);
 }
 
+void pa_command_stream_timing(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_context *c = userdata;
+    pa_stream *s;
+    pa_timing_info *i;
+    uint32_t channel, last_tag;
+    pa_usec_t sink_usec, source_usec;
+    bool playing;
+    struct timeval remote, now;
+    int64_t write_index, read_index;
+    uint64_t underrun_for = 0, playing_for = 0;
+
+    pa_assert(pd);
+    pa_assert(command == PA_COMMAND_PLAYBACK_STREAM_TIMING || command == PA_COMMAND_RECORD_STREAM_TIMING);
+    pa_assert(t);
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    pa_context_ref(c);
+
+    if (c->version < 32) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (pa_tagstruct_getu32(t, &channel) < 0 ||
+        pa_tagstruct_getu32(t, &last_tag) < 0 ||
+        pa_tagstruct_get_usec(t, &sink_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &source_usec) < 0 ||
+        pa_tagstruct_get_boolean(t, &playing) < 0 ||
+        pa_tagstruct_get_timeval(t, &remote) < 0 ||
+        pa_tagstruct_gets64(t, &write_index) < 0 ||
+        pa_tagstruct_gets64(t, &read_index) < 0 ||
+        (command == PA_COMMAND_PLAYBACK_STREAM_TIMING &&
+         (pa_tagstruct_getu64(t, &underrun_for) < 0 ||
+          pa_tagstruct_getu64(t, &playing_for) < 0)) ||
+        !pa_tagstruct_eof(t)) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (!(s = pa_hashmap_get(command == PA_COMMAND_PLAYBACK_STREAM_TIMING ? c->playback_streams : c->record_streams, PA_UINT32_TO_PTR(channel))))
+        goto finish;
+
+    if (s->state != PA_STREAM_READY)
+        goto finish;
+
+    /* We build on the data of the last reply, which includes the write
+     * index of playback streams and the transport latency */
+    if (!s->timing_info_valid)
+        goto finish;
+
+    i = &s->timing_info;
+
+    i->sink_usec = sink_usec;
+    i->source_usec = source_usec;
+    i->playing = (int) playing;
+    i->since_underrun = (int64_t) (playing ? playing_for : underrun_for);
+
+    pa_gettimeofday(&now);
+
+    /* There is no request to measure the round trip with. If the clocks
+     * are synchronized, we know how long the update took to get here,
+     * otherwise we go with the estimate from the last reply. */
+    if (i->synchronized_clocks && pa_timeval_cmp(&remote, &now) <= 0) {
+        i->transport_usec = pa_timeval_diff(&now, &remote);
+        i->timestamp = remote;
+    } else {
+        i->timestamp = now;
+        pa_timeval_sub(&i->timestamp, i->transport_usec);
+    }
+
+    /* Updates from before the last command that invalidated an index
+     * don't tell us anything about it */
+    if (s->direction == PA_STREAM_PLAYBACK) {
+        /* The write index is tracked locally, the server's one misses
+         * what is still on its way there */
+        if (last_tag >= s->read_index_not_before) {
+            i->read_index = read_index;
+            i->read_index_corrupt = false;
+        }
+    } else {
+        if (last_tag >= s->write_index_not_before) {
+            i->write_index = write_index;
+            i->write_index_corrupt = false;
+        }
+
+        if (last_tag >= s->read_index_not_before) {
+            i->read_index = read_index - (int64_t) pa_memblockq_get_length(s->record_memblockq);
+            i->read_index_corrupt = false;
+        }
+    }
+
+    update_smoother(s);
+
+    if (s->latency_update_callback)
+        s->latency_update_callback(s, s->latency_update_userdata);
+
+finish:
+    pa_context_unref(c);
+}
+
 pa_operation* pa_stream_update_timing_info(pa_stream *s, pa_stream_success_cb_t cb, void *userdata) {
     uint32_t tag;
     pa_operation *o;
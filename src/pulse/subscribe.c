@@ -23,16 +23,23 @@
 
 #include <stdio.h>
 
+#include <pulse/timeval.h>
+
 #include <pulsecore/macro.h>
 #include <pulsecore/pstream-util.h>
 
 #include "internal.h"
 #include "subscribe.h"
 
+/* The longest time events may be held back */
+#define SUBSCRIPTION_WINDOW_MAX (10*PA_USEC_PER_SEC)
+
 void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_context *c = userdata;
     pa_subscription_event_type_t e;
     uint32_t idx;
+    pa_snapshot_entry entry, *ep = NULL;
+    pa_snapshot_object so;
 
     pa_assert(pd);
     pa_assert(command == PA_COMMAND_SUBSCRIBE_EVENT);
@@ -43,16 +50,42 @@ void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag
     pa_context_ref(c);
 
     if (pa_tagstruct_getu32(t, &e) < 0 ||
-        pa_tagstruct_getu32(t, &idx) < 0 ||
-        !pa_tagstruct_eof(t)) {
+        pa_tagstruct_getu32(t, &idx) < 0) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         goto finish;
     }
 
-    if (c->subscribe_callback)
+    /* Since protocol v32, the state of the object may follow */
+    if (!pa_tagstruct_eof(t)) {
+        uint32_t fields;
+
+        pa_zero(entry);
+        entry.facility = e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+
+        if (c->version < 32 ||
+            pa_tagstruct_getu32(t, &fields) < 0 ||
+            pa_snapshot_object_read(c, t, (pa_snapshot_fields_t) fields, &so, &entry) < 0) {
+            pa_context_fail(c, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        ep = &entry;
+
+        if (entry.index != idx || !pa_tagstruct_eof(t)) {
+            pa_context_fail(c, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+    }
+
+    if (c->subscribe_state_callback)
+        c->subscribe_state_callback(c, e, idx, ep, c->subscribe_state_userdata);
+    else if (c->subscribe_callback)
         c->subscribe_callback(c, e, idx, c->subscribe_userdata);
 
 finish:
+    if (ep)
+        pa_snapshot_object_free(&so, ep);
+
     pa_context_unref(c);
 }
 
@@ -70,6 +103,39 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
 
     t = pa_tagstruct_command(c, PA_COMMAND_SUBSCRIBE, &tag);
     pa_tagstruct_putu32(t, m);
+
+    if (c->version >= 32) {
+        pa_tagstruct_put_usec(t, 0);
+        pa_tagstruct_put_boolean(t, false);
+        pa_tagstruct_putu32(t, PA_SNAPSHOT_FIELDS_NONE);
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
+pa_operation* pa_context_subscribe_with_options(pa_context *c, pa_subscription_mask_t m, pa_usec_t window, int with_state, pa_snapshot_fields_t fields, pa_context_success_cb_t cb, void *userdata) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, window <= SUBSCRIPTION_WINDOW_MAX, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (fields & ~PA_SNAPSHOT_FIELDS_ALL) == 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 32, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_SUBSCRIBE, &tag);
+    pa_tagstruct_putu32(t, m);
+    pa_tagstruct_put_usec(t, window);
+    pa_tagstruct_put_boolean(t, !!with_state);
+    pa_tagstruct_putu32(t, fields);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
@@ -86,3 +152,14 @@ void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t
     c->subscribe_callback = cb;
     c->subscribe_userdata = userdata;
 }
+
+void pa_context_set_subscribe_state_callback(pa_context *c, pa_context_subscribe_state_cb_t cb, void *userdata) {
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    if (c->state == PA_CONTEXT_TERMINATED || c->state == PA_CONTEXT_FAILED)
+        return;
+
+    c->subscribe_state_callback = cb;
+    c->subscribe_state_userdata = userdata;
+}
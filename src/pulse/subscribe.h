@@ -27,6 +27,7 @@
 #include <pulse/context.h>
 #include <pulse/cdecl.h>
 #include <pulse/version.h>
+#include <pulse/introspect.h>
 
 /** \page subscribe Event Subscription
  *
@@ -59,6 +60,17 @@ void my_subscription_callback(pa_context *c, pa_subscription_event_type_t t,
     }
 }
 @endverbatim
+ *
+ * \section coalesce_sec Merging Events
+ *
+ * Busy servers can generate a lot of change events, e.g. during volume
+ * ramps. With pa_context_subscribe_with_options(), the server holds events
+ * back for a short time window and merges all events for the same object
+ * within it into one. Objects that are created and removed within the same
+ * window are not reported at all. Optionally, events can carry the new state of the
+ * object they are about, so there is no need to query it afterwards. Such
+ * events are delivered to the callback set with
+ * pa_context_set_subscribe_state_callback().
  */
 
 /** \file
@@ -78,6 +90,24 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
 /** Set the context specific call back function that is called whenever the state of the daemon changes */
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata);
 
+/** Subscription event callback prototype for events that may carry the
+ * state of the object. e is NULL if the event does not carry it. \since 10.0 */
+typedef void (*pa_context_subscribe_state_cb_t)(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, const pa_snapshot_entry *e, void *userdata);
+
+/** Enable event notification, like pa_context_subscribe(). If window is
+ * non-zero, the server delays events by up to that many microseconds and
+ * merges all events for the same object that happen within that time into
+ * one. Objects that are created and removed within that time are not
+ * reported at all. window may be at most 10 seconds. If with_state is non-zero, new and
+ * change events for sinks, sources, sink inputs, source outputs, modules
+ * and clients carry the state of the object at the time the event is
+ * sent, including the optional parts selected by fields. \since 10.0 */
+pa_operation* pa_context_subscribe_with_options(pa_context *c, pa_subscription_mask_t m, pa_usec_t window, int with_state, pa_snapshot_fields_t fields, pa_context_success_cb_t cb, void *userdata);
+
+/** Set a callback that is called for all events instead of the one set
+ * with pa_context_set_subscribe_callback(). \since 10.0 */
+void pa_context_set_subscribe_state_callback(pa_context *c, pa_context_subscribe_state_cb_t cb, void *userdata);
+
 PA_C_DECL_END
 
 #endif
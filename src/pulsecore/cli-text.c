@@ -36,6 +36,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/namereg.h>
+#include <pulsecore/render-profile.h>
 
 #include "cli-text.h"
 
@@ -196,6 +197,34 @@ char *pa_card_list_to_string(pa_core *c) {
     return pa_strbuf_to_string_free(s);
 }
 
+static void append_render_profile(pa_strbuf *s, const char *prefix, const char *name, pa_render_profile *p) {
+    pa_render_profile_data d;
+
+    pa_render_profile_get(p, &d);
+
+    if (d.count == 0)
+        return;
+
+    pa_strbuf_printf(s, "%s%s: %llu calls, %0.2f ms total, %0.2f usec avg, %0.2f usec max\n",
+                     prefix, name,
+                     (unsigned long long) d.count,
+                     (double) d.total_nsec / PA_NSEC_PER_MSEC,
+                     (double) d.total_nsec / d.count / PA_NSEC_PER_USEC,
+                     (double) d.max_nsec / PA_NSEC_PER_USEC);
+}
+
+static void append_sink_render_profile(pa_strbuf *s, const char *prefix, pa_sink *sink) {
+    append_render_profile(s, prefix, "render time", &sink->thread_info.render_profile);
+    append_render_profile(s, prefix, "mix time", &sink->thread_info.mix_profile);
+    append_render_profile(s, prefix, "message time", &sink->parent.process_msg_profile);
+}
+
+static void append_sink_input_render_profile(pa_strbuf *s, const char *prefix, pa_sink_input *i) {
+    append_render_profile(s, prefix, "peek time", &i->thread_info.peek_profile);
+    append_render_profile(s, prefix, "resampler time", &i->thread_info.resampler_profile);
+    append_render_profile(s, prefix, "message time", &i->parent.process_msg_profile);
+}
+
 static const char *sink_state_to_string(pa_sink_state_t state) {
     switch (state) {
         case PA_SINK_INIT:
@@ -343,6 +372,8 @@ char *pa_sink_list_to_string(pa_core *c) {
                     s,
                     "\tactive port: <%s>\n",
                     sink->active_port->name);
+
+        append_sink_render_profile(s, "\t", sink);
     }
 
     return pa_strbuf_to_string_free(s);
@@ -651,6 +682,33 @@ char *pa_sink_input_list_to_string(pa_core *c) {
         t = pa_proplist_to_string_sep(i->proplist, "\n\t\t");
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
         pa_xfree(t);
+
+        append_sink_input_render_profile(s, "\t", i);
+    }
+
+    return pa_strbuf_to_string_free(s);
+}
+
+char *pa_render_profile_list_to_string(pa_core *c) {
+    pa_strbuf *s;
+    pa_sink *sink;
+    pa_sink_input *i;
+    uint32_t idx, i_idx;
+
+    pa_assert(c);
+    s = pa_strbuf_new();
+
+    pa_strbuf_printf(s, "Render profiling is %s.\n", pa_render_profile_enabled() ? "enabled" : "disabled");
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        pa_strbuf_printf(s, "  sink %u <%s>\n", sink->index, sink->name);
+        append_sink_render_profile(s, "\t", sink);
+
+        PA_IDXSET_FOREACH(i, sink->inputs, i_idx) {
+            pa_strbuf_printf(s, "    sink input %u <%s>\n", i->index,
+                             pa_strnull(pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME)));
+            append_sink_input_render_profile(s, "\t", i);
+        }
     }
 
     return pa_strbuf_to_string_free(s);
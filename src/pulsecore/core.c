@@ -38,6 +38,7 @@
 #include <pulsecore/random.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/thread-mq.h>
 
 #include "core.h"
 
@@ -54,6 +55,10 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
             pa_module_unload(userdata, true);
             return 0;
 
+        case PA_CORE_MESSAGE_GROW_MEMPOOL:
+            pa_mempool_grow(c->mempool);
+            return 0;
+
         default:
             return -1;
     }
@@ -61,6 +66,18 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
 
 static void core_free(pa_object *o);
 
+/* Called from any thread. Mapping new memory may block, so IO threads
+ * leave growing the pool to the main thread. */
+static void mempool_grow_cb(pa_mempool *pool, void *userdata) {
+    pa_core *c = userdata;
+    pa_thread_mq *q;
+
+    if ((q = pa_thread_mq_get()))
+        pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(c), PA_CORE_MESSAGE_GROW_MEMPOOL, NULL, 0, NULL, NULL);
+    else
+        pa_mempool_grow(pool);
+}
+
 pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size) {
     pa_core* c;
     pa_mempool *pool;
@@ -127,6 +144,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     c->mempool = pool;
     c->shm_size = shm_size;
+    pa_mempool_set_grow_callback(pool, mempool_grow_cb, c);
     pa_silence_cache_init(&c->silence_cache);
 
     c->exit_event = NULL;
@@ -145,6 +163,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->disable_lfe_remixing = true;
     c->lfe_crossover_freq = 0;
     c->deferred_volume = true;
+    c->premix_resampling = false;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
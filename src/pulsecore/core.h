@@ -201,6 +201,7 @@ struct pa_core {
     bool disable_remixing:1;
     bool disable_lfe_remixing:1;
     bool deferred_volume:1;
+    bool premix_resampling:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
@@ -217,6 +218,7 @@ PA_DECLARE_PUBLIC_CLASS(pa_core);
 
 enum {
     PA_CORE_MESSAGE_UNLOAD_MODULE,
+    PA_CORE_MESSAGE_GROW_MEMPOOL,
     PA_CORE_MESSAGE_MAX
 };
 
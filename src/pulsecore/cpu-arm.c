@@ -153,8 +153,9 @@ bool pa_cpu_init_arm(pa_cpu_arm_flag_t *flags) {
 #ifdef HAVE_NEON
     if (*flags & PA_CPU_ARM_NEON) {
         pa_convert_func_init_neon(*flags);
-        pa_mix_func_init_neon(*flags);
         pa_remap_func_init_neon(*flags);
+        pa_polyphase_func_init_neon(*flags);
+        pa_volume_func_init_neon(*flags);
     }
 #endif
 
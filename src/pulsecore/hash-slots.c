@@ -0,0 +1,79 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/macro.h>
+
+#include "hash-slots.h"
+
+pa_hash_slot *pa_hash_slots_new(unsigned n_slots) {
+    pa_assert(n_slots >= PA_HASH_SLOTS_MIN);
+    pa_assert((n_slots & (n_slots - 1)) == 0);
+
+    return pa_xnew0(pa_hash_slot, n_slots);
+}
+
+void pa_hash_slots_insert(pa_hash_slot *slots, unsigned n_slots, unsigned hash, void *entry) {
+    unsigned i;
+
+    pa_assert(slots);
+    pa_assert(entry);
+
+    for (i = hash & (n_slots - 1); slots[i].entry; i = pa_hash_slots_next(i, n_slots))
+        ;
+
+    slots[i].hash = hash;
+    slots[i].entry = entry;
+}
+
+/* Remove the entry from the table, and move entries that follow it in
+ * the same probe sequence up, so that lookups never need tombstones */
+void pa_hash_slots_remove(pa_hash_slot *slots, unsigned n_slots, unsigned hash, const void *entry) {
+    unsigned mask = n_slots - 1;
+    unsigned i, j;
+
+    pa_assert(slots);
+    pa_assert(entry);
+
+    for (i = hash & mask; slots[i].entry != entry; i = pa_hash_slots_next(i, n_slots))
+        pa_assert(slots[i].entry);
+
+    for (j = i;;) {
+        unsigned home;
+
+        j = pa_hash_slots_next(j, n_slots);
+
+        if (!slots[j].entry)
+            break;
+
+        home = slots[j].hash & mask;
+
+        /* The entry at j may only move to i if its home slot does not
+         * lie cyclically in (i, j] */
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+
+        slots[i] = slots[j];
+        i = j;
+    }
+
+    slots[i].entry = NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef foopulsecorehashslotshfoo
+#define foopulsecorehashslotshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Open addressing hash tables with linear probing, as used by pa_hashmap
+ * and pa_idxset. A table is a power of two sized array of slots, each
+ * holding an entry pointer and the full hash value of the entry, so that
+ * probing rarely needs to touch the entries themselves. Empty slots have
+ * a NULL entry. The owner keeps the entries themselves, e.g. in a list,
+ * and rebuilds the table from them when it is resized. */
+
+#define PA_HASH_SLOTS_MIN 16U
+
+typedef struct pa_hash_slot {
+    unsigned hash;
+    void *entry;
+} pa_hash_slot;
+
+/* The hash functions often leave bits unused, e.g. the low bits of
+ * pointers, so mix them before using the low bits as slot index. This
+ * is a bijection on 32 bit. */
+static inline unsigned pa_hash_slots_mix(unsigned hash) {
+    hash ^= hash >> 16;
+    hash *= 0x7feb352dU;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bU;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+static inline unsigned pa_hash_slots_next(unsigned i, unsigned n_slots) {
+    return (i + 1) & (n_slots - 1);
+}
+
+/* Returns the number of slots a table of n_slots slots should be resized
+ * to when it holds n_entries entries, or n_slots if it is fine as it is.
+ * This keeps the load factor between 1/8 and 3/4. */
+static inline unsigned pa_hash_slots_resize_to(unsigned n_slots, unsigned n_entries) {
+    if (n_entries > n_slots / 4 * 3)
+        return n_slots * 2;
+
+    if (n_slots > PA_HASH_SLOTS_MIN && n_entries < n_slots / 8)
+        return n_slots / 2;
+
+    return n_slots;
+}
+
+pa_hash_slot *pa_hash_slots_new(unsigned n_slots);
+
+void pa_hash_slots_insert(pa_hash_slot *slots, unsigned n_slots, unsigned hash, void *entry);
+
+/* Removes the entry, which must be in the table */
+void pa_hash_slots_remove(pa_hash_slot *slots, unsigned n_slots, unsigned hash, const void *entry);
+
+#endif
@@ -26,17 +26,20 @@
 #include <pulse/xmalloc.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/hash-slots.h>
 #include <pulsecore/macro.h>
 
 #include "hashmap.h"
 
-#define NBUCKETS 127
+/* The entries are kept in a linked list in insertion order, for
+ * iteration. For lookups, an open addressing hash table (see
+ * hash-slots.h) points to them. */
 
 struct hashmap_entry {
     void *key;
     void *value;
+    unsigned hash;
 
-    struct hashmap_entry *bucket_next, *bucket_previous;
     struct hashmap_entry *iterate_next, *iterate_previous;
 };
 
@@ -47,18 +50,19 @@ struct pa_hashmap {
     pa_free_cb_t key_free_func;
     pa_free_cb_t value_free_func;
 
+    pa_hash_slot *slots;
+    unsigned n_slots;
+
     struct hashmap_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
 };
 
-#define BY_HASH(h) ((struct hashmap_entry**) ((uint8_t*) (h) + PA_ALIGN(sizeof(pa_hashmap))))
-
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
 pa_hashmap *pa_hashmap_new_full(pa_hash_func_t hash_func, pa_compare_func_t compare_func, pa_free_cb_t key_free_func, pa_free_cb_t value_free_func) {
     pa_hashmap *h;
 
-    h = pa_xmalloc0(PA_ALIGN(sizeof(pa_hashmap)) + NBUCKETS*sizeof(struct hashmap_entry*));
+    h = pa_xnew0(pa_hashmap, 1);
 
     h->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     h->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
@@ -66,6 +70,9 @@ pa_hashmap *pa_hashmap_new_full(pa_hash_func_t hash_func, pa_compare_func_t comp
     h->key_free_func = key_free_func;
     h->value_free_func = value_free_func;
 
+    h->n_slots = PA_HASH_SLOTS_MIN;
+    h->slots = pa_hash_slots_new(h->n_slots);
+
     h->n_entries = 0;
     h->iterate_list_head = h->iterate_list_tail = NULL;
 
@@ -76,7 +83,23 @@ pa_hashmap *pa_hashmap_new(pa_hash_func_t hash_func, pa_compare_func_t compare_f
     return pa_hashmap_new_full(hash_func, compare_func, NULL, NULL);
 }
 
+static void resize(pa_hashmap *h, unsigned n_slots) {
+    struct hashmap_entry *e;
+
+    pa_assert(h);
+    pa_assert(h->n_entries < n_slots);
+
+    pa_xfree(h->slots);
+    h->slots = pa_hash_slots_new(n_slots);
+    h->n_slots = n_slots;
+
+    for (e = h->iterate_list_head; e; e = e->iterate_next)
+        pa_hash_slots_insert(h->slots, h->n_slots, e->hash, e);
+}
+
 static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
+    unsigned n_slots;
+
     pa_assert(h);
     pa_assert(e);
 
@@ -91,16 +114,8 @@ static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
     else
         h->iterate_list_head = e->iterate_next;
 
-    /* Remove from hash table bucket list */
-    if (e->bucket_next)
-        e->bucket_next->bucket_previous = e->bucket_previous;
-
-    if (e->bucket_previous)
-        e->bucket_previous->bucket_next = e->bucket_next;
-    else {
-        unsigned hash = h->hash_func(e->key) % NBUCKETS;
-        BY_HASH(h)[hash] = e->bucket_next;
-    }
+    /* Remove from hash table */
+    pa_hash_slots_remove(h->slots, h->n_slots, e->hash, e);
 
     if (h->key_free_func)
         h->key_free_func(e->key);
@@ -110,34 +125,40 @@ static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
 
     pa_assert(h->n_entries >= 1);
     h->n_entries--;
+
+    if ((n_slots = pa_hash_slots_resize_to(h->n_slots, h->n_entries)) != h->n_slots)
+        resize(h, n_slots);
 }
 
 void pa_hashmap_free(pa_hashmap *h) {
     pa_assert(h);
 
     pa_hashmap_remove_all(h);
+    pa_xfree(h->slots);
     pa_xfree(h);
 }
 
 static struct hashmap_entry *hash_scan(pa_hashmap *h, unsigned hash, const void *key) {
-    struct hashmap_entry *e;
+    unsigned i;
     pa_assert(h);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_HASH(h)[hash]; e; e = e->bucket_next)
-        if (h->compare_func(e->key, key) == 0)
+    for (i = hash & (h->n_slots - 1); h->slots[i].entry; i = pa_hash_slots_next(i, h->n_slots)) {
+        struct hashmap_entry *e = h->slots[i].entry;
+
+        if (h->slots[i].hash == hash && h->compare_func(e->key, key) == 0)
             return e;
+    }
 
     return NULL;
 }
 
 int pa_hashmap_put(pa_hashmap *h, void *key, void *value) {
     struct hashmap_entry *e;
-    unsigned hash;
+    unsigned hash, n_slots;
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = pa_hash_slots_mix(h->hash_func(key));
 
     if (hash_scan(h, hash, key))
         return -1;
@@ -147,13 +168,7 @@ int pa_hashmap_put(pa_hashmap *h, void *key, void *value) {
 
     e->key = key;
     e->value = value;
-
-    /* Insert into hash table */
-    e->bucket_next = BY_HASH(h)[hash];
-    e->bucket_previous = NULL;
-    if (BY_HASH(h)[hash])
-        BY_HASH(h)[hash]->bucket_previous = e;
-    BY_HASH(h)[hash] = e;
+    e->hash = hash;
 
     /* Insert into iteration list */
     e->iterate_previous = h->iterate_list_tail;
@@ -170,18 +185,21 @@ int pa_hashmap_put(pa_hashmap *h, void *key, void *value) {
     h->n_entries++;
     pa_assert(h->n_entries >= 1);
 
+    /* Insert into hash table */
+    if ((n_slots = pa_hash_slots_resize_to(h->n_slots, h->n_entries)) != h->n_slots)
+        resize(h, n_slots);
+    else
+        pa_hash_slots_insert(h->slots, h->n_slots, e->hash, e);
+
     return 0;
 }
 
 void* pa_hashmap_get(pa_hashmap *h, const void *key) {
-    unsigned hash;
     struct hashmap_entry *e;
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
-
-    if (!(e = hash_scan(h, hash, key)))
+    if (!(e = hash_scan(h, pa_hash_slots_mix(h->hash_func(key)), key)))
         return NULL;
 
     return e->value;
@@ -189,14 +207,11 @@ void* pa_hashmap_get(pa_hashmap *h, const void *key) {
 
 void* pa_hashmap_remove(pa_hashmap *h, const void *key) {
     struct hashmap_entry *e;
-    unsigned hash;
     void *data;
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
-
-    if (!(e = hash_scan(h, hash, key)))
+    if (!(e = hash_scan(h, pa_hash_slots_mix(h->hash_func(key)), key)))
         return NULL;
 
     data = e->value;
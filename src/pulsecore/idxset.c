@@ -28,18 +28,20 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/hash-slots.h>
 #include <pulsecore/macro.h>
 
 #include "idxset.h"
 
-#define NBUCKETS 127
+/* The entries are kept in a linked list in insertion order, for
+ * iteration. Two open addressing hash tables (see hash-slots.h) point
+ * to them, one hashed by data and one by index. */
 
 struct idxset_entry {
     uint32_t idx;
     void *data;
+    unsigned data_hash;
 
-    struct idxset_entry *data_next, *data_previous;
-    struct idxset_entry *index_next, *index_previous;
     struct idxset_entry *iterate_next, *iterate_previous;
 };
 
@@ -49,15 +51,34 @@ struct pa_idxset {
 
     uint32_t current_index;
 
+    /* Both tables have n_slots slots */
+    pa_hash_slot *by_data, *by_index;
+    unsigned n_slots;
+
     struct idxset_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
 };
 
-#define BY_DATA(i) ((struct idxset_entry**) ((uint8_t*) (i) + PA_ALIGN(sizeof(pa_idxset))))
-#define BY_INDEX(i) (BY_DATA(i) + NBUCKETS)
-
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
+static void resize(pa_idxset *s, unsigned n_slots) {
+    struct idxset_entry *e;
+
+    pa_assert(s);
+    pa_assert(s->n_entries < n_slots);
+
+    pa_xfree(s->by_data);
+    pa_xfree(s->by_index);
+    s->by_data = pa_hash_slots_new(n_slots);
+    s->by_index = pa_hash_slots_new(n_slots);
+    s->n_slots = n_slots;
+
+    for (e = s->iterate_list_head; e; e = e->iterate_next) {
+        pa_hash_slots_insert(s->by_data, s->n_slots, e->data_hash, e);
+        pa_hash_slots_insert(s->by_index, s->n_slots, pa_hash_slots_mix(e->idx), e);
+    }
+}
+
 unsigned pa_idxset_string_hash_func(const void *p) {
     unsigned hash = 0;
     const char *c;
@@ -83,11 +104,15 @@ int pa_idxset_trivial_compare_func(const void *a, const void *b) {
 pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_idxset *s;
 
-    s = pa_xmalloc0(PA_ALIGN(sizeof(pa_idxset)) + NBUCKETS*2*sizeof(struct idxset_entry*));
+    s = pa_xnew0(pa_idxset, 1);
 
     s->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     s->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
 
+    s->n_slots = PA_HASH_SLOTS_MIN;
+    s->by_data = pa_hash_slots_new(s->n_slots);
+    s->by_index = pa_hash_slots_new(s->n_slots);
+
     s->current_index = 0;
     s->n_entries = 0;
     s->iterate_list_head = s->iterate_list_tail = NULL;
@@ -96,6 +121,8 @@ pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_fun
 }
 
 static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
+    unsigned n_slots;
+
     pa_assert(s);
     pa_assert(e);
 
@@ -110,72 +137,70 @@ static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
     else
         s->iterate_list_head = e->iterate_next;
 
-    /* Remove from data hash table */
-    if (e->data_next)
-        e->data_next->data_previous = e->data_previous;
-
-    if (e->data_previous)
-        e->data_previous->data_next = e->data_next;
-    else {
-        unsigned hash = s->hash_func(e->data) % NBUCKETS;
-        BY_DATA(s)[hash] = e->data_next;
-    }
-
-    /* Remove from index hash table */
-    if (e->index_next)
-        e->index_next->index_previous = e->index_previous;
-
-    if (e->index_previous)
-        e->index_previous->index_next = e->index_next;
-    else
-        BY_INDEX(s)[e->idx % NBUCKETS] = e->index_next;
+    /* Remove from data and index hash tables */
+    pa_hash_slots_remove(s->by_data, s->n_slots, e->data_hash, e);
+    pa_hash_slots_remove(s->by_index, s->n_slots, pa_hash_slots_mix(e->idx), e);
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
 
     pa_assert(s->n_entries >= 1);
     s->n_entries--;
+
+    if ((n_slots = pa_hash_slots_resize_to(s->n_slots, s->n_entries)) != s->n_slots)
+        resize(s, n_slots);
 }
 
 void pa_idxset_free(pa_idxset *s, pa_free_cb_t free_cb) {
     pa_assert(s);
 
     pa_idxset_remove_all(s, free_cb);
+    pa_xfree(s->by_data);
+    pa_xfree(s->by_index);
     pa_xfree(s);
 }
 
 static struct idxset_entry* data_scan(pa_idxset *s, unsigned hash, const void *p) {
-    struct idxset_entry *e;
+    unsigned i, mask;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
     pa_assert(p);
 
-    for (e = BY_DATA(s)[hash]; e; e = e->data_next)
-        if (s->compare_func(e->data, p) == 0)
+    mask = s->n_slots - 1;
+
+    for (i = hash & mask; s->by_data[i].entry; i = pa_hash_slots_next(i, s->n_slots)) {
+        struct idxset_entry *e = s->by_data[i].entry;
+
+        if (s->by_data[i].hash == hash && s->compare_func(e->data, p) == 0)
             return e;
+    }
 
     return NULL;
 }
 
-static struct idxset_entry* index_scan(pa_idxset *s, unsigned hash, uint32_t idx) {
-    struct idxset_entry *e;
+static struct idxset_entry* index_scan(pa_idxset *s, uint32_t idx) {
+    unsigned i, mask, hash;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_INDEX(s)[hash]; e; e = e->index_next)
-        if (e->idx == idx)
-            return e;
+    mask = s->n_slots - 1;
+
+    /* pa_hash_slots_mix() is a bijection on 32 bit, so comparing the
+     * hashes suffices */
+    hash = pa_hash_slots_mix(idx);
+
+    for (i = hash & mask; s->by_index[i].entry; i = pa_hash_slots_next(i, s->n_slots))
+        if (s->by_index[i].hash == hash)
+            return s->by_index[i].entry;
 
     return NULL;
 }
 
 int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
-    unsigned hash;
+    unsigned hash, n_slots;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = pa_hash_slots_mix(s->hash_func(p));
 
     if ((e = data_scan(s, hash, p))) {
         if (idx)
@@ -188,24 +213,9 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
         e = pa_xnew(struct idxset_entry, 1);
 
     e->data = p;
+    e->data_hash = hash;
     e->idx = s->current_index++;
 
-    /* Insert into data hash table */
-    e->data_next = BY_DATA(s)[hash];
-    e->data_previous = NULL;
-    if (BY_DATA(s)[hash])
-        BY_DATA(s)[hash]->data_previous = e;
-    BY_DATA(s)[hash] = e;
-
-    hash = e->idx % NBUCKETS;
-
-    /* Insert into index hash table */
-    e->index_next = BY_INDEX(s)[hash];
-    e->index_previous = NULL;
-    if (BY_INDEX(s)[hash])
-        BY_INDEX(s)[hash]->index_previous = e;
-    BY_INDEX(s)[hash] = e;
-
     /* Insert into iteration list */
     e->iterate_previous = s->iterate_list_tail;
     e->iterate_next = NULL;
@@ -221,6 +231,14 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
     s->n_entries++;
     pa_assert(s->n_entries >= 1);
 
+    /* Insert into data and index hash tables */
+    if ((n_slots = pa_hash_slots_resize_to(s->n_slots, s->n_entries)) != s->n_slots)
+        resize(s, n_slots);
+    else {
+        pa_hash_slots_insert(s->by_data, s->n_slots, e->data_hash, e);
+        pa_hash_slots_insert(s->by_index, s->n_slots, pa_hash_slots_mix(e->idx), e);
+    }
+
     if (idx)
         *idx = e->idx;
 
@@ -228,28 +246,22 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 }
 
 void* pa_idxset_get_by_index(pa_idxset*s, uint32_t idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     return e->data;
 }
 
 void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
-
-    if (!(e = data_scan(s, hash, p)))
+    if (!(e = data_scan(s, pa_hash_slots_mix(s->hash_func(p)), p)))
         return NULL;
 
     if (idx)
@@ -260,14 +272,11 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
 void* pa_idxset_remove_by_index(pa_idxset*s, uint32_t idx) {
     struct idxset_entry *e;
-    unsigned hash;
     void *data;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     data = e->data;
@@ -278,14 +287,11 @@ void* pa_idxset_remove_by_index(pa_idxset*s, uint32_t idx) {
 
 void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
     void *r;
 
     pa_assert(s);
 
-    hash = s->hash_func(data) % NBUCKETS;
-
-    if (!(e = data_scan(s, hash, data)))
+    if (!(e = data_scan(s, pa_hash_slots_mix(s->hash_func(data)), data)))
         return NULL;
 
     r = e->data;
@@ -312,15 +318,12 @@ void pa_idxset_remove_all(pa_idxset *s, pa_free_cb_t free_cb) {
 }
 
 void* pa_idxset_rrobin(pa_idxset *s, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
     pa_assert(idx);
 
-    hash = *idx % NBUCKETS;
-
-    e = index_scan(s, hash, *idx);
+    e = index_scan(s, *idx);
 
     if (e && e->iterate_next)
         e = e->iterate_next;
@@ -402,7 +405,6 @@ void* pa_idxset_first(pa_idxset *s, uint32_t *idx) {
 
 void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
 
     pa_assert(s);
     pa_assert(idx);
@@ -410,9 +412,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     if (*idx == PA_IDXSET_INVALID)
         return NULL;
 
-    hash = *idx % NBUCKETS;
-
-    if ((e = index_scan(s, hash, *idx))) {
+    if ((e = index_scan(s, *idx))) {
 
         e = e->iterate_next;
 
@@ -431,9 +431,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
 
         for ((*idx)++; *idx < s->current_index; (*idx)++) {
 
-            hash = *idx % NBUCKETS;
-
-            if ((e = index_scan(s, hash, *idx))) {
+            if ((e = index_scan(s, *idx))) {
                 *idx = e->idx;
                 return e->data;
             }
@@ -41,6 +41,50 @@
 
 #include "iochannel.h"
 
+#ifdef HAVE_IO_URING
+
+typedef struct uring_rx {
+    unsigned buffer;
+    const uint8_t *data;
+    size_t length;
+    PA_LLIST_FIELDS(struct uring_rx);
+} uring_rx;
+
+/* The state of a channel in io_uring mode. It is kept around after the
+ * channel is freed until all operations on the socket are done, and the
+ * socket is only closed then, so that its number can't be reused under
+ * our feet. */
+typedef struct uring_channel {
+    pa_uring *uring;
+    pa_iochannel *io;
+    int fd;
+    bool close_fd;
+
+    pa_uring_op *recv_op;
+    PA_LLIST_HEAD(uring_rx, rx);
+    uring_rx *rx_tail;
+    bool eof;
+    int recv_error;
+
+    /* What is written during a main loop iteration is collected in the
+     * fill buffer and sent in one go at the end of it. Only one send is
+     * in flight at a time. Both are registered send buffers, or malloc()ed
+     * memory (buffer -1) if we ran out of those. */
+    int fill_buffer;
+    uint8_t *fill_data;
+    size_t fill_length;
+
+    pa_uring_op *send_op;
+    int send_buffer;
+    uint8_t *send_data;
+    size_t send_index, send_length;
+    int send_error;
+
+    pa_uring_flush_item flush_item;
+} uring_channel;
+
+#endif
+
 struct pa_iochannel {
     int ifd, ofd;
     int ifd_type, ofd_type;
@@ -55,6 +99,11 @@ struct pa_iochannel {
     bool no_close:1;
 
     pa_io_event* input_event, *output_event;
+
+#ifdef HAVE_IO_URING
+    uring_channel *uring;
+    pa_defer_event *uring_defer;
+#endif
 };
 
 static void callback(pa_mainloop_api* m, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata);
@@ -74,6 +123,11 @@ static void delete_events(pa_iochannel *io) {
 static void enable_events(pa_iochannel *io) {
     pa_assert(io);
 
+#ifdef HAVE_IO_URING
+    if (io->uring)
+        return;
+#endif
+
     if (io->hungup) {
         delete_events(io);
         return;
@@ -159,6 +213,290 @@ static void callback(pa_mainloop_api* m, pa_io_event *e, int fd, pa_io_event_fla
     }
 }
 
+#ifdef HAVE_IO_URING
+
+static void uring_channel_maybe_free(uring_channel *c) {
+    uring_rx *rx;
+
+    pa_assert(c);
+
+    if (c->io || c->recv_op || c->send_op)
+        return;
+
+    while ((rx = c->rx)) {
+        PA_LLIST_REMOVE(uring_rx, c->rx, rx);
+        pa_uring_put_recv_buffer(c->uring, rx->buffer);
+        pa_xfree(rx);
+    }
+
+    if (c->fill_data) {
+        if (c->fill_buffer >= 0)
+            pa_uring_put_send_buffer(c->uring, (unsigned) c->fill_buffer);
+        else
+            pa_xfree(c->fill_data);
+    }
+
+    pa_uring_dequeue_flush(c->uring, &c->flush_item);
+
+    if (c->close_fd)
+        pa_close(c->fd);
+
+    pa_uring_unref(c->uring);
+    pa_xfree(c);
+}
+
+/* Calls the user callback from a clean stack, the completions of the ring
+ * are dispatched for all channels at once */
+static void uring_notify(pa_iochannel *io) {
+    pa_assert(io);
+
+    io->mainloop->defer_enable(io->uring_defer, 1);
+}
+
+static void uring_defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
+    pa_iochannel *io = userdata;
+
+    pa_assert(io);
+
+    m->defer_enable(e, 0);
+
+    if (io->callback)
+        io->callback(io, io->userdata);
+}
+
+static void uring_recv_cb(pa_uring_op *op, int32_t res, unsigned buffer, bool final, void *userdata) {
+    uring_channel *c = userdata;
+
+    pa_assert(c);
+
+    if (res > 0) {
+        uring_rx *rx;
+
+        rx = pa_xnew(uring_rx, 1);
+        rx->buffer = buffer;
+        rx->data = pa_uring_get_recv_buffer(c->uring, buffer);
+        rx->length = (size_t) res;
+
+        PA_LLIST_INSERT_AFTER(uring_rx, c->rx, c->rx_tail, rx);
+        c->rx_tail = rx;
+    }
+
+    if (final) {
+        c->recv_op = NULL;
+
+        if (res == 0)
+            c->eof = true;
+        else if (res < 0 && res != -ECANCELED)
+            c->recv_error = -res;
+    }
+
+    if (!c->io) {
+        uring_channel_maybe_free(c);
+        return;
+    }
+
+    if (c->rx)
+        c->io->readable = true;
+
+    if (c->eof || c->recv_error)
+        c->io->hungup = true;
+
+    uring_notify(c->io);
+}
+
+static void uring_send_cb(pa_uring_op *op, int32_t res, unsigned buffer, bool final, void *userdata);
+
+static void uring_send(uring_channel *c) {
+    pa_assert(c);
+    pa_assert(!c->send_op);
+    pa_assert(c->send_index < c->send_length);
+
+    if (!(c->send_op = pa_uring_send(c->uring, c->fd, c->send_buffer, c->send_data + c->send_index,
+                                     c->send_length - c->send_index, uring_send_cb, c)))
+        c->send_error = errno;
+}
+
+static void uring_send_fill(uring_channel *c) {
+    pa_assert(c);
+    pa_assert(!c->send_op);
+    pa_assert(!c->send_data);
+
+    if (c->fill_length <= 0 || c->send_error)
+        return;
+
+    c->send_buffer = c->fill_buffer;
+    c->send_data = c->fill_data;
+    c->send_index = 0;
+    c->send_length = c->fill_length;
+
+    c->fill_data = NULL;
+    c->fill_length = 0;
+
+    uring_send(c);
+}
+
+static void uring_release_send_data(uring_channel *c) {
+    pa_assert(c);
+    pa_assert(c->send_data);
+
+    if (c->send_buffer >= 0)
+        pa_uring_put_send_buffer(c->uring, (unsigned) c->send_buffer);
+    else
+        pa_xfree(c->send_data);
+
+    c->send_data = NULL;
+}
+
+static void uring_send_cb(pa_uring_op *op, int32_t res, unsigned buffer, bool final, void *userdata) {
+    uring_channel *c = userdata;
+
+    pa_assert(c);
+    pa_assert(final);
+
+    c->send_op = NULL;
+
+    if (res < 0) {
+        if (res != -ECANCELED)
+            c->send_error = -res;
+    } else
+        c->send_index += (size_t) res;
+
+    if (c->send_index < c->send_length && !c->send_error && c->io) {
+        /* Partial send, the socket buffer is full */
+        uring_send(c);
+
+        if (c->send_op)
+            return;
+    }
+
+    uring_release_send_data(c);
+
+    if (!c->io) {
+        uring_channel_maybe_free(c);
+        return;
+    }
+
+    uring_send_fill(c);
+
+    if (c->send_error)
+        c->io->hungup = true;
+
+    c->io->writable = true;
+    uring_notify(c->io);
+}
+
+static void uring_flush_cb(pa_uring_flush_item *item) {
+    uring_channel *c = item->userdata;
+
+    pa_assert(c);
+
+    if (!c->send_op)
+        uring_send_fill(c);
+}
+
+static ssize_t uring_write(pa_iochannel *io, const void *data, size_t l) {
+    uring_channel *c = io->uring;
+    size_t size;
+
+    if (c->send_error) {
+        errno = c->send_error;
+        return -1;
+    }
+
+    size = pa_uring_get_send_buffer_size(c->uring);
+
+    if (!c->fill_data) {
+        void *d;
+
+        if ((c->fill_buffer = pa_uring_get_send_buffer(c->uring, &d)) < 0)
+            d = pa_xmalloc(size);
+
+        c->fill_data = d;
+    }
+
+    l = PA_MIN(l, size - c->fill_length);
+    memcpy(c->fill_data + c->fill_length, data, l);
+    c->fill_length += l;
+
+    if (!c->send_op)
+        pa_uring_queue_flush(c->uring, &c->flush_item);
+
+    /* We get going again once the send in flight is done */
+    if (c->fill_length >= size)
+        io->writable = false;
+
+    return (ssize_t) l;
+}
+
+static ssize_t uring_read(pa_iochannel *io, void *data, size_t l) {
+    uring_channel *c = io->uring;
+    uring_rx *rx;
+    size_t n = 0;
+
+    while (n < l && (rx = c->rx)) {
+        size_t k = PA_MIN(l - n, rx->length);
+
+        memcpy((uint8_t*) data + n, rx->data, k);
+        rx->data += k;
+        rx->length -= k;
+        n += k;
+
+        if (rx->length <= 0) {
+            PA_LLIST_REMOVE(uring_rx, c->rx, rx);
+            if (c->rx_tail == rx)
+                c->rx_tail = NULL;
+
+            pa_uring_put_recv_buffer(c->uring, rx->buffer);
+            pa_xfree(rx);
+        }
+    }
+
+    /* Whatever is left is not going to trigger another completion */
+    io->readable = !!c->rx;
+    if (io->readable || io->hungup)
+        uring_notify(io);
+
+    if (n > 0)
+        return (ssize_t) n;
+
+    if (c->recv_error) {
+        errno = c->recv_error;
+        return -1;
+    }
+
+    if (c->eof)
+        return 0;
+
+    errno = EAGAIN;
+    return -1;
+}
+
+static void uring_free(pa_iochannel *io) {
+    uring_channel *c = io->uring;
+
+    pa_assert(c);
+
+    c->close_fd = !io->no_close;
+
+    io->mainloop->defer_free(io->uring_defer);
+    pa_xfree(io);
+
+    /* Like a plain close() we drop whatever hasn't been sent yet */
+    c->io = NULL;
+    pa_uring_dequeue_flush(c->uring, &c->flush_item);
+
+    if (c->send_op)
+        pa_uring_cancel(c->send_op);
+
+    /* This may call uring_recv_cb() right away, which frees c */
+    if (c->recv_op)
+        pa_uring_cancel(c->recv_op);
+    else
+        uring_channel_maybe_free(c);
+}
+
+#endif
+
 pa_iochannel* pa_iochannel_new(pa_mainloop_api*m, int ifd, int ofd) {
     pa_iochannel *io;
 
@@ -183,6 +521,13 @@ pa_iochannel* pa_iochannel_new(pa_mainloop_api*m, int ifd, int ofd) {
 void pa_iochannel_free(pa_iochannel*io) {
     pa_assert(io);
 
+#ifdef HAVE_IO_URING
+    if (io->uring) {
+        uring_free(io);
+        return;
+    }
+#endif
+
     delete_events(io);
 
     if (!io->no_close) {
@@ -221,6 +566,11 @@ ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l) {
     pa_assert(l);
     pa_assert(io->ofd >= 0);
 
+#ifdef HAVE_IO_URING
+    if (io->uring)
+        return uring_write(io, data, l);
+#endif
+
     r = pa_write(io->ofd, data, l, &io->ofd_type);
 
     if ((size_t) r == l)
@@ -247,6 +597,11 @@ ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     pa_assert(data);
     pa_assert(io->ifd >= 0);
 
+#ifdef HAVE_IO_URING
+    if (io->uring)
+        return uring_read(io, data, l);
+#endif
+
     if ((r = pa_read(io->ifd, data, l, &io->ifd_type)) >= 0) {
 
         /* We also reset the hangup flag here to ensure that another
@@ -311,6 +666,9 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     pa_assert(data);
     pa_assert(l);
     pa_assert(io->ofd >= 0);
+#ifdef HAVE_IO_URING
+    pa_assert(!io->uring);
+#endif
 
     pa_zero(iov);
     iov.iov_base = (void*) data;
@@ -360,6 +718,9 @@ ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l,
     pa_assert(data);
     pa_assert(l);
     pa_assert(io->ofd >= 0);
+#ifdef HAVE_IO_URING
+    pa_assert(!io->uring);
+#endif
     pa_assert(fds);
     pa_assert(nfd > 0);
     pa_assert(nfd <= MAX_ANCIL_DATA_FDS);
@@ -404,6 +765,14 @@ ssize_t pa_iochannel_read_with_ancil_data(pa_iochannel*io, void*data, size_t l,
     pa_assert(io->ifd >= 0);
     pa_assert(ancil_data);
 
+#ifdef HAVE_IO_URING
+    if (io->uring) {
+        ancil_data->creds_valid = false;
+        ancil_data->nfd = 0;
+        return uring_read(io, data, l);
+    }
+#endif
+
     if (io->ifd_type > 0) {
         ancil_data->creds_valid = false;
         ancil_data->nfd = 0;
@@ -531,3 +900,53 @@ bool pa_iochannel_socket_is_local(pa_iochannel *io) {
 
     return false;
 }
+
+#ifdef HAVE_IO_URING
+
+int pa_iochannel_enable_uring(pa_iochannel *io, pa_uring *u) {
+    union {
+        struct sockaddr sa;
+        struct sockaddr_storage storage;
+    } sa;
+    socklen_t l = sizeof(sa);
+    uring_channel *c;
+
+    pa_assert(io);
+    pa_assert(u);
+    pa_assert(!io->uring);
+
+    if (io->ifd < 0 || io->ifd != io->ofd)
+        return -1;
+
+    /* Credentials and file descriptors need sendmsg()/recvmsg() */
+    if (getsockname(io->ifd, &sa.sa, &l) < 0 || sa.sa.sa_family == AF_UNIX)
+        return -1;
+
+    c = pa_xnew0(uring_channel, 1);
+    c->uring = pa_uring_ref(u);
+    c->io = io;
+    c->fd = io->ifd;
+    c->fill_buffer = c->send_buffer = -1;
+    c->flush_item.callback = uring_flush_cb;
+    c->flush_item.userdata = c;
+
+    if (!(c->recv_op = pa_uring_recv(u, c->fd, uring_recv_cb, c))) {
+        pa_uring_unref(c->uring);
+        pa_xfree(c);
+        return -1;
+    }
+
+    delete_events(io);
+
+    io->uring = c;
+    io->uring_defer = io->mainloop->defer_new(io->mainloop, uring_defer_cb, io);
+
+    /* Data that arrived already is picked up by the receive */
+    io->readable = io->hungup = false;
+    io->writable = true;
+    uring_notify(io);
+
+    return 0;
+}
+
+#endif
@@ -31,6 +31,10 @@
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
 
+#ifdef HAVE_IO_URING
+#include <pulsecore/uring.h>
+#endif
+
 /* A wrapper around UNIX file descriptors for attaching them to the a
    main event loop. Every time new data may be read or be written to
    the channel a callback function is called. It is safe to destroy
@@ -86,4 +90,11 @@ pa_mainloop_api* pa_iochannel_get_mainloop_api(pa_iochannel *io);
 int pa_iochannel_get_recv_fd(pa_iochannel *io);
 int pa_iochannel_get_send_fd(pa_iochannel *io);
 
+#ifdef HAVE_IO_URING
+/* Switch a socket channel over to do all its IO through the ring. This
+ * fails for UNIX sockets, since those may carry ancillary data. Writes are
+ * buffered and sent at the end of the main loop iteration. */
+int pa_iochannel_enable_uring(pa_iochannel *io, pa_uring *u);
+#endif
+
 #endif
@@ -45,6 +45,7 @@
 #include <pulsecore/refcnt.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/memtrap.h>
 
@@ -57,6 +58,43 @@
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
+/* Small blocks are not given a slot of their own. Instead some slots
+ * are split up into equally sized pieces ("slabs"), one set of slabs
+ * for each size class. Class i hands out pieces of block_size >>
+ * slab_shift[i] bytes, memblock header included. At most
+ * PA_MEMPOOL_SLABS_MAX slots are split up per class, after that small
+ * blocks get a whole slot again. */
+#define PA_MEMPOOL_N_CLASSES 4
+#define PA_MEMPOOL_SLABS_MAX 8U
+
+/* Allocation class for blocks that take a whole slot */
+#define PA_MEMPOOL_CLASS_SLOT PA_MEMPOOL_N_CLASSES
+
+/* Freed slots and slab pieces are kept in a number of small caches
+ * first, each thread using the one picked by its thread index. Only
+ * when a cache is empty (or full) the shared free lists are touched,
+ * which all threads contend on. */
+#define PA_MEMPOOL_MAGAZINES 8
+#define PA_MEMPOOL_MAGAZINE_SIZE 16
+
+/* When the slots run low, the pool grows by additional segments of
+ * a quarter of its initial size each, up to its maximum size, instead
+ * of letting blocks fall back to malloc() and losing zero-copy
+ * transfer. Segments are created by the main thread ahead of time, see
+ * pa_mempool_grow(). Segments that are completely unused are given back
+ * by pa_mempool_vacuum(). */
+#define PA_MEMPOOL_SEGMENT_FRACTION 4
+
+/* Growing is requested once this share of the slots, in quarters, of
+ * the pool or of all its segments is in use */
+#define PA_MEMPOOL_HIGH_WATER_QUARTERS 3
+
+enum {
+    SEGMENT_UNUSED,
+    SEGMENT_ACTIVE,
+    SEGMENT_RETIRING
+};
+
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
 #define PA_MEMIMPORT_SLOTS_MAX 160
@@ -92,6 +130,32 @@ struct pa_memblock {
     } per_type;
 };
 
+static const unsigned slab_shift[PA_MEMPOOL_N_CLASSES] = { 8, 6, 4, 2 };
+
+struct mempool_magazine {
+    /* Taken with a cmpxchg, never waited for */
+    pa_atomic_t busy;
+    unsigned n_free[PA_MEMPOOL_N_CLASSES + 1];
+    void *free[PA_MEMPOOL_N_CLASSES + 1][PA_MEMPOOL_MAGAZINE_SIZE];
+};
+
+struct mempool_segment {
+    pa_atomic_t state;
+    /* Threads currently allocating from this segment */
+    pa_atomic_t n_users;
+    /* Slots handed out */
+    pa_atomic_t n_used;
+    pa_atomic_t n_init;
+
+    /* Set once the memfd was handed out for registration with a
+     * client. Registrations are permanent on the client side, so such a
+     * segment is kept until the pool is freed. Main thread only. */
+    bool registered;
+
+    pa_shm memory;
+    pa_flist *free_slots;
+};
+
 struct pa_memimport_segment {
     pa_memimport *import;
     pa_shm memory;
@@ -200,6 +264,30 @@ struct pa_mempool {
     /* A list of free slots that may be reused */
     pa_flist *free_slots;
 
+    /* For each slot the size class + 1 if it was split up into slabs,
+     * 0 otherwise. Slots never go back once they have been split. */
+    uint8_t *slot_class;
+
+    /* Free slab pieces, per size class */
+    pa_flist *free_slabs[PA_MEMPOOL_N_CLASSES];
+    pa_atomic_t n_slabs[PA_MEMPOOL_N_CLASSES];
+    unsigned n_slabs_max;
+
+    struct mempool_magazine magazines[PA_MEMPOOL_MAGAZINES];
+
+    /* Grown segments, all n_segment_blocks slots large. Created and
+     * destroyed with the mutex held, but allocation from them is lock
+     * free. */
+    struct mempool_segment segments[PA_MEMPOOL_SEGMENTS_MAX];
+    unsigned n_segments_max;
+    unsigned n_segment_blocks;
+    pa_atomic_t segment_generation;
+
+    pa_mempool_grow_cb_t grow_cb;
+    void *grow_userdata;
+    /* Set while a request to grow is outstanding */
+    pa_atomic_t grow_requested;
+
     pa_mempool_stat stat;
 };
 
@@ -207,6 +295,10 @@ static void segment_detach(pa_memimport_segment *seg);
 
 PA_STATIC_FLIST_DECLARE(unused_memblocks, 0, pa_xfree);
 
+/* Index + 1 of the magazine the calling thread uses */
+PA_STATIC_TLS_DECLARE_NO_FREE(mempool_magazine);
+static pa_atomic_t n_magazine_threads = PA_ATOMIC_INIT(0);
+
 /* No lock necessary */
 static void stat_add(pa_memblock*b) {
     pa_assert(b);
@@ -249,6 +341,18 @@ static void stat_remove(pa_memblock *b) {
     pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
 }
 
+/* No lock necessary */
+static void stat_add_pool_used(pa_mempool *p, int size) {
+    int used, max;
+
+    used = pa_atomic_add(&p->stat.pool_used_size, size) + size;
+
+    do {
+        if ((max = pa_atomic_load(&p->stat.pool_used_size_max)) >= used)
+            break;
+    } while (!pa_atomic_cmpxchg(&p->stat.pool_used_size_max, max, used));
+}
+
 static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length);
 
 /* No lock necessary */
@@ -258,8 +362,10 @@ pa_memblock *pa_memblock_new(pa_mempool *p, size_t length) {
     pa_assert(p);
     pa_assert(length);
 
-    if (!(b = pa_memblock_new_pool(p, length)))
+    if (!(b = pa_memblock_new_pool(p, length))) {
+        pa_atomic_inc(&p->stat.n_fallback);
         b = memblock_new_appended(p, length);
+    }
 
     return b;
 }
@@ -292,7 +398,97 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static struct mempool_slot* segment_allocate_slot(pa_mempool *p, struct mempool_segment *seg) {
+    struct mempool_slot *slot;
+    int idx;
+
+    if ((slot = pa_flist_pop(seg->free_slots)))
+        return slot;
+
+    if ((unsigned) (idx = pa_atomic_inc(&seg->n_init)) >= p->n_segment_blocks) {
+        pa_atomic_dec(&seg->n_init);
+        return NULL;
+    }
+
+    return (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + (p->block_size * (size_t) idx));
+}
+
+/* No lock necessary. Asks the owner of the pool to grow it, unless it
+ * can't grow any further or was asked already. Returns true if the
+ * request was made. */
+static bool mempool_request_grow(pa_mempool *p) {
+    unsigned i;
+
+    if (!p->grow_cb)
+        return false;
+
+    for (i = 0; i < p->n_segments_max; i++)
+        if (pa_atomic_load(&p->segments[i].state) == SEGMENT_UNUSED)
+            break;
+
+    if (i >= p->n_segments_max)
+        return false;
+
+    if (!pa_atomic_cmpxchg(&p->grow_requested, 0, 1))
+        return false;
+
+    p->grow_cb(p, p->grow_userdata);
+    return true;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_from_segments(pa_mempool *p) {
+    unsigned i;
+
+    for (i = 0; i < p->n_segments_max; i++) {
+        struct mempool_segment *seg = &p->segments[i];
+        struct mempool_slot *slot = NULL;
+        unsigned n_used = 0;
+
+        if (pa_atomic_load(&seg->state) != SEGMENT_ACTIVE)
+            continue;
+
+        /* Keeps pa_mempool_vacuum() from destroying the segment under
+         * our feet, see mempool_shrink() */
+        pa_atomic_inc(&seg->n_users);
+
+        if (pa_atomic_load(&seg->state) == SEGMENT_ACTIVE &&
+            (slot = segment_allocate_slot(p, seg)))
+            n_used = (unsigned) pa_atomic_inc(&seg->n_used) + 1;
+
+        pa_atomic_dec(&seg->n_users);
+
+        if (slot) {
+            /* pa_mempool_grow() checks whether the others have room left */
+            if (n_used * 4 >= p->n_segment_blocks * PA_MEMPOOL_HIGH_WATER_QUARTERS)
+                mempool_request_grow(p);
+
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_grown(pa_mempool *p) {
+    struct mempool_slot *slot;
+
+    if ((slot = mempool_allocate_from_segments(p)))
+        return slot;
+
+    /* If the pool was grown right away, because we are the main thread,
+     * the new segment can be used already. Otherwise this allocation
+     * fails and the following ones use the new segment. */
+    if (mempool_request_grow(p))
+        slot = mempool_allocate_from_segments(p);
+
+    return slot;
+}
+
+/* No lock necessary. Slots of grown segments are only handed out if
+ * grow is true, they can't be split into slabs. */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, bool grow) {
     struct mempool_slot *slot;
     pa_assert(p);
 
@@ -303,10 +499,18 @@ static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
 
         if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
             pa_atomic_dec(&p->n_init);
-        else
+        else {
             slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
 
-        if (!slot) {
+            /* Get a segment ready before the pool runs full */
+            if ((unsigned) idx * 4 >= p->n_blocks * PA_MEMPOOL_HIGH_WATER_QUARTERS)
+                mempool_request_grow(p);
+        }
+
+        if (!slot && !grow)
+            return NULL;
+
+        if (!slot && !(slot = mempool_allocate_grown(p))) {
             if (pa_log_ratelimit(PA_LOG_DEBUG))
                 pa_log_debug("Pool full");
             pa_atomic_inc(&p->stat.n_pool_full);
@@ -328,6 +532,27 @@ static inline void* mempool_slot_data(struct mempool_slot *slot) {
     return slot;
 }
 
+/* No lock necessary. Returns the grown segment ptr points into, or
+ * NULL if it is part of the pool's initial memory. */
+static struct mempool_segment* mempool_segment_by_ptr(pa_mempool *p, void *ptr) {
+    unsigned i;
+
+    if ((uint8_t*) ptr >= (uint8_t*) p->memory.ptr && (uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size)
+        return NULL;
+
+    for (i = 0; i < p->n_segments_max; i++) {
+        struct mempool_segment *seg = &p->segments[i];
+
+        if (pa_atomic_load(&seg->state) == SEGMENT_UNUSED)
+            continue;
+
+        if ((uint8_t*) ptr >= (uint8_t*) seg->memory.ptr && (uint8_t*) ptr < (uint8_t*) seg->memory.ptr + seg->memory.size)
+            return seg;
+    }
+
+    pa_assert_not_reached();
+}
+
 /* No lock necessary */
 static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
     pa_assert(p);
@@ -348,6 +573,182 @@ static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
     return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
 }
 
+/* No lock necessary */
+static size_t mempool_class_size(pa_mempool *p, unsigned c) {
+    pa_assert(c <= PA_MEMPOOL_CLASS_SLOT);
+
+    if (c == PA_MEMPOOL_CLASS_SLOT)
+        return p->block_size;
+
+    return p->block_size >> slab_shift[c];
+}
+
+/* No lock necessary. Returns the smallest size class a block with
+ * header and the given amount of data fits in. */
+static unsigned mempool_class_for_size(pa_mempool *p, size_t length) {
+    unsigned c;
+
+    for (c = 0; c < PA_MEMPOOL_N_CLASSES; c++)
+        if (PA_ALIGN(sizeof(pa_memblock)) + length <= mempool_class_size(p, c))
+            return c;
+
+    return PA_MEMPOOL_CLASS_SLOT;
+}
+
+/* No lock necessary. Returns the magazine of the calling thread, or
+ * NULL if another thread happens to use it right now. Release it with
+ * mempool_magazine_put(). */
+static struct mempool_magazine *mempool_magazine_get(pa_mempool *p) {
+    struct mempool_magazine *m;
+    unsigned idx;
+
+    if (!(idx = PA_PTR_TO_UINT(PA_STATIC_TLS_GET(mempool_magazine)))) {
+        idx = (unsigned) pa_atomic_inc(&n_magazine_threads) % PA_MEMPOOL_MAGAZINES + 1;
+        PA_STATIC_TLS_SET(mempool_magazine, PA_UINT_TO_PTR(idx));
+    }
+
+    m = &p->magazines[idx - 1];
+
+    if (!pa_atomic_cmpxchg(&m->busy, 0, 1))
+        return NULL;
+
+    return m;
+}
+
+static void mempool_magazine_put(struct mempool_magazine *m) {
+    pa_atomic_store(&m->busy, 0);
+}
+
+/* No lock necessary */
+static void mempool_push_free(pa_mempool *p, unsigned c, void *ptr) {
+    /* The free list dimensions allow all slots (or pieces of
+     * slabs) to fit in, hence try harder if pushing fails */
+    while (pa_flist_push(c == PA_MEMPOOL_CLASS_SLOT ? p->free_slots : p->free_slabs[c], ptr) < 0)
+        ;
+}
+
+/* No lock necessary. Splits a fresh slot up into pieces of size class
+ * c, returns the first one and puts the rest on the free list. */
+static void *mempool_allocate_slab(pa_mempool *p, unsigned c) {
+    struct mempool_slot *slot;
+    size_t size, i;
+
+    if ((unsigned) pa_atomic_inc(&p->n_slabs[c]) >= p->n_slabs_max) {
+        pa_atomic_dec(&p->n_slabs[c]);
+        return NULL;
+    }
+
+    if (!(slot = mempool_allocate_slot(p, false))) {
+        pa_atomic_dec(&p->n_slabs[c]);
+        return NULL;
+    }
+
+    /* Published to other threads by the barrier in pa_flist_push() */
+    p->slot_class[mempool_slot_idx(p, slot)] = (uint8_t) (c + 1);
+    pa_atomic_inc(&p->stat.n_slabs);
+    stat_add_pool_used(p, (int) p->block_size);
+
+    size = mempool_class_size(p, c);
+    for (i = size; i < p->block_size; i += size)
+        mempool_push_free(p, c, (uint8_t*) slot + i);
+
+    return slot;
+}
+
+/* No lock necessary. Takes a cached entry of class c from any magazine
+ * that isn't in use right now. */
+static void *mempool_steal_from_magazines(pa_mempool *p, unsigned c) {
+    unsigned i;
+    void *ptr = NULL;
+
+    for (i = 0; i < PA_MEMPOOL_MAGAZINES && !ptr; i++) {
+        struct mempool_magazine *m = &p->magazines[i];
+
+        if (!pa_atomic_cmpxchg(&m->busy, 0, 1))
+            continue;
+
+        if (m->n_free[c] > 0)
+            ptr = m->free[c][--m->n_free[c]];
+
+        mempool_magazine_put(m);
+    }
+
+    return ptr;
+}
+
+/* No lock necessary */
+static void *mempool_allocate(pa_mempool *p, unsigned c) {
+    struct mempool_magazine *m;
+    void *ptr = NULL;
+
+    if ((m = mempool_magazine_get(p))) {
+        if (m->n_free[c] > 0)
+            ptr = m->free[c][--m->n_free[c]];
+        mempool_magazine_put(m);
+
+        if (ptr)
+            return ptr;
+    }
+
+    if (c == PA_MEMPOOL_CLASS_SLOT)
+        ptr = mempool_allocate_slot(p, false);
+    else if (!(ptr = pa_flist_pop(p->free_slabs[c])))
+        ptr = mempool_allocate_slab(p, c);
+
+    if (ptr)
+        return ptr;
+
+    /* Threads that free more than they allocate may be sitting on what
+     * we need in their magazines. Take it from there before growing the
+     * pool or giving up. */
+    if ((ptr = mempool_steal_from_magazines(p, c)))
+        return ptr;
+
+    if (c == PA_MEMPOOL_CLASS_SLOT)
+        return mempool_allocate_slot(p, true);
+
+    return NULL;
+}
+
+/* No lock necessary */
+static void mempool_free_slot(pa_mempool *p, unsigned c, void *ptr) {
+    struct mempool_magazine *m;
+
+    if ((m = mempool_magazine_get(p))) {
+        bool cached = false;
+
+        if (m->n_free[c] < PA_MEMPOOL_MAGAZINE_SIZE) {
+            m->free[c][m->n_free[c]++] = ptr;
+            cached = true;
+        }
+        mempool_magazine_put(m);
+
+        if (cached)
+            return;
+    }
+
+    mempool_push_free(p, c, ptr);
+}
+
+/* Not multiple caller safe. Moves everything cached in the magazines
+ * back to the shared free lists, skipping magazines that are in use. */
+static void mempool_flush_magazines(pa_mempool *p) {
+    unsigned i, c;
+
+    for (i = 0; i < PA_MEMPOOL_MAGAZINES; i++) {
+        struct mempool_magazine *m = &p->magazines[i];
+
+        if (!pa_atomic_cmpxchg(&m->busy, 0, 1))
+            continue;
+
+        for (c = 0; c <= PA_MEMPOOL_CLASS_SLOT; c++)
+            while (m->n_free[c] > 0)
+                mempool_push_free(p, c, m->free[c][--m->n_free[c]]);
+
+        mempool_magazine_put(m);
+    }
+}
+
 /* No lock necessary */
 bool pa_mempool_is_remote_writable(pa_mempool *p) {
     pa_assert(p);
@@ -383,19 +784,31 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
         length = pa_mempool_block_size_max(p);
 
     if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+        unsigned c = mempool_class_for_size(p, length);
 
-        if (!(slot = mempool_allocate_slot(p)))
+        /* If the slabs of this class are used up, take a whole slot */
+        if (!(slot = mempool_allocate(p, c)) && c != PA_MEMPOOL_CLASS_SLOT)
+            slot = mempool_allocate(p, c = PA_MEMPOOL_CLASS_SLOT);
+
+        if (!slot)
             return NULL;
 
+        pa_atomic_add(&p->stat.pool_footprint_size, (int) mempool_class_size(p, c));
+        if (c == PA_MEMPOOL_CLASS_SLOT)
+            stat_add_pool_used(p, (int) p->block_size);
+
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
     } else if (p->block_size >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate(p, PA_MEMPOOL_CLASS_SLOT)))
             return NULL;
 
+        pa_atomic_add(&p->stat.pool_footprint_size, (int) p->block_size);
+        stat_add_pool_used(p, (int) p->block_size);
+
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
             b = pa_xnew(pa_memblock, 1);
 
@@ -642,12 +1055,47 @@ static void memblock_free(pa_memblock *b) {
 
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
+            struct mempool_segment *seg;
             struct mempool_slot *slot;
+            unsigned c;
             bool call_free;
 
+            call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
+
+            if ((seg = mempool_segment_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)))) {
+                size_t offset = (size_t) ((uint8_t*) pa_atomic_ptr_load(&b->data) - (uint8_t*) seg->memory.ptr);
+
+                slot = (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + offset / b->pool->block_size * b->pool->block_size);
+
+                pa_atomic_sub(&b->pool->stat.pool_footprint_size, (int) b->pool->block_size);
+                stat_add_pool_used(b->pool, - (int) b->pool->block_size);
+
+                /* Grown segments are not cached in magazines, so that
+                 * they can be given back when unused */
+                while (pa_flist_push(seg->free_slots, slot) < 0)
+                    ;
+                pa_atomic_dec(&seg->n_used);
+
+                if (call_free)
+                    if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
+                        pa_xfree(b);
+
+                break;
+            }
+
             pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
 
-            call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
+            /* Pieces of a slab start with their memblock header */
+            if ((c = b->pool->slot_class[mempool_slot_idx(b->pool, slot)]) > 0) {
+                pa_assert(!call_free);
+                slot = (struct mempool_slot*) b;
+                c--;
+            } else {
+                c = PA_MEMPOOL_CLASS_SLOT;
+                stat_add_pool_used(b->pool, - (int) b->pool->block_size);
+            }
+
+            pa_atomic_sub(&b->pool->stat.pool_footprint_size, (int) mempool_class_size(b->pool, c));
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*             if (PA_UNLIKELY(pa_in_valgrind())) { */
@@ -655,11 +1103,7 @@ static void memblock_free(pa_memblock *b) {
 /*             } */
 /* #endif */
 
-            /* The free list dimensions should easily allow all slots
-             * to fit in, hence try harder if pushing this slot into
-             * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
-                ;
+            mempool_free_slot(b->pool, c, slot);
 
             if (call_free)
                 if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
@@ -714,10 +1158,13 @@ static void memblock_make_local(pa_memblock *b) {
     if (b->length <= b->pool->block_size) {
         struct mempool_slot *slot;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, true))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
+            pa_atomic_add(&b->pool->stat.pool_footprint_size, (int) b->pool->block_size);
+            stat_add_pool_used(b->pool, (int) b->pool->block_size);
+
             new_data = mempool_slot_data(slot);
             memcpy(new_data, pa_atomic_ptr_load(&b->data), b->length);
             pa_atomic_ptr_store(&b->data, new_data);
@@ -828,6 +1275,7 @@ static void memblock_replace_import(pa_memblock *b) {
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
+    unsigned i;
 
     p = pa_xnew0(pa_mempool, 1);
     PA_REFCNT_INIT(p);
@@ -869,12 +1317,78 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
 
     p->free_slots = pa_flist_new(p->n_blocks);
 
+    p->slot_class = pa_xnew0(uint8_t, p->n_blocks);
+
+    /* Leave most slots to blocks that need them whole */
+    p->n_slabs_max = PA_MIN(PA_MEMPOOL_SLABS_MAX, p->n_blocks / 16);
+
+    for (i = 0; i < PA_MEMPOOL_N_CLASSES; i++)
+        p->free_slabs[i] = pa_flist_new(p->n_slabs_max << slab_shift[i]);
+
+    /* The pool doesn't grow unless asked to */
+    p->n_segments_max = 0;
+    p->n_segment_blocks = PA_MAX(p->n_blocks / PA_MEMPOOL_SEGMENT_FRACTION, 2U);
+    pa_atomic_store(&p->stat.pool_size, (int) p->memory.size);
+
     return p;
 }
 
+/* Self-locked. Gives back the grown segments that have no slots in
+ * use and that no client has mapped. */
+static void mempool_shrink(pa_mempool *p) {
+    unsigned i;
+
+    pa_mutex_lock(p->mutex);
+
+    for (i = 0; i < p->n_segments_max; i++) {
+        struct mempool_segment *seg = &p->segments[i];
+        pa_shm memory;
+
+        if (pa_atomic_load(&seg->n_used) > 0)
+            continue;
+
+        /* Unmapping it here would free nothing while the clients keep
+         * their mappings, and we can't revoke those */
+        if (seg->registered)
+            continue;
+
+        if (!pa_atomic_cmpxchg(&seg->state, SEGMENT_ACTIVE, SEGMENT_RETIRING))
+            continue;
+
+        /* Anybody who started allocating before we marked the segment
+         * is still counted in n_users, anybody after that sees the
+         * mark and backs off. Check n_used again, allocations that
+         * completed in the meantime show up there. */
+        if (pa_atomic_load(&seg->n_users) > 0 || pa_atomic_load(&seg->n_used) > 0) {
+            pa_atomic_store(&seg->state, SEGMENT_ACTIVE);
+            continue;
+        }
+
+        memory = seg->memory;
+        pa_flist_free(seg->free_slots, NULL);
+        seg->free_slots = NULL;
+
+        /* Mark it unused before unmapping, so that the address range
+         * can't be mistaken for a new segment mapped at the same
+         * place, see mempool_segment_by_ptr() */
+        pa_atomic_store(&seg->state, SEGMENT_UNUSED);
+
+        pa_atomic_dec(&p->stat.n_segments);
+        pa_atomic_sub(&p->stat.pool_size, (int) memory.size);
+
+        pa_shm_free(&memory);
+    }
+
+    pa_mutex_unlock(p->mutex);
+}
+
 static void mempool_free(pa_mempool *p) {
+    unsigned i;
+
     pa_assert(p);
 
+    mempool_flush_magazines(p);
+
     pa_mutex_lock(p->mutex);
 
     while (p->imports)
@@ -887,6 +1401,9 @@ static void mempool_free(pa_mempool *p) {
 
     pa_flist_free(p->free_slots, NULL);
 
+    for (i = 0; i < PA_MEMPOOL_N_CLASSES; i++)
+        pa_flist_free(p->free_slabs[i], NULL);
+
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
@@ -931,11 +1448,22 @@ static void mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
+    for (i = 0; i < p->n_segments_max; i++) {
+        struct mempool_segment *seg = &p->segments[i];
+
+        if (pa_atomic_load(&seg->state) == SEGMENT_UNUSED)
+            continue;
+
+        pa_flist_free(seg->free_slots, NULL);
+        pa_shm_free(&seg->memory);
+    }
+
     pa_shm_free(&p->memory);
 
     pa_mutex_free(p->mutex);
     pa_semaphore_free(p->semaphore);
 
+    pa_xfree(p->slot_class);
     pa_xfree(p);
 }
 
@@ -960,6 +1488,8 @@ void pa_mempool_vacuum(pa_mempool *p) {
 
     pa_assert(p);
 
+    mempool_flush_magazines(p);
+
     list = pa_flist_new(p->n_blocks);
 
     while ((slot = pa_flist_pop(p->free_slots)))
@@ -974,6 +1504,124 @@ void pa_mempool_vacuum(pa_mempool *p) {
     }
 
     pa_flist_free(list, NULL);
+
+    mempool_shrink(p);
+
+    /* In case a request got lost, e.g. with the thread that made it */
+    pa_atomic_store(&p->grow_requested, 0);
+}
+
+/* Not multiple caller safe, call before the pool is used. */
+void pa_mempool_set_max_size(pa_mempool *p, size_t size) {
+    size_t segment_size;
+
+    pa_assert(p);
+
+    segment_size = p->n_segment_blocks * p->block_size;
+
+    if (size == 0)
+        size = p->memory.size * 4;
+
+    if (size <= p->memory.size)
+        p->n_segments_max = 0;
+    else
+        p->n_segments_max = (unsigned) PA_MIN((size - p->memory.size) / segment_size, (size_t) PA_MEMPOOL_SEGMENTS_MAX);
+
+    pa_log_debug("Memory pool may grow by %u segments of %lu bytes each",
+                 p->n_segments_max, (unsigned long) segment_size);
+}
+
+/* Not multiple caller safe, call before the pool is used. */
+void pa_mempool_set_grow_callback(pa_mempool *p, pa_mempool_grow_cb_t cb, void *userdata) {
+    pa_assert(p);
+
+    p->grow_cb = cb;
+    p->grow_userdata = userdata;
+}
+
+/* Main thread only. Adds a segment, unless one of the existing ones
+ * still has plenty of free slots. */
+void pa_mempool_grow(pa_mempool *p) {
+    struct mempool_segment *seg = NULL;
+    char t[PA_BYTES_SNPRINT_MAX];
+    unsigned i;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+
+    for (i = 0; i < p->n_segments_max; i++) {
+        unsigned state = (unsigned) pa_atomic_load(&p->segments[i].state);
+
+        if (state == SEGMENT_UNUSED && !seg)
+            seg = &p->segments[i];
+        else if (state == SEGMENT_ACTIVE &&
+                 (unsigned) pa_atomic_load(&p->segments[i].n_used) * 4 < p->n_segment_blocks * PA_MEMPOOL_HIGH_WATER_QUARTERS) {
+            seg = NULL;
+            break;
+        }
+    }
+
+    if (!seg)
+        goto finish;
+
+    if (pa_shm_create_rw(&seg->memory, p->memory.type, p->n_segment_blocks * p->block_size, 0700) < 0)
+        goto finish;
+
+    seg->free_slots = pa_flist_new(p->n_segment_blocks);
+    seg->registered = false;
+    pa_atomic_store(&seg->n_users, 0);
+    pa_atomic_store(&seg->n_used, 0);
+    pa_atomic_store(&seg->n_init, 0);
+
+    /* Publishes the segment */
+    pa_atomic_store(&seg->state, SEGMENT_ACTIVE);
+
+    pa_atomic_inc(&p->segment_generation);
+    pa_atomic_inc(&p->stat.n_segments);
+    pa_atomic_add(&p->stat.pool_size, (int) seg->memory.size);
+
+    pa_log_debug("Memory pool running low, grew by %s", pa_bytes_snprint(t, sizeof(t), (unsigned) seg->memory.size));
+
+finish:
+    pa_atomic_store(&p->grow_requested, 0);
+    pa_mutex_unlock(p->mutex);
+}
+
+/* No lock necessary. Changes every time the pool grows. */
+unsigned pa_mempool_get_segment_generation(pa_mempool *p) {
+    pa_assert(p);
+
+    return (unsigned) pa_atomic_load(&p->segment_generation);
+}
+
+/* Main thread only, vacuuming must not happen concurrently.
+ *
+ * Returns the memfd fd of the idx-th grown segment of the pool and
+ * stores its SHM ID in *id, or returns -1 if that segment doesn't exist
+ * right now. The fd stays owned by the pool. Since the fd is meant to be
+ * registered with a client, the segment won't be given back by
+ * pa_mempool_vacuum() anymore. */
+int pa_mempool_get_segment_memfd_fd(pa_mempool *p, unsigned idx, uint32_t *id) {
+    struct mempool_segment *seg;
+
+    pa_assert(p);
+    pa_assert(id);
+    pa_assert(idx < PA_MEMPOOL_SEGMENTS_MAX);
+
+    if (!pa_mempool_is_memfd_backed(p))
+        return -1;
+
+    seg = &p->segments[idx];
+
+    if (pa_atomic_load(&seg->state) == SEGMENT_UNUSED)
+        return -1;
+
+    *id = seg->memory.id;
+    seg->registered = true;
+
+    pa_assert(seg->memory.fd != -1);
+    return seg->memory.fd;
 }
 
 /* No lock necessary */
@@ -1494,10 +2142,16 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint3
         pa_assert(b->per_type.imported.segment);
         memory = &b->per_type.imported.segment->memory;
     } else {
+        struct mempool_segment *seg;
+
         pa_assert(b->type == PA_MEMBLOCK_POOL || b->type == PA_MEMBLOCK_POOL_EXTERNAL);
         pa_assert(b->pool);
         pa_assert(pa_mempool_is_shared(b->pool));
-        memory = &b->pool->memory;
+
+        if ((seg = mempool_segment_by_ptr(b->pool, data)))
+            memory = &seg->memory;
+        else
+            memory = &b->pool->memory;
     }
 
     pa_assert(data >= memory->ptr);
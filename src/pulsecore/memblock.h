@@ -54,8 +54,12 @@ typedef struct pa_memimport_segment pa_memimport_segment;
 typedef struct pa_memimport pa_memimport;
 typedef struct pa_memexport pa_memexport;
 
+/* Maximum number of segments a pool grows by */
+#define PA_MEMPOOL_SEGMENTS_MAX 16
+
 typedef void (*pa_memimport_release_cb_t)(pa_memimport *i, uint32_t block_id, void *userdata);
 typedef void (*pa_memexport_revoke_cb_t)(pa_memexport *e, uint32_t block_id, void *userdata);
+typedef void (*pa_mempool_grow_cb_t)(pa_mempool *p, void *userdata);
 
 /* Please note that updates to this structure are not locked,
  * i.e. n_allocated might be updated at a point in time where
@@ -74,6 +78,22 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Pool memory taken by the allocated pool blocks, including headers
+     * and rounding up to the slot or slab size */
+    pa_atomic_t pool_footprint_size;
+    /* Slots split up for small blocks */
+    pa_atomic_t n_slabs;
+
+    /* Memory mapped by the pool, including segments it grew by */
+    pa_atomic_t pool_size;
+    pa_atomic_t n_segments;
+    /* Memory of the slots in use, and its high-water mark */
+    pa_atomic_t pool_used_size;
+    pa_atomic_t pool_used_size_max;
+    /* Blocks allocated with malloc() since the pool was full or the
+     * block too large for it */
+    pa_atomic_t n_fallback;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
 };
@@ -138,6 +158,19 @@ bool pa_mempool_is_remote_writable(pa_mempool *p);
 void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable);
 size_t pa_mempool_block_size_max(pa_mempool *p);
 
+/* Lets the pool grow up to size bytes when it runs full, 0 picks four
+ * times the initial size. By default it doesn't grow. */
+void pa_mempool_set_max_size(pa_mempool *p, size_t size);
+
+/* Growing maps new shared memory, which allocating threads never do
+ * themselves. When the pool is running low, the callback is called from
+ * the allocating thread instead, and is expected to get pa_mempool_grow()
+ * called from the main thread. The pool doesn't grow without it. */
+void pa_mempool_set_grow_callback(pa_mempool *p, pa_mempool_grow_cb_t cb, void *userdata);
+void pa_mempool_grow(pa_mempool *p);
+unsigned pa_mempool_get_segment_generation(pa_mempool *p);
+int pa_mempool_get_segment_memfd_fd(pa_mempool *p, unsigned idx, uint32_t *id);
+
 int pa_mempool_take_memfd_fd(pa_mempool *p);
 int pa_mempool_get_memfd_fd(pa_mempool *p);
 
@@ -24,17 +24,17 @@
 #endif
 
 #include <math.h>
+#include <string.h>
 
 #include <pulsecore/sample-util.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/g711.h>
 #include <pulsecore/endianmacros.h>
+#include <pulsecore/sconv.h>
 
 #include "cpu.h"
 #include "mix.h"
 
-#define VOLUME_PADDING 32
-
 static void calc_linear_integer_volume(int32_t linear[], const pa_cvolume *volume) {
     unsigned channel, nchannels, padding;
 
@@ -46,7 +46,7 @@ static void calc_linear_integer_volume(int32_t linear[], const pa_cvolume *volum
     for (channel = 0; channel < nchannels; channel++)
         linear[channel] = (int32_t) lrint(pa_sw_volume_to_linear(volume->values[channel]) * 0x10000);
 
-    for (padding = 0; padding < VOLUME_PADDING; padding++, channel++)
+    for (padding = 0; padding < PA_VOLUME_PADDING; padding++, channel++)
         linear[channel] = linear[padding];
 }
 
@@ -61,13 +61,13 @@ static void calc_linear_float_volume(float linear[], const pa_cvolume *volume) {
     for (channel = 0; channel < nchannels; channel++)
         linear[channel] = (float) pa_sw_volume_to_linear(volume->values[channel]);
 
-    for (padding = 0; padding < VOLUME_PADDING; padding++, channel++)
+    for (padding = 0; padding < PA_VOLUME_PADDING; padding++, channel++)
         linear[channel] = linear[padding];
 }
 
 static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
     unsigned k, channel;
-    float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
+    float linear[PA_CHANNELS_MAX + PA_VOLUME_PADDING];
 
     pa_assert(streams);
     pa_assert(spec);
@@ -86,7 +86,7 @@ static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned n
 
 static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
     unsigned k, channel;
-    float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
+    float linear[PA_CHANNELS_MAX + PA_VOLUME_PADDING];
 
     pa_assert(streams);
     pa_assert(spec);
@@ -605,11 +605,151 @@ static pa_do_mix_func_t do_mix_table[] = {
     [PA_SAMPLE_S24_32RE]  = (pa_do_mix_func_t) pa_mix_s24_32re_c
 };
 
+/* Mixing many streams: the output is processed in tiles, each stream is
+ * added to a wide accumulator for the tile one after the other and the
+ * accumulator is clamped and stored once at the end. This keeps the inner
+ * loop free of per-sample stream switching and pointer updates, and the
+ * accumulator in the L1 cache, no matter how many streams there are. */
+#define ACCUMULATE_FRAMES 64U
+
+static void pa_mix_accumulate_s16ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    int32_t acc[ACCUMULATE_FRAMES * PA_CHANNELS_MAX];
+    unsigned nframes = length / (sizeof(int16_t) * channels);
+
+    while (nframes > 0) {
+        unsigned frames = PA_MIN(nframes, ACCUMULATE_FRAMES);
+        unsigned n = frames * channels;
+        unsigned i, j, f, c;
+
+        memset(acc, 0, n * sizeof(int32_t));
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const int16_t *src = m->ptr;
+            int32_t lin[PA_CHANNELS_MAX];
+
+            for (c = 0; c < channels; c++)
+                lin[c] = m->linear[c].i;
+
+            if (channels == 2) {
+                for (j = 0; j < n; j += 2) {
+                    acc[j] += pa_mult_s16_volume(src[j], lin[0]);
+                    acc[j + 1] += pa_mult_s16_volume(src[j + 1], lin[1]);
+                }
+            } else {
+                for (f = 0, j = 0; f < frames; f++)
+                    for (c = 0; c < channels; c++, j++)
+                        acc[j] += pa_mult_s16_volume(src[j], lin[c]);
+            }
+
+            m->ptr = (uint8_t*) m->ptr + n * sizeof(int16_t);
+        }
+
+        for (j = 0; j < n; j++)
+            *data++ = PA_CLAMP_UNLIKELY(acc[j], -0x8000, 0x7FFF);
+
+        nframes -= frames;
+    }
+}
+
+static void pa_mix_accumulate_s32ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    int64_t acc[ACCUMULATE_FRAMES * PA_CHANNELS_MAX];
+    unsigned nframes = length / (sizeof(int32_t) * channels);
+
+    while (nframes > 0) {
+        unsigned frames = PA_MIN(nframes, ACCUMULATE_FRAMES);
+        unsigned n = frames * channels;
+        unsigned i, j, f, c;
+
+        memset(acc, 0, n * sizeof(int64_t));
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const int32_t *src = m->ptr;
+            int64_t lin[PA_CHANNELS_MAX];
+
+            for (c = 0; c < channels; c++)
+                lin[c] = m->linear[c].i;
+
+            for (f = 0, j = 0; f < frames; f++)
+                for (c = 0; c < channels; c++, j++)
+                    acc[j] += (src[j] * lin[c]) >> 16;
+
+            m->ptr = (uint8_t*) m->ptr + n * sizeof(int32_t);
+        }
+
+        for (j = 0; j < n; j++)
+            *data++ = (int32_t) PA_CLAMP_UNLIKELY(acc[j], -0x80000000LL, 0x7FFFFFFFLL);
+
+        nframes -= frames;
+    }
+}
+
+static void pa_mix_accumulate_float32ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned nframes = length / (sizeof(float) * channels);
+
+    /* The float output needs no clamping, so it is the accumulator */
+    while (nframes > 0) {
+        unsigned frames = PA_MIN(nframes, ACCUMULATE_FRAMES);
+        unsigned n = frames * channels;
+        unsigned i, j, f, c;
+
+        memset(data, 0, n * sizeof(float));
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const float *src = m->ptr;
+            float lin[PA_CHANNELS_MAX];
+
+            for (c = 0; c < channels; c++)
+                lin[c] = m->linear[c].f;
+
+            for (f = 0, j = 0; f < frames; f++)
+                for (c = 0; c < channels; c++, j++)
+                    data[j] += src[j] * lin[c];
+
+            m->ptr = (uint8_t*) m->ptr + n * sizeof(float);
+        }
+
+        data += n;
+        nframes -= frames;
+    }
+}
+
+/* Optimized functions installed with pa_set_mix_func() sum all streams in
+ * wide registers themselves, so they take over from these (see there). */
+static pa_do_mix_func_t do_mix_accumulate_table[] = {
+    [PA_SAMPLE_S16NE]     = (pa_do_mix_func_t) pa_mix_accumulate_s16ne,
+    [PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_accumulate_float32ne,
+    [PA_SAMPLE_S32NE]     = (pa_do_mix_func_t) pa_mix_accumulate_s32ne,
+    [PA_SAMPLE_MAX]       = NULL
+};
+
 void pa_mix_func_init(const pa_cpu_info *cpu_info) {
-    if (cpu_info->force_generic_code)
+    do_mix_accumulate_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_accumulate_s16ne;
+    do_mix_accumulate_table[PA_SAMPLE_S32NE] = (pa_do_mix_func_t) pa_mix_accumulate_s32ne;
+    do_mix_accumulate_table[PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_accumulate_float32ne;
+
+    do_mix_table[PA_SAMPLE_S32NE] = (pa_do_mix_func_t) pa_mix_s32ne_c;
+    do_mix_table[PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_float32ne_c;
+
+    if (cpu_info->force_generic_code) {
         do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_generic_s16ne;
-    else
-        do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_s16ne_c;
+        return;
+    }
+
+    do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_s16ne_c;
+
+    /* The optimized functions are installed last, so that they are not
+     * overridden by the C versions above */
+#if defined (__i386__) || defined (__amd64__)
+    if (cpu_info->cpu_type == PA_CPU_X86)
+        pa_mix_func_init_sse(cpu_info->flags.x86);
+#endif
+#ifdef HAVE_NEON
+    if (cpu_info->cpu_type == PA_CPU_ARM && (cpu_info->flags.arm & PA_CPU_ARM_NEON))
+        pa_mix_func_init_neon(cpu_info->flags.arm);
+#endif
 }
 
 size_t pa_mix(
@@ -644,7 +784,11 @@ size_t pa_mix(
     }
 
     calc_stream_volumes_table[spec->format](streams, nstreams, volume, spec);
-    do_mix_table[spec->format](streams, nstreams, spec->channels, data, length);
+
+    if (nstreams > PA_MIX_DIRECT_STREAMS_MAX && do_mix_accumulate_table[spec->format])
+        do_mix_accumulate_table[spec->format](streams, nstreams, spec->channels, data, length);
+    else
+        do_mix_table[spec->format](streams, nstreams, spec->channels, data, length);
 
     for (k = 0; k < nstreams; k++)
         pa_memblock_release(streams[k].chunk.memblock);
@@ -652,6 +796,78 @@ size_t pa_mix(
     return length;
 }
 
+/* Converts frames frames of each stream to float, applies the stream
+ * volumes and adds them to acc */
+static void accumulate_float32(pa_mix_info streams[], unsigned nstreams, const pa_sample_spec *spec, pa_convert_func_t to_float, float *acc, unsigned frames) {
+    float tmp[ACCUMULATE_FRAMES * PA_CHANNELS_MAX];
+    unsigned channels = spec->channels;
+    unsigned n = frames * channels;
+    size_t sample_size = pa_sample_size(spec);
+    unsigned i, j, f, c;
+
+    pa_assert(frames <= ACCUMULATE_FRAMES);
+
+    for (i = 0; i < nstreams; i++) {
+        pa_mix_info *m = streams + i;
+        float lin[PA_CHANNELS_MAX];
+
+        to_float(n, m->ptr, tmp);
+
+        for (c = 0; c < channels; c++)
+            lin[c] = m->linear[c].f;
+
+        for (f = 0, j = 0; f < frames; f++)
+            for (c = 0; c < channels; c++, j++)
+                acc[j] += tmp[j] * lin[c];
+
+        m->ptr = (uint8_t*) m->ptr + n * sample_size;
+    }
+}
+
+void pa_mix_add_float32ne(
+        pa_mix_info streams[],
+        unsigned nstreams,
+        float *data,
+        size_t length,
+        const pa_sample_spec *spec) {
+
+    pa_cvolume full_volume;
+    pa_convert_func_t to_float;
+    size_t nframes;
+    unsigned k;
+
+    pa_assert(streams);
+    pa_assert(data);
+    pa_assert(spec);
+    pa_assert(pa_frame_aligned(length, spec));
+
+    if (nstreams <= 0)
+        return;
+
+    pa_assert_se(to_float = pa_get_convert_to_float32ne_function(spec->format));
+
+    for (k = 0; k < nstreams; k++) {
+        pa_assert(length <= streams[k].chunk.length);
+        streams[k].ptr = pa_memblock_acquire_chunk(&streams[k].chunk);
+    }
+
+    calc_linear_float_stream_volumes(streams, nstreams, pa_cvolume_reset(&full_volume, spec->channels), spec);
+
+    nframes = length / pa_frame_size(spec);
+
+    while (nframes > 0) {
+        unsigned frames = (unsigned) PA_MIN(nframes, ACCUMULATE_FRAMES);
+
+        accumulate_float32(streams, nstreams, spec, to_float, data, frames);
+
+        data += frames * spec->channels;
+        nframes -= frames;
+    }
+
+    for (k = 0; k < nstreams; k++)
+        pa_memblock_release(streams[k].chunk.memblock);
+}
+
 pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f) {
     pa_assert(pa_sample_format_valid(f));
 
@@ -662,6 +878,7 @@ void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func) {
     pa_assert(pa_sample_format_valid(f));
 
     do_mix_table[f] = func;
+    do_mix_accumulate_table[f] = NULL;
 }
 
 typedef union {
@@ -693,7 +910,7 @@ void pa_volume_memchunk(
         const pa_cvolume *volume) {
 
     void *ptr;
-    volume_val linear[PA_CHANNELS_MAX + VOLUME_PADDING];
+    volume_val linear[PA_CHANNELS_MAX + PA_VOLUME_PADDING];
     pa_do_volume_func_t do_volume;
 
     pa_assert(c);
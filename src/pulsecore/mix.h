@@ -40,6 +40,13 @@ typedef struct pa_mix_info {
     } linear[PA_CHANNELS_MAX];
 } pa_mix_info;
 
+/* Up to this many streams are mixed sample by sample with the function
+ * returned by pa_get_mix_func(). Beyond that, pa_mix() accumulates the
+ * streams one by one into a wide intermediate buffer, unless an optimized
+ * function was installed with pa_set_mix_func(). There is no limit on the
+ * number of streams. */
+#define PA_MIX_DIRECT_STREAMS_MAX 32
+
 size_t pa_mix(
     pa_mix_info channels[],
     unsigned nchannels,
@@ -49,6 +56,17 @@ size_t pa_mix(
     const pa_cvolume *volume,
     bool mute);
 
+/* Converts the streams from the sample format of spec to float32, applies
+ * their volumes and adds them to the float32ne samples in data, which
+ * hold as many frames as length bytes in spec. The sum is neither
+ * converted nor clamped. */
+void pa_mix_add_float32ne(
+    pa_mix_info streams[],
+    unsigned nstreams,
+    float *data,
+    size_t length,
+    const pa_sample_spec *spec);
+
 typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length);
 
 pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
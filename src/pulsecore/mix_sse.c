@@ -0,0 +1,700 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
+
+/* All functions in here process the output in blocks of a fixed number of
+ * samples. Each block is accumulated over all streams in registers and
+ * written out once. The per-sample volume factors are loaded straight from
+ * m->linear[], which is extended beyond the last channel so that a block
+ * starting at any channel can be loaded without wrapping around. */
+
+#define PTR_OFFSET offsetof(pa_mix_info, ptr)
+#define LINEAR_OFFSET offsetof(pa_mix_info, linear)
+
+/* Repeat the channel volumes so that linear[phase .. phase + block - 1] is
+ * valid for every phase < channels. Returns false if this does not fit. */
+static bool pad_linear(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned block) {
+    unsigned i, c;
+
+    if (channels + block - 1 > PA_CHANNELS_MAX)
+        return false;
+
+    for (i = 0; i < nstreams; i++)
+        for (c = channels; c < channels + block - 1; c++)
+            streams[i].linear[c] = streams[i].linear[c - channels];
+
+    return true;
+}
+
+static inline unsigned next_phase(unsigned phase, unsigned step, unsigned channels) {
+    phase += step;
+    if (phase >= channels)
+        phase -= channels;
+    return phase;
+}
+
+/* Scalar versions, used for the samples that do not fill a whole block and
+ * for channel counts the vector code does not handle. They give the same
+ * results as the generic functions in mix.c. */
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *data, unsigned n) {
+    for (; n > 0; n--) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += pa_mult_s16_volume(*((int16_t*) m->ptr), m->linear[channel].i);
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
+
+        *data++ = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *data, unsigned n) {
+    for (; n > 0; n--) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += ((int64_t) *((int32_t*) m->ptr) * m->linear[channel].i) >> 16;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
+
+        *data++ = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *data, unsigned n) {
+    for (; n > 0; n--) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += *((float*) m->ptr) * m->linear[channel].f;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
+
+        *data++ = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+/* s16 samples are multiplied with the 16.16 fixed point volume by splitting
+ * the volume in its high and low 16 bits, just like pa_mult_s16_volume()
+ * does, so the result is bit exact:
+ *   (p * v) >> 16 == p * vh + ((p * vl) >> 16)
+ * pmulhuw treats p as unsigned, which is corrected by subtracting vl for
+ * negative samples. s is expected as | 0 | p | and v as | vh | vl | per
+ * dword, the result is accumulated in a. */
+#define MIX_32x16_SSE2(s,v,a)                                                    \
+      " movdqa "#s", %%xmm6             \n\t" /* .. |    0  |   p0  | */         \
+      " pxor %%xmm7, %%xmm7             \n\t"                                    \
+      " pcmpgtw "#s", %%xmm7            \n\t" /* .. |    0  | s(p0) | */         \
+      " pand "#v", %%xmm7               \n\t" /* .. |    0  |  (vl) | */         \
+      " pmulhuw "#v", "#s"              \n\t" /* .. |    0  | vl*p0 | */         \
+      " psubd %%xmm7, "#s"              \n\t" /* .. |    0  | vl*p0 | + sign correct */ \
+      " psrld $16, "#v"                 \n\t" /* .. |    0  |   vh  | */         \
+      " pmaddwd %%xmm6, "#v"            \n\t" /* .. |    p0 * vh    | */         \
+      " paddd "#s", "#v"                \n\t" /* .. |    p0 * v0    | */         \
+      " paddd "#v", "#a"                \n\t"
+
+/* mix s16ne streams, 8 samples at a time */
+static void pa_mix_s16ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned step;
+    pa_reg_x86 phase = 0;
+
+    length /= sizeof(int16_t);
+
+    if (!pad_linear(streams, nstreams, channels, 8)) {
+        mix_s16ne_tail(streams, nstreams, channels, 0, data, length);
+        return;
+    }
+
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8, data += 8) {
+        pa_mix_info *m = streams;
+        pa_reg_x86 n = nstreams, ptr;
+
+        __asm__ __volatile__ (
+            " pxor %%xmm0, %%xmm0                   \n\t" /* sum of samples 0..3 */
+            " pxor %%xmm1, %%xmm1                   \n\t" /* sum of samples 4..7 */
+
+            "1:                                     \n\t"
+            " mov %c[poff](%[m]), %[ptr]            \n\t"
+            " movdqu (%[ptr]), %%xmm3               \n\t" /* | p7 .. p0 | */
+            " add $16, %[ptr]                       \n\t"
+            " mov %[ptr], %c[poff](%[m])            \n\t"
+
+            " pxor %%xmm7, %%xmm7                   \n\t"
+            " movdqa %%xmm3, %%xmm4                 \n\t"
+            " punpcklwd %%xmm7, %%xmm4              \n\t" /* | 0 | p3 | .. | 0 | p0 | */
+            " punpckhwd %%xmm7, %%xmm3              \n\t" /* | 0 | p7 | .. | 0 | p4 | */
+
+            " movdqu %c[loff](%[m],%[phase],4), %%xmm2 \n\t" /* | v3 .. v0 | */
+            MIX_32x16_SSE2(%%xmm4, %%xmm2, %%xmm0)
+            " movdqu %c[loff]+16(%[m],%[phase],4), %%xmm2 \n\t" /* | v7 .. v4 | */
+            MIX_32x16_SSE2(%%xmm3, %%xmm2, %%xmm1)
+
+            " add %[size], %[m]                     \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            " packssdw %%xmm1, %%xmm0               \n\t" /* clamp and pack */
+            " movdqu %%xmm0, (%[data])              \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [ptr] "=&r" (ptr)
+            : [data] "r" (data), [phase] "r" (phase),
+              [poff] "i" (PTR_OFFSET), [loff] "i" (LINEAR_OFFSET), [size] "i" (sizeof(pa_mix_info))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        phase = next_phase(phase, step, channels);
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, phase, data, length);
+}
+
+/* special case: mix 2 s16ne streams whose channel count divides 8, so the
+ * volumes for each block are the same and can be kept in registers */
+static void pa_mix2_s16ne_sse2(pa_mix_info streams[], unsigned channels, int16_t *data, unsigned length) {
+    int16_t *ptr0 = streams[0].ptr;
+    int16_t *ptr1 = streams[1].ptr;
+    pa_reg_x86 n;
+
+    pa_assert(8 % channels == 0);
+    pad_linear(streams, 2, channels, 8);
+
+    length /= sizeof(int16_t);
+    n = length / 8;
+
+    if (n > 0) {
+        __asm__ __volatile__ (
+            "1:                                     \n\t"
+            " movdqu (%[ptr0]), %%xmm0              \n\t" /* | p7 .. p0 | of stream 0 */
+            " movdqu (%[ptr1]), %%xmm1              \n\t" /* | p7 .. p0 | of stream 1 */
+            " add $16, %[ptr0]                      \n\t"
+            " add $16, %[ptr1]                      \n\t"
+            " pxor %%xmm2, %%xmm2                   \n\t" /* sum of samples 0..3 */
+            " pxor %%xmm3, %%xmm3                   \n\t" /* sum of samples 4..7 */
+
+            " pxor %%xmm7, %%xmm7                   \n\t"
+            " movdqa %%xmm0, %%xmm4                 \n\t"
+            " punpcklwd %%xmm7, %%xmm4              \n\t" /* | 0 | p3 | .. | 0 | p0 | */
+            " punpckhwd %%xmm7, %%xmm0              \n\t" /* | 0 | p7 | .. | 0 | p4 | */
+            " movdqu (%[lin0]), %%xmm5              \n\t"
+            MIX_32x16_SSE2(%%xmm4, %%xmm5, %%xmm2)
+            " movdqu 16(%[lin0]), %%xmm5            \n\t"
+            MIX_32x16_SSE2(%%xmm0, %%xmm5, %%xmm3)
+
+            " pxor %%xmm7, %%xmm7                   \n\t"
+            " movdqa %%xmm1, %%xmm4                 \n\t"
+            " punpcklwd %%xmm7, %%xmm4              \n\t"
+            " punpckhwd %%xmm7, %%xmm1              \n\t"
+            " movdqu (%[lin1]), %%xmm5              \n\t"
+            MIX_32x16_SSE2(%%xmm4, %%xmm5, %%xmm2)
+            " movdqu 16(%[lin1]), %%xmm5            \n\t"
+            MIX_32x16_SSE2(%%xmm1, %%xmm5, %%xmm3)
+
+            " packssdw %%xmm3, %%xmm2               \n\t" /* clamp and pack */
+            " movdqu %%xmm2, (%[data])              \n\t"
+            " add $16, %[data]                      \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            : [ptr0] "+r" (ptr0), [ptr1] "+r" (ptr1), [data] "+r" (data), [n] "+r" (n)
+            : [lin0] "r" (streams[0].linear), [lin1] "r" (streams[1].linear)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    streams[0].ptr = ptr0;
+    streams[1].ptr = ptr1;
+
+    mix_s16ne_tail(streams, 2, channels, 0, data, length % 8);
+}
+
+static void pa_mix_s16ne_sse2_dispatch(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    if (nstreams == 2 && 8 % channels == 0)
+        pa_mix2_s16ne_sse2(streams, channels, data, length);
+    else
+        pa_mix_s16ne_sse2(streams, nstreams, channels, data, length);
+}
+
+/* mix s16ne streams, 16 samples at a time. The 32 bit products of the samples
+ * with the high and low part of the volume cannot overflow, see above. */
+static void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned step;
+    pa_reg_x86 phase = 0;
+
+    if (!pad_linear(streams, nstreams, channels, 16)) {
+        pa_mix_s16ne_sse2_dispatch(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    length /= sizeof(int16_t);
+    step = 16 % channels;
+
+    for (; length >= 16; length -= 16, data += 16) {
+        pa_mix_info *m = streams;
+        pa_reg_x86 n = nstreams, ptr;
+
+        __asm__ __volatile__ (
+            " vpxor %%ymm0, %%ymm0, %%ymm0          \n\t" /* sum of samples 0..7 */
+            " vpxor %%ymm1, %%ymm1, %%ymm1          \n\t" /* sum of samples 8..15 */
+            " vpcmpeqd %%ymm7, %%ymm7, %%ymm7       \n\t"
+            " vpsrld $16, %%ymm7, %%ymm7            \n\t" /* 0x0000ffff mask */
+
+            "1:                                     \n\t"
+            " mov %c[poff](%[m]), %[ptr]            \n\t"
+            " vpmovsxwd (%[ptr]), %%ymm2            \n\t" /* p7 .. p0 */
+            " vpmovsxwd 16(%[ptr]), %%ymm3          \n\t" /* p15 .. p8 */
+            " add $32, %[ptr]                       \n\t"
+            " mov %[ptr], %c[poff](%[m])            \n\t"
+
+            " vmovdqu %c[loff](%[m],%[phase],4), %%ymm4    \n\t" /* v7 .. v0 */
+            " vmovdqu %c[loff]+32(%[m],%[phase],4), %%ymm5 \n\t" /* v15 .. v8 */
+
+            " vpand %%ymm7, %%ymm4, %%ymm6          \n\t" /* vl */
+            " vpsrld $16, %%ymm4, %%ymm4            \n\t" /* vh */
+            " vpmulld %%ymm2, %%ymm6, %%ymm6        \n\t" /* p * vl */
+            " vpsrad $16, %%ymm6, %%ymm6            \n\t"
+            " vpmulld %%ymm2, %%ymm4, %%ymm4        \n\t" /* p * vh */
+            " vpaddd %%ymm6, %%ymm0, %%ymm0         \n\t"
+            " vpaddd %%ymm4, %%ymm0, %%ymm0         \n\t"
+
+            " vpand %%ymm7, %%ymm5, %%ymm6          \n\t"
+            " vpsrld $16, %%ymm5, %%ymm5            \n\t"
+            " vpmulld %%ymm3, %%ymm6, %%ymm6        \n\t"
+            " vpsrad $16, %%ymm6, %%ymm6            \n\t"
+            " vpmulld %%ymm3, %%ymm5, %%ymm5        \n\t"
+            " vpaddd %%ymm6, %%ymm1, %%ymm1         \n\t"
+            " vpaddd %%ymm5, %%ymm1, %%ymm1         \n\t"
+
+            " add %[size], %[m]                     \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            " vpackssdw %%ymm1, %%ymm0, %%ymm0      \n\t" /* clamp and pack per 128 bit lane */
+            " vpermq $0xd8, %%ymm0, %%ymm0          \n\t" /* restore sample order */
+            " vmovdqu %%ymm0, (%[data])             \n\t"
+            " vzeroupper                            \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [ptr] "=&r" (ptr)
+            : [data] "r" (data), [phase] "r" (phase),
+              [poff] "i" (PTR_OFFSET), [loff] "i" (LINEAR_OFFSET), [size] "i" (sizeof(pa_mix_info))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        phase = next_phase(phase, step, channels);
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, phase, data, length);
+}
+
+/* special case: mix 2 s16ne streams whose channel count divides 16 */
+static void pa_mix2_s16ne_avx2(pa_mix_info streams[], unsigned channels, int16_t *data, unsigned length) {
+    int16_t *ptr0 = streams[0].ptr;
+    int16_t *ptr1 = streams[1].ptr;
+    pa_reg_x86 n;
+
+    pa_assert(16 % channels == 0);
+    pad_linear(streams, 2, channels, 16);
+
+    length /= sizeof(int16_t);
+    n = length / 16;
+
+    if (n > 0) {
+        __asm__ __volatile__ (
+            " vpcmpeqd %%ymm7, %%ymm7, %%ymm7       \n\t"
+            " vpsrld $16, %%ymm7, %%ymm7            \n\t" /* 0x0000ffff mask */
+
+            "1:                                     \n\t"
+            " vpmovsxwd (%[ptr0]), %%ymm0           \n\t" /* stream 0, p7 .. p0 */
+            " vpmovsxwd (%[ptr1]), %%ymm1           \n\t" /* stream 1, p7 .. p0 */
+            " vmovdqu (%[lin0]), %%ymm4             \n\t"
+            " vmovdqu (%[lin1]), %%ymm5             \n\t"
+
+            " vpand %%ymm7, %%ymm4, %%ymm6          \n\t"
+            " vpsrld $16, %%ymm4, %%ymm4            \n\t"
+            " vpmulld %%ymm0, %%ymm6, %%ymm6        \n\t"
+            " vpsrad $16, %%ymm6, %%ymm6            \n\t"
+            " vpmulld %%ymm0, %%ymm4, %%ymm2        \n\t"
+            " vpaddd %%ymm6, %%ymm2, %%ymm2         \n\t"
+
+            " vpand %%ymm7, %%ymm5, %%ymm6          \n\t"
+            " vpsrld $16, %%ymm5, %%ymm5            \n\t"
+            " vpmulld %%ymm1, %%ymm6, %%ymm6        \n\t"
+            " vpsrad $16, %%ymm6, %%ymm6            \n\t"
+            " vpmulld %%ymm1, %%ymm5, %%ymm5        \n\t"
+            " vpaddd %%ymm6, %%ymm2, %%ymm2         \n\t"
+            " vpaddd %%ymm5, %%ymm2, %%ymm2         \n\t" /* sum of samples 0..7 */
+
+            " vpmovsxwd 16(%[ptr0]), %%ymm0         \n\t" /* stream 0, p15 .. p8 */
+            " vpmovsxwd 16(%[ptr1]), %%ymm1         \n\t" /* stream 1, p15 .. p8 */
+            " vmovdqu 32(%[lin0]), %%ymm4           \n\t"
+            " vmovdqu 32(%[lin1]), %%ymm5           \n\t"
+
+            " vpand %%ymm7, %%ymm4, %%ymm6          \n\t"
+            " vpsrld $16, %%ymm4, %%ymm4            \n\t"
+            " vpmulld %%ymm0, %%ymm6, %%ymm6        \n\t"
+            " vpsrad $16, %%ymm6, %%ymm6            \n\t"
+            " vpmulld %%ymm0, %%ymm4, %%ymm3        \n\t"
+            " vpaddd %%ymm6, %%ymm3, %%ymm3         \n\t"
+
+            " vpand %%ymm7, %%ymm5, %%ymm6          \n\t"
+            " vpsrld $16, %%ymm5, %%ymm5            \n\t"
+            " vpmulld %%ymm1, %%ymm6, %%ymm6        \n\t"
+            " vpsrad $16, %%ymm6, %%ymm6            \n\t"
+            " vpmulld %%ymm1, %%ymm5, %%ymm5        \n\t"
+            " vpaddd %%ymm6, %%ymm3, %%ymm3         \n\t"
+            " vpaddd %%ymm5, %%ymm3, %%ymm3         \n\t" /* sum of samples 8..15 */
+
+            " vpackssdw %%ymm3, %%ymm2, %%ymm2      \n\t"
+            " vpermq $0xd8, %%ymm2, %%ymm2          \n\t"
+            " vmovdqu %%ymm2, (%[data])             \n\t"
+
+            " add $32, %[ptr0]                      \n\t"
+            " add $32, %[ptr1]                      \n\t"
+            " add $32, %[data]                      \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+            " vzeroupper                            \n\t"
+
+            : [ptr0] "+r" (ptr0), [ptr1] "+r" (ptr1), [data] "+r" (data), [n] "+r" (n)
+            : [lin0] "r" (streams[0].linear), [lin1] "r" (streams[1].linear)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    streams[0].ptr = ptr0;
+    streams[1].ptr = ptr1;
+
+    mix_s16ne_tail(streams, 2, channels, 0, data, length % 16);
+}
+
+static void pa_mix_s16ne_avx2_dispatch(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    if (nstreams == 2 && 16 % channels == 0)
+        pa_mix2_s16ne_avx2(streams, channels, data, length);
+    else
+        pa_mix_s16ne_avx2(streams, nstreams, channels, data, length);
+}
+
+/* s32 samples need the full 64 bit product. pmuldq is signed but there is no
+ * arithmetic 64 bit shift, so a bias of 2^62 keeps the product positive for
+ * a logical shift. |p * v| < 2^62, so this cannot overflow. The bias,
+ * 2^46 per stream after shifting, is removed again when clamping. */
+#define S32_BIAS_SHIFTED (INT64_C(1) << 46)
+
+static void clamp_s32ne(int32_t *data, const int64_t *sum, unsigned nstreams, unsigned n) {
+    const int64_t bias = S32_BIAS_SHIFTED * nstreams;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        int64_t s = sum[i] - bias;
+
+        data[i] = (int32_t) PA_CLAMP_UNLIKELY(s, -0x80000000LL, 0x7FFFFFFFLL);
+    }
+}
+
+/* mix s32ne streams, 4 samples at a time */
+static void pa_mix_s32ne_sse4_1(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(16, int64_t, sum[4]);
+    unsigned step;
+    pa_reg_x86 phase = 0;
+
+    length /= sizeof(int32_t);
+
+    if (!pad_linear(streams, nstreams, channels, 4)) {
+        mix_s32ne_tail(streams, nstreams, channels, 0, data, length);
+        return;
+    }
+
+    step = 4 % channels;
+
+    for (; length >= 4; length -= 4, data += 4) {
+        pa_mix_info *m = streams;
+        pa_reg_x86 n = nstreams, ptr;
+
+        __asm__ __volatile__ (
+            " pxor %%xmm0, %%xmm0                   \n\t" /* sum of samples 0..1 */
+            " pxor %%xmm1, %%xmm1                   \n\t" /* sum of samples 2..3 */
+            " pcmpeqd %%xmm7, %%xmm7                \n\t"
+            " psrlq $63, %%xmm7                     \n\t"
+            " psllq $62, %%xmm7                     \n\t" /* bias */
+
+            "1:                                     \n\t"
+            " mov %c[poff](%[m]), %[ptr]            \n\t"
+            " pmovsxdq (%[ptr]), %%xmm2             \n\t" /* p1 .. p0 */
+            " pmovsxdq 8(%[ptr]), %%xmm3            \n\t" /* p3 .. p2 */
+            " add $16, %[ptr]                       \n\t"
+            " mov %[ptr], %c[poff](%[m])            \n\t"
+
+            " pmovzxdq %c[loff](%[m],%[phase],4), %%xmm4   \n\t" /* v1 .. v0 */
+            " pmovzxdq %c[loff]+8(%[m],%[phase],4), %%xmm5 \n\t" /* v3 .. v2 */
+            " pmuldq %%xmm4, %%xmm2                 \n\t"
+            " pmuldq %%xmm5, %%xmm3                 \n\t"
+            " paddq %%xmm7, %%xmm2                  \n\t"
+            " paddq %%xmm7, %%xmm3                  \n\t"
+            " psrlq $16, %%xmm2                     \n\t"
+            " psrlq $16, %%xmm3                     \n\t"
+            " paddq %%xmm2, %%xmm0                  \n\t"
+            " paddq %%xmm3, %%xmm1                  \n\t"
+
+            " add %[size], %[m]                     \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            " movdqa %%xmm0, (%[sum])               \n\t"
+            " movdqa %%xmm1, 16(%[sum])             \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [ptr] "=&r" (ptr)
+            : [sum] "r" (sum), [phase] "r" (phase),
+              [poff] "i" (PTR_OFFSET), [loff] "i" (LINEAR_OFFSET), [size] "i" (sizeof(pa_mix_info))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        clamp_s32ne(data, sum, nstreams, 4);
+        phase = next_phase(phase, step, channels);
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, phase, data, length);
+}
+
+/* mix s32ne streams, 8 samples at a time */
+static void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(32, int64_t, sum[8]);
+    unsigned step;
+    pa_reg_x86 phase = 0;
+
+    if (!pad_linear(streams, nstreams, channels, 8)) {
+        pa_mix_s32ne_sse4_1(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    length /= sizeof(int32_t);
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8, data += 8) {
+        pa_mix_info *m = streams;
+        pa_reg_x86 n = nstreams, ptr;
+
+        __asm__ __volatile__ (
+            " vpxor %%ymm0, %%ymm0, %%ymm0          \n\t" /* sum of samples 0..3 */
+            " vpxor %%ymm1, %%ymm1, %%ymm1          \n\t" /* sum of samples 4..7 */
+            " vpcmpeqd %%ymm7, %%ymm7, %%ymm7       \n\t"
+            " vpsrlq $63, %%ymm7, %%ymm7            \n\t"
+            " vpsllq $62, %%ymm7, %%ymm7            \n\t" /* bias */
+
+            "1:                                     \n\t"
+            " mov %c[poff](%[m]), %[ptr]            \n\t"
+            " vpmovsxdq (%[ptr]), %%ymm2            \n\t" /* p3 .. p0 */
+            " vpmovsxdq 16(%[ptr]), %%ymm3          \n\t" /* p7 .. p4 */
+            " add $32, %[ptr]                       \n\t"
+            " mov %[ptr], %c[poff](%[m])            \n\t"
+
+            " vpmovzxdq %c[loff](%[m],%[phase],4), %%ymm4    \n\t" /* v3 .. v0 */
+            " vpmovzxdq %c[loff]+16(%[m],%[phase],4), %%ymm5 \n\t" /* v7 .. v4 */
+            " vpmuldq %%ymm4, %%ymm2, %%ymm2        \n\t"
+            " vpmuldq %%ymm5, %%ymm3, %%ymm3        \n\t"
+            " vpaddq %%ymm7, %%ymm2, %%ymm2         \n\t"
+            " vpaddq %%ymm7, %%ymm3, %%ymm3         \n\t"
+            " vpsrlq $16, %%ymm2, %%ymm2            \n\t"
+            " vpsrlq $16, %%ymm3, %%ymm3            \n\t"
+            " vpaddq %%ymm2, %%ymm0, %%ymm0         \n\t"
+            " vpaddq %%ymm3, %%ymm1, %%ymm1         \n\t"
+
+            " add %[size], %[m]                     \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            " vmovdqa %%ymm0, (%[sum])              \n\t"
+            " vmovdqa %%ymm1, 32(%[sum])            \n\t"
+            " vzeroupper                            \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [ptr] "=&r" (ptr)
+            : [sum] "r" (sum), [phase] "r" (phase),
+              [poff] "i" (PTR_OFFSET), [loff] "i" (LINEAR_OFFSET), [size] "i" (sizeof(pa_mix_info))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        clamp_s32ne(data, sum, nstreams, 8);
+        phase = next_phase(phase, step, channels);
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, phase, data, length);
+}
+
+/* mix float32ne streams, 8 samples at a time. Multiplication and addition are
+ * done in the same order as the C version, so the results are identical. */
+static void pa_mix_float32ne_sse(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned step;
+    pa_reg_x86 phase = 0;
+
+    length /= sizeof(float);
+
+    if (!pad_linear(streams, nstreams, channels, 8)) {
+        mix_float32ne_tail(streams, nstreams, channels, 0, data, length);
+        return;
+    }
+
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8, data += 8) {
+        pa_mix_info *m = streams;
+        pa_reg_x86 n = nstreams, ptr;
+
+        __asm__ __volatile__ (
+            " xorps %%xmm0, %%xmm0                  \n\t" /* sum of samples 0..3 */
+            " xorps %%xmm1, %%xmm1                  \n\t" /* sum of samples 4..7 */
+
+            "1:                                     \n\t"
+            " mov %c[poff](%[m]), %[ptr]            \n\t"
+            " movups (%[ptr]), %%xmm2               \n\t" /* p3 .. p0 */
+            " movups 16(%[ptr]), %%xmm3             \n\t" /* p7 .. p4 */
+            " add $32, %[ptr]                       \n\t"
+            " mov %[ptr], %c[poff](%[m])            \n\t"
+
+            " movups %c[loff](%[m],%[phase],4), %%xmm4    \n\t" /* v3 .. v0 */
+            " movups %c[loff]+16(%[m],%[phase],4), %%xmm5 \n\t" /* v7 .. v4 */
+            " mulps %%xmm4, %%xmm2                  \n\t"
+            " mulps %%xmm5, %%xmm3                  \n\t"
+            " addps %%xmm2, %%xmm0                  \n\t"
+            " addps %%xmm3, %%xmm1                  \n\t"
+
+            " add %[size], %[m]                     \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            " movups %%xmm0, (%[data])              \n\t"
+            " movups %%xmm1, 16(%[data])            \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [ptr] "=&r" (ptr)
+            : [data] "r" (data), [phase] "r" (phase),
+              [poff] "i" (PTR_OFFSET), [loff] "i" (LINEAR_OFFSET), [size] "i" (sizeof(pa_mix_info))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        phase = next_phase(phase, step, channels);
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, phase, data, length);
+}
+
+/* mix float32ne streams, 16 samples at a time. No FMA, to stay identical
+ * to the C version. */
+static void pa_mix_float32ne_avx(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned step;
+    pa_reg_x86 phase = 0;
+
+    if (!pad_linear(streams, nstreams, channels, 16)) {
+        pa_mix_float32ne_sse(streams, nstreams, channels, data, length);
+        return;
+    }
+
+    length /= sizeof(float);
+    step = 16 % channels;
+
+    for (; length >= 16; length -= 16, data += 16) {
+        pa_mix_info *m = streams;
+        pa_reg_x86 n = nstreams, ptr;
+
+        __asm__ __volatile__ (
+            " vxorps %%ymm0, %%ymm0, %%ymm0         \n\t" /* sum of samples 0..7 */
+            " vxorps %%ymm1, %%ymm1, %%ymm1         \n\t" /* sum of samples 8..15 */
+
+            "1:                                     \n\t"
+            " mov %c[poff](%[m]), %[ptr]            \n\t"
+            " vmovups %c[loff](%[m],%[phase],4), %%ymm4    \n\t" /* v7 .. v0 */
+            " vmovups %c[loff]+32(%[m],%[phase],4), %%ymm5 \n\t" /* v15 .. v8 */
+            " vmulps (%[ptr]), %%ymm4, %%ymm2       \n\t"
+            " vmulps 32(%[ptr]), %%ymm5, %%ymm3     \n\t"
+            " add $64, %[ptr]                       \n\t"
+            " mov %[ptr], %c[poff](%[m])            \n\t"
+            " vaddps %%ymm2, %%ymm0, %%ymm0         \n\t"
+            " vaddps %%ymm3, %%ymm1, %%ymm1         \n\t"
+
+            " add %[size], %[m]                     \n\t"
+            " dec %[n]                              \n\t"
+            " jne 1b                                \n\t"
+
+            " vmovups %%ymm0, (%[data])             \n\t"
+            " vmovups %%ymm1, 32(%[data])           \n\t"
+            " vzeroupper                            \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [ptr] "=&r" (ptr)
+            : [data] "r" (data), [phase] "r" (phase),
+              [poff] "i" (PTR_OFFSET), [loff] "i" (LINEAR_OFFSET), [size] "i" (sizeof(pa_mix_info))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        phase = next_phase(phase, step, channels);
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, phase, data, length);
+}
+
+#endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2_dispatch);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+    } else if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixing functions.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2_dispatch);
+        if (flags & PA_CPU_X86_SSE4_1)
+            pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse4_1);
+    }
+
+    if (flags & PA_CPU_X86_AVX)
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx);
+    else if (flags & PA_CPU_X86_SSE)
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse);
+#endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
+}
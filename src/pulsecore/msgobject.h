@@ -26,12 +26,17 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/object.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/render-profile.h>
 
 typedef struct pa_msgobject pa_msgobject;
 
 struct pa_msgobject {
     pa_object parent;
     int (*process_msg)(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
+
+    /* Time spent in process_msg() for messages from pa_asyncmsgq that
+     * were handled by an rtpoll, i.e. in the IO thread */
+    pa_render_profile process_msg_profile;
 };
 
 pa_msgobject *pa_msgobject_new_internal(size_t size, const char *type_id, bool (*check_type)(const char *type_name));
@@ -187,6 +187,15 @@ enum {
      * BOTH DIRECTIONS */
     PA_COMMAND_REGISTER_MEMFD_SHMID,
 
+    /* Supported since protocol v32 (10.0) */
+    PA_COMMAND_GET_SNAPSHOT,
+    PA_COMMAND_SET_PLAYBACK_STREAM_TIMING_PUSH,
+    PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH,
+
+    /* SERVER->CLIENT */
+    PA_COMMAND_PLAYBACK_STREAM_TIMING,
+    PA_COMMAND_RECORD_STREAM_TIMING,
+
     PA_COMMAND_MAX
 };
 
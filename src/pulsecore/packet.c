@@ -34,7 +34,7 @@
 
 struct pa_packet {
     PA_REFCNT_DECLARE;
-    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
+    enum { PA_PACKET_APPENDED, PA_PACKET_POOLED, PA_PACKET_DYNAMIC } type;
     size_t length;
     uint8_t *data;
     union {
@@ -44,6 +44,26 @@ struct pa_packet {
 
 PA_STATIC_FLIST_DECLARE(packets, 0, pa_xfree);
 
+/* Buffers of PA_PACKET_POOL_BUFFER_SIZE bytes. This is kept smaller than
+ * the other lists, we don't want to hold on to too much memory. */
+PA_STATIC_FLIST_DECLARE(buffers, 64, pa_xfree);
+
+void* pa_packet_buffer_new(void) {
+    void *data;
+
+    if (!(data = pa_flist_pop(PA_STATIC_FLIST_GET(buffers))))
+        data = pa_xmalloc(PA_PACKET_POOL_BUFFER_SIZE);
+
+    return data;
+}
+
+void pa_packet_buffer_free(void *data) {
+    pa_assert(data);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(buffers), data) < 0)
+        pa_xfree(data);
+}
+
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
 
@@ -53,9 +73,12 @@ pa_packet* pa_packet_new(size_t length) {
         p = pa_xnew(pa_packet, 1);
     PA_REFCNT_INIT(p);
     p->length = length;
-    if (length > MAX_APPENDED_SIZE) {
+    if (length > PA_PACKET_POOL_BUFFER_SIZE) {
         p->data = pa_xmalloc(length);
         p->type = PA_PACKET_DYNAMIC;
+    } else if (length > MAX_APPENDED_SIZE) {
+        p->data = pa_packet_buffer_new();
+        p->type = PA_PACKET_POOLED;
     } else {
         p->data = p->per_type.appended;
         p->type = PA_PACKET_APPENDED;
@@ -91,6 +114,23 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     return p;
 }
 
+pa_packet* pa_packet_new_pooled(void *data, size_t length) {
+    pa_packet *p;
+
+    pa_assert(data);
+    pa_assert(length > 0);
+    pa_assert(length <= PA_PACKET_POOL_BUFFER_SIZE);
+
+    if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
+        p = pa_xnew(pa_packet, 1);
+    PA_REFCNT_INIT(p);
+    p->length = length;
+    p->data = data;
+    p->type = PA_PACKET_POOLED;
+
+    return p;
+}
+
 const void* pa_packet_data(pa_packet *p, size_t *l) {
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
     pa_assert(p->data);
@@ -116,6 +156,8 @@ void pa_packet_unref(pa_packet *p) {
     if (PA_REFCNT_DEC(p) <= 0) {
         if (p->type == PA_PACKET_DYNAMIC)
             pa_xfree(p->data);
+        else if (p->type == PA_PACKET_POOLED)
+            pa_packet_buffer_free(p->data);
         if (pa_flist_push(PA_STATIC_FLIST_GET(packets), p) < 0)
             pa_xfree(p);
     }
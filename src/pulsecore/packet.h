@@ -25,8 +25,12 @@
 
 typedef struct pa_packet pa_packet;
 
-/* create empty packet (either of type appended or dynamic depending
- * on length) */
+/* Packets up to this size get their data from a pool of recycled
+ * buffers */
+#define PA_PACKET_POOL_BUFFER_SIZE 4096
+
+/* create empty packet (either of type appended, pooled or dynamic
+ * depending on length) */
 pa_packet* pa_packet_new(size_t length);
 
 /* create packet (either of type appended or dynamic depending on length)
@@ -37,6 +41,16 @@ pa_packet* pa_packet_new_data(const void* data, size_t length);
  * i.e. memory is free()d with the packet */
 pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
+/* Get a buffer of PA_PACKET_POOL_BUFFER_SIZE bytes from the pool. It has
+ * to be passed to either pa_packet_new_pooled() or
+ * pa_packet_buffer_free(). */
+void* pa_packet_buffer_new(void);
+void pa_packet_buffer_free(void *data);
+
+/* data must have been obtained with pa_packet_buffer_new(); the packet
+ * takes ownership of it and gives it back to the pool when freed */
+pa_packet* pa_packet_new_pooled(void *data, size_t length);
+
 const void* pa_packet_data(pa_packet *p, size_t *l);
 
 pa_packet* pa_packet_ref(pa_packet *p);
@@ -199,6 +199,13 @@ static const char *command_names[PA_COMMAND_MAX] = {
     /* Supported since protocol v31 (9.0) */
     /* BOTH DIRECTIONS */
     [PA_COMMAND_REGISTER_MEMFD_SHMID] = "REGISTER_MEMFD_SHMID",
+
+    /* Supported since protocol v32 (10.0) */
+    [PA_COMMAND_GET_SNAPSHOT] = "GET_SNAPSHOT",
+    [PA_COMMAND_SET_PLAYBACK_STREAM_TIMING_PUSH] = "SET_PLAYBACK_STREAM_TIMING_PUSH",
+    [PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH] = "SET_RECORD_STREAM_TIMING_PUSH",
+    [PA_COMMAND_PLAYBACK_STREAM_TIMING] = "PLAYBACK_STREAM_TIMING",
+    [PA_COMMAND_RECORD_STREAM_TIMING] = "RECORD_STREAM_TIMING",
 };
 
 #endif
@@ -225,6 +232,7 @@ struct pa_pdispatch {
     void *drain_userdata;
     pa_cmsg_ancil_data *ancil_data;
     bool use_rtclock;
+    uint32_t last_command_tag;
 };
 
 static void reply_info_free(struct reply_info *r) {
@@ -343,6 +351,7 @@ int pa_pdispatch_run(pa_pdispatch *pd, pa_packet *packet, pa_cmsg_ancil_data *an
     } else if (pd->callback_table && (command < pd->n_commands) && pd->callback_table[command]) {
         const pa_pdispatch_cb_t *cb = pd->callback_table+command;
 
+        pd->last_command_tag = tag;
         (*cb)(pd, command, tag, ts, userdata);
     } else {
         pa_log("Received unsupported command %u", command);
@@ -441,6 +450,13 @@ pa_pdispatch* pa_pdispatch_ref(pa_pdispatch *pd) {
     return pd;
 }
 
+uint32_t pa_pdispatch_last_command_tag(pa_pdispatch *pd) {
+    pa_assert(pd);
+    pa_assert(PA_REFCNT_VALUE(pd) >= 1);
+
+    return pd->last_command_tag;
+}
+
 #ifdef HAVE_CREDS
 
 const pa_creds * pa_pdispatch_creds(pa_pdispatch *pd) {
@@ -53,4 +53,7 @@ void pa_pdispatch_unregister_reply(pa_pdispatch *pd, void *userdata);
 const pa_creds * pa_pdispatch_creds(pa_pdispatch *pd);
 pa_cmsg_ancil_data *pa_pdispatch_take_ancil_data(pa_pdispatch *pd);
 
+/* The tag of the last command that was dispatched, 0 if there was none */
+uint32_t pa_pdispatch_last_command_tag(pa_pdispatch *pd);
+
 #endif
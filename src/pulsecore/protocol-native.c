@@ -33,6 +33,7 @@
 #include <pulse/utf8.h>
 #include <pulse/util.h>
 #include <pulse/xmalloc.h>
+#include <pulse/introspect.h>
 #include <pulse/internal.h>
 
 #include <pulsecore/native-common.h>
@@ -41,12 +42,14 @@
 #include <pulsecore/source-output.h>
 #include <pulsecore/sink-input.h>
 #include <pulsecore/pstream.h>
+#include <pulsecore/ringbuffer.h>
 #include <pulsecore/tagstruct.h>
 #include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream-util.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
+#include <pulsecore/random.h>
 #include <pulsecore/log.h>
 #include <pulsecore/mem.h>
 #include <pulsecore/strlist.h>
@@ -68,11 +71,18 @@
 /* Don't accept more connection than this */
 #define MAX_CONNECTIONS 64
 
+/* Send buffers shared by all connections on the ring, each one uses up to
+ * two at a time and falls back to malloc() beyond that */
+#define URING_SEND_BUFFERS 64
+
 #define MAX_MEMBLOCKQ_LENGTH (4*1024*1024) /* 4MB */
 #define DEFAULT_TLENGTH_MSEC 2000 /* 2s */
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
 #define DEFAULT_FRAGSIZE_MSEC DEFAULT_TLENGTH_MSEC
 
+/* Rough size of one entry of an info list reply, mostly the proplist */
+#define INFO_LIST_ENTRY_SIZE_HINT 1024
+
 struct pa_native_protocol;
 
 typedef struct record_stream {
@@ -100,6 +110,12 @@ typedef struct record_stream {
     size_t on_the_fly_snapshot;
     pa_usec_t current_monitor_latency;
     pa_usec_t current_source_latency;
+
+    /* Timing data is pushed to the client in this interval, if it asked
+     * for it */
+    pa_usec_t timing_push_interval;
+    pa_time_event *timing_push_event;
+    bool timing_pushed_running:1;
 } record_stream;
 
 #define RECORD_STREAM(o) (record_stream_cast(o))
@@ -133,6 +149,16 @@ typedef struct playback_stream {
     pa_atomic_t seek_or_post_in_queue;
     int64_t seek_windex;
 
+    /* Data written by the client is copied into this ring by the main
+     * thread and picked up by the IO thread when it renders, without a
+     * message per write. The IO thread sets ring_wakeup when it runs dry
+     * and wants a message for the next write. The ring holds tlength
+     * bytes as negotiated when the stream was created. See
+     * playback_stream_write_ring(). */
+    pa_ringbuffer ring;
+    pa_atomic_t ring_count;
+    pa_atomic_t ring_wakeup;
+
     pa_atomic_t missing;
     pa_usec_t configured_sink_latency;
     /* Requested buffer attributes */
@@ -145,6 +171,12 @@ typedef struct playback_stream {
     size_t render_memblockq_length;
     pa_usec_t current_sink_latency;
     uint64_t playing_for, underrun_for;
+
+    /* Timing data is pushed to the client in this interval, if it asked
+     * for it */
+    pa_usec_t timing_push_interval;
+    pa_time_event *timing_push_event;
+    bool timing_pushed_running:1;
 } playback_stream;
 
 #define PLAYBACK_STREAM(o) (playback_stream_cast(o))
@@ -186,8 +218,21 @@ struct pa_native_connection {
     pa_idxset *record_streams, *output_streams;
     uint32_t rrobin_index;
     pa_subscription *subscription;
+    /* Subscription events are held back for this long to merge repeated
+     * events for the same object */
+    pa_usec_t subscription_window;
+    bool subscription_with_state;
+    pa_snapshot_fields_t subscription_fields;
+    /* Held back events in the order they came in, and by object for
+     * merging */
+    PA_LLIST_HEAD(struct pending_event, pending_event_queue);
+    struct pending_event *pending_event_last;
+    pa_hashmap *pending_events;
+    pa_time_event *subscription_time_event;
     pa_time_event *auth_timeout_event;
     pa_srbchannel *srbpending;
+    /* The mempool segment generation last registered with the client */
+    unsigned mempool_segment_generation;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -203,6 +248,14 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+#ifdef HAVE_IO_URING
+    pa_uring *uring;
+    bool uring_failed;
+#endif
+
+    /* Created on the first PA_COMMAND_GET_SNAPSHOT */
+    struct snapshot_tracker *snapshot_tracker;
 };
 
 enum {
@@ -279,6 +332,7 @@ static void command_remove_sample(pa_pdispatch *pd, uint32_t command, uint32_t t
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_volume(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_mute(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -303,6 +357,7 @@ static void command_set_sink_or_source_port(pa_pdispatch *pd, uint32_t command,
 static void command_set_port_latency_offset(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_enable_srbchannel(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_register_memfd_shmid(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_set_stream_timing_push(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 
 static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_ERROR] = NULL,
@@ -410,6 +465,10 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
 
     [PA_COMMAND_REGISTER_MEMFD_SHMID] = command_register_memfd_shmid,
 
+    [PA_COMMAND_GET_SNAPSHOT] = command_get_snapshot,
+    [PA_COMMAND_SET_PLAYBACK_STREAM_TIMING_PUSH] = command_set_stream_timing_push,
+    [PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH] = command_set_stream_timing_push,
+
     [PA_COMMAND_EXTENSION] = command_extension
 };
 
@@ -491,6 +550,11 @@ static void record_stream_unlink(record_stream *s) {
         s->source_output = NULL;
     }
 
+    if (s->timing_push_event) {
+        s->connection->protocol->core->mainloop->time_free(s->timing_push_event);
+        s->timing_push_event = NULL;
+    }
+
     pa_assert_se(pa_idxset_remove_by_data(s->connection->record_streams, s, NULL) == s);
     s->connection = NULL;
     record_stream_unref(s);
@@ -792,6 +856,11 @@ static void playback_stream_unlink(playback_stream *s) {
     if (s->drain_request)
         pa_pstream_send_error(s->connection->pstream, s->drain_tag, PA_ERR_NOENTITY);
 
+    if (s->timing_push_event) {
+        s->connection->protocol->core->mainloop->time_free(s->timing_push_event);
+        s->timing_push_event = NULL;
+    }
+
     pa_assert_se(pa_idxset_remove_by_data(s->connection->output_streams, s, NULL) == s);
     s->connection = NULL;
     playback_stream_unref(s);
@@ -804,6 +873,8 @@ static void playback_stream_free(pa_object* o) {
 
     playback_stream_unlink(s);
 
+    pa_xfree(s->ring.memory);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
@@ -1202,6 +1273,11 @@ static playback_stream* playback_stream_new(
     pa_atomic_store(&s->seek_or_post_in_queue, 0);
     s->seek_windex = -1;
 
+    pa_zero(s->ring);
+    s->ring.count = &s->ring_count;
+    pa_atomic_store(&s->ring_count, 0);
+    pa_atomic_store(&s->ring_wakeup, 1);
+
     s->sink_input->parent.process_msg = sink_input_process_msg;
     s->sink_input->pop = sink_input_pop_cb;
     s->sink_input->process_underrun = sink_input_process_underrun_cb;
@@ -1235,6 +1311,9 @@ static playback_stream* playback_stream_new(
 
     pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
 
+    s->ring.capacity = (int) s->buffer_attr.tlength;
+    s->ring.memory = pa_xmalloc(s->buffer_attr.tlength);
+
     *missing = (uint32_t) pa_memblockq_pop_missing(s->memblockq);
 
 #ifdef PROTOCOL_NATIVE_DEBUG
@@ -1356,6 +1435,11 @@ static void native_connection_unlink(pa_native_connection *c) {
     if (c->subscription)
         pa_subscription_free(c->subscription);
 
+    if (c->subscription_time_event) {
+        c->protocol->core->mainloop->time_free(c->subscription_time_event);
+        c->subscription_time_event = NULL;
+    }
+
     if (c->pstream)
         pa_pstream_unlink(c->pstream);
 
@@ -1370,6 +1454,8 @@ static void native_connection_unlink(pa_native_connection *c) {
 }
 
 /* Called from main context */
+static void free_pending_event(pa_native_connection *c, struct pending_event *e);
+
 static void native_connection_free(pa_object *o) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(o);
 
@@ -1380,6 +1466,10 @@ static void native_connection_free(pa_object *o) {
     pa_idxset_free(c->record_streams, NULL);
     pa_idxset_free(c->output_streams, NULL);
 
+    while (c->pending_event_queue)
+        free_pending_event(c, c->pending_event_queue);
+    pa_hashmap_free(c->pending_events);
+
     pa_pdispatch_unref(c->pdispatch);
     pa_pstream_unref(c->pstream);
     if (c->rw_mempool)
@@ -1391,6 +1481,21 @@ static void native_connection_free(pa_object *o) {
 }
 
 /* Called from main context */
+/* The core mempool may have grown since we last sent record data. Make
+ * sure the client knows about any new memfd segments before it sees
+ * blocks from them. Over an srbchannel the blocks could still overtake
+ * the registration, so the pstream copies them in that case. */
+static void native_connection_register_mempool_segments(pa_native_connection *c) {
+    unsigned generation;
+
+    generation = pa_mempool_get_segment_generation(c->protocol->core->mempool);
+    if (generation == c->mempool_segment_generation)
+        return;
+
+    c->mempool_segment_generation = generation;
+    pa_pstream_register_memfd_mempool_segments(c->pstream, c->protocol->core->mempool);
+}
+
 static void native_connection_send_memblock(pa_native_connection *c) {
     uint32_t start;
     record_stream *r;
@@ -1413,6 +1518,7 @@ static void native_connection_send_memblock(pa_native_connection *c) {
             if (schunk.length > r->buffer_attr.fragsize)
                 schunk.length = r->buffer_attr.fragsize;
 
+            native_connection_register_mempool_segments(c);
             pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &schunk);
 
             pa_memblockq_drop(r->memblockq, schunk.length);
@@ -1426,6 +1532,69 @@ static void native_connection_send_memblock(pa_native_connection *c) {
 /*** sink input callbacks ***/
 
 /* Called from thread context */
+static void playback_stream_push(playback_stream *s, pa_memchunk *chunk) {
+    if (pa_memblockq_push_align(s->memblockq, chunk) < 0) {
+        if (pa_log_ratelimit(PA_LOG_WARN))
+            pa_log_warn("Failed to push data into queue");
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
+        pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
+    }
+}
+
+/* Called from thread context. Moves everything the main thread wrote to
+ * the ring into the memblockq. Returns true if there was anything. */
+static bool playback_stream_read_ring(playback_stream *s) {
+    pa_memchunk chunk;
+    uint8_t *d;
+    int n, l;
+
+    if ((n = pa_atomic_load(&s->ring_count)) <= 0)
+        return false;
+
+    /* Writes are always complete frames, so n is frame aligned */
+    chunk.memblock = pa_memblock_new(s->connection->protocol->core->mempool, (size_t) n);
+    chunk.index = 0;
+    chunk.length = (size_t) n;
+
+    d = pa_memblock_acquire(chunk.memblock);
+
+    while (n > 0) {
+        const void *p = pa_ringbuffer_peek(&s->ring, &l);
+
+        l = PA_MIN(l, n);
+        memcpy(d, p, (size_t) l);
+        pa_ringbuffer_drop(&s->ring, l);
+
+        d += l;
+        n -= l;
+    }
+
+    pa_memblock_release(chunk.memblock);
+
+    playback_stream_push(s, &chunk);
+    pa_memblock_unref(chunk.memblock);
+
+    return true;
+}
+
+/* Called from thread context */
+static void playback_stream_post_ring_data(playback_stream *s, pa_asyncmsgq *q) {
+    pa_atomic_inc(&s->seek_or_post_in_queue);
+    pa_asyncmsgq_post(q, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, NULL, NULL);
+}
+
+/* Called from thread context. Asks the main thread to notify us about
+ * the next write to the ring, since we ran out of data. */
+static void playback_stream_request_ring_wakeup(playback_stream *s) {
+    pa_atomic_store(&s->ring_wakeup, 1);
+
+    /* Data written just before we asked would otherwise go unnoticed
+     * until the next write. Rewinds can't be requested from here, so
+     * send the message to ourselves. */
+    if (pa_atomic_load(&s->ring_count) > 0 && pa_atomic_cmpxchg(&s->ring_wakeup, 1, 0))
+        playback_stream_post_ring_data(s, s->sink_input->sink->asyncmsgq);
+}
+
 static void handle_seek(playback_stream *s, int64_t indexw) {
     playback_stream_assert_ref(s);
 
@@ -1468,6 +1637,14 @@ static void flush_write_no_account(pa_memblockq *q) {
     pa_memblockq_flush_write(q, false);
 }
 
+/* Called from thread context */
+static void playback_stream_drain_ring(playback_stream *s) {
+    int64_t windex = pa_memblockq_get_write_index(s->memblockq);
+
+    if (playback_stream_read_ring(s))
+        handle_seek(s, windex);
+}
+
 /* Called from thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1483,6 +1660,10 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
         case SINK_INPUT_MESSAGE_POST_DATA: {
             int64_t windex = pa_memblockq_get_write_index(s->memblockq);
 
+            /* Anything in the ring was written before this message was
+             * sent */
+            playback_stream_read_ring(s);
+
             if (code == SINK_INPUT_MESSAGE_SEEK) {
                 /* The client side is incapable of accounting correctly
                  * for seeks of a type != PA_SEEK_RELATIVE. We need to be
@@ -1492,12 +1673,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
                 windex = PA_MIN(windex, pa_memblockq_get_write_index(s->memblockq));
             }
 
-            if (chunk && pa_memblockq_push_align(s->memblockq, chunk) < 0) {
-                if (pa_log_ratelimit(PA_LOG_WARN))
-                    pa_log_warn("Failed to push data into queue");
-                pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
-                pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
-            }
+            if (chunk)
+                playback_stream_push(s, chunk);
 
             /* If more data is in queue, we rewind later instead. */
             if (s->seek_windex != -1)
@@ -1520,6 +1697,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             pa_sink_input *isync;
             void (*func)(pa_memblockq *bq);
 
+            playback_stream_drain_ring(s);
+
             switch (code) {
                 case SINK_INPUT_MESSAGE_FLUSH:
                     func = flush_write_no_account;
@@ -1545,6 +1724,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             /* Do the same for all other members in the sync group */
             for (isync = i->sync_prev; isync; isync = isync->sync_prev) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_drain_ring(ssync);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1552,6 +1732,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
 
             for (isync = i->sync_next; isync; isync = isync->sync_next) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_drain_ring(ssync);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1570,6 +1751,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
         }
 
         case SINK_INPUT_MESSAGE_UPDATE_LATENCY:
+            playback_stream_drain_ring(s);
+
             /* Atomically get a snapshot of all timing parameters... */
             s->read_index = pa_memblockq_get_read_index(s->memblockq);
             s->write_index = pa_memblockq_get_write_index(s->memblockq);
@@ -1583,6 +1766,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
         case PA_SINK_INPUT_MESSAGE_SET_STATE: {
             int64_t windex;
 
+            playback_stream_drain_ring(s);
             windex = pa_memblockq_get_write_index(s->memblockq);
 
             /* We enable prebuffering so that after CORKED -> RUNNING
@@ -1640,6 +1824,7 @@ static bool handle_input_underrun(playback_stream *s, bool force) {
     }
     s->is_underrun = true;
     playback_stream_request_bytes(s);
+    playback_stream_request_ring_wakeup(s);
     return true;
 }
 
@@ -1667,6 +1852,13 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     pa_log("%s, pop(): %lu", pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME), (unsigned long) pa_memblockq_get_length(s->memblockq));
 #endif
 
+    /* While playing, data from the ring ends up right at the read index
+     * and needs no rewind. After an underrun it is picked up by the
+     * message that playback_stream_request_ring_wakeup() arranged for,
+     * which takes care of the rewind. */
+    if (!s->is_underrun)
+        playback_stream_read_ring(s);
+
     if (!handle_input_underrun(s, false))
         s->is_underrun = false;
 
@@ -1987,15 +2179,21 @@ if (!(expression)) { \
 } \
 } while(0);
 
-static pa_tagstruct *reply_new(uint32_t tag) {
+/* size_hint is what the whole reply is expected to take, so that large
+ * replies don't have to be reallocated while they are filled in */
+static pa_tagstruct *reply_new_sized(uint32_t tag, size_t size_hint) {
     pa_tagstruct *reply;
 
-    reply = pa_tagstruct_new();
+    reply = pa_tagstruct_new_sized(size_hint);
     pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
     pa_tagstruct_putu32(reply, tag);
     return reply;
 }
 
+static pa_tagstruct *reply_new(uint32_t tag) {
+    return reply_new_sized(tag, 0);
+}
+
 static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     playback_stream *s;
@@ -2995,9 +3193,29 @@ static void command_stat(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->n_accumulated));
     pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->accumulated_size));
     pa_tagstruct_putu32(reply, (uint32_t) pa_scache_total_size(c->protocol->core));
+
+    if (c->version >= 32) {
+        pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->pool_size));
+        pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->pool_used_size));
+        pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->pool_used_size_max));
+        pa_tagstruct_putu32(reply, (uint32_t) pa_atomic_load(&stat->n_fallback));
+    }
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+static bool playback_stream_is_running(playback_stream *s) {
+    return
+        pa_sink_get_state(s->sink_input->sink) == PA_SINK_RUNNING &&
+        pa_sink_input_get_state(s->sink_input) == PA_SINK_INPUT_RUNNING;
+}
+
+static bool record_stream_is_running(record_stream *s) {
+    return
+        pa_source_get_state(s->source_output->source) == PA_SOURCE_RUNNING &&
+        pa_source_output_get_state(s->source_output) == PA_SOURCE_OUTPUT_RUNNING;
+}
+
 static void command_get_playback_latency(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_tagstruct *reply;
@@ -3028,10 +3246,7 @@ static void command_get_playback_latency(pa_pdispatch *pd, uint32_t command, uin
                           s->current_sink_latency +
                           pa_bytes_to_usec(s->render_memblockq_length, &s->sink_input->sink->sample_spec));
     pa_tagstruct_put_usec(reply, 0);
-    pa_tagstruct_put_boolean(reply,
-                             s->playing_for > 0 &&
-                             pa_sink_get_state(s->sink_input->sink) == PA_SINK_RUNNING &&
-                             pa_sink_input_get_state(s->sink_input) == PA_SINK_INPUT_RUNNING);
+    pa_tagstruct_put_boolean(reply, s->playing_for > 0 && playback_stream_is_running(s));
     pa_tagstruct_put_timeval(reply, &tv);
     pa_tagstruct_put_timeval(reply, pa_gettimeofday(&now));
     pa_tagstruct_puts64(reply, s->write_index);
@@ -3074,9 +3289,7 @@ static void command_get_record_latency(pa_pdispatch *pd, uint32_t command, uint3
     pa_tagstruct_put_usec(reply,
                           s->current_source_latency +
                           pa_bytes_to_usec(s->on_the_fly_snapshot, &s->source_output->source->sample_spec));
-    pa_tagstruct_put_boolean(reply,
-                             pa_source_get_state(s->source_output->source) == PA_SOURCE_RUNNING &&
-                             pa_source_output_get_state(s->source_output) == PA_SOURCE_OUTPUT_RUNNING);
+    pa_tagstruct_put_boolean(reply, record_stream_is_running(s));
     pa_tagstruct_put_timeval(reply, &tv);
     pa_tagstruct_put_timeval(reply, pa_gettimeofday(&now));
     pa_tagstruct_puts64(reply, pa_memblockq_get_write_index(s->memblockq));
@@ -3084,6 +3297,153 @@ static void command_get_record_latency(pa_pdispatch *pd, uint32_t command, uint3
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+/*** Timing push ***/
+
+/* Instead of polling with GET_xxx_LATENCY, clients can have the timing
+ * data pushed to them regularly. Since the push doesn't answer a request,
+ * it carries the tag of the last command we processed on the connection,
+ * which the client uses to tell whether its own seeks and flushes are
+ * included already. While a stream isn't running, we send one last update
+ * and then stay quiet, to not wake up idle clients. */
+
+#define TIMING_PUSH_INTERVAL_MIN (10*PA_USEC_PER_MSEC)
+#define TIMING_PUSH_INTERVAL_MAX (10*PA_USEC_PER_SEC)
+
+static void playback_stream_timing_push_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    playback_stream *s = PLAYBACK_STREAM(userdata);
+    pa_tagstruct *t;
+    struct timeval now;
+    bool running;
+
+    playback_stream_assert_ref(s);
+    pa_assert(s->connection);
+
+    pa_core_rttime_restart(s->connection->protocol->core, e, pa_rtclock_now() + s->timing_push_interval);
+
+    running = playback_stream_is_running(s);
+    if (!running && !s->timing_pushed_running)
+        return;
+
+    s->timing_pushed_running = running;
+
+    /* Get an atomic snapshot of all timing parameters */
+    pa_assert_se(pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_UPDATE_LATENCY, s, 0, NULL) == 0);
+
+    t = pa_tagstruct_new();
+    pa_tagstruct_putu32(t, PA_COMMAND_PLAYBACK_STREAM_TIMING);
+    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
+    pa_tagstruct_putu32(t, s->index);
+    pa_tagstruct_putu32(t, pa_pdispatch_last_command_tag(s->connection->pdispatch));
+    pa_tagstruct_put_usec(t,
+                          s->current_sink_latency +
+                          pa_bytes_to_usec(s->render_memblockq_length, &s->sink_input->sink->sample_spec));
+    pa_tagstruct_put_usec(t, 0);
+    pa_tagstruct_put_boolean(t, s->playing_for > 0 && running);
+    pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
+    pa_tagstruct_puts64(t, s->write_index);
+    pa_tagstruct_puts64(t, s->read_index);
+    pa_tagstruct_putu64(t, s->underrun_for);
+    pa_tagstruct_putu64(t, s->playing_for);
+    pa_pstream_send_tagstruct(s->connection->pstream, t);
+}
+
+static void record_stream_timing_push_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    record_stream *s = RECORD_STREAM(userdata);
+    pa_tagstruct *t;
+    struct timeval now;
+    bool running;
+
+    record_stream_assert_ref(s);
+    pa_assert(s->connection);
+
+    pa_core_rttime_restart(s->connection->protocol->core, e, pa_rtclock_now() + s->timing_push_interval);
+
+    running = record_stream_is_running(s);
+    if (!running && !s->timing_pushed_running)
+        return;
+
+    s->timing_pushed_running = running;
+
+    /* Get an atomic snapshot of all timing parameters */
+    pa_assert_se(pa_asyncmsgq_send(s->source_output->source->asyncmsgq, PA_MSGOBJECT(s->source_output), SOURCE_OUTPUT_MESSAGE_UPDATE_LATENCY, s, 0, NULL) == 0);
+
+    t = pa_tagstruct_new();
+    pa_tagstruct_putu32(t, PA_COMMAND_RECORD_STREAM_TIMING);
+    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
+    pa_tagstruct_putu32(t, s->index);
+    pa_tagstruct_putu32(t, pa_pdispatch_last_command_tag(s->connection->pdispatch));
+    pa_tagstruct_put_usec(t, s->current_monitor_latency);
+    pa_tagstruct_put_usec(t,
+                          s->current_source_latency +
+                          pa_bytes_to_usec(s->on_the_fly_snapshot, &s->source_output->source->sample_spec));
+    pa_tagstruct_put_boolean(t, running);
+    pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
+    pa_tagstruct_puts64(t, pa_memblockq_get_write_index(s->memblockq));
+    pa_tagstruct_puts64(t, pa_memblockq_get_read_index(s->memblockq));
+    pa_pstream_send_tagstruct(s->connection->pstream, t);
+}
+
+static void set_timing_push(pa_native_connection *c, pa_time_event **e, pa_usec_t interval, pa_time_event_cb_t cb, void *userdata) {
+    if (interval <= 0) {
+        if (*e) {
+            c->protocol->core->mainloop->time_free(*e);
+            *e = NULL;
+        }
+
+        return;
+    }
+
+    /* The first update goes out right away */
+    if (*e)
+        pa_core_rttime_restart(c->protocol->core, *e, pa_rtclock_now());
+    else
+        *e = pa_core_rttime_new(c->protocol->core, pa_rtclock_now(), cb, userdata);
+}
+
+static void command_set_stream_timing_push(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t idx;
+    pa_usec_t interval;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
+        pa_tagstruct_get_usec(t, &interval) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, interval == 0 || (interval >= TIMING_PUSH_INTERVAL_MIN && interval <= TIMING_PUSH_INTERVAL_MAX), tag, PA_ERR_INVALID);
+
+    if (command == PA_COMMAND_SET_PLAYBACK_STREAM_TIMING_PUSH) {
+        playback_stream *s;
+
+        s = pa_idxset_get_by_index(c->output_streams, idx);
+        CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
+        CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
+
+        s->timing_push_interval = interval;
+        s->timing_pushed_running = true;
+        set_timing_push(c, &s->timing_push_event, interval, playback_stream_timing_push_cb, s);
+    } else {
+        record_stream *s;
+
+        pa_assert(command == PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH);
+
+        s = pa_idxset_get_by_index(c->record_streams, idx);
+        CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
+
+        s->timing_push_interval = interval;
+        s->timing_pushed_running = true;
+        set_timing_push(c, &s->timing_push_event, interval, record_stream_timing_push_cb, s);
+    }
+
+    pa_pstream_send_simple_ack(c->pstream, tag);
+}
+
 static void command_create_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     upload_stream *s;
@@ -3286,7 +3646,7 @@ static void fixup_sample_spec(pa_native_connection *c, pa_sample_spec *fixed, co
     }
 }
 
-static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink) {
+static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink, pa_snapshot_fields_t fields) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3306,14 +3666,15 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         PA_TAG_BOOLEAN, pa_sink_get_mute(sink, false),
         PA_TAG_U32, sink->monitor_source ? sink->monitor_source->index : PA_INVALID_INDEX,
         PA_TAG_STRING, sink->monitor_source ? sink->monitor_source->name : NULL,
-        PA_TAG_USEC, pa_sink_get_latency(sink),
+        PA_TAG_USEC, (fields & PA_SNAPSHOT_FIELDS_LATENCY) ? pa_sink_get_latency(sink) : 0,
         PA_TAG_STRING, sink->driver,
         PA_TAG_U32, sink->flags & PA_SINK_CLIENT_FLAGS_MASK,
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, sink->proplist);
-        pa_tagstruct_put_usec(t, pa_sink_get_requested_latency(sink));
+        if (fields & PA_SNAPSHOT_FIELDS_PROPLIST)
+            pa_tagstruct_put_proplist(t, sink->proplist);
+        pa_tagstruct_put_usec(t, (fields & PA_SNAPSHOT_FIELDS_LATENCY) ? pa_sink_get_requested_latency(sink) : 0);
     }
 
     if (c->version >= 15) {
@@ -3325,7 +3686,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         pa_tagstruct_putu32(t, sink->card ? sink->card->index : PA_INVALID_INDEX);
     }
 
-    if (c->version >= 16) {
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_FIELDS_PORTS)) {
         void *state;
         pa_device_port *p;
 
@@ -3342,7 +3703,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         pa_tagstruct_puts(t, sink->active_port ? sink->active_port->name : NULL);
     }
 
-    if (c->version >= 21) {
+    if (c->version >= 21 && (fields & PA_SNAPSHOT_FIELDS_FORMATS)) {
         uint32_t i;
         pa_format_info *f;
         pa_idxset *formats = pa_sink_get_formats(sink);
@@ -3356,7 +3717,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
     }
 }
 
-static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source) {
+static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source, pa_snapshot_fields_t fields) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3376,14 +3737,15 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         PA_TAG_BOOLEAN, pa_source_get_mute(source, false),
         PA_TAG_U32, source->monitor_of ? source->monitor_of->index : PA_INVALID_INDEX,
         PA_TAG_STRING, source->monitor_of ? source->monitor_of->name : NULL,
-        PA_TAG_USEC, pa_source_get_latency(source),
+        PA_TAG_USEC, (fields & PA_SNAPSHOT_FIELDS_LATENCY) ? pa_source_get_latency(source) : 0,
         PA_TAG_STRING, source->driver,
         PA_TAG_U32, source->flags & PA_SOURCE_CLIENT_FLAGS_MASK,
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, source->proplist);
-        pa_tagstruct_put_usec(t, pa_source_get_requested_latency(source));
+        if (fields & PA_SNAPSHOT_FIELDS_PROPLIST)
+            pa_tagstruct_put_proplist(t, source->proplist);
+        pa_tagstruct_put_usec(t, (fields & PA_SNAPSHOT_FIELDS_LATENCY) ? pa_source_get_requested_latency(source) : 0);
     }
 
     if (c->version >= 15) {
@@ -3395,7 +3757,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         pa_tagstruct_putu32(t, source->card ? source->card->index : PA_INVALID_INDEX);
     }
 
-    if (c->version >= 16) {
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_FIELDS_PORTS)) {
         void *state;
         pa_device_port *p;
 
@@ -3412,7 +3774,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         pa_tagstruct_puts(t, source->active_port ? source->active_port->name : NULL);
     }
 
-    if (c->version >= 22) {
+    if (c->version >= 22 && (fields & PA_SNAPSHOT_FIELDS_FORMATS)) {
         uint32_t i;
         pa_format_info *f;
         pa_idxset *formats = pa_source_get_formats(source);
@@ -3426,7 +3788,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     }
 }
 
-static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client) {
+static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client, pa_snapshot_fields_t fields) {
     pa_assert(t);
     pa_assert(client);
 
@@ -3435,7 +3797,7 @@ static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_c
     pa_tagstruct_putu32(t, client->module ? client->module->index : PA_INVALID_INDEX);
     pa_tagstruct_puts(t, client->driver);
 
-    if (c->version >= 13)
+    if (c->version >= 13 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST))
         pa_tagstruct_put_proplist(t, client->proplist);
 }
 
@@ -3493,7 +3855,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     }
 }
 
-static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module) {
+static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module, pa_snapshot_fields_t fields) {
     pa_assert(t);
     pa_assert(module);
 
@@ -3505,13 +3867,13 @@ static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_m
     if (c->version < 15)
         pa_tagstruct_put_boolean(t, false); /* autoload is obsolete */
 
-    if (c->version >= 15)
+    if (c->version >= 15 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST))
         pa_tagstruct_put_proplist(t, module->proplist);
 }
 
-static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s) {
+static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s, pa_snapshot_fields_t fields) {
     pa_sample_spec fixed_ss;
-    pa_usec_t sink_latency;
+    pa_usec_t latency = 0, sink_latency = 0;
     pa_cvolume v;
     bool has_volume = false;
 
@@ -3534,13 +3896,15 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
     pa_tagstruct_put_sample_spec(t, &fixed_ss);
     pa_tagstruct_put_channel_map(t, &s->channel_map);
     pa_tagstruct_put_cvolume(t, &v);
-    pa_tagstruct_put_usec(t, pa_sink_input_get_latency(s, &sink_latency));
+    if (fields & PA_SNAPSHOT_FIELDS_LATENCY)
+        latency = pa_sink_input_get_latency(s, &sink_latency);
+    pa_tagstruct_put_usec(t, latency);
     pa_tagstruct_put_usec(t, sink_latency);
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_sink_input_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 11)
         pa_tagstruct_put_boolean(t, s->muted);
-    if (c->version >= 13)
+    if (c->version >= 13 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST))
         pa_tagstruct_put_proplist(t, s->proplist);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_sink_input_get_state(s) == PA_SINK_INPUT_CORKED));
@@ -3548,13 +3912,13 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
         pa_tagstruct_put_boolean(t, has_volume);
         pa_tagstruct_put_boolean(t, s->volume_writable);
     }
-    if (c->version >= 21)
+    if (c->version >= 21 && (fields & PA_SNAPSHOT_FIELDS_FORMATS))
         pa_tagstruct_put_format_info(t, s->format);
 }
 
-static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s) {
+static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s, pa_snapshot_fields_t fields) {
     pa_sample_spec fixed_ss;
-    pa_usec_t source_latency;
+    pa_usec_t latency = 0, source_latency = 0;
     pa_cvolume v;
     bool has_volume = false;
 
@@ -3576,11 +3940,13 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_tagstruct_putu32(t, s->source->index);
     pa_tagstruct_put_sample_spec(t, &fixed_ss);
     pa_tagstruct_put_channel_map(t, &s->channel_map);
-    pa_tagstruct_put_usec(t, pa_source_output_get_latency(s, &source_latency));
+    if (fields & PA_SNAPSHOT_FIELDS_LATENCY)
+        latency = pa_source_output_get_latency(s, &source_latency);
+    pa_tagstruct_put_usec(t, latency);
     pa_tagstruct_put_usec(t, source_latency);
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_source_output_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
-    if (c->version >= 13)
+    if (c->version >= 13 && (fields & PA_SNAPSHOT_FIELDS_PROPLIST))
         pa_tagstruct_put_proplist(t, s->proplist);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_source_output_get_state(s) == PA_SOURCE_OUTPUT_CORKED));
@@ -3589,7 +3955,8 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
         pa_tagstruct_put_boolean(t, s->muted);
         pa_tagstruct_put_boolean(t, has_volume);
         pa_tagstruct_put_boolean(t, s->volume_writable);
-        pa_tagstruct_put_format_info(t, s->format);
+        if (fields & PA_SNAPSHOT_FIELDS_FORMATS)
+            pa_tagstruct_put_format_info(t, s->format);
     }
 }
 
@@ -3703,19 +4070,19 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
 
     reply = reply_new(tag);
     if (sink)
-        sink_fill_tagstruct(c, reply, sink);
+        sink_fill_tagstruct(c, reply, sink, PA_SNAPSHOT_FIELDS_ALL);
     else if (source)
-        source_fill_tagstruct(c, reply, source);
+        source_fill_tagstruct(c, reply, source, PA_SNAPSHOT_FIELDS_ALL);
     else if (client)
-        client_fill_tagstruct(c, reply, client);
+        client_fill_tagstruct(c, reply, client, PA_SNAPSHOT_FIELDS_ALL);
     else if (card)
         card_fill_tagstruct(c, reply, card);
     else if (module)
-        module_fill_tagstruct(c, reply, module);
+        module_fill_tagstruct(c, reply, module, PA_SNAPSHOT_FIELDS_ALL);
     else if (si)
-        sink_input_fill_tagstruct(c, reply, si);
+        sink_input_fill_tagstruct(c, reply, si, PA_SNAPSHOT_FIELDS_ALL);
     else if (so)
-        source_output_fill_tagstruct(c, reply, so);
+        source_output_fill_tagstruct(c, reply, so, PA_SNAPSHOT_FIELDS_ALL);
     else
         scache_fill_tagstruct(c, reply, sce);
     pa_pstream_send_tagstruct(c->pstream, reply);
@@ -3738,8 +4105,6 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
 
-    reply = reply_new(tag);
-
     if (command == PA_COMMAND_GET_SINK_INFO_LIST)
         i = c->protocol->core->sinks;
     else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
@@ -3759,22 +4124,24 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
         i = c->protocol->core->scache;
     }
 
+    reply = reply_new_sized(tag, i ? pa_idxset_size(i) * INFO_LIST_ENTRY_SIZE_HINT : 0);
+
     if (i) {
         PA_IDXSET_FOREACH(p, i, idx) {
             if (command == PA_COMMAND_GET_SINK_INFO_LIST)
-                sink_fill_tagstruct(c, reply, p);
+                sink_fill_tagstruct(c, reply, p, PA_SNAPSHOT_FIELDS_ALL);
             else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
-                source_fill_tagstruct(c, reply, p);
+                source_fill_tagstruct(c, reply, p, PA_SNAPSHOT_FIELDS_ALL);
             else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST)
-                client_fill_tagstruct(c, reply, p);
+                client_fill_tagstruct(c, reply, p, PA_SNAPSHOT_FIELDS_ALL);
             else if (command == PA_COMMAND_GET_CARD_INFO_LIST)
                 card_fill_tagstruct(c, reply, p);
             else if (command == PA_COMMAND_GET_MODULE_INFO_LIST)
-                module_fill_tagstruct(c, reply, p);
+                module_fill_tagstruct(c, reply, p, PA_SNAPSHOT_FIELDS_ALL);
             else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST)
-                sink_input_fill_tagstruct(c, reply, p);
+                sink_input_fill_tagstruct(c, reply, p, PA_SNAPSHOT_FIELDS_ALL);
             else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST)
-                source_output_fill_tagstruct(c, reply, p);
+                source_output_fill_tagstruct(c, reply, p, PA_SNAPSHOT_FIELDS_ALL);
             else {
                 pa_assert(command == PA_COMMAND_GET_SAMPLE_INFO_LIST);
                 scache_fill_tagstruct(c, reply, p);
@@ -3831,28 +4198,426 @@ static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
-    pa_tagstruct *t;
+/*** Snapshots ***/
+
+/* For delta snapshots we remember for each object when it last changed,
+ * counted in generations. Every subscription event for one of the snapshot
+ * facilities starts a new generation. Removed objects are kept as
+ * tombstones for a while, once we have to drop them we can't compute deltas
+ * against generations before the dropped ones anymore and send full
+ * snapshots instead. */
+
+#define SNAPSHOT_TYPES                                                  \
+    (PA_SUBSCRIPTION_MASK_SINK|PA_SUBSCRIPTION_MASK_SOURCE|             \
+     PA_SUBSCRIPTION_MASK_SINK_INPUT|PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT| \
+     PA_SUBSCRIPTION_MASK_MODULE|PA_SUBSCRIPTION_MASK_CLIENT)
+
+/* PA_SUBSCRIPTION_EVENT_SINK to ..._CLIENT */
+#define SNAPSHOT_N_FACILITIES (PA_SUBSCRIPTION_EVENT_CLIENT + 1)
+
+#define SNAPSHOT_MAX_TOMBSTONES 1024
+
+struct snapshot_change {
+    pa_subscription_event_type_t facility;
+    uint32_t index;
+    uint64_t generation;
+    bool removed;
+    PA_LLIST_FIELDS(struct snapshot_change);
+};
+
+struct snapshot_tracker {
+    pa_subscription *subscription;
+
+    /* Indexed by facility, keyed by object index */
+    pa_hashmap *changes_by_index[SNAPSHOT_N_FACILITIES];
+
+    /* Most recent change first */
+    PA_LLIST_HEAD(struct snapshot_change, changes);
+    unsigned n_tombstones;
+
+    uint64_t generation;
+
+    /* Deltas can only be computed against generations >= horizon */
+    uint64_t horizon;
+};
+
+static void snapshot_tracker_prune(struct snapshot_tracker *st) {
+    struct snapshot_change *ch, *n;
+    unsigned keep = st->n_tombstones / 2;
+
+    PA_LLIST_FOREACH_SAFE(ch, n, st->changes) {
+        if (!ch->removed)
+            continue;
+
+        if (keep > 0) {
+            keep--;
+            continue;
+        }
+
+        /* The list is ordered, so the first one we drop is the newest */
+        if (ch->generation > st->horizon)
+            st->horizon = ch->generation;
+
+        pa_hashmap_remove(st->changes_by_index[ch->facility], PA_UINT32_TO_PTR(ch->index));
+        PA_LLIST_REMOVE(struct snapshot_change, st->changes, ch);
+        pa_xfree(ch);
+        st->n_tombstones--;
+    }
+}
+
+static void snapshot_subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
+    struct snapshot_tracker *st = userdata;
+    pa_subscription_event_type_t facility = e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    bool removed = (e & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE;
+    struct snapshot_change *ch;
+
+    pa_assert(st);
+    pa_assert(facility < SNAPSHOT_N_FACILITIES);
+
+    if ((ch = pa_hashmap_get(st->changes_by_index[facility], PA_UINT32_TO_PTR(idx)))) {
+        PA_LLIST_REMOVE(struct snapshot_change, st->changes, ch);
+
+        if (ch->removed)
+            st->n_tombstones--;
+    } else {
+        ch = pa_xnew(struct snapshot_change, 1);
+        ch->facility = facility;
+        ch->index = idx;
+        pa_assert_se(pa_hashmap_put(st->changes_by_index[facility], PA_UINT32_TO_PTR(idx), ch) == 0);
+    }
+
+    ch->generation = ++st->generation;
+    ch->removed = removed;
+    PA_LLIST_PREPEND(struct snapshot_change, st->changes, ch);
+
+    if (removed && ++st->n_tombstones > SNAPSHOT_MAX_TOMBSTONES)
+        snapshot_tracker_prune(st);
+}
+
+static struct snapshot_tracker *snapshot_tracker_new(pa_core *core) {
+    struct snapshot_tracker *st;
+    uint32_t r;
+    unsigned i;
+
+    st = pa_xnew0(struct snapshot_tracker, 1);
+
+    for (i = 0; i < SNAPSHOT_N_FACILITIES; i++)
+        st->changes_by_index[i] = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    /* Start at a random generation, so that clients that kept a generation
+     * across a daemon restart very likely get a full snapshot, and never 0,
+     * which is what clients pass for their first request */
+    pa_random(&r, sizeof(r));
+    st->generation = st->horizon = (uint64_t) (r | 1) << 32;
+
+    st->subscription = pa_subscription_new(core, SNAPSHOT_TYPES, snapshot_subscription_cb, st);
+
+    return st;
+}
+
+static void snapshot_tracker_free(struct snapshot_tracker *st) {
+    struct snapshot_change *ch;
+    unsigned i;
+
+    pa_assert(st);
+
+    pa_subscription_free(st->subscription);
+
+    while ((ch = st->changes)) {
+        PA_LLIST_REMOVE(struct snapshot_change, st->changes, ch);
+        pa_xfree(ch);
+    }
+
+    for (i = 0; i < SNAPSHOT_N_FACILITIES; i++)
+        pa_hashmap_free(st->changes_by_index[i]);
+
+    pa_xfree(st);
+}
+
+static pa_idxset *snapshot_objects(pa_core *core, pa_subscription_event_type_t facility) {
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            return core->sinks;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            return core->sources;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            return core->sink_inputs;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            return core->source_outputs;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            return core->modules;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            return core->clients;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void snapshot_fill_object(pa_native_connection *c, pa_tagstruct *t, pa_subscription_event_type_t facility, void *o, pa_snapshot_fields_t fields) {
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            sink_fill_tagstruct(c, t, o, fields);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            source_fill_tagstruct(c, t, o, fields);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            sink_input_fill_tagstruct(c, t, o, fields);
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            source_output_fill_tagstruct(c, t, o, fields);
+            break;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            module_fill_tagstruct(c, t, o, fields);
+            break;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            client_fill_tagstruct(c, t, o, fields);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void snapshot_put_object(pa_native_connection *c, pa_tagstruct *t, pa_subscription_event_type_t facility, void *o, pa_snapshot_fields_t fields) {
+    pa_tagstruct_putu32(t, facility);
+    pa_tagstruct_put_boolean(t, false);
+    snapshot_fill_object(c, t, facility, o, fields);
+}
+
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    struct snapshot_tracker *st;
+    pa_subscription_mask_t types;
+    uint32_t fields;
+    uint64_t since;
+    pa_tagstruct *reply;
 
     pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &types) < 0 ||
+        pa_tagstruct_getu32(t, &fields) < 0 ||
+        pa_tagstruct_getu64(t, &since) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, (types & ~SNAPSHOT_TYPES) == 0, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, (fields & ~PA_SNAPSHOT_FIELDS_ALL) == 0, tag, PA_ERR_INVALID);
+
+    if (!c->protocol->snapshot_tracker)
+        c->protocol->snapshot_tracker = snapshot_tracker_new(c->protocol->core);
+
+    st = c->protocol->snapshot_tracker;
+
+    reply = reply_new(tag);
+    pa_tagstruct_putu64(reply, st->generation);
+
+    if (since < st->horizon || since > st->generation) {
+        /* Modules and clients first, then devices, then streams, so that
+         * everything an object refers to comes before it */
+        static const pa_subscription_event_type_t order[] = {
+            PA_SUBSCRIPTION_EVENT_MODULE,
+            PA_SUBSCRIPTION_EVENT_CLIENT,
+            PA_SUBSCRIPTION_EVENT_SINK,
+            PA_SUBSCRIPTION_EVENT_SOURCE,
+            PA_SUBSCRIPTION_EVENT_SINK_INPUT,
+            PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT
+        };
+        unsigned i;
+
+        pa_tagstruct_put_boolean(reply, true);
+
+        for (i = 0; i < PA_ELEMENTSOF(order); i++) {
+            uint32_t idx;
+            void *o;
+
+            if (!pa_subscription_match_flags(types, order[i]))
+                continue;
+
+            PA_IDXSET_FOREACH(o, snapshot_objects(c->protocol->core, order[i]), idx)
+                snapshot_put_object(c, reply, order[i], o, fields);
+        }
+    } else {
+        struct snapshot_change *ch;
+
+        pa_tagstruct_put_boolean(reply, false);
+
+        PA_LLIST_FOREACH(ch, st->changes) {
+            void *o = NULL;
+
+            if (ch->generation <= since)
+                break;
+
+            if (!pa_subscription_match_flags(types, ch->facility))
+                continue;
+
+            /* Subscription events are delivered asynchronously, so the
+             * object might be gone already even if we haven't been told
+             * yet */
+            if (!ch->removed)
+                o = pa_idxset_get_by_index(snapshot_objects(c->protocol->core, ch->facility), ch->index);
+
+            if (o)
+                snapshot_put_object(c, reply, ch->facility, o, fields);
+            else {
+                pa_tagstruct_putu32(reply, ch->facility);
+                pa_tagstruct_put_boolean(reply, true);
+                pa_tagstruct_putu32(reply, ch->index);
+            }
+        }
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+/*** Subscriptions ***/
+
+/* Events are held back at most this long */
+#define SUBSCRIPTION_WINDOW_MAX (10*PA_USEC_PER_SEC)
+
+struct pending_event {
+    pa_subscription_event_type_t type;
+    uint32_t index;
+
+    PA_LLIST_FIELDS(struct pending_event);
+};
+
+static unsigned pending_event_hash_func(const void *p) {
+    const struct pending_event *e = p;
+
+    return e->index * 31U + (e->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+}
+
+static int pending_event_compare_func(const void *a, const void *b) {
+    const struct pending_event *x = a, *y = b;
+    pa_subscription_event_type_t fx = x->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    pa_subscription_event_type_t fy = y->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+
+    if (fx != fy)
+        return fx < fy ? -1 : 1;
+
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+
+    return 0;
+}
+
+static void send_subscription_event(pa_native_connection *c, pa_subscription_event_type_t e, uint32_t idx) {
+    pa_subscription_event_type_t facility = e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    pa_tagstruct *t;
 
     t = pa_tagstruct_new();
     pa_tagstruct_putu32(t, PA_COMMAND_SUBSCRIBE_EVENT);
     pa_tagstruct_putu32(t, (uint32_t) -1);
     pa_tagstruct_putu32(t, e);
     pa_tagstruct_putu32(t, idx);
+
+    if (c->subscription_with_state &&
+        (e & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_REMOVE &&
+        pa_subscription_match_flags(SNAPSHOT_TYPES, e)) {
+        void *o;
+
+        /* The object may be gone already, the remove event follows then */
+        if ((o = pa_idxset_get_by_index(snapshot_objects(c->protocol->core, facility), idx))) {
+            pa_tagstruct_putu32(t, c->subscription_fields);
+            snapshot_fill_object(c, t, facility, o, c->subscription_fields);
+        }
+    }
+
     pa_pstream_send_tagstruct(c->pstream, t);
 }
 
+static void free_pending_event(pa_native_connection *c, struct pending_event *e) {
+    if (!e->next)
+        c->pending_event_last = e->prev;
+
+    PA_LLIST_REMOVE(struct pending_event, c->pending_event_queue, e);
+    pa_assert_se(pa_hashmap_remove(c->pending_events, e) == e);
+    pa_xfree(e);
+}
+
+static void flush_subscription_events(pa_native_connection *c) {
+    if (c->subscription_time_event) {
+        c->protocol->core->mainloop->time_free(c->subscription_time_event);
+        c->subscription_time_event = NULL;
+    }
+
+    while (c->pending_event_queue) {
+        struct pending_event *e = c->pending_event_queue;
+
+        send_subscription_event(c, e->type, e->index);
+        free_pending_event(c, e);
+    }
+}
+
+static void subscription_window_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+
+    pa_native_connection_assert_ref(c);
+
+    flush_subscription_events(c);
+}
+
+static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    struct pending_event key, *pe;
+
+    pa_native_connection_assert_ref(c);
+
+    if (c->subscription_window <= 0) {
+        send_subscription_event(c, e, idx);
+        return;
+    }
+
+    key.type = e;
+    key.index = idx;
+
+    if ((pe = pa_hashmap_get(c->pending_events, &key))) {
+        bool was_new = (pe->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW;
+
+        /* A pending new or change event covers this change already. A
+         * removal replaces whatever is pending for the object. */
+        if ((e & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_REMOVE)
+            return;
+
+        free_pending_event(c, pe);
+
+        /* The client never heard of an object that came and went within
+         * the window, so it doesn't hear of its removal either */
+        if (was_new)
+            return;
+    }
+
+    pe = pa_xnew(struct pending_event, 1);
+    pe->type = e;
+    pe->index = idx;
+
+    PA_LLIST_INSERT_AFTER(struct pending_event, c->pending_event_queue, c->pending_event_last, pe);
+    c->pending_event_last = pe;
+    pa_assert_se(pa_hashmap_put(c->pending_events, pe, pe) == 0);
+
+    if (!c->subscription_time_event)
+        c->subscription_time_event = pa_core_rttime_new(core, pa_rtclock_now() + c->subscription_window, subscription_window_cb, c);
+}
+
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_subscription_mask_t m;
+    pa_usec_t window = 0;
+    bool with_state = false;
+    uint32_t fields = PA_SNAPSHOT_FIELDS_NONE;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
     if (pa_tagstruct_getu32(t, &m) < 0 ||
+        (c->version >= 32 &&
+         (pa_tagstruct_get_usec(t, &window) < 0 ||
+          pa_tagstruct_get_boolean(t, &with_state) < 0 ||
+          pa_tagstruct_getu32(t, &fields) < 0)) ||
         !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
@@ -3860,6 +4625,16 @@ static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag,
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
     CHECK_VALIDITY(c->pstream, (m & ~PA_SUBSCRIPTION_MASK_ALL) == 0, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, window <= SUBSCRIPTION_WINDOW_MAX, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, (fields & ~PA_SNAPSHOT_FIELDS_ALL) == 0, tag, PA_ERR_INVALID);
+
+    /* Events that are held back were subscribed to, deliver them as they
+     * were asked for */
+    flush_subscription_events(c);
+
+    c->subscription_window = window;
+    c->subscription_with_state = with_state;
+    c->subscription_fields = fields;
 
     if (c->subscription)
         pa_subscription_free(c->subscription);
@@ -4992,6 +5767,44 @@ static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, pa_cmsg_an
     }
 }
 
+/* Called from main context. Copies the data into the ring of the stream
+ * if that keeps it in order with everything else we sent to the IO
+ * thread. Returns false if the data needs to be posted instead. */
+static bool playback_stream_write_ring(playback_stream *s, const pa_memchunk *chunk) {
+    const uint8_t *d;
+    size_t n;
+
+    /* Data in the ring may overtake queued messages. While corked
+     * nobody picks it up from the ring. */
+    if (pa_atomic_load(&s->seek_or_post_in_queue) > 0 ||
+        s->sink_input->state != PA_SINK_INPUT_RUNNING)
+        return false;
+
+    if (chunk->length > (size_t) (s->ring.capacity - pa_atomic_load(&s->ring_count)))
+        return false;
+
+    d = pa_memblock_acquire_chunk(chunk);
+
+    for (n = chunk->length; n > 0; ) {
+        int l;
+        void *p = pa_ringbuffer_begin_write(&s->ring, &l);
+
+        l = PA_MIN(l, (int) n);
+        memcpy(p, d, (size_t) l);
+        pa_ringbuffer_end_write(&s->ring, l);
+
+        d += l;
+        n -= (size_t) l;
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    if (pa_atomic_cmpxchg(&s->ring_wakeup, 1, 0))
+        playback_stream_post_ring_data(s, s->sink_input->sink->asyncmsgq);
+
+    return true;
+}
+
 static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     output_stream *stream;
@@ -5020,6 +5833,13 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
             return;
         }
 
+        /* Blocks imported from the client's SHM or memfd pool are passed
+         * on by reference, copying them would only cost us */
+        if (chunk->memblock && pa_memblock_is_ours(chunk->memblock) &&
+            seek == PA_SEEK_RELATIVE && offset == 0 &&
+            playback_stream_write_ring(ps, chunk))
+            return;
+
         pa_atomic_inc(&ps->seek_or_post_in_queue);
         if (chunk->memblock) {
             if (seek != PA_SEEK_RELATIVE || offset != 0)
@@ -5153,6 +5973,24 @@ static void auth_timeout(pa_mainloop_api*m, pa_time_event *e, const struct timev
     }
 }
 
+#ifdef HAVE_IO_URING
+static void enable_uring(pa_native_protocol *p, pa_iochannel *io) {
+    pa_assert(p);
+    pa_assert(io);
+
+    if (!p->uring && !p->uring_failed) {
+        if (!(p->uring = pa_uring_new(p->core->mainloop, pa_mempool_block_size_max(p->core->mempool), URING_SEND_BUFFERS))) {
+            pa_log_warn("io_uring not available, falling back to plain socket IO.");
+            p->uring_failed = true;
+            return;
+        }
+    }
+
+    if (p->uring && pa_iochannel_enable_uring(io, p->uring) < 0)
+        pa_log_debug("Not using io_uring for this connection.");
+}
+#endif
+
 void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_native_options *o) {
     pa_native_connection *c;
     char pname[128];
@@ -5163,8 +6001,8 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_assert(io);
     pa_assert(o);
 
-    if (pa_idxset_size(p->connections)+1 > MAX_CONNECTIONS) {
-        pa_log_warn("Warning! Too many connections (%u), dropping incoming connection.", MAX_CONNECTIONS);
+    if (pa_idxset_size(p->connections)+1 > o->max_connections) {
+        pa_log_warn("Warning! Too many connections (%u), dropping incoming connection.", o->max_connections);
         pa_iochannel_free(io);
         return;
     }
@@ -5188,6 +6026,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     c->options = pa_native_options_ref(o);
     c->authorized = false;
     c->srbpending = NULL;
+    c->mempool_segment_generation = 0;
 
     if (o->auth_anonymous) {
         pa_log_info("Client authenticated anonymously.");
@@ -5217,6 +6056,11 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rw_mempool = NULL;
 
+#ifdef HAVE_IO_URING
+    if (o->io_uring)
+        enable_uring(p, io);
+#endif
+
     c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
     pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
     pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
@@ -5232,6 +6076,13 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->subscription_window = 0;
+    c->subscription_with_state = false;
+    c->subscription_fields = PA_SNAPSHOT_FIELDS_NONE;
+    PA_LLIST_HEAD_INIT(struct pending_event, c->pending_event_queue);
+    c->pending_event_last = NULL;
+    c->pending_events = pa_hashmap_new(pending_event_hash_func, pending_event_compare_func);
+    c->subscription_time_event = NULL;
 
     pa_idxset_put(p->connections, c, NULL);
 
@@ -5270,6 +6121,13 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
 
     p->extensions = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
+#ifdef HAVE_IO_URING
+    p->uring = NULL;
+    p->uring_failed = false;
+#endif
+
+    p->snapshot_tracker = NULL;
+
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
         pa_hook_init(&p->hooks[h], p);
 
@@ -5318,6 +6176,14 @@ void pa_native_protocol_unref(pa_native_protocol *p) {
 
     pa_hashmap_free(p->extensions);
 
+#ifdef HAVE_IO_URING
+    if (p->uring)
+        pa_uring_unref(p->uring);
+#endif
+
+    if (p->snapshot_tracker)
+        snapshot_tracker_free(p->snapshot_tracker);
+
     pa_assert_se(pa_shared_remove(p->core, "native-protocol") >= 0);
 
     pa_xfree(p);
@@ -5382,6 +6248,8 @@ pa_native_options* pa_native_options_new(void) {
     o = pa_xnew0(pa_native_options, 1);
     PA_REFCNT_INIT(o);
 
+    o->max_connections = MAX_CONNECTIONS;
+
     return o;
 }
 
@@ -5420,12 +6288,24 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
     pa_assert(PA_REFCNT_VALUE(o) >= 1);
     pa_assert(ma);
 
+    o->max_connections = MAX_CONNECTIONS;
+    if (pa_modargs_get_value_u32(ma, "max-connections", &o->max_connections) < 0 || o->max_connections < 1) {
+        pa_log("max-connections= expects a positive integer argument.");
+        return -1;
+    }
+
     o->srbchannel = true;
     if (pa_modargs_get_value_boolean(ma, "srbchannel", &o->srbchannel) < 0) {
         pa_log("srbchannel= expects a boolean argument.");
         return -1;
     }
 
+    o->io_uring = false;
+    if (pa_modargs_get_value_boolean(ma, "io-uring", &o->io_uring) < 0) {
+        pa_log("io-uring= expects a boolean argument.");
+        return -1;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "auth-anonymous", &o->auth_anonymous) < 0) {
         pa_log("auth-anonymous= expects a boolean argument.");
         return -1;
@@ -31,16 +31,12 @@
 #include "pstream-util.h"
 
 static void pa_pstream_send_tagstruct_with_ancil_data(pa_pstream *p, pa_tagstruct *t, pa_cmsg_ancil_data *ancil_data) {
-    size_t length;
-    const uint8_t *data;
     pa_packet *packet;
 
     pa_assert(p);
     pa_assert(t);
 
-    pa_assert_se(data = pa_tagstruct_data(t, &length));
-    pa_assert_se(packet = pa_packet_new_data(data, length));
-    pa_tagstruct_free(t);
+    pa_assert_se(packet = pa_tagstruct_free_to_packet(t));
 
     pa_pstream_send_packet(p, packet, ancil_data);
     pa_packet_unref(packet);
@@ -116,6 +112,23 @@ void pa_pstream_send_simple_ack(pa_pstream *p, uint32_t tag) {
     pa_pstream_send_tagstruct(p, t);
 }
 
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+static int register_memfd(pa_pstream *p, uint32_t shm_id, int memfd_fd, bool close_fd) {
+    pa_tagstruct *t;
+
+    if (pa_pstream_attach_memfd_shmid(p, shm_id, memfd_fd))
+        return -1;
+
+    t = pa_tagstruct_new();
+    pa_tagstruct_putu32(t, PA_COMMAND_REGISTER_MEMFD_SHMID);
+    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
+    pa_tagstruct_putu32(t, shm_id);
+    pa_pstream_send_tagstruct_with_fds(p, t, 1, &memfd_fd, close_fd);
+
+    return 0;
+}
+#endif
+
 /* Before sending blocks from a memfd-backed pool over the pipe, we
  * must call this method first.
  *
@@ -133,7 +146,6 @@ int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool, const cha
 #if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
     unsigned shm_id;
     int memfd_fd, ret = -1;
-    pa_tagstruct *t;
     bool per_client_mempool;
 
     pa_assert(p);
@@ -171,7 +183,7 @@ int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool, const cha
      * fd, and we're thus the sole code path responsible for closing it.
      * In case of any failure, it MUST be closed. */
 
-    if (pa_pstream_attach_memfd_shmid(p, shm_id, memfd_fd)) {
+    if (register_memfd(p, shm_id, memfd_fd, per_client_mempool) < 0) {
         *fail_reason = "could not attach memfd SHM ID to pipe";
 
         if (per_client_mempool)
@@ -179,12 +191,6 @@ int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool, const cha
         goto finish;
     }
 
-    t = pa_tagstruct_new();
-    pa_tagstruct_putu32(t, PA_COMMAND_REGISTER_MEMFD_SHMID);
-    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
-    pa_tagstruct_putu32(t, shm_id);
-    pa_pstream_send_tagstruct_with_fds(p, t, 1, &memfd_fd, per_client_mempool);
-
     ret = 0;
 finish:
     pa_pstream_unref(p);
@@ -196,3 +202,42 @@ finish:
     return -1;
 #endif
 }
+
+/* Registers the segments a memfd-backed pool grew by, which weren't
+ * registered with this pipe yet. Needs to be called before sending
+ * blocks from a pool that may grow, see pa_mempool_set_max_size().
+ *
+ * The other end may process these registrations only after blocks that
+ * follow them over an srbchannel, so such blocks are copied, see
+ * pa_pstream_set_memfd_shmid_late(). */
+void pa_pstream_register_memfd_mempool_segments(pa_pstream *p, pa_mempool *pool) {
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+    unsigned i;
+
+    pa_assert(p);
+    pa_assert(pool);
+
+    if (!pa_pstream_get_memfd(p) || !pa_mempool_is_memfd_backed(pool))
+        return;
+
+    for (i = 0; i < PA_MEMPOOL_SEGMENTS_MAX; i++) {
+        uint32_t shm_id;
+        int memfd_fd;
+
+        if ((memfd_fd = pa_mempool_get_segment_memfd_fd(pool, i, &shm_id)) < 0)
+            continue;
+
+        if (pa_pstream_is_memfd_shmid_attached(p, shm_id))
+            continue;
+
+        /* Registered segments stay around as long as the pool does,
+         * so the fd can be passed like that of the pool itself */
+        if (register_memfd(p, shm_id, memfd_fd, false) < 0) {
+            pa_log_warn("Failed to register memfd pool segment with ID = %u", shm_id);
+            continue;
+        }
+
+        pa_pstream_set_memfd_shmid_late(p, shm_id);
+    }
+#endif
+}
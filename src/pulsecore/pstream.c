@@ -152,9 +152,13 @@ struct pa_pstream {
      * @use_memfd: pipe supports sending SHM memfd block references
      *
      * @registered_memfd_ids: registered memfd pools SHM IDs. Check
-     * pa_pstream_register_memfd_mempool() for more information. */
+     * pa_pstream_register_memfd_mempool() for more information.
+     *
+     * @late_memfd_ids: registered SHM IDs whose registration may reach
+     * the other end only after blocks sent over the srbchannel. Check
+     * pa_pstream_set_memfd_shmid_late(). */
     bool use_shm, use_memfd;
-    pa_idxset *registered_memfd_ids;
+    pa_idxset *registered_memfd_ids, *late_memfd_ids;
 
     pa_memimport *import;
     pa_memexport *export;
@@ -243,7 +247,10 @@ static void do_pstream_read_write(pa_pstream *p) {
 
     p->mainloop->defer_enable(p->defer_event, 0);
 
+    /* Everything queued for the srbchannel goes out with a single wakeup
+     * of the other side, no matter how many streams it is for */
     if (!p->dead && p->srb) {
+         pa_srbchannel_begin_batch(p->srb);
          do_write(p);
          while (!p->dead && do_read(p, &p->readsrb) == 0);
     }
@@ -262,6 +269,11 @@ static void do_pstream_read_write(pa_pstream *p) {
             break;
     }
 
+    /* If we switched srbchannels in between, the old one has been
+     * signalled when it was freed */
+    if (p->srb)
+        pa_srbchannel_end_batch(p->srb);
+
     pa_pstream_unref(p);
     return;
 
@@ -375,6 +387,27 @@ int pa_pstream_attach_memfd_shmid(pa_pstream *p, unsigned shm_id, int memfd_fd)
     return 0;
 }
 
+bool pa_pstream_is_memfd_shmid_attached(pa_pstream *p, unsigned shm_id) {
+    pa_assert(p);
+
+    return p->use_memfd && pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
+/* The REGISTER_MEMFD_SHMID packet always goes over the socket, as it
+ * carries the memfd fd. Blocks sent over an srbchannel may be read by
+ * the other end before that packet, unless the registration happened
+ * before the srbchannel was set up. Blocks from regions registered later
+ * are thus sent by copying their data whenever an srbchannel is used. */
+void pa_pstream_set_memfd_shmid_late(pa_pstream *p, unsigned shm_id) {
+    pa_assert(p);
+    pa_assert(pa_pstream_is_memfd_shmid_attached(p, shm_id));
+
+    if (!p->late_memfd_ids)
+        p->late_memfd_ids = pa_idxset_new(NULL, NULL);
+
+    pa_idxset_put(p->late_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
 static void item_free(void *item) {
     struct item_info *i = item;
     pa_assert(i);
@@ -428,6 +461,9 @@ static void pstream_free(pa_pstream *p) {
     if (p->registered_memfd_ids)
         pa_idxset_free(p->registered_memfd_ids, NULL);
 
+    if (p->late_memfd_ids)
+        pa_idxset_free(p->late_memfd_ids, NULL);
+
     pa_xfree(p);
 }
 
@@ -665,7 +701,11 @@ static void prepare_next_write_item(pa_pstream *p) {
                     send_payload = false;
 
                 if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd) {
-                    if (pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
+                    if (p->srb && p->late_memfd_ids &&
+                        pa_idxset_get_by_data(p->late_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
+                        /* The other end might not know the ID yet when
+                         * it reads this, see pa_pstream_set_memfd_shmid_late() */
+                    } else if (pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
                         flags |= PA_FLAG_SHMDATA_MEMFD_BLOCK;
                         send_payload = false;
                     } else {
@@ -24,6 +24,7 @@
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -121,9 +122,679 @@ static void remap_mono_to_stereo_float32ne_sse2(pa_remap_t *m, float *dst, const
     );
 }
 
+#if defined (__amd64__)
+/* The matrix kernels below use the coefficients the way the C code does:
+ * a coefficient <= 0 leaves the input channel out, one >= 1 adds it
+ * unscaled. The first two helpers compute a single frame like that, for
+ * the frames at the end that don't fill a whole register. */
+static void remap_frame_s16ne(pa_remap_t *m, int16_t *dst, const int16_t *src) {
+    unsigned oc, ic;
+
+    for (oc = 0; oc < m->o_ss.channels; oc++) {
+        int16_t sum = 0;
+
+        for (ic = 0; ic < m->i_ss.channels; ic++) {
+            int32_t vol = m->map_table_i[oc][ic];
+
+            if (vol <= 0)
+                continue;
+
+            if (vol >= 0x10000)
+                sum += src[ic];
+            else
+                sum += (int16_t) (((int32_t) src[ic] * vol) >> 16);
+        }
+
+        dst[oc] = sum;
+    }
+}
+
+static void remap_frame_float32ne(pa_remap_t *m, float *dst, const float *src) {
+    unsigned oc, ic;
+
+    for (oc = 0; oc < m->o_ss.channels; oc++) {
+        float sum = 0.0f;
+
+        for (ic = 0; ic < m->i_ss.channels; ic++) {
+            float vol = m->map_table_f[oc][ic];
+
+            if (vol <= 0.0f)
+                continue;
+
+            if (vol >= 1.0f)
+                sum += src[ic];
+            else
+                sum += src[ic] * vol;
+        }
+
+        dst[oc] = sum;
+    }
+}
+
+/* Generic matrix remapping for up to 4 output channels: the output frame
+ * lives in the lanes of one register, and each input sample is broadcast
+ * and multiplied with its column of the matrix. The whole register is
+ * stored, spilling into the next output frame, which is why the last
+ * frames are left to remap_frame_float32ne(). */
+static void remap_channels_matrix_float32ne_sse2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    const unsigned tail = 3 / n_oc;
+    pa_reg_x86 frames, k, c;
+
+    if (n > tail) {
+        frames = n - tail;
+
+        __asm__ __volatile__ (
+            "1:                                     \n\t"
+            " xorps %%xmm0, %%xmm0                  \n\t"
+            " mov %[cols], %[c]                     \n\t"
+            " mov %[n_ic], %[k]                     \n\t"
+            "2:                                     \n\t"
+            " movss (%[src]), %%xmm1                \n\t"
+            " shufps $0, %%xmm1, %%xmm1             \n\t" /* broadcast input sample */
+            " movups (%[c]), %%xmm2                 \n\t"
+            " mulps %%xmm2, %%xmm1                  \n\t"
+            " addps %%xmm1, %%xmm0                  \n\t"
+            " add $4, %[src]                        \n\t"
+            " add $16, %[c]                         \n\t"
+            " dec %[k]                              \n\t"
+            " jne 2b                                \n\t"
+            " movups %%xmm0, (%[dst])               \n\t"
+            " add %[stride], %[dst]                 \n\t"
+            " dec %[frames]                         \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [frames] "+r" (frames), [k] "=&r" (k), [c] "=&r" (c)
+            : [cols] "r" (m->state), [n_ic] "r" ((pa_reg_x86) n_ic), [stride] "r" ((pa_reg_x86) (n_oc * sizeof(float)))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2"
+        );
+
+        n = tail;
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc)
+        remap_frame_float32ne(m, dst, src);
+}
+
+/* Downmixing to stereo works on two frames at a time. The input samples
+ * are multiplied with the left and right coefficients and summed up
+ * horizontally, which leaves L0 R0 L1 R1 in one register. */
+static void remap_ch4_to_stereo_float32ne_sse3(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    pa_reg_x86 pairs = n / 2;
+
+    if (pairs > 0) {
+        __asm__ __volatile__ (
+            " movups (%[coef]), %%xmm8              \n\t" /* left */
+            " movups 16(%[coef]), %%xmm9            \n\t" /* right */
+            "1:                                     \n\t"
+            " movups (%[src]), %%xmm0               \n\t"
+            " movaps %%xmm0, %%xmm1                 \n\t"
+            " mulps %%xmm8, %%xmm0                  \n\t"
+            " mulps %%xmm9, %%xmm1                  \n\t"
+            " haddps %%xmm1, %%xmm0                 \n\t"
+            " movups 16(%[src]), %%xmm2             \n\t"
+            " movaps %%xmm2, %%xmm3                 \n\t"
+            " mulps %%xmm8, %%xmm2                  \n\t"
+            " mulps %%xmm9, %%xmm3                  \n\t"
+            " haddps %%xmm3, %%xmm2                 \n\t"
+            " haddps %%xmm2, %%xmm0                 \n\t"
+            " movups %%xmm0, (%[dst])               \n\t"
+            " add $32, %[src]                       \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[pairs]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [pairs] "+r" (pairs)
+            : [coef] "r" (m->state)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm8", "xmm9"
+        );
+    }
+
+    if (n & 1)
+        remap_frame_float32ne(m, dst, src);
+}
+
+/* Two 5.1 frames are three registers, the middle one holding the end of
+ * the first and the start of the second frame. Its coefficients are
+ * rotated accordingly, and its sums are shuffled into place at the end. */
+static void remap_ch6_to_stereo_float32ne_sse3(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    pa_reg_x86 pairs = n / 2;
+
+    if (pairs > 0) {
+        __asm__ __volatile__ (
+            " movups (%[coef]), %%xmm8              \n\t" /* left 0..3 */
+            " movups 16(%[coef]), %%xmm9            \n\t" /* right 0..3 */
+            " movups 32(%[coef]), %%xmm10           \n\t" /* left 4 5 0 1 */
+            " movups 48(%[coef]), %%xmm11           \n\t" /* right 4 5 0 1 */
+            " movups 64(%[coef]), %%xmm12           \n\t" /* left 2..5 */
+            " movups 80(%[coef]), %%xmm13           \n\t" /* right 2..5 */
+            "1:                                     \n\t"
+            " movups (%[src]), %%xmm0               \n\t"
+            " movaps %%xmm0, %%xmm1                 \n\t"
+            " mulps %%xmm8, %%xmm0                  \n\t"
+            " mulps %%xmm9, %%xmm1                  \n\t"
+            " haddps %%xmm1, %%xmm0                 \n\t"
+            " movups 32(%[src]), %%xmm2             \n\t"
+            " movaps %%xmm2, %%xmm3                 \n\t"
+            " mulps %%xmm12, %%xmm2                 \n\t"
+            " mulps %%xmm13, %%xmm3                 \n\t"
+            " haddps %%xmm3, %%xmm2                 \n\t"
+            " haddps %%xmm2, %%xmm0                 \n\t" /* L0 R0 L1 R1 without the middle */
+            " movups 16(%[src]), %%xmm4             \n\t"
+            " movaps %%xmm4, %%xmm5                 \n\t"
+            " mulps %%xmm10, %%xmm4                 \n\t"
+            " mulps %%xmm11, %%xmm5                 \n\t"
+            " haddps %%xmm5, %%xmm4                 \n\t" /* L0 L1 R0 R1 of the middle */
+            " shufps $0xd8, %%xmm4, %%xmm4          \n\t"
+            " addps %%xmm4, %%xmm0                  \n\t"
+            " movups %%xmm0, (%[dst])               \n\t"
+            " add $48, %[src]                       \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[pairs]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [pairs] "+r" (pairs)
+            : [coef] "r" (m->state)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+              "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13"
+        );
+    }
+
+    if (n & 1)
+        remap_frame_float32ne(m, dst, src);
+}
+
+static void remap_ch8_to_stereo_float32ne_sse3(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    pa_reg_x86 pairs = n / 2;
+
+    if (pairs > 0) {
+        __asm__ __volatile__ (
+            " movups (%[coef]), %%xmm8              \n\t" /* left 0..3 */
+            " movups 16(%[coef]), %%xmm9            \n\t" /* right 0..3 */
+            " movups 32(%[coef]), %%xmm10           \n\t" /* left 4..7 */
+            " movups 48(%[coef]), %%xmm11           \n\t" /* right 4..7 */
+            "1:                                     \n\t"
+            " movups (%[src]), %%xmm0               \n\t"
+            " movups 16(%[src]), %%xmm1             \n\t"
+            " movaps %%xmm0, %%xmm2                 \n\t"
+            " movaps %%xmm1, %%xmm3                 \n\t"
+            " mulps %%xmm8, %%xmm0                  \n\t"
+            " mulps %%xmm10, %%xmm1                 \n\t"
+            " addps %%xmm1, %%xmm0                  \n\t"
+            " mulps %%xmm9, %%xmm2                  \n\t"
+            " mulps %%xmm11, %%xmm3                 \n\t"
+            " addps %%xmm3, %%xmm2                  \n\t"
+            " haddps %%xmm2, %%xmm0                 \n\t"
+            " movups 32(%[src]), %%xmm4             \n\t"
+            " movups 48(%[src]), %%xmm5             \n\t"
+            " movaps %%xmm4, %%xmm6                 \n\t"
+            " movaps %%xmm5, %%xmm7                 \n\t"
+            " mulps %%xmm8, %%xmm4                  \n\t"
+            " mulps %%xmm10, %%xmm5                 \n\t"
+            " addps %%xmm5, %%xmm4                  \n\t"
+            " mulps %%xmm9, %%xmm6                  \n\t"
+            " mulps %%xmm11, %%xmm7                 \n\t"
+            " addps %%xmm7, %%xmm6                  \n\t"
+            " haddps %%xmm6, %%xmm4                 \n\t"
+            " haddps %%xmm4, %%xmm0                 \n\t"
+            " movups %%xmm0, (%[dst])               \n\t"
+            " add $64, %[src]                       \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[pairs]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [pairs] "+r" (pairs)
+            : [coef] "r" (m->state)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+              "xmm8", "xmm9", "xmm10", "xmm11"
+        );
+    }
+
+    if (n & 1)
+        remap_frame_float32ne(m, dst, src);
+}
+
+/* One frame of up to 8 channels fits a YMM register, so downmixing to
+ * stereo needs no shuffling. Frames are loaded masked so that they don't
+ * pick up samples from the next frame or read beyond the end. */
+static void remap_to_stereo_float32ne_avx(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    pa_reg_x86 pairs = n / 2;
+
+    if (pairs > 0) {
+        __asm__ __volatile__ (
+            " vmovups (%[coef]), %%ymm8             \n\t" /* left */
+            " vmovups 32(%[coef]), %%ymm9           \n\t" /* right */
+            " vmovups 64(%[coef]), %%ymm10          \n\t" /* load mask */
+            "1:                                     \n\t"
+            " vmaskmovps (%[src]), %%ymm10, %%ymm0  \n\t"
+            " vmaskmovps (%[src],%[stride]), %%ymm10, %%ymm1 \n\t"
+            " vmulps %%ymm8, %%ymm0, %%ymm2         \n\t"
+            " vmulps %%ymm9, %%ymm0, %%ymm0         \n\t"
+            " vhaddps %%ymm0, %%ymm2, %%ymm2        \n\t"
+            " vmulps %%ymm8, %%ymm1, %%ymm3         \n\t"
+            " vmulps %%ymm9, %%ymm1, %%ymm1         \n\t"
+            " vhaddps %%ymm1, %%ymm3, %%ymm3        \n\t"
+            " vhaddps %%ymm3, %%ymm2, %%ymm2        \n\t" /* L0 R0 L1 R1 of either half */
+            " vextractf128 $1, %%ymm2, %%xmm3       \n\t"
+            " vaddps %%xmm3, %%xmm2, %%xmm2         \n\t"
+            " vmovups %%xmm2, (%[dst])              \n\t"
+            " lea (%[src],%[stride],2), %[src]      \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[pairs]                          \n\t"
+            " jne 1b                                \n\t"
+            " vzeroupper                            \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [pairs] "+r" (pairs)
+            : [coef] "r" (m->state), [stride] "r" ((pa_reg_x86) (m->i_ss.channels * sizeof(float)))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm8", "xmm9", "xmm10"
+        );
+    }
+
+    if (n & 1)
+        remap_frame_float32ne(m, dst, src);
+}
+
+/* Same as remap_channels_matrix_float32ne_sse2(), for 5 to 8 output
+ * channels */
+static void remap_channels_matrix_float32ne_avx(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    const unsigned tail = 7 / n_oc;
+    pa_reg_x86 frames, k, c;
+
+    if (n > tail) {
+        frames = n - tail;
+
+        __asm__ __volatile__ (
+            "1:                                     \n\t"
+            " vxorps %%ymm0, %%ymm0, %%ymm0         \n\t"
+            " mov %[cols], %[c]                     \n\t"
+            " mov %[n_ic], %[k]                     \n\t"
+            "2:                                     \n\t"
+            " vbroadcastss (%[src]), %%ymm1         \n\t"
+            " vmulps (%[c]), %%ymm1, %%ymm1         \n\t"
+            " vaddps %%ymm1, %%ymm0, %%ymm0         \n\t"
+            " add $4, %[src]                        \n\t"
+            " add $32, %[c]                         \n\t"
+            " dec %[k]                              \n\t"
+            " jne 2b                                \n\t"
+            " vmovups %%ymm0, (%[dst])              \n\t"
+            " add %[stride], %[dst]                 \n\t"
+            " dec %[frames]                         \n\t"
+            " jne 1b                                \n\t"
+            " vzeroupper                            \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [frames] "+r" (frames), [k] "=&r" (k), [c] "=&r" (c)
+            : [cols] "r" (m->state), [n_ic] "r" ((pa_reg_x86) n_ic), [stride] "r" ((pa_reg_x86) (n_oc * sizeof(float)))
+            : "memory", "cc", "xmm0", "xmm1"
+        );
+
+        n = tail;
+    }
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc)
+        remap_frame_float32ne(m, dst, src);
+}
+
+/* The s16 matrix kernels put 2 frames of 4 or 4 frames of 2 output
+ * channels in a register. A coefficient is split into a signed 16 bit
+ * factor and a mask selecting the input sample itself, which is added
+ * to the high product. This gives the same (s * vol) >> 16 per input
+ * channel as the C code, and paddw wraps around just like it does. */
+static void remap_channels_matrix_ch4_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const unsigned n_ic = m->i_ss.channels;
+    pa_reg_x86 pairs = n / 2, k, c;
+
+    if (pairs > 0) {
+        __asm__ __volatile__ (
+            "1:                                     \n\t"
+            " pxor %%xmm0, %%xmm0                   \n\t"
+            " mov %[cols], %[c]                     \n\t"
+            " mov %[n_ic], %[k]                     \n\t"
+            "2:                                     \n\t"
+            " pinsrw $0, (%[src]), %%xmm1           \n\t"
+            " pinsrw $4, (%[src],%[stride]), %%xmm1 \n\t"
+            " pshuflw $0, %%xmm1, %%xmm1            \n\t"
+            " pshufhw $0, %%xmm1, %%xmm1            \n\t"
+            " movdqu (%[c]), %%xmm2                 \n\t" /* factors */
+            " movdqu 16(%[c]), %%xmm3               \n\t" /* masks */
+            " pand %%xmm1, %%xmm3                   \n\t"
+            " pmulhw %%xmm2, %%xmm1                 \n\t"
+            " paddw %%xmm3, %%xmm0                  \n\t"
+            " paddw %%xmm1, %%xmm0                  \n\t"
+            " add $2, %[src]                        \n\t"
+            " add $32, %[c]                         \n\t"
+            " dec %[k]                              \n\t"
+            " jne 2b                                \n\t"
+            " add %[stride], %[src]                 \n\t"
+            " movdqu %%xmm0, (%[dst])               \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[pairs]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [pairs] "+r" (pairs), [k] "=&r" (k), [c] "=&r" (c)
+            : [cols] "r" (m->state), [n_ic] "r" ((pa_reg_x86) n_ic), [stride] "r" ((pa_reg_x86) (n_ic * sizeof(int16_t)))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+    }
+
+    if (n & 1)
+        remap_frame_s16ne(m, dst, src);
+}
+
+static void remap_channels_matrix_ch2_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const unsigned n_ic = m->i_ss.channels;
+    pa_reg_x86 quads = n / 4, k, c;
+
+    if (quads > 0) {
+        __asm__ __volatile__ (
+            "1:                                     \n\t"
+            " pxor %%xmm0, %%xmm0                   \n\t"
+            " mov %[cols], %[c]                     \n\t"
+            " mov %[n_ic], %[k]                     \n\t"
+            "2:                                     \n\t"
+            " pinsrw $0, (%[src]), %%xmm1           \n\t"
+            " pinsrw $2, (%[src],%[stride]), %%xmm1 \n\t"
+            " pinsrw $4, (%[src],%[stride],2), %%xmm1 \n\t"
+            " pinsrw $6, (%[src],%[stride3]), %%xmm1 \n\t"
+            " pshuflw $0xa0, %%xmm1, %%xmm1         \n\t"
+            " pshufhw $0xa0, %%xmm1, %%xmm1         \n\t"
+            " movdqu (%[c]), %%xmm2                 \n\t" /* factors */
+            " movdqu 16(%[c]), %%xmm3               \n\t" /* masks */
+            " pand %%xmm1, %%xmm3                   \n\t"
+            " pmulhw %%xmm2, %%xmm1                 \n\t"
+            " paddw %%xmm3, %%xmm0                  \n\t"
+            " paddw %%xmm1, %%xmm0                  \n\t"
+            " add $2, %[src]                        \n\t"
+            " add $32, %[c]                         \n\t"
+            " dec %[k]                              \n\t"
+            " jne 2b                                \n\t"
+            " add %[stride3], %[src]                \n\t"
+            " movdqu %%xmm0, (%[dst])               \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[quads]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [quads] "+r" (quads), [k] "=&r" (k), [c] "=&r" (c)
+            : [cols] "r" (m->state), [n_ic] "r" ((pa_reg_x86) n_ic), [stride] "r" ((pa_reg_x86) (n_ic * sizeof(int16_t))),
+              [stride3] "r" ((pa_reg_x86) (3 * n_ic * sizeof(int16_t)))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+    }
+
+    for (n &= 3; n > 0; n--, src += n_ic, dst += 2)
+        remap_frame_s16ne(m, dst, src);
+}
+
+/* Downmixing s16 to stereo with SSSE3 takes frames of up to 8 channels
+ * in a register each, the way the float code does, and sums them up
+ * horizontally with phaddw. Four frames make one register of output. */
+#define S16_STEREO_TERMS(x)                                    \
+                " movdqa %%" x ", %%xmm4                \n\t"  \
+                " movdqa %%" x ", %%xmm5                \n\t"  \
+                " pand %%xmm9, %%xmm5                   \n\t"  \
+                " pmulhw %%xmm8, %%" x "                \n\t"  \
+                " paddw %%xmm5, %%" x "                 \n\t"  \
+                " movdqa %%xmm4, %%xmm5                 \n\t"  \
+                " pand %%xmm11, %%xmm5                  \n\t"  \
+                " pmulhw %%xmm10, %%xmm4                \n\t"  \
+                " paddw %%xmm5, %%xmm4                  \n\t"  \
+                " phaddw %%xmm4, %%" x "                \n\t" /* L pairs, R pairs */
+
+#define S16_STEREO_LOAD_COEF                                   \
+                " movdqu (%[coef]), %%xmm8              \n\t"  \
+                " movdqu 16(%[coef]), %%xmm9            \n\t"  \
+                " movdqu 32(%[coef]), %%xmm10           \n\t"  \
+                " movdqu 48(%[coef]), %%xmm11           \n\t"
+
+static void remap_ch4_to_stereo_s16ne_ssse3(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    pa_reg_x86 quads = n / 4;
+
+    if (quads > 0) {
+        __asm__ __volatile__ (
+            S16_STEREO_LOAD_COEF
+            "1:                                     \n\t"
+            " movdqu (%[src]), %%xmm0               \n\t"
+            " movdqu 16(%[src]), %%xmm1             \n\t"
+            S16_STEREO_TERMS("xmm0")
+            S16_STEREO_TERMS("xmm1")
+            " phaddw %%xmm1, %%xmm0                 \n\t" /* L0 L1 R0 R1 L2 L3 R2 R3 */
+            " pshuflw $0xd8, %%xmm0, %%xmm0         \n\t"
+            " pshufhw $0xd8, %%xmm0, %%xmm0         \n\t"
+            " movdqu %%xmm0, (%[dst])               \n\t"
+            " add $32, %[src]                       \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[quads]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [quads] "+r" (quads)
+            : [coef] "r" (m->state)
+            : "memory", "cc", "xmm0", "xmm1", "xmm4", "xmm5", "xmm8", "xmm9", "xmm10", "xmm11"
+        );
+    }
+
+    for (n &= 3; n > 0; n--, src += 4, dst += 2)
+        remap_frame_s16ne(m, dst, src);
+}
+
+/* Four 5.1 frames are three registers. The frames are shifted into
+ * registers of their own, the two channels beyond the frame have
+ * coefficients of 0. */
+static void remap_ch6_to_stereo_s16ne_ssse3(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    pa_reg_x86 quads = n / 4;
+
+    if (quads > 0) {
+        __asm__ __volatile__ (
+            S16_STEREO_LOAD_COEF
+            "1:                                     \n\t"
+            " movdqu (%[src]), %%xmm0               \n\t"
+            " movdqu 16(%[src]), %%xmm1             \n\t"
+            " movdqu 32(%[src]), %%xmm3             \n\t"
+            " movdqa %%xmm3, %%xmm2                 \n\t"
+            " palignr $8, %%xmm1, %%xmm2            \n\t" /* frame 2 */
+            " palignr $12, %%xmm0, %%xmm1           \n\t" /* frame 1 */
+            " psrldq $4, %%xmm3                     \n\t" /* frame 3 */
+            S16_STEREO_TERMS("xmm0")
+            S16_STEREO_TERMS("xmm1")
+            S16_STEREO_TERMS("xmm2")
+            S16_STEREO_TERMS("xmm3")
+            " phaddw %%xmm1, %%xmm0                 \n\t"
+            " phaddw %%xmm3, %%xmm2                 \n\t"
+            " phaddw %%xmm2, %%xmm0                 \n\t" /* L0 R0 L1 R1 L2 R2 L3 R3 */
+            " movdqu %%xmm0, (%[dst])               \n\t"
+            " add $48, %[src]                       \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[quads]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [quads] "+r" (quads)
+            : [coef] "r" (m->state)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+              "xmm8", "xmm9", "xmm10", "xmm11"
+        );
+    }
+
+    for (n &= 3; n > 0; n--, src += 6, dst += 2)
+        remap_frame_s16ne(m, dst, src);
+}
+
+static void remap_ch8_to_stereo_s16ne_ssse3(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    pa_reg_x86 quads = n / 4;
+
+    if (quads > 0) {
+        __asm__ __volatile__ (
+            S16_STEREO_LOAD_COEF
+            "1:                                     \n\t"
+            " movdqu (%[src]), %%xmm0               \n\t"
+            " movdqu 16(%[src]), %%xmm1             \n\t"
+            " movdqu 32(%[src]), %%xmm2             \n\t"
+            " movdqu 48(%[src]), %%xmm3             \n\t"
+            S16_STEREO_TERMS("xmm0")
+            S16_STEREO_TERMS("xmm1")
+            S16_STEREO_TERMS("xmm2")
+            S16_STEREO_TERMS("xmm3")
+            " phaddw %%xmm1, %%xmm0                 \n\t"
+            " phaddw %%xmm3, %%xmm2                 \n\t"
+            " phaddw %%xmm2, %%xmm0                 \n\t" /* L0 R0 L1 R1 L2 R2 L3 R3 */
+            " movdqu %%xmm0, (%[dst])               \n\t"
+            " add $64, %[src]                       \n\t"
+            " add $16, %[dst]                       \n\t"
+            " dec %[quads]                          \n\t"
+            " jne 1b                                \n\t"
+            : [dst] "+r" (dst), [src] "+r" (src), [quads] "+r" (quads)
+            : [coef] "r" (m->state)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+              "xmm8", "xmm9", "xmm10", "xmm11"
+        );
+    }
+
+    for (n &= 3; n > 0; n--, src += 8, dst += 2)
+        remap_frame_s16ne(m, dst, src);
+}
+
+static float clamp_float_coef(pa_remap_t *m, unsigned oc, unsigned ic) {
+    return PA_CLAMP_UNLIKELY(m->map_table_f[oc][ic], 0.0f, 1.0f);
+}
+
+/* Matrix columns, one per input channel, with the output channels
+ * repeated to fill a register of the given number of lanes */
+static void *setup_columns_float(pa_remap_t *m, unsigned lanes) {
+    float *cols = pa_xnew0(float, PA_CHANNELS_MAX * lanes);
+    unsigned ic, l;
+
+    for (ic = 0; ic < m->i_ss.channels; ic++)
+        for (l = 0; l < lanes && l < m->o_ss.channels; l++)
+            cols[ic * lanes + l] = clamp_float_coef(m, l, ic);
+
+    return cols;
+}
+
+/* Splits an s16 coefficient into the factor for pmulhw and the mask for
+ * the input sample, see above */
+static void split_s16_coef(int32_t vol, int16_t *factor, int16_t *mask) {
+    *factor = *mask = 0;
+
+    if (vol <= 0)
+        return;
+
+    if (vol >= 0x10000)
+        *mask = -1;
+    else if (vol >= 0x8000) {
+        *factor = (int16_t) (vol - 0x10000);
+        *mask = -1;
+    } else
+        *factor = (int16_t) vol;
+}
+
+static void *setup_columns_s16(pa_remap_t *m) {
+    int16_t *cols = pa_xnew0(int16_t, PA_CHANNELS_MAX * 16);
+    unsigned ic, l;
+
+    for (ic = 0; ic < m->i_ss.channels; ic++)
+        for (l = 0; l < 8; l++)
+            split_s16_coef(m->map_table_i[l % m->o_ss.channels][ic], &cols[ic * 16 + l], &cols[ic * 16 + 8 + l]);
+
+    return cols;
+}
+
+/* Left factors and masks, then right ones, for one register of input.
+ * With 4 channels it holds two frames, with more the lanes beyond the
+ * frame are left at 0. */
+static void *setup_stereo_s16(pa_remap_t *m) {
+    const unsigned n_ic = m->i_ss.channels;
+    int16_t *coef = pa_xnew0(int16_t, 32);
+    unsigned l;
+
+    for (l = 0; l < 8; l++) {
+        if (n_ic != 4 && l >= n_ic)
+            continue;
+
+        split_s16_coef(m->map_table_i[0][l % n_ic], &coef[l], &coef[8 + l]);
+        split_s16_coef(m->map_table_i[1][l % n_ic], &coef[16 + l], &coef[24 + l]);
+    }
+
+    return coef;
+}
+
+/* Left and right coefficients for 4 samples each, in the order the
+ * samples of two consecutive frames appear in the registers */
+static void *setup_stereo_sse3(pa_remap_t *m) {
+    const unsigned n_ic = m->i_ss.channels;
+    float *coef = pa_xnew0(float, 32);
+    unsigned j, l;
+
+    for (j = 0; j < n_ic / 2; j++) {
+        for (l = 0; l < 4; l++) {
+            coef[j * 8 + l] = clamp_float_coef(m, 0, (j * 4 + l) % n_ic);
+            coef[j * 8 + 4 + l] = clamp_float_coef(m, 1, (j * 4 + l) % n_ic);
+        }
+    }
+
+    return coef;
+}
+
+static void *setup_stereo_avx(pa_remap_t *m) {
+    float *coef = pa_xnew0(float, 24);
+    uint32_t *mask = (uint32_t *) (coef + 16);
+    unsigned ic;
+
+    for (ic = 0; ic < m->i_ss.channels; ic++) {
+        coef[ic] = clamp_float_coef(m, 0, ic);
+        coef[8 + ic] = clamp_float_coef(m, 1, ic);
+        mask[ic] = 0xffffffff;
+    }
+
+    return coef;
+}
+
+static pa_cpu_x86_flag_t x86_flags;
+
+static void init_remap_matrix_float32ne(pa_remap_t *m) {
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+
+    if (n_oc == 2 && n_ic >= 3 && (x86_flags & PA_CPU_X86_AVX)) {
+        pa_log_info("Using AVX %u-channel to stereo remapping", n_ic);
+        m->do_remap = (pa_do_remap_func_t) remap_to_stereo_float32ne_avx;
+        m->state = setup_stereo_avx(m);
+    } else if (n_oc == 2 && (n_ic == 4 || n_ic == 6 || n_ic == 8) && (x86_flags & PA_CPU_X86_SSE3)) {
+        pa_log_info("Using SSE3 %u-channel to stereo remapping", n_ic);
+        if (n_ic == 4)
+            m->do_remap = (pa_do_remap_func_t) remap_ch4_to_stereo_float32ne_sse3;
+        else if (n_ic == 6)
+            m->do_remap = (pa_do_remap_func_t) remap_ch6_to_stereo_float32ne_sse3;
+        else
+            m->do_remap = (pa_do_remap_func_t) remap_ch8_to_stereo_float32ne_sse3;
+        m->state = setup_stereo_sse3(m);
+    } else if (n_oc > 4 && (x86_flags & PA_CPU_X86_AVX)) {
+        pa_log_info("Using AVX matrix remapping");
+        m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_float32ne_avx;
+        m->state = setup_columns_float(m, 8);
+    } else if (n_oc <= 4) {
+        pa_log_info("Using SSE2 matrix remapping");
+        m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_float32ne_sse2;
+        m->state = setup_columns_float(m, 4);
+    }
+}
+
+static void init_remap_matrix_s16ne(pa_remap_t *m) {
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+
+    if (n_oc == 2 && (n_ic == 4 || n_ic == 6 || n_ic == 8) && (x86_flags & PA_CPU_X86_SSSE3)) {
+        pa_log_info("Using SSSE3 %u-channel to stereo remapping", n_ic);
+        if (n_ic == 4)
+            m->do_remap = (pa_do_remap_func_t) remap_ch4_to_stereo_s16ne_ssse3;
+        else if (n_ic == 6)
+            m->do_remap = (pa_do_remap_func_t) remap_ch6_to_stereo_s16ne_ssse3;
+        else
+            m->do_remap = (pa_do_remap_func_t) remap_ch8_to_stereo_s16ne_ssse3;
+        m->state = setup_stereo_s16(m);
+    } else if (n_oc == 2) {
+        pa_log_info("Using SSE2 matrix remapping to stereo");
+        m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_ch2_s16ne_sse2;
+        m->state = setup_columns_s16(m);
+    } else if (n_oc == 4) {
+        pa_log_info("Using SSE2 matrix remapping to 4 channels");
+        m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_ch4_s16ne_sse2;
+        m->state = setup_columns_s16(m);
+    }
+}
+#endif /* defined (__amd64__) */
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
+#if defined (__amd64__)
+    int8_t arrange[PA_CHANNELS_MAX];
+#endif
 
     n_oc = m->o_ss.channels;
     n_ic = m->i_ss.channels;
@@ -136,6 +807,23 @@ static void init_remap_sse2(pa_remap_t *m) {
         pa_set_remap_func(m, (pa_do_remap_func_t) remap_mono_to_stereo_s16ne_sse2,
             (pa_do_remap_func_t) remap_mono_to_stereo_float32ne_sse2);
     }
+#if defined (__amd64__)
+    /* mixing from or to mono and plain rearranging are left to the C code */
+    else if (n_ic >= 2 && n_ic <= 8 && n_oc >= 2 && n_oc <= 8 &&
+            !pa_setup_remap_arrange(m, arrange)) {
+
+        switch (m->format) {
+        case PA_SAMPLE_S16NE:
+            init_remap_matrix_s16ne(m);
+            break;
+        case PA_SAMPLE_FLOAT32NE:
+            init_remap_matrix_float32ne(m);
+            break;
+        default:
+            pa_assert_not_reached();
+        }
+    }
+#endif
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
 
@@ -144,6 +832,9 @@ void pa_remap_func_init_sse(pa_cpu_x86_flag_t flags) {
 
     if (flags & PA_CPU_X86_SSE2) {
         pa_log_info("Initialising SSE2 optimized remappers.");
+#if defined (__amd64__)
+        x86_flags = flags;
+#endif
         pa_set_init_remap_func ((pa_init_remap_func_t) init_remap_sse2);
     }
 
@@ -0,0 +1,90 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/macro.h>
+
+#include "render-profile.h"
+
+static pa_atomic_t enabled = PA_ATOMIC_INIT(0);
+
+static uint64_t now_nsec(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (uint64_t) ts.tv_sec * PA_NSEC_PER_SEC + (uint64_t) ts.tv_nsec;
+#endif
+
+    return pa_rtclock_now() * PA_NSEC_PER_USEC;
+}
+
+void pa_render_profile_set_enabled(bool b) {
+    pa_atomic_store(&enabled, b);
+}
+
+bool pa_render_profile_enabled(void) {
+    return pa_atomic_load(&enabled);
+}
+
+uint64_t pa_render_profile_start(void) {
+    if (PA_LIKELY(!pa_atomic_load(&enabled)))
+        return 0;
+
+    return now_nsec();
+}
+
+void pa_render_profile_stop(pa_render_profile *p, uint64_t start) {
+    uint64_t d;
+
+    pa_assert(p);
+
+    if (PA_LIKELY(start == 0))
+        return;
+
+    d = now_nsec() - start;
+
+    pa_atomic_inc(&p->seq);
+
+    p->data.count++;
+    p->data.total_nsec += d;
+
+    if (d > p->data.max_nsec)
+        p->data.max_nsec = d;
+
+    pa_atomic_inc(&p->seq);
+}
+
+void pa_render_profile_get(pa_render_profile *p, pa_render_profile_data *data) {
+    int seq;
+
+    pa_assert(p);
+    pa_assert(data);
+
+    do {
+        seq = pa_atomic_load(&p->seq);
+        *data = p->data;
+    } while ((seq & 1) || seq != pa_atomic_load(&p->seq));
+}
@@ -0,0 +1,53 @@
+#ifndef foorenderprofilehfoo
+#define foorenderprofilehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/atomic.h>
+
+/* Optional accounting of the time spent in the render path. Each counter
+ * is only updated from one thread, usually an IO thread, and can be read
+ * from any other thread without locking: the writer makes seq odd while
+ * it updates the values, and readers retry until they get a stable copy.
+ *
+ * Measuring is off by default. While it is off, pa_render_profile_start()
+ * returns 0 and pa_render_profile_stop() ignores that. */
+
+typedef struct pa_render_profile_data {
+    uint64_t count;
+    uint64_t total_nsec;
+    uint64_t max_nsec;
+} pa_render_profile_data;
+
+typedef struct pa_render_profile {
+    pa_atomic_t seq;
+    pa_render_profile_data data;
+} pa_render_profile;
+
+void pa_render_profile_set_enabled(bool enabled);
+bool pa_render_profile_enabled(void);
+
+uint64_t pa_render_profile_start(void);
+void pa_render_profile_stop(pa_render_profile *p, uint64_t start);
+
+/* Called from any thread */
+void pa_render_profile_get(pa_render_profile *p, pa_render_profile_data *data);
+
+#endif
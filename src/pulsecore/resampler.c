@@ -22,6 +22,7 @@
 #endif
 
 #include <string.h>
+#include <math.h>
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
@@ -34,6 +35,10 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Size of the largest intermediate buffer for one tile. With all stages
+ * together this should stay well within the L2 cache. */
+#define TILE_SIZE (16 * 1024)
+
 struct ffmpeg_data { /* data specific to ffmpeg */
     struct AVResampleContext *state;
 };
@@ -42,6 +47,7 @@ static int copy_init(pa_resampler *r);
 
 static void setup_remap(const pa_resampler *r, pa_remap_t *m, bool *lfe_remixed);
 static void free_remap(pa_remap_t *m);
+static void setup_fused_stages(pa_resampler *r);
 
 static int (* const init_table[])(pa_resampler *r) = {
 #ifdef HAVE_LIBSAMPLERATE
@@ -118,6 +124,7 @@ static int (* const init_table[])(pa_resampler *r) = {
     [PA_RESAMPLER_SOXR_HQ]                 = NULL,
     [PA_RESAMPLER_SOXR_VHQ]                = NULL,
 #endif
+    [PA_RESAMPLER_POLYPHASE]               = pa_resampler_polyphase_init,
 };
 
 static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
@@ -380,6 +387,9 @@ pa_resampler* pa_resampler_new(
         if (r->work_format == PA_SAMPLE_FLOAT32NE) {
             if (!(r->from_work_format_func = pa_get_convert_from_float32ne_function(r->o_ss.format)))
                 goto fail;
+
+            if (!r->map_required)
+                r->from_work_volume_func = pa_get_volume_from_float32ne_func(r->o_ss.format);
         } else {
             pa_assert(r->work_format == PA_SAMPLE_S16NE);
             if (!(r->from_work_format_func = pa_get_convert_from_s16ne_function(r->o_ss.format)))
@@ -428,6 +438,8 @@ pa_resampler* pa_resampler_new(
     if (init_table[method](r) < 0)
         goto fail;
 
+    setup_fused_stages(r);
+
     return r;
 
 fail:
@@ -600,6 +612,38 @@ pa_resample_method_t pa_resampler_get_method(pa_resampler *r) {
     return r->method;
 }
 
+pa_resample_flags_t pa_resampler_get_flags(pa_resampler *r) {
+    pa_assert(r);
+
+    return r->flags;
+}
+
+bool pa_resampler_set_volume(pa_resampler *r, const pa_cvolume *volume) {
+    unsigned c;
+
+    pa_assert(r);
+
+    if (!volume) {
+        r->have_volume = false;
+        return true;
+    }
+
+    if (!r->from_work_volume_func)
+        return false;
+
+    pa_assert(volume->channels == r->o_ss.channels);
+
+    for (c = 0; c < volume->channels; c++)
+        r->volume[c] = (float) pa_sw_volume_to_linear(volume->values[c]);
+
+    for (; c < volume->channels + (unsigned) PA_VOLUME_PADDING; c++)
+        r->volume[c] = r->volume[c - volume->channels];
+
+    r->have_volume = true;
+
+    return true;
+}
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r) {
     pa_assert(r);
 
@@ -659,7 +703,8 @@ static const char * const resample_methods[] = {
     "peaks",
     "soxr-mq",
     "soxr-hq",
-    "soxr-vhq"
+    "soxr-vhq",
+    "polyphase"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -1169,6 +1214,120 @@ static void free_remap(pa_remap_t *m) {
     pa_xfree(m->state);
 }
 
+/*** fused stages ***/
+
+static void s16ne_to_float32ne_arrange(const int8_t *arrange, unsigned n_ic, unsigned n_oc, unsigned n_frames,
+                                       const int16_t *src, float *dst) {
+    unsigned oc;
+
+    for (; n_frames > 0; n_frames--, src += n_ic)
+        for (oc = 0; oc < n_oc; oc++)
+            *(dst++) = arrange[oc] >= 0 ? src[arrange[oc]] * (1.0f / (1 << 15)) : 0.0f;
+}
+
+static void s32ne_to_float32ne_arrange(const int8_t *arrange, unsigned n_ic, unsigned n_oc, unsigned n_frames,
+                                       const int32_t *src, float *dst) {
+    unsigned oc;
+
+    for (; n_frames > 0; n_frames--, src += n_ic)
+        for (oc = 0; oc < n_oc; oc++)
+            *(dst++) = arrange[oc] >= 0 ? src[arrange[oc]] * (1.0f / (1U << 31)) : 0.0f;
+}
+
+static void float32ne_to_s16ne_arrange(const int8_t *arrange, unsigned n_ic, unsigned n_oc, unsigned n_frames,
+                                       const float *src, int16_t *dst) {
+    unsigned oc;
+
+    for (; n_frames > 0; n_frames--, src += n_ic)
+        for (oc = 0; oc < n_oc; oc++) {
+            float v = arrange[oc] >= 0 ? src[arrange[oc]] * (1 << 15) : 0.0f;
+
+            *(dst++) = (int16_t) PA_CLAMP_UNLIKELY(lrintf(v), -0x8000, 0x7FFF);
+        }
+}
+
+static void float32ne_to_s32ne_arrange(const int8_t *arrange, unsigned n_ic, unsigned n_oc, unsigned n_frames,
+                                       const float *src, int32_t *dst) {
+    unsigned oc;
+
+    for (; n_frames > 0; n_frames--, src += n_ic)
+        for (oc = 0; oc < n_oc; oc++) {
+            float v = arrange[oc] >= 0 ? src[arrange[oc]] * (1U << 31) : 0.0f;
+
+            *(dst++) = (int32_t) PA_CLAMP_UNLIKELY(llrintf(v), -0x80000000LL, 0x7FFFFFFFLL);
+        }
+}
+
+static pa_convert_arrange_func_t get_to_float32ne_arrange_func(pa_sample_format_t f) {
+    switch (f) {
+        case PA_SAMPLE_S16NE:
+            return (pa_convert_arrange_func_t) s16ne_to_float32ne_arrange;
+        case PA_SAMPLE_S32NE:
+            return (pa_convert_arrange_func_t) s32ne_to_float32ne_arrange;
+        default:
+            return NULL;
+    }
+}
+
+static pa_convert_arrange_func_t get_from_float32ne_arrange_func(pa_sample_format_t f) {
+    switch (f) {
+        case PA_SAMPLE_S16NE:
+            return (pa_convert_arrange_func_t) float32ne_to_s16ne_arrange;
+        case PA_SAMPLE_S32NE:
+            return (pa_convert_arrange_func_t) float32ne_to_s32ne_arrange;
+        default:
+            return NULL;
+    }
+}
+
+/* Merges remapping into the format conversion next to it, where possible,
+ * and decides whether running the stages in tiles is worthwhile */
+static void setup_fused_stages(pa_resampler *r) {
+    unsigned n_stages = 0, max_channels;
+    size_t max_fz;
+
+    pa_assert(r);
+
+    if (r->map_required && r->work_format == PA_SAMPLE_FLOAT32NE && !r->lfe_filter &&
+        pa_setup_remap_arrange(&r->remap, r->arrange)) {
+
+        /* The remapping is next to the conversion that has the fewer
+         * channels, see pa_resampler_new() */
+        if (r->o_ss.channels <= r->i_ss.channels && r->to_work_format_func)
+            r->to_work_arrange_func = get_to_float32ne_arrange_func(r->i_ss.format);
+        else if (r->o_ss.channels > r->i_ss.channels && r->from_work_format_func)
+            r->from_work_arrange_func = get_from_float32ne_arrange_func(r->o_ss.format);
+
+        if (r->to_work_arrange_func || r->from_work_arrange_func)
+            pa_log_debug("  format conversion and channel arrangement fused");
+    }
+
+    if (r->to_work_format_func)
+        n_stages++;
+    if (r->map_required)
+        n_stages++;
+    if (r->impl.resample)
+        n_stages++;
+    if (r->from_work_format_func)
+        n_stages++;
+    if (r->to_work_arrange_func || r->from_work_arrange_func)
+        n_stages--;
+
+    /* With a single stage, the data goes through memory only once anyway */
+    if (n_stages < 2)
+        return;
+
+    max_channels = PA_MAX(r->i_ss.channels, r->o_ss.channels);
+    max_fz = PA_MAX(r->i_fz, r->o_fz);
+    max_fz = PA_MAX(max_fz, r->w_sz * max_channels);
+
+    /* Upsampling makes the buffers after the resampling stage larger */
+    if (r->impl.resample && r->o_ss.rate > r->i_ss.rate)
+        max_fz = max_fz * ((r->o_ss.rate + r->i_ss.rate - 1) / r->i_ss.rate);
+
+    r->tile_frames = PA_MAX(TILE_SIZE / max_fz, 1U);
+}
+
 /* check if buf's memblock is large enough to hold 'len' bytes; create a
  * new memblock if necessary and optionally preserve 'copy' data bytes */
 static void fit_buf(pa_resampler *r, pa_memchunk *buf, size_t len, size_t *size, size_t copy) {
@@ -1197,6 +1356,45 @@ static void fit_buf(pa_resampler *r, pa_memchunk *buf, size_t len, size_t *size,
     buf->length = len;
 }
 
+static pa_memchunk *convert_arrange_to_work_format(pa_resampler *r, pa_memchunk *input) {
+    unsigned in_n_frames, out_n_frames;
+    void *src, *dst;
+    size_t leftover_length = 0;
+    bool have_leftover;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(input->memblock);
+
+    /* Fused variant of convert_to_work_format() and remap_channels(). The
+     * result goes to remap_buf, behind the leftover data. */
+
+    have_leftover = r->leftover_in_remap;
+    r->leftover_in_remap = false;
+
+    if (input->length <= 0)
+        return have_leftover ? &r->remap_buf : input;
+
+    in_n_frames = out_n_frames = (unsigned) (input->length / r->i_fz);
+
+    if (have_leftover) {
+        leftover_length = r->remap_buf.length;
+        out_n_frames += leftover_length / r->w_fz;
+    }
+
+    fit_buf(r, &r->remap_buf, out_n_frames * r->w_fz, &r->remap_buf_size, leftover_length);
+
+    src = pa_memblock_acquire_chunk(input);
+    dst = (uint8_t *) pa_memblock_acquire(r->remap_buf.memblock) + leftover_length;
+
+    r->to_work_arrange_func(r->arrange, r->i_ss.channels, r->o_ss.channels, in_n_frames, src, dst);
+
+    pa_memblock_release(input->memblock);
+    pa_memblock_release(r->remap_buf.memblock);
+
+    return &r->remap_buf;
+}
+
 static pa_memchunk* convert_to_work_format(pa_resampler *r, pa_memchunk *input) {
     unsigned in_n_samples, out_n_samples;
     void *src, *dst;
@@ -1338,8 +1536,30 @@ static pa_memchunk *resample(pa_resampler *r, pa_memchunk *input) {
     return &r->resample_buf;
 }
 
+/* Number of frames in a chunk that is ready for the last stage */
+static unsigned work_frames(pa_resampler *r, const pa_memchunk *chunk) {
+    unsigned channels;
+
+    /* If the remapping is fused into the last stage, it hasn't been done
+     * yet */
+    channels = r->from_work_arrange_func ? r->i_ss.channels : r->o_ss.channels;
+
+    return (unsigned) (chunk->length / (r->w_sz * channels));
+}
+
+static void from_work_format(pa_resampler *r, unsigned n_frames, const void *src, void *dst) {
+    if (r->from_work_arrange_func)
+        r->from_work_arrange_func(r->arrange, r->i_ss.channels, r->o_ss.channels, n_frames, src, dst);
+    else if (r->have_volume)
+        r->from_work_volume_func(n_frames * r->o_ss.channels, src, dst, r->volume, r->o_ss.channels);
+    else if (r->from_work_format_func)
+        r->from_work_format_func(n_frames * r->o_ss.channels, src, dst);
+    else
+        memcpy(dst, src, n_frames * r->o_fz);
+}
+
 static pa_memchunk *convert_from_work_format(pa_resampler *r, pa_memchunk *input) {
-    unsigned n_samples, n_frames;
+    unsigned n_frames;
     void *src, *dst;
 
     pa_assert(r);
@@ -1351,45 +1571,107 @@ static pa_memchunk *convert_from_work_format(pa_resampler *r, pa_memchunk *input
     if (!r->from_work_format_func || !input->length)
         return input;
 
-    n_samples = (unsigned) (input->length / r->w_sz);
-    n_frames = n_samples / r->o_ss.channels;
+    n_frames = work_frames(r, input);
     fit_buf(r, &r->from_work_format_buf, r->o_fz * n_frames, &r->from_work_format_buf_size, 0);
 
     src = pa_memblock_acquire_chunk(input);
     dst = pa_memblock_acquire(r->from_work_format_buf.memblock);
-    r->from_work_format_func(n_samples, src, dst);
+    from_work_format(r, n_frames, src, dst);
     pa_memblock_release(input->memblock);
     pa_memblock_release(r->from_work_format_buf.memblock);
 
     return &r->from_work_format_buf;
 }
 
-void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
-    pa_memchunk *buf;
-
+/* Runs all stages but the last format conversion */
+static pa_memchunk *run_stages(pa_resampler *r, pa_memchunk *buf) {
     pa_assert(r);
-    pa_assert(in);
-    pa_assert(out);
-    pa_assert(in->length);
-    pa_assert(in->memblock);
-    pa_assert(in->length % r->i_fz == 0);
-
-    buf = (pa_memchunk*) in;
-    buf = convert_to_work_format(r, buf);
+    pa_assert(buf);
 
     /* Try to save resampling effort: if we have more output channels than
      * input channels, do resampling first, then remapping. */
     if (r->o_ss.channels <= r->i_ss.channels) {
-        buf = remap_channels(r, buf);
+        if (r->to_work_arrange_func)
+            buf = convert_arrange_to_work_format(r, buf);
+        else {
+            buf = convert_to_work_format(r, buf);
+            buf = remap_channels(r, buf);
+        }
         buf = resample(r, buf);
     } else {
+        buf = convert_to_work_format(r, buf);
         buf = resample(r, buf);
-        buf = remap_channels(r, buf);
+        if (!r->from_work_arrange_func)
+            buf = remap_channels(r, buf);
     }
 
     if (r->lfe_filter)
         buf = pa_lfe_filter_process(r->lfe_filter, buf);
 
+    return buf;
+}
+
+/* Runs the input through all stages one tile at a time, so that only the
+ * input and the final output go through memory in full */
+static void run_tiled(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
+    size_t tile_size, offset, length = 0;
+    pa_memchunk tile;
+
+    tile_size = r->tile_frames * r->i_fz;
+
+    fit_buf(r, &r->from_work_format_buf, pa_resampler_result(r, in->length) + EXTRA_FRAMES * r->o_fz,
+            &r->from_work_format_buf_size, 0);
+
+    for (offset = 0; offset < in->length; offset += tile.length) {
+        pa_memchunk *buf;
+        unsigned n_frames;
+        void *src, *dst;
+
+        tile.memblock = in->memblock;
+        tile.index = in->index + offset;
+        tile.length = PA_MIN(tile_size, in->length - offset);
+
+        buf = run_stages(r, &tile);
+        if (!buf->length)
+            continue;
+
+        n_frames = work_frames(r, buf);
+        fit_buf(r, &r->from_work_format_buf, length + n_frames * r->o_fz, &r->from_work_format_buf_size, length);
+
+        src = pa_memblock_acquire_chunk(buf);
+        dst = (uint8_t *) pa_memblock_acquire(r->from_work_format_buf.memblock) + length;
+        from_work_format(r, n_frames, src, dst);
+        pa_memblock_release(buf->memblock);
+        pa_memblock_release(r->from_work_format_buf.memblock);
+
+        length += n_frames * r->o_fz;
+    }
+
+    if (length) {
+        r->from_work_format_buf.length = length;
+        *out = r->from_work_format_buf;
+        pa_memchunk_reset(&r->from_work_format_buf);
+    } else
+        pa_memchunk_reset(out);
+}
+
+void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
+    pa_memchunk *buf;
+
+    pa_assert(r);
+    pa_assert(in);
+    pa_assert(out);
+    pa_assert(in->length);
+    pa_assert(in->memblock);
+    pa_assert(in->length % r->i_fz == 0);
+
+    if (r->tile_frames && in->length > r->tile_frames * r->i_fz) {
+        run_tiled(r, in, out);
+        return;
+    }
+
+    buf = run_stages(r, (pa_memchunk*) in);
+
     if (buf->length) {
         buf = convert_from_work_format(r, buf);
         *out = *buf;
@@ -25,12 +25,18 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/sconv.h>
+#include <pulsecore/sample-util.h>
 #include <pulsecore/remap.h>
 #include <pulsecore/filter/lfe-filter.h>
 
 typedef struct pa_resampler pa_resampler;
 typedef struct pa_resampler_impl pa_resampler_impl;
 
+/* Converts between formats and rearranges channels in one go. arrange has an
+ * entry for each output channel, see pa_setup_remap_arrange(). */
+typedef void (*pa_convert_arrange_func_t) (const int8_t *arrange, unsigned n_ic, unsigned n_oc, unsigned n_frames,
+                                           const void *src, void *dst);
+
 struct pa_resampler_impl {
     void (*free)(pa_resampler *r);
     void (*update_rates)(pa_resampler *r);
@@ -61,6 +67,7 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_SOXR_MQ,
     PA_RESAMPLER_SOXR_HQ,
     PA_RESAMPLER_SOXR_VHQ,
+    PA_RESAMPLER_POLYPHASE,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -107,6 +114,23 @@ struct pa_resampler {
     pa_remap_t remap;
     bool map_required;
 
+    /* If remapping only rearranges channels, it is done together with the
+     * format conversion next to it */
+    pa_convert_arrange_func_t to_work_arrange_func;
+    pa_convert_arrange_func_t from_work_arrange_func;
+    int8_t arrange[PA_CHANNELS_MAX];
+
+    /* Volume applied while converting from the work format, see
+     * pa_resampler_set_volume() */
+    pa_do_volume_from_float32ne_func_t from_work_volume_func;
+    bool have_volume;
+    float volume[PA_CHANNELS_MAX + PA_VOLUME_PADDING];
+
+    /* Large inputs are run through all stages in tiles of this many frames,
+     * so that the intermediate buffers stay in the cache. 0 if there is
+     * nothing to gain. */
+    unsigned tile_frames;
+
     pa_lfe_filter_t *lfe_filter;
 
     pa_resampler_impl impl;
@@ -151,6 +175,16 @@ void pa_resampler_rewind(pa_resampler *r, size_t out_frames);
 /* Return the resampling method of the resampler object */
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r);
 
+/* Return the flags the resampler object was created with */
+pa_resample_flags_t pa_resampler_get_flags(pa_resampler *r);
+
+/* Makes the resampler apply the volume to its output while converting it
+ * from float32, which saves a pass over the data. This is only possible if
+ * the resampler doesn't remap the channels, so the volume may be given for
+ * the input channels just as well. Returns false if the resampler can't do
+ * it. Pass NULL to remove the volume again. */
+bool pa_resampler_set_volume(pa_resampler *r, const pa_cvolume *volume);
+
 /* Try to parse the resampler method */
 pa_resample_method_t pa_parse_resample_method(const char *string);
 
@@ -172,6 +206,14 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_polyphase_init(pa_resampler *r);
+
+/* Inner product of the taps of one polyphase filter phase and the input
+ * samples. n is a multiple of 8 and taps are aligned to 32 bytes. */
+typedef float (*pa_polyphase_dot_func_t) (const float *taps, const float *samples, unsigned n);
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void);
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
@@ -0,0 +1,495 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/resampler.h>
+
+/* A polyphase FIR resampler. The filter is a Kaiser windowed sinc, split
+ * into one set of taps ("phase") for each position between two input
+ * samples that an output sample can fall on. For fixed rates with a small
+ * enough ratio, e.g. 44.1 <-> 48 kHz, there is exactly one phase for each
+ * position. Otherwise, and always for variable rate, a bank of
+ * INTERP_PHASES phases is used and the outputs of the two neighbouring
+ * phases are interpolated linearly.
+ *
+ * Filter banks only depend on the rate ratio, so they are shared by all
+ * resamplers in the process. Variable rate resamplers keep the bank they
+ * start with, so that no filter is designed in the IO thread when the
+ * rate changes. */
+
+/* Taps per phase when upsampling. When downsampling, the filter gets
+ * longer by the downsampling factor to keep the same transition band
+ * relative to the output rate. */
+#define BASE_TAPS 32
+
+/* Has to be a multiple of what the dot product functions process at a
+ * time */
+#define TAPS_ALIGN 8
+
+#define KAISER_BETA 7.0
+
+/* Cutoff relative to the Nyquist frequency of the lower rate */
+#define CUTOFF 0.91
+
+#define MAX_EXACT_PHASES 1024
+#define INTERP_PHASES 256
+
+/* For interpolated banks, the downsampling factor that determines the
+ * cutoff is rounded down to a multiple of 1/RATIO_STEPS, so that similar
+ * ratios share a bank */
+#define RATIO_STEPS 64
+
+/* Variable rate banks are designed for a ratio this much lower than the
+ * initial one, leaving room for the rate to drift without aliasing */
+#define VARIABLE_RATE_MARGIN 0.98
+
+struct polyphase_bank {
+    unsigned n_phases;
+    unsigned n_taps;
+    /* The rate ratio the cutoff is designed for, out/in */
+    unsigned ratio_num, ratio_den;
+    bool interpolate;
+
+    unsigned ref;
+
+    void *allocation;
+    float *taps; /* n_taps * (n_phases + 1) coefficients, rows are aligned */
+
+    PA_LLIST_FIELDS(struct polyphase_bank);
+};
+
+struct polyphase_data {
+    struct polyphase_bank *bank;
+
+    /* Output sample n is at input position l_step * n / m_step */
+    unsigned l_step, m_step;
+    unsigned m_int, m_frac;
+
+    /* Position of the next output sample, relative to the start of the
+     * channel buffers. The filter starts at in_index, the output sample
+     * falls on in_index + center + phase / l_step. */
+    unsigned in_index;
+    unsigned phase;
+    unsigned center;
+
+    /* Deinterleaved input, one buffer per channel */
+    float *buf[PA_CHANNELS_MAX];
+    unsigned buf_frames;
+    unsigned buf_size;
+};
+
+static PA_LLIST_HEAD(struct polyphase_bank, banks) = NULL;
+static pa_static_mutex banks_mutex = PA_STATIC_MUTEX_INIT;
+
+/*** SIMD dispatch ***/
+
+static float dot_c(const float *taps, const float *samples, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    for (; n > 0; n -= 4, taps += 4, samples += 4) {
+        s0 += taps[0] * samples[0];
+        s1 += taps[1] * samples[1];
+        s2 += taps[2] * samples[2];
+        s3 += taps[3] * samples[3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static pa_polyphase_dot_func_t dot_func = dot_c;
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+/*** filter design ***/
+
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    unsigned k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+/* The windowed sinc at t input samples from its center. cutoff is
+ * relative to the input Nyquist frequency. */
+static double windowed_sinc(double t, double half_width, double cutoff) {
+    double w, x;
+
+    if (fabs(t) >= half_width)
+        return 0;
+
+    x = t / half_width;
+    w = bessel_i0(KAISER_BETA * sqrt(1 - x * x)) / bessel_i0(KAISER_BETA);
+
+    if (fabs(t) < 1e-9)
+        return cutoff * w;
+
+    return sin(M_PI * cutoff * t) / (M_PI * t) * w;
+}
+
+static void design_bank(struct polyphase_bank *b) {
+    unsigned p, k, center = b->n_taps / 2 - 1;
+    double cutoff = CUTOFF * PA_MIN((double) b->ratio_num / b->ratio_den, 1.0);
+    double half_width = b->n_taps / 2.0;
+
+    /* The interpolating bank has an extra row for the position of the
+     * next input sample, so that rows p and p + 1 always exist */
+    for (p = 0; p <= b->n_phases; p++) {
+        float *row = b->taps + p * b->n_taps;
+        double sum = 0;
+
+        for (k = 0; k < b->n_taps; k++) {
+            double t = (double) k - center - (double) p / b->n_phases;
+
+            row[k] = (float) windowed_sinc(t, half_width, cutoff);
+            sum += row[k];
+        }
+
+        /* Normalize for unity gain at DC */
+        for (k = 0; k < b->n_taps; k++)
+            row[k] = (float) (row[k] / sum);
+    }
+}
+
+static unsigned taps_for_ratio(unsigned ratio_num, unsigned ratio_den) {
+    unsigned n = BASE_TAPS;
+
+    if (ratio_num < ratio_den)
+        n = (BASE_TAPS * ratio_den + ratio_num - 1) / ratio_num;
+
+    return PA_ROUND_UP(n, TAPS_ALIGN);
+}
+
+/* Returns a reference to a bank, creating it if no other resampler
+ * uses one with the same parameters yet */
+static struct polyphase_bank *bank_ref(unsigned n_phases, unsigned ratio_num, unsigned ratio_den, bool interpolate) {
+    struct polyphase_bank *b;
+    unsigned n_taps = taps_for_ratio(ratio_num, ratio_den);
+    pa_mutex *mutex;
+
+    mutex = pa_static_mutex_get(&banks_mutex, false, false);
+    pa_mutex_lock(mutex);
+
+    PA_LLIST_FOREACH(b, banks)
+        if (b->n_phases == n_phases && b->n_taps == n_taps &&
+            b->ratio_num == ratio_num && b->ratio_den == ratio_den &&
+            b->interpolate == interpolate) {
+            b->ref++;
+            pa_mutex_unlock(mutex);
+            return b;
+        }
+
+    b = pa_xnew0(struct polyphase_bank, 1);
+    b->n_phases = n_phases;
+    b->n_taps = n_taps;
+    b->ratio_num = ratio_num;
+    b->ratio_den = ratio_den;
+    b->interpolate = interpolate;
+    b->ref = 1;
+
+    /* Rows are a multiple of 32 bytes, aligning the start aligns them all */
+    b->allocation = pa_xmalloc(sizeof(float) * n_taps * (n_phases + 1) + 32);
+    b->taps = (float *) (((uintptr_t) b->allocation + 31) & ~(uintptr_t) 31);
+    design_bank(b);
+
+    PA_LLIST_PREPEND(struct polyphase_bank, banks, b);
+
+    pa_mutex_unlock(mutex);
+
+    pa_log_debug("Created polyphase filter bank with %u phases of %u taps for ratio %u/%u%s.",
+                 n_phases, n_taps, ratio_num, ratio_den, interpolate ? ", interpolated" : "");
+
+    return b;
+}
+
+static void bank_unref(struct polyphase_bank *b) {
+    pa_mutex *mutex;
+
+    mutex = pa_static_mutex_get(&banks_mutex, false, false);
+    pa_mutex_lock(mutex);
+
+    if (--b->ref > 0) {
+        pa_mutex_unlock(mutex);
+        return;
+    }
+
+    PA_LLIST_REMOVE(struct polyphase_bank, banks, b);
+    pa_mutex_unlock(mutex);
+
+    pa_xfree(b->allocation);
+    pa_xfree(b);
+}
+
+/*** resampler implementation ***/
+
+static void ensure_buf_size(struct polyphase_data *d, unsigned channels, unsigned frames) {
+    unsigned c;
+
+    if (frames <= d->buf_size)
+        return;
+
+    d->buf_size = PA_MAX(frames, d->buf_size * 2);
+
+    for (c = 0; c < channels; c++)
+        d->buf[c] = pa_xrealloc(d->buf[c], d->buf_size * sizeof(float));
+}
+
+/* Inserts zeros at the start of the channel buffers */
+static void prepend_silence(struct polyphase_data *d, unsigned channels, unsigned frames) {
+    unsigned c;
+
+    ensure_buf_size(d, channels, d->buf_frames + frames);
+
+    for (c = 0; c < channels; c++) {
+        memmove(d->buf[c] + frames, d->buf[c], d->buf_frames * sizeof(float));
+        memset(d->buf[c], 0, frames * sizeof(float));
+    }
+
+    d->buf_frames += frames;
+}
+
+/* Picks the filter bank for the current rates */
+static struct polyphase_bank *bank_for_rates(pa_resampler *r, unsigned l_step, unsigned m_step) {
+    bool variable_rate = r->flags & PA_RESAMPLER_VARIABLE_RATE;
+    double ratio;
+    unsigned steps;
+
+    if (!variable_rate && l_step <= MAX_EXACT_PHASES)
+        return bank_ref(l_step, l_step, m_step, false);
+
+    ratio = (double) l_step / m_step;
+    if (variable_rate)
+        ratio *= VARIABLE_RATE_MARGIN;
+
+    steps = (unsigned) PA_CLAMP(floor(ratio * RATIO_STEPS), 1.0, (double) RATIO_STEPS);
+
+    return bank_ref(INTERP_PHASES, steps, RATIO_STEPS, true);
+}
+
+/* Sets up rates and filter bank, keeping the position of the next output
+ * sample in time */
+static void setup_rates(pa_resampler *r) {
+    struct polyphase_data *d = r->impl.data;
+    struct polyphase_bank *old_bank = d->bank;
+    unsigned old_center = d->center, old_l_step = d->l_step;
+    unsigned gcd, l_step, m_step;
+
+    gcd = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    l_step = r->o_ss.rate / gcd;
+    m_step = r->i_ss.rate / gcd;
+
+    /* Rate changes of variable rate resamplers happen in the IO thread,
+     * the interpolated bank works for any steps */
+    if (!old_bank || !(r->flags & PA_RESAMPLER_VARIABLE_RATE))
+        d->bank = bank_for_rates(r, l_step, m_step);
+
+    d->center = d->bank->n_taps / 2 - 1;
+
+    d->l_step = l_step;
+    d->m_step = m_step;
+    d->m_int = m_step / l_step;
+    d->m_frac = m_step % l_step;
+
+    if (old_bank) {
+        d->phase = (unsigned) (((uint64_t) d->phase * l_step) / old_l_step);
+
+        if (d->center > old_center) {
+            unsigned shift = d->center - old_center;
+
+            if (d->in_index >= shift)
+                d->in_index -= shift;
+            else {
+                prepend_silence(d, r->work_channels, shift - d->in_index);
+                d->in_index = 0;
+            }
+        } else
+            d->in_index += old_center - d->center;
+
+        if (old_bank != d->bank)
+            bank_unref(old_bank);
+    }
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    struct polyphase_data *d = r->impl.data;
+    unsigned c;
+
+    /* The first output sample falls on the first input sample */
+    d->buf_frames = d->center;
+    d->in_index = 0;
+    d->phase = 0;
+
+    ensure_buf_size(d, r->work_channels, d->buf_frames);
+    for (c = 0; c < r->work_channels; c++)
+        memset(d->buf[c], 0, d->buf_frames * sizeof(float));
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    pa_assert(r);
+
+    setup_rates(r);
+}
+
+static unsigned polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    struct polyphase_data *d;
+    const struct polyphase_bank *b;
+    const unsigned channels = r->work_channels;
+    unsigned c, i, o_index = 0, consumed;
+    const float *src;
+    float *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    d = r->impl.data;
+    b = d->bank;
+
+    /* Deinterleave the input behind what is left from the last run */
+    ensure_buf_size(d, channels, d->buf_frames + in_n_frames);
+
+    src = pa_memblock_acquire_chunk(input);
+    for (c = 0; c < channels; c++) {
+        float *buf = d->buf[c] + d->buf_frames;
+
+        for (i = 0; i < in_n_frames; i++)
+            buf[i] = src[i * channels + c];
+    }
+    pa_memblock_release(input->memblock);
+
+    d->buf_frames += in_n_frames;
+
+    dst = pa_memblock_acquire_chunk(output);
+
+    while (d->in_index + b->n_taps <= d->buf_frames && o_index < *out_n_frames) {
+
+        if (b->interpolate) {
+            const float *row;
+            uint64_t pos;
+            float frac;
+
+            /* Position between the phases of the bank */
+            pos = (uint64_t) d->phase * INTERP_PHASES;
+            frac = (float) (pos % d->l_step) / d->l_step;
+            row = b->taps + (pos / d->l_step) * b->n_taps;
+
+            for (c = 0; c < channels; c++) {
+                const float *s = d->buf[c] + d->in_index;
+                float a0 = dot_func(row, s, b->n_taps);
+                float a1 = dot_func(row + b->n_taps, s, b->n_taps);
+
+                *dst++ = a0 + (a1 - a0) * frac;
+            }
+        } else {
+            const float *row = b->taps + d->phase * b->n_taps;
+
+            for (c = 0; c < channels; c++)
+                *dst++ = dot_func(row, d->buf[c] + d->in_index, b->n_taps);
+        }
+
+        o_index++;
+
+        d->in_index += d->m_int;
+        d->phase += d->m_frac;
+        if (d->phase >= d->l_step) {
+            d->phase -= d->l_step;
+            d->in_index++;
+        }
+    }
+
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o_index;
+
+    /* Drop what is no longer needed. When downsampling by a lot, the next
+     * output sample may start behind the end of the buffer. */
+    consumed = PA_MIN(d->in_index, d->buf_frames);
+    for (c = 0; c < channels; c++)
+        memmove(d->buf[c], d->buf[c] + consumed, (d->buf_frames - consumed) * sizeof(float));
+
+    d->buf_frames -= consumed;
+    d->in_index -= consumed;
+
+    /* Everything was consumed, the history is kept internally */
+    return 0;
+}
+
+static void polyphase_free(pa_resampler *r) {
+    struct polyphase_data *d;
+    unsigned c;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    if (!d)
+        return;
+
+    if (d->bank)
+        bank_unref(d->bank);
+
+    for (c = 0; c < PA_CHANNELS_MAX; c++)
+        pa_xfree(d->buf[c]);
+
+    pa_xfree(d);
+}
+
+int pa_resampler_polyphase_init(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    d = pa_xnew0(struct polyphase_data, 1);
+
+    r->impl.resample = polyphase_resample;
+    r->impl.update_rates = polyphase_update_rates;
+    r->impl.reset = polyphase_reset;
+    r->impl.free = polyphase_free;
+    r->impl.data = d;
+
+    setup_rates(r);
+    polyphase_reset(r);
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/resampler.h>
+
+#include <arm_neon.h>
+
+static float polyphase_dot_neon(const float *taps, const float *samples, unsigned n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    float32x2_t sum;
+
+    for (; n > 0; n -= 8, taps += 8, samples += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(taps), vld1q_f32(samples));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(taps + 4), vld1q_f32(samples + 4));
+    }
+
+    acc0 = vaddq_f32(acc0, acc1);
+    sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    sum = vpadd_f32(sum, sum);
+
+    return vget_lane_f32(sum, 0);
+}
+
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized polyphase resampler.");
+
+    pa_set_polyphase_dot_func(polyphase_dot_neon);
+}
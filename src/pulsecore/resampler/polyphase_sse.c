@@ -0,0 +1,108 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/resampler.h>
+
+#if defined (__i386__) || defined (__amd64__)
+
+/* The taps are aligned, the samples are not. Both process 8 taps per
+ * iteration, the SSE version in two accumulators to hide the latency of
+ * addps. */
+
+static float polyphase_dot_sse(const float *taps, const float *samples, unsigned n) {
+    pa_reg_x86 blocks = n / 8;
+    float sum;
+
+    __asm__ __volatile__ (
+        " xorps %%xmm0, %%xmm0                  \n\t"
+        " xorps %%xmm1, %%xmm1                  \n\t"
+        "1:                                     \n\t"
+        " movups (%[samples]), %%xmm2           \n\t"
+        " movups 16(%[samples]), %%xmm3         \n\t"
+        " mulps (%[taps]), %%xmm2               \n\t"
+        " mulps 16(%[taps]), %%xmm3             \n\t"
+        " addps %%xmm2, %%xmm0                  \n\t"
+        " addps %%xmm3, %%xmm1                  \n\t"
+        " add $32, %[samples]                   \n\t"
+        " add $32, %[taps]                      \n\t"
+        " dec %[blocks]                         \n\t"
+        " jne 1b                                \n\t"
+        " addps %%xmm1, %%xmm0                  \n\t"
+        " movhlps %%xmm0, %%xmm1                \n\t"
+        " addps %%xmm1, %%xmm0                  \n\t"
+        " movaps %%xmm0, %%xmm1                 \n\t"
+        " shufps $0x55, %%xmm1, %%xmm1          \n\t"
+        " addss %%xmm1, %%xmm0                  \n\t"
+        " movss %%xmm0, %[sum]                  \n\t"
+        : [taps] "+r" (taps), [samples] "+r" (samples), [blocks] "+r" (blocks), [sum] "=m" (sum)
+        :
+        : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3"
+    );
+
+    return sum;
+}
+
+static float polyphase_dot_avx(const float *taps, const float *samples, unsigned n) {
+    pa_reg_x86 blocks = n / 8;
+    float sum;
+
+    __asm__ __volatile__ (
+        " vxorps %%ymm0, %%ymm0, %%ymm0         \n\t"
+        "1:                                     \n\t"
+        " vmovups (%[samples]), %%ymm1          \n\t"
+        " vmulps (%[taps]), %%ymm1, %%ymm1      \n\t"
+        " vaddps %%ymm1, %%ymm0, %%ymm0         \n\t"
+        " add $32, %[samples]                   \n\t"
+        " add $32, %[taps]                      \n\t"
+        " dec %[blocks]                         \n\t"
+        " jne 1b                                \n\t"
+        " vextractf128 $1, %%ymm0, %%xmm1       \n\t"
+        " vaddps %%xmm1, %%xmm0, %%xmm0         \n\t"
+        " vmovhlps %%xmm0, %%xmm0, %%xmm1       \n\t"
+        " vaddps %%xmm1, %%xmm0, %%xmm0         \n\t"
+        " vshufps $0x55, %%xmm0, %%xmm0, %%xmm1 \n\t"
+        " vaddss %%xmm1, %%xmm0, %%xmm0         \n\t"
+        " vmovss %%xmm0, %[sum]                 \n\t"
+        " vzeroupper                            \n\t"
+        : [taps] "+r" (taps), [samples] "+r" (samples), [blocks] "+r" (blocks), [sum] "=m" (sum)
+        :
+        : "memory", "cc", "xmm0", "xmm1"
+    );
+
+    return sum;
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_polyphase_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_AVX) {
+        pa_log_info("Initialising AVX optimized polyphase resampler.");
+        pa_set_polyphase_dot_func(polyphase_dot_avx);
+    } else if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized polyphase resampler.");
+        pa_set_polyphase_dot_func(polyphase_dot_sse);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -24,9 +24,15 @@
 
 #include <sys/types.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
 
@@ -38,6 +44,7 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/render-profile.h>
 #include <pulse/rtclock.h>
 
 #include "rtpoll.h"
@@ -62,9 +69,49 @@ struct pa_rtpoll {
     pa_usec_t slept, awake;
 #endif
 
+#ifdef HAVE_EPOLL
+    /* If epoll_fd is valid, the pollfds of the items are mirrored into
+     * an epoll set right before sleeping, and the timer is a timerfd in
+     * that same set. Otherwise, or if anything about that fails, we fall
+     * back to plain ppoll(). */
+    int epoll_fd, timer_fd;
+    struct epoll_event *epoll_events;
+    unsigned n_epoll_events;
+
+    /* Maps the index stored in the epoll data back to its slot */
+    struct epoll_slot **epoll_slot_table;
+    unsigned n_epoll_slot_table;
+    uint32_t epoll_generation;
+
+    struct timeval timer_armed_at;
+    bool timer_armed:1;
+#endif
+
     PA_LLIST_HEAD(pa_rtpoll_item, items);
 };
 
+#ifdef HAVE_EPOLL
+/* What is registered in the epoll set for one pollfd of an item. The
+ * epoll data is not a pointer to this but its index in the slot table
+ * plus a generation that changes on every EPOLL_CTL_ADD: the kernel keeps
+ * a registration for as long as the open file description lives, so if
+ * an fd was dup()ed or passed on and then closed here without the
+ * EPOLL_CTL_DEL getting through, events for it keep arriving after the
+ * slot has been freed or reused. */
+struct epoll_slot {
+    pa_rtpoll_item *item;
+    unsigned idx;
+    int fd;
+    short events;
+
+    unsigned table_idx;
+    uint32_t generation;
+};
+
+/* Epoll data of the timerfd; no slot table ever gets this big */
+#define EPOLL_DATA_TIMER ((uint64_t) -1)
+#endif
+
 struct pa_rtpoll_item {
     pa_rtpoll *rtpoll;
     bool dead;
@@ -79,11 +126,342 @@ struct pa_rtpoll_item {
     void (*after_cb)(pa_rtpoll_item *i);
     void *userdata;
 
+#ifdef HAVE_EPOLL
+    struct epoll_slot *epoll_slots;
+#endif
+
     PA_LLIST_FIELDS(pa_rtpoll_item);
 };
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
+#ifdef HAVE_EPOLL
+
+static void epoll_init(pa_rtpoll *p) {
+    struct epoll_event ev;
+
+    pa_assert(p);
+
+    if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_warn("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK)) < 0) {
+        pa_log_warn("timerfd_create() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.u64 = EPOLL_DATA_TIMER;
+
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+        pa_log_warn("Failed to add timerfd to epoll set: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    return;
+
+fail:
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+    pa_close(p->epoll_fd);
+    p->timer_fd = p->epoll_fd = -1;
+}
+
+static void epoll_done(pa_rtpoll *p) {
+    pa_rtpoll_item *i;
+
+    pa_assert(p);
+
+    if (p->epoll_fd < 0)
+        return;
+
+    pa_close(p->timer_fd);
+    pa_close(p->epoll_fd);
+    p->timer_fd = p->epoll_fd = -1;
+    p->timer_armed = false;
+
+    for (i = p->items; i; i = i->next) {
+        pa_xfree(i->epoll_slots);
+        i->epoll_slots = NULL;
+    }
+
+    pa_xfree(p->epoll_slot_table);
+    p->epoll_slot_table = NULL;
+    p->n_epoll_slot_table = 0;
+
+    pa_xfree(p->epoll_events);
+    p->epoll_events = NULL;
+    p->n_epoll_events = 0;
+}
+
+static void epoll_slot_register(pa_rtpoll *p, struct epoll_slot *s) {
+    unsigned k;
+
+    pa_assert(p);
+    pa_assert(s);
+
+    for (k = 0; k < p->n_epoll_slot_table; k++)
+        if (!p->epoll_slot_table[k])
+            break;
+
+    if (k >= p->n_epoll_slot_table) {
+        unsigned n = PA_MAX(p->n_epoll_slot_table * 2, 16U);
+
+        p->epoll_slot_table = pa_xrealloc(p->epoll_slot_table, n * sizeof(struct epoll_slot *));
+        memset(p->epoll_slot_table + p->n_epoll_slot_table, 0, (n - p->n_epoll_slot_table) * sizeof(struct epoll_slot *));
+        p->n_epoll_slot_table = n;
+    }
+
+    p->epoll_slot_table[k] = s;
+    s->table_idx = k;
+    s->generation = 0;
+}
+
+static void epoll_slot_unregister(pa_rtpoll *p, struct epoll_slot *s) {
+    pa_assert(p);
+    pa_assert(s);
+    pa_assert(s->table_idx < p->n_epoll_slot_table);
+    pa_assert(p->epoll_slot_table[s->table_idx] == s);
+
+    p->epoll_slot_table[s->table_idx] = NULL;
+}
+
+static uint64_t epoll_slot_data(const struct epoll_slot *s) {
+    return ((uint64_t) s->generation << 32) | s->table_idx;
+}
+
+/* Returns NULL if the event belongs to a registration we have already
+ * given up on */
+static struct epoll_slot *epoll_slot_lookup(pa_rtpoll *p, uint64_t data) {
+    unsigned table_idx = (unsigned) (data & 0xFFFFFFFFU);
+    struct epoll_slot *s;
+
+    pa_assert(p);
+
+    if (table_idx >= p->n_epoll_slot_table)
+        return NULL;
+
+    if (!(s = p->epoll_slot_table[table_idx]))
+        return NULL;
+
+    if (s->fd < 0 || s->generation != (uint32_t) (data >> 32))
+        return NULL;
+
+    return s;
+}
+
+static uint32_t map_flags_to_epoll(short events) {
+    return
+        (events & POLLIN ? EPOLLIN : 0) |
+        (events & POLLOUT ? EPOLLOUT : 0) |
+        (events & POLLPRI ? EPOLLPRI : 0);
+}
+
+static short map_flags_from_epoll(uint32_t events) {
+    return (short)
+        (events & EPOLLIN ? POLLIN : 0) |
+        (events & EPOLLOUT ? POLLOUT : 0) |
+        (events & EPOLLPRI ? POLLPRI : 0) |
+        (events & EPOLLERR ? POLLERR : 0) |
+        (events & EPOLLHUP ? POLLHUP : 0);
+}
+
+/* Bring the epoll set in line with what the items have put in their
+ * pollfds since the last iteration. Usually nothing changed, so this
+ * doesn't need any syscalls. */
+static int epoll_update(pa_rtpoll *p) {
+    pa_rtpoll_item *i;
+    unsigned j;
+
+    pa_assert(p);
+
+    /* Remove everything that went away or changed fds first, so that an
+     * fd that moved between two pollfds can be added again right after */
+    for (i = p->items; i; i = i->next) {
+
+        if (!i->epoll_slots)
+            continue;
+
+        for (j = 0; j < i->n_pollfd; j++) {
+            struct epoll_slot *s = i->epoll_slots + j;
+
+            if (s->fd < 0)
+                continue;
+
+            if (!i->dead && s->fd == i->pollfd[j].fd)
+                continue;
+
+            /* The fd might have been closed already, which removes it
+             * from the set anyway */
+            (void) epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+            s->fd = -1;
+        }
+    }
+
+    for (i = p->items; i; i = i->next) {
+
+        if (i->dead || i->n_pollfd <= 0)
+            continue;
+
+        if (!i->epoll_slots) {
+            i->epoll_slots = pa_xnew(struct epoll_slot, i->n_pollfd);
+
+            for (j = 0; j < i->n_pollfd; j++) {
+                i->epoll_slots[j].item = i;
+                i->epoll_slots[j].idx = j;
+                i->epoll_slots[j].fd = -1;
+                i->epoll_slots[j].events = 0;
+                epoll_slot_register(p, i->epoll_slots + j);
+            }
+        }
+
+        for (j = 0; j < i->n_pollfd; j++) {
+            struct epoll_slot *s = i->epoll_slots + j;
+            struct pollfd *f = i->pollfd + j;
+            struct epoll_event ev;
+
+            if (f->fd < 0)
+                continue;
+
+            if (s->fd == f->fd && s->events == f->events)
+                continue;
+
+            if (s->fd < 0)
+                s->generation = ++p->epoll_generation;
+
+            pa_zero(ev);
+            ev.events = map_flags_to_epoll(f->events);
+            ev.data.u64 = epoll_slot_data(s);
+
+            /* This fails for fds that cannot be used with epoll, like
+             * regular files, and for fds that are listed twice */
+            if (epoll_ctl(p->epoll_fd, s->fd < 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, f->fd, &ev) < 0) {
+                pa_log_debug("Cannot use epoll for fd %i, falling back to ppoll(): %s", f->fd, pa_cstrerror(errno));
+                return -1;
+            }
+
+            s->fd = f->fd;
+            s->events = f->events;
+        }
+    }
+
+    if (p->n_epoll_events < p->n_pollfd_used + 1) {
+        p->n_epoll_events = p->n_pollfd_used + 1;
+        p->epoll_events = pa_xrealloc(p->epoll_events, p->n_epoll_events * sizeof(struct epoll_event));
+    }
+
+    return 0;
+}
+
+static int epoll_arm_timer(pa_rtpoll *p) {
+    struct itimerspec its;
+
+    pa_assert(p);
+
+    if (!p->timer_enabled) {
+
+        if (p->timer_armed) {
+            /* Disarming also drops an expiration that wasn't read yet */
+            pa_zero(its);
+
+            if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+                goto fail;
+
+            p->timer_armed = false;
+        }
+
+        return 0;
+    }
+
+    if (p->timer_armed && pa_timeval_cmp(&p->timer_armed_at, &p->next_elapse) == 0)
+        return 0;
+
+    pa_zero(its);
+    its.it_value.tv_sec = p->next_elapse.tv_sec;
+    its.it_value.tv_nsec = p->next_elapse.tv_usec * 1000;
+
+    /* All zero would disarm the timer */
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+        its.it_value.tv_nsec = 1;
+
+    if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        goto fail;
+
+    p->timer_armed_at = p->next_elapse;
+    p->timer_armed = true;
+
+    return 0;
+
+fail:
+    pa_log_debug("timerfd_settime() failed, falling back to ppoll(): %s", pa_cstrerror(errno));
+    return -1;
+}
+
+/* Returns the number of pollfds with events, like poll() would */
+static int epoll_sleep(pa_rtpoll *p) {
+    unsigned k;
+    int r, n = 0;
+    bool timer_fired = false, stale = false;
+
+    pa_assert(p);
+
+    if ((r = epoll_wait(p->epoll_fd, p->epoll_events, (int) p->n_epoll_events, p->quit ? 0 : -1)) < 0)
+        return r;
+
+    for (k = 0; k < p->n_pollfd_used; k++)
+        p->pollfd[k].revents = 0;
+
+    for (k = 0; k < (unsigned) r; k++) {
+        struct epoll_slot *s;
+
+        if (p->epoll_events[k].data.u64 == EPOLL_DATA_TIMER) {
+            uint64_t expirations;
+
+            (void) pa_read(p->timer_fd, &expirations, sizeof(expirations), NULL);
+            p->timer_armed = false;
+            timer_fired = true;
+            continue;
+        }
+
+        if (!(s = epoll_slot_lookup(p, p->epoll_events[k].data.u64))) {
+            stale = true;
+            continue;
+        }
+
+        s->item->pollfd[s->idx].revents = map_flags_from_epoll(p->epoll_events[k].events);
+        n++;
+    }
+
+    if (stale) {
+        /* We can't remove such a registration anymore, since we no
+         * longer have an fd for it. Start over with a fresh set, which
+         * the next epoll_update() fills again. */
+        pa_log_debug("Got events for an fd that is gone, recreating the epoll set.");
+
+        epoll_done(p);
+        epoll_init(p);
+
+        if (n <= 0 && !timer_fired && !p->quit) {
+            /* Nothing happened that anyone asked for; have
+             * pa_rtpoll_run() come back without treating this as a
+             * timeout */
+            errno = EINTR;
+            return -1;
+        }
+    }
+
+    /* Like poll(), 0 means we timed out. pa_rtpoll_timer_elapsed()
+     * relies on that. */
+    pa_assert(n > 0 || timer_fired || p->quit);
+
+    return n;
+}
+
+#endif /* HAVE_EPOLL */
+
 pa_rtpoll *pa_rtpoll_new(void) {
     pa_rtpoll *p;
 
@@ -97,6 +475,13 @@ pa_rtpoll *pa_rtpoll_new(void) {
     p->timestamp = pa_rtclock_now();
 #endif
 
+#ifdef HAVE_EPOLL
+    p->epoll_fd = p->timer_fd = -1;
+
+    if (!getenv("PULSE_NO_EPOLL"))
+        epoll_init(p);
+#endif
+
     return p;
 }
 
@@ -156,6 +541,21 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
 
     p->n_pollfd_used -= i->n_pollfd;
 
+#ifdef HAVE_EPOLL
+    if (i->epoll_slots) {
+        unsigned j;
+
+        for (j = 0; j < i->n_pollfd; j++) {
+            if (i->epoll_slots[j].fd >= 0)
+                (void) epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, i->epoll_slots[j].fd, NULL);
+
+            epoll_slot_unregister(p, i->epoll_slots + j);
+        }
+
+        pa_xfree(i->epoll_slots);
+    }
+#endif
+
     if (pa_flist_push(PA_STATIC_FLIST_GET(items), i) < 0)
         pa_xfree(i);
 
@@ -168,6 +568,10 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     while (p->items)
         rtpoll_item_destroy(p->items);
 
+#ifdef HAVE_EPOLL
+    epoll_done(p);
+#endif
+
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
@@ -306,6 +710,14 @@ int pa_rtpoll_run(pa_rtpoll *p) {
 #endif
 
     /* OK, now let's sleep */
+#ifdef HAVE_EPOLL
+    if (p->epoll_fd >= 0 && (epoll_update(p) < 0 || epoll_arm_timer(p) < 0))
+        epoll_done(p);
+
+    if (p->epoll_fd >= 0)
+        r = epoll_sleep(p);
+    else
+#endif
 #ifdef HAVE_PPOLL
     {
         struct timespec ts;
@@ -416,6 +828,10 @@ pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsi
     i->after_cb = NULL;
     i->work_cb = NULL;
 
+#ifdef HAVE_EPOLL
+    i->epoll_slots = NULL;
+#endif
+
     for (j = p->items; j; j = j->next) {
         if (prio <= j->priority)
             break;
@@ -553,6 +969,7 @@ static int asyncmsgq_read_work(pa_rtpoll_item *i) {
     pa_assert(i);
 
     if (pa_asyncmsgq_get(i->userdata, &object, &code, &data, &offset, &chunk, 0) == 0) {
+        uint64_t start;
         int ret;
 
         if (!object && code == PA_MESSAGE_SHUTDOWN) {
@@ -563,7 +980,15 @@ static int asyncmsgq_read_work(pa_rtpoll_item *i) {
             return 1;
         }
 
+        /* Only count messages handled here, in the IO thread. The main
+         * thread dispatches messages to the same objects, and the profile
+         * may only have one writer. */
+        start = pa_render_profile_start();
         ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
+
+        if (object)
+            pa_render_profile_stop(&object->process_msg_profile, start);
+
         pa_asyncmsgq_done(i->userdata, ret);
         return 1;
     }
@@ -78,11 +78,24 @@ void pa_memchunk_dump_to_file(pa_memchunk *c, const char *fn);
 
 void pa_memchunk_sine(pa_memchunk *c, pa_mempool *pool, unsigned rate, unsigned freq);
 
+/* The volume arrays passed to the volume functions repeat their channels
+ * for this many more entries, so that optimized functions may read a
+ * whole vector of volumes starting at any channel. */
+#define PA_VOLUME_PADDING 32
+
 typedef void (*pa_do_volume_func_t) (void *samples, const void *volumes, unsigned channels, unsigned length);
 
 pa_do_volume_func_t pa_get_volume_func(pa_sample_format_t f);
 void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func);
 
+/* Applies the float volumes to n float32ne samples in a, clamps them and
+ * converts them to the sample format in b. Only available for some
+ * formats, NULL is returned for the others. */
+typedef void (*pa_do_volume_from_float32ne_func_t) (unsigned n, const float *a, void *b, const float *volumes, unsigned channels);
+
+pa_do_volume_from_float32ne_func_t pa_get_volume_from_float32ne_func(pa_sample_format_t f);
+void pa_set_volume_from_float32ne_func(pa_sample_format_t f, pa_do_volume_from_float32ne_func_t func);
+
 size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_spec *to);
 
 #define PA_CHANNEL_POSITION_MASK_LEFT                                   \
@@ -85,6 +85,230 @@ static void pa_sconv_s16le_to_f32ne_neon(unsigned n, const int16_t *src, float *
     }
 }
 
+#ifndef WORDS_BIGENDIAN
+/* The remaining conversions handle 8 samples per iteration. Integer samples
+ * are unpacked to 32 bit integers with the sample in the upper bits, so s16,
+ * s24, s24-32 and s32 only differ in how they are loaded and stored. The
+ * fixed point conversions from floats round towards zero, so results may be
+ * off by one from the generic functions. */
+
+static inline int32x4x2_t load_s16(uint8x16_t v) {
+    int16x8_t s = vreinterpretq_s16_u8(v);
+    int32x4x2_t r = { { vshll_n_s16(vget_low_s16(s), 16), vshll_n_s16(vget_high_s16(s), 16) } };
+
+    return r;
+}
+
+static inline int32x4x2_t load_s16ne(const uint8_t *a) {
+    return load_s16(vld1q_u8(a));
+}
+
+static inline int32x4x2_t load_s16re(const uint8_t *a) {
+    return load_s16(vrev16q_u8(vld1q_u8(a)));
+}
+
+static inline int32x4x2_t load_s32ne(const uint8_t *a) {
+    int32x4x2_t r = { { vreinterpretq_s32_u8(vld1q_u8(a)), vreinterpretq_s32_u8(vld1q_u8(a + 16)) } };
+
+    return r;
+}
+
+static inline int32x4x2_t load_s32re(const uint8_t *a) {
+    int32x4x2_t r = { { vreinterpretq_s32_u8(vrev32q_u8(vld1q_u8(a))), vreinterpretq_s32_u8(vrev32q_u8(vld1q_u8(a + 16))) } };
+
+    return r;
+}
+
+static inline int32x4x2_t shift_s24_32(int32x4x2_t r) {
+    r.val[0] = vshlq_n_s32(r.val[0], 8);
+    r.val[1] = vshlq_n_s32(r.val[1], 8);
+
+    return r;
+}
+
+static inline int32x4x2_t load_s24_32ne(const uint8_t *a) {
+    return shift_s24_32(load_s32ne(a));
+}
+
+static inline int32x4x2_t load_s24_32re(const uint8_t *a) {
+    return shift_s24_32(load_s32re(a));
+}
+
+/* Widens the low, middle and high bytes of 8 samples to dwords */
+static inline int32x4x2_t load_s24(uint8x8_t l, uint8x8_t m, uint8x8_t h) {
+    uint16x8x2_t s = vzipq_u16(vshll_n_u8(l, 8), vorrq_u16(vmovl_u8(m), vshll_n_u8(h, 8)));
+    int32x4x2_t r = { { vreinterpretq_s32_u16(s.val[0]), vreinterpretq_s32_u16(s.val[1]) } };
+
+    return r;
+}
+
+static inline int32x4x2_t load_s24ne(const uint8_t *a) {
+    uint8x8x3_t b = vld3_u8(a);
+
+    return load_s24(b.val[0], b.val[1], b.val[2]);
+}
+
+static inline int32x4x2_t load_s24re(const uint8_t *a) {
+    uint8x8x3_t b = vld3_u8(a);
+
+    return load_s24(b.val[2], b.val[1], b.val[0]);
+}
+
+static inline float32x4x2_t load_float32ne(const uint8_t *a) {
+    float32x4x2_t r = { { vreinterpretq_f32_u8(vld1q_u8(a)), vreinterpretq_f32_u8(vld1q_u8(a + 16)) } };
+
+    return r;
+}
+
+static inline float32x4x2_t load_float32re(const uint8_t *a) {
+    float32x4x2_t r = { { vreinterpretq_f32_u8(vrev32q_u8(vld1q_u8(a))), vreinterpretq_f32_u8(vrev32q_u8(vld1q_u8(a + 16))) } };
+
+    return r;
+}
+
+static inline float32x4x2_t s32_to_float(int32x4x2_t s) {
+    float32x4x2_t r = { { vcvtq_n_f32_s32(s.val[0], 31), vcvtq_n_f32_s32(s.val[1], 31) } };
+
+    return r;
+}
+
+static inline int32x4x2_t float_to_s32(float32x4x2_t f) {
+    int32x4x2_t r = { { vcvtq_n_s32_f32(f.val[0], 31), vcvtq_n_s32_f32(f.val[1], 31) } };
+
+    return r;
+}
+
+static inline int16x8_t float_to_s16(float32x4x2_t f) {
+    int32x4x2_t s = float_to_s32(f);
+
+    return vcombine_s16(vqrshrn_n_s32(s.val[0], 16), vqrshrn_n_s32(s.val[1], 16));
+}
+
+static inline int16x8_t s32_to_s16(int32x4x2_t s) {
+    return vcombine_s16(vshrn_n_s32(s.val[0], 16), vshrn_n_s32(s.val[1], 16));
+}
+
+static inline void store_s16ne(uint8_t *b, int16x8_t s) {
+    vst1q_u8(b, vreinterpretq_u8_s16(s));
+}
+
+static inline void store_s16re(uint8_t *b, int16x8_t s) {
+    vst1q_u8(b, vrev16q_u8(vreinterpretq_u8_s16(s)));
+}
+
+static inline void store_s32ne(uint8_t *b, int32x4x2_t s) {
+    vst1q_u8(b, vreinterpretq_u8_s32(s.val[0]));
+    vst1q_u8(b + 16, vreinterpretq_u8_s32(s.val[1]));
+}
+
+static inline void store_s32re(uint8_t *b, int32x4x2_t s) {
+    vst1q_u8(b, vrev32q_u8(vreinterpretq_u8_s32(s.val[0])));
+    vst1q_u8(b + 16, vrev32q_u8(vreinterpretq_u8_s32(s.val[1])));
+}
+
+static inline int32x4x2_t unshift_s24_32(int32x4x2_t s) {
+    s.val[0] = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(s.val[0]), 8));
+    s.val[1] = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(s.val[1]), 8));
+
+    return s;
+}
+
+static inline void store_s24_32ne(uint8_t *b, int32x4x2_t s) {
+    store_s32ne(b, unshift_s24_32(s));
+}
+
+static inline void store_s24_32re(uint8_t *b, int32x4x2_t s) {
+    store_s32re(b, unshift_s24_32(s));
+}
+
+/* Narrows 8 dwords to their low, middle and high sample bytes */
+static inline uint8x8x3_t store_s24(int32x4x2_t s) {
+    uint16x8x2_t h = vuzpq_u16(vreinterpretq_u16_s32(s.val[0]), vreinterpretq_u16_s32(s.val[1]));
+    uint8x8x3_t r = { { vshrn_n_u16(h.val[0], 8), vmovn_u16(h.val[1]), vshrn_n_u16(h.val[1], 8) } };
+
+    return r;
+}
+
+static inline void store_s24ne(uint8_t *b, int32x4x2_t s) {
+    vst3_u8(b, store_s24(s));
+}
+
+static inline void store_s24re(uint8_t *b, int32x4x2_t s) {
+    uint8x8x3_t r = store_s24(s);
+    uint8x8_t t = r.val[0];
+
+    r.val[0] = r.val[2];
+    r.val[2] = t;
+    vst3_u8(b, r);
+}
+
+static inline void store_float32ne(uint8_t *b, float32x4x2_t f) {
+    vst1q_u8(b, vreinterpretq_u8_f32(f.val[0]));
+    vst1q_u8(b + 16, vreinterpretq_u8_f32(f.val[1]));
+}
+
+static inline void store_float32re(uint8_t *b, float32x4x2_t f) {
+    vst1q_u8(b, vrev32q_u8(vreinterpretq_u8_f32(f.val[0])));
+    vst1q_u8(b + 16, vrev32q_u8(vreinterpretq_u8_f32(f.val[1])));
+}
+
+/* Converts blocks of 8 samples, and leaves the rest to the function that
+ * was registered before */
+#define SCONV_FUNC(name, a_size, b_size, store, convert, load)             \
+static pa_convert_func_t name##_ref;                                        \
+                                                                            \
+static void name(unsigned n, const uint8_t *a, uint8_t *b) {                \
+    for (; n >= 8; n -= 8, a += 8 * a_size, b += 8 * b_size)                \
+        store(b, convert(load(a)));                                         \
+                                                                            \
+    if (n)                                                                  \
+        name##_ref(n, a, b);                                                \
+}
+
+#define SCONV_COPY(x) (x)
+
+SCONV_FUNC(s16re_to_float32ne_neon, 2, 4, store_float32ne, s32_to_float, load_s16re)
+SCONV_FUNC(s32ne_to_float32ne_neon, 4, 4, store_float32ne, s32_to_float, load_s32ne)
+SCONV_FUNC(s32re_to_float32ne_neon, 4, 4, store_float32ne, s32_to_float, load_s32re)
+SCONV_FUNC(s24ne_to_float32ne_neon, 3, 4, store_float32ne, s32_to_float, load_s24ne)
+SCONV_FUNC(s24re_to_float32ne_neon, 3, 4, store_float32ne, s32_to_float, load_s24re)
+SCONV_FUNC(s24_32ne_to_float32ne_neon, 4, 4, store_float32ne, s32_to_float, load_s24_32ne)
+SCONV_FUNC(s24_32re_to_float32ne_neon, 4, 4, store_float32ne, s32_to_float, load_s24_32re)
+SCONV_FUNC(float32re_to_float32ne_neon, 4, 4, store_float32ne, SCONV_COPY, load_float32re)
+
+SCONV_FUNC(s16re_from_float32ne_neon, 4, 2, store_s16re, float_to_s16, load_float32ne)
+SCONV_FUNC(s32ne_from_float32ne_neon, 4, 4, store_s32ne, float_to_s32, load_float32ne)
+SCONV_FUNC(s32re_from_float32ne_neon, 4, 4, store_s32re, float_to_s32, load_float32ne)
+SCONV_FUNC(s24ne_from_float32ne_neon, 4, 3, store_s24ne, float_to_s32, load_float32ne)
+SCONV_FUNC(s24re_from_float32ne_neon, 4, 3, store_s24re, float_to_s32, load_float32ne)
+SCONV_FUNC(s24_32ne_from_float32ne_neon, 4, 4, store_s24_32ne, float_to_s32, load_float32ne)
+SCONV_FUNC(s24_32re_from_float32ne_neon, 4, 4, store_s24_32re, float_to_s32, load_float32ne)
+
+SCONV_FUNC(s16re_to_s16ne_neon, 2, 2, store_s16ne, s32_to_s16, load_s16re)
+SCONV_FUNC(s32ne_to_s16ne_neon, 4, 2, store_s16ne, s32_to_s16, load_s32ne)
+SCONV_FUNC(s32re_to_s16ne_neon, 4, 2, store_s16ne, s32_to_s16, load_s32re)
+SCONV_FUNC(s24ne_to_s16ne_neon, 3, 2, store_s16ne, s32_to_s16, load_s24ne)
+SCONV_FUNC(s24re_to_s16ne_neon, 3, 2, store_s16ne, s32_to_s16, load_s24re)
+SCONV_FUNC(s24_32ne_to_s16ne_neon, 4, 2, store_s16ne, s32_to_s16, load_s24_32ne)
+SCONV_FUNC(s24_32re_to_s16ne_neon, 4, 2, store_s16ne, s32_to_s16, load_s24_32re)
+SCONV_FUNC(float32re_to_s16ne_neon, 4, 2, store_s16ne, float_to_s16, load_float32re)
+
+SCONV_FUNC(s32ne_from_s16ne_neon, 2, 4, store_s32ne, SCONV_COPY, load_s16ne)
+SCONV_FUNC(s32re_from_s16ne_neon, 2, 4, store_s32re, SCONV_COPY, load_s16ne)
+SCONV_FUNC(s24ne_from_s16ne_neon, 2, 3, store_s24ne, SCONV_COPY, load_s16ne)
+SCONV_FUNC(s24re_from_s16ne_neon, 2, 3, store_s24re, SCONV_COPY, load_s16ne)
+SCONV_FUNC(s24_32ne_from_s16ne_neon, 2, 4, store_s24_32ne, SCONV_COPY, load_s16ne)
+SCONV_FUNC(s24_32re_from_s16ne_neon, 2, 4, store_s24_32re, SCONV_COPY, load_s16ne)
+SCONV_FUNC(float32re_from_s16ne_neon, 2, 4, store_float32re, s32_to_float, load_s16ne)
+
+#define SET_CONVERT_FUNC(table, format, func)                              \
+    do {                                                                    \
+        if (!func##_ref)                                                    \
+            func##_ref = pa_get_convert_##table##_function(format);         \
+        pa_set_convert_##table##_function(format, (pa_convert_func_t) func); \
+    } while (0)
+#endif
+
 void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
     pa_log_info("Initialising ARM NEON optimized conversions.");
     pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_neon);
@@ -92,5 +316,41 @@ void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
 #ifndef WORDS_BIGENDIAN
     pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_to_f32ne_neon);
     pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_neon);
+
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S16BE, s16re_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S32LE, s32ne_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S32BE, s32re_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24LE, s24ne_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24BE, s24re_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24_32LE, s24_32ne_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24_32BE, s24_32re_to_float32ne_neon);
+    SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_FLOAT32BE, float32re_to_float32ne_neon);
+
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S16BE, s16re_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S32LE, s32ne_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S32BE, s32re_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24LE, s24ne_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24BE, s24re_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24_32LE, s24_32ne_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24_32BE, s24_32re_from_float32ne_neon);
+    SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_FLOAT32BE, float32re_to_float32ne_neon);
+
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S16BE, s16re_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S32LE, s32ne_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S32BE, s32re_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24LE, s24ne_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24BE, s24re_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24_32LE, s24_32ne_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24_32BE, s24_32re_to_s16ne_neon);
+    SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_FLOAT32BE, float32re_to_s16ne_neon);
+
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S16BE, s16re_to_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S32LE, s32ne_from_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S32BE, s32re_from_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24LE, s24ne_from_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24BE, s24re_from_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24_32LE, s24_32ne_from_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24_32BE, s24_32re_from_s16ne_neon);
+    SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_FLOAT32BE, float32re_from_s16ne_neon);
 #endif
 }
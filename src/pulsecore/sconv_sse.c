@@ -158,6 +158,246 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
     );
 }
 
+/* The remaining conversions are built from a load, a convert and a store
+ * step, each handling 8 samples. Integer samples are unpacked to 32 bit
+ * integers with the sample in the upper bits, in %xmm0 and %xmm1, so s16,
+ * s24, s24-32 and s32 only differ in how they are loaded and stored. Byte
+ * swapping and packed 24 bit samples need SSSE3's pshufb. The conversions
+ * to and from floats round exactly like the generic functions do. */
+
+static const PA_DECLARE_ALIGNED (16, float, f32_from_s32[4]) = { 1.0f / (1U << 31), 1.0f / (1U << 31), 1.0f / (1U << 31), 1.0f / (1U << 31) };
+static const PA_DECLARE_ALIGNED (16, float, f32_to_s32[4]) = { (1U << 31), (1U << 31), (1U << 31), (1U << 31) };
+static const PA_DECLARE_ALIGNED (16, uint8_t, swap16[16]) = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, swap32[16]) = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+/* Turns s24-32be into the upper 24 bits of a dword and back */
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24_32re_swap[16]) = {
+    0x80, 3, 2, 1, 0x80, 7, 6, 5, 0x80, 11, 10, 9, 0x80, 15, 14, 13 };
+/* The first four packed samples are unpacked from bytes 0-11, the next four
+ * from bytes 12-23, loaded from offset 8 so we never read past the input */
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24ne_unpack[2][16]) = {
+    { 0x80, 0, 1, 2, 0x80, 3, 4, 5, 0x80, 6, 7, 8, 0x80, 9, 10, 11 },
+    { 0x80, 4, 5, 6, 0x80, 7, 8, 9, 0x80, 10, 11, 12, 0x80, 13, 14, 15 } };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24re_unpack[2][16]) = {
+    { 0x80, 2, 1, 0, 0x80, 5, 4, 3, 0x80, 8, 7, 6, 0x80, 11, 10, 9 },
+    { 0x80, 6, 5, 4, 0x80, 9, 8, 7, 0x80, 12, 11, 10, 0x80, 15, 14, 13 } };
+/* Packs 8 samples into 16 bytes from %xmm0 and the upper 4 bytes of %xmm1,
+ * and 8 more bytes from the remaining samples of %xmm1 */
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24ne_pack[3][16]) = {
+    { 1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, 0x80, 0x80, 0x80, 0x80 },
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 1, 2, 3, 5 },
+    { 6, 7, 9, 10, 11, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 } };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24re_pack[3][16]) = {
+    { 3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, 0x80, 0x80, 0x80, 0x80 },
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 3, 2, 1, 7 },
+    { 6, 5, 11, 10, 9, 15, 14, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 } };
+
+#define LOAD_S16(swap)                                                      \
+      " movdqu (%[a]), %%xmm2               \n\t"                           \
+      swap                                                                  \
+      " pxor %%xmm0, %%xmm0                 \n\t"                           \
+      " pxor %%xmm1, %%xmm1                 \n\t"                           \
+      " punpcklwd %%xmm2, %%xmm0            \n\t" /* s16 to upper 16 bits */ \
+      " punpckhwd %%xmm2, %%xmm1            \n\t"
+
+#define LOAD_S16NE LOAD_S16("")
+#define LOAD_S16RE LOAD_S16(" pshufb %[swap16], %%xmm2 \n\t")
+
+#define LOAD_S32NE                                                          \
+      " movdqu (%[a]), %%xmm0               \n\t"                           \
+      " movdqu 16(%[a]), %%xmm1             \n\t"
+
+#define LOAD_S32RE                                                          \
+      LOAD_S32NE                                                            \
+      " pshufb %[swap32], %%xmm0            \n\t"                           \
+      " pshufb %[swap32], %%xmm1            \n\t"
+
+#define LOAD_S24_32NE                                                       \
+      LOAD_S32NE                                                            \
+      " pslld $8, %%xmm0                    \n\t"                           \
+      " pslld $8, %%xmm1                    \n\t"
+
+#define LOAD_S24_32RE                                                       \
+      LOAD_S32NE                                                            \
+      " pshufb %[s24_32re_swap], %%xmm0     \n\t"                           \
+      " pshufb %[s24_32re_swap], %%xmm1     \n\t"
+
+#define LOAD_S24(unpack)                                                    \
+      " movdqu (%[a]), %%xmm0               \n\t"                           \
+      " movdqu 8(%[a]), %%xmm1              \n\t"                           \
+      " pshufb %[" #unpack "0], %%xmm0      \n\t"                           \
+      " pshufb %[" #unpack "1], %%xmm1      \n\t"
+
+#define LOAD_S24NE LOAD_S24(s24ne_unpack)
+#define LOAD_S24RE LOAD_S24(s24re_unpack)
+
+#define LOAD_FLOAT32NE                                                      \
+      " movups (%[a]), %%xmm0               \n\t"                           \
+      " movups 16(%[a]), %%xmm1             \n\t"
+
+#define LOAD_FLOAT32RE LOAD_S32RE
+
+#define S32_TO_FLOAT                                                        \
+      " cvtdq2ps %%xmm0, %%xmm0             \n\t"                           \
+      " cvtdq2ps %%xmm1, %%xmm1             \n\t"                           \
+      " mulps %[f32_from_s32], %%xmm0       \n\t" /* *= 1/0x80000000 */     \
+      " mulps %[f32_from_s32], %%xmm1       \n\t"
+
+/* cvtps2dq turns everything out of range into 0x80000000, so positive
+ * overflows get flipped to 0x7fffffff */
+#define FLOAT_TO_S32                                                        \
+      " mulps %[f32_to_s32], %%xmm0         \n\t" /* *= 0x80000000 */       \
+      " mulps %[f32_to_s32], %%xmm1         \n\t"                           \
+      " movaps %[f32_to_s32], %%xmm2        \n\t"                           \
+      " movaps %[f32_to_s32], %%xmm3        \n\t"                           \
+      " cmpleps %%xmm0, %%xmm2              \n\t" /* overflow masks */      \
+      " cmpleps %%xmm1, %%xmm3              \n\t"                           \
+      " cvtps2dq %%xmm0, %%xmm0             \n\t"                           \
+      " cvtps2dq %%xmm1, %%xmm1             \n\t"                           \
+      " pxor %%xmm2, %%xmm0                 \n\t"                           \
+      " pxor %%xmm3, %%xmm1                 \n\t"
+
+#define FLOAT_TO_S16                                                        \
+      " mulps %[f32_to_s16], %%xmm0         \n\t" /* *= 0x8000 */           \
+      " mulps %[f32_to_s16], %%xmm1         \n\t"                           \
+      " cvtps2dq %%xmm0, %%xmm0             \n\t"                           \
+      " cvtps2dq %%xmm1, %%xmm1             \n\t"                           \
+      " packssdw %%xmm1, %%xmm0             \n\t"
+
+#define S32_TO_S16                                                          \
+      " psrad $16, %%xmm0                   \n\t"                           \
+      " psrad $16, %%xmm1                   \n\t"                           \
+      " packssdw %%xmm1, %%xmm0             \n\t"
+
+#define STORE_S16NE                                                         \
+      " movdqu %%xmm0, (%[b])               \n\t"
+
+#define STORE_S16RE                                                         \
+      " pshufb %[swap16], %%xmm0            \n\t"                           \
+      STORE_S16NE
+
+#define STORE_S32NE                                                         \
+      " movdqu %%xmm0, (%[b])               \n\t"                           \
+      " movdqu %%xmm1, 16(%[b])             \n\t"
+
+#define STORE_S32RE                                                         \
+      " pshufb %[swap32], %%xmm0            \n\t"                           \
+      " pshufb %[swap32], %%xmm1            \n\t"                           \
+      STORE_S32NE
+
+#define STORE_S24_32NE                                                      \
+      " psrld $8, %%xmm0                    \n\t"                           \
+      " psrld $8, %%xmm1                    \n\t"                           \
+      STORE_S32NE
+
+#define STORE_S24_32RE                                                      \
+      " pshufb %[s24_32re_swap], %%xmm0     \n\t"                           \
+      " pshufb %[s24_32re_swap], %%xmm1     \n\t"                           \
+      STORE_S32NE
+
+#define STORE_S24(pack)                                                     \
+      " movdqa %%xmm1, %%xmm2               \n\t"                           \
+      " pshufb %[" #pack "0], %%xmm0        \n\t"                           \
+      " pshufb %[" #pack "1], %%xmm1        \n\t"                           \
+      " pshufb %[" #pack "2], %%xmm2        \n\t"                           \
+      " por %%xmm1, %%xmm0                  \n\t"                           \
+      " movdqu %%xmm0, (%[b])               \n\t"                           \
+      " movq %%xmm2, 16(%[b])               \n\t"
+
+#define STORE_S24NE STORE_S24(s24ne_pack)
+#define STORE_S24RE STORE_S24(s24re_pack)
+
+#define STORE_FLOAT32NE                                                     \
+      " movups %%xmm0, (%[b])               \n\t"                           \
+      " movups %%xmm1, 16(%[b])             \n\t"
+
+#define STORE_FLOAT32RE STORE_S32RE
+
+/* Converts blocks of 8 samples, and leaves the rest to the function that
+ * was registered before */
+#define SCONV_FUNC(name, a_size, b_size, load, convert, store)             \
+static pa_convert_func_t name##_ref;                                        \
+                                                                            \
+static void name(unsigned n, const uint8_t *a, uint8_t *b) {                \
+    const uint8_t *end = a + (n & ~7U) * a_size;                            \
+                                                                            \
+    __asm__ __volatile__ (                                                  \
+        " cmp %[end], %[a]                  \n\t"                           \
+        " jae 2f                            \n\t"                           \
+                                                                            \
+        "1:                                 \n\t"                           \
+        load                                                                \
+        convert                                                             \
+        store                                                               \
+        " add $8*" #a_size ", %[a]          \n\t"                           \
+        " add $8*" #b_size ", %[b]          \n\t"                           \
+        " cmp %[end], %[a]                  \n\t"                           \
+        " jb 1b                             \n\t"                           \
+                                                                            \
+        "2:                                 \n\t"                           \
+        : [a] "+r" (a), [b] "+r" (b)                                        \
+        : [end] "rm" (end),                                                 \
+          [f32_from_s32] "m" (*f32_from_s32), [f32_to_s32] "m" (*f32_to_s32), \
+          [f32_to_s16] "m" (*scale),                                        \
+          [swap16] "m" (*swap16), [swap32] "m" (*swap32),                   \
+          [s24_32re_swap] "m" (*s24_32re_swap),                             \
+          [s24ne_unpack0] "m" (*s24ne_unpack[0]), [s24ne_unpack1] "m" (*s24ne_unpack[1]), \
+          [s24re_unpack0] "m" (*s24re_unpack[0]), [s24re_unpack1] "m" (*s24re_unpack[1]), \
+          [s24ne_pack0] "m" (*s24ne_pack[0]), [s24ne_pack1] "m" (*s24ne_pack[1]), \
+          [s24ne_pack2] "m" (*s24ne_pack[2]),                               \
+          [s24re_pack0] "m" (*s24re_pack[0]), [s24re_pack1] "m" (*s24re_pack[1]), \
+          [s24re_pack2] "m" (*s24re_pack[2])                                \
+        : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3"                    \
+    );                                                                      \
+                                                                            \
+    if (n & 7)                                                              \
+        name##_ref(n & 7, a, b);                                            \
+}
+
+/* SSE2 */
+SCONV_FUNC(s16ne_to_float32ne_sse2, 2, 4, LOAD_S16NE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s32ne_to_float32ne_sse2, 4, 4, LOAD_S32NE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s24_32ne_to_float32ne_sse2, 4, 4, LOAD_S24_32NE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s32ne_from_float32ne_sse2, 4, 4, LOAD_FLOAT32NE, FLOAT_TO_S32, STORE_S32NE)
+SCONV_FUNC(s24_32ne_from_float32ne_sse2, 4, 4, LOAD_FLOAT32NE, FLOAT_TO_S32, STORE_S24_32NE)
+SCONV_FUNC(s32ne_to_s16ne_sse2, 4, 2, LOAD_S32NE, S32_TO_S16, STORE_S16NE)
+SCONV_FUNC(s24_32ne_to_s16ne_sse2, 4, 2, LOAD_S24_32NE, S32_TO_S16, STORE_S16NE)
+SCONV_FUNC(s32ne_from_s16ne_sse2, 2, 4, LOAD_S16NE, "", STORE_S32NE)
+SCONV_FUNC(s24_32ne_from_s16ne_sse2, 2, 4, LOAD_S16NE, "", STORE_S24_32NE)
+
+/* SSSE3 */
+SCONV_FUNC(s16re_to_float32ne_ssse3, 2, 4, LOAD_S16RE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s32re_to_float32ne_ssse3, 4, 4, LOAD_S32RE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s24ne_to_float32ne_ssse3, 3, 4, LOAD_S24NE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s24re_to_float32ne_ssse3, 3, 4, LOAD_S24RE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(s24_32re_to_float32ne_ssse3, 4, 4, LOAD_S24_32RE, S32_TO_FLOAT, STORE_FLOAT32NE)
+SCONV_FUNC(float32re_to_float32ne_ssse3, 4, 4, LOAD_FLOAT32RE, "", STORE_FLOAT32NE)
+
+SCONV_FUNC(s16re_from_float32ne_ssse3, 4, 2, LOAD_FLOAT32NE, FLOAT_TO_S16, STORE_S16RE)
+SCONV_FUNC(s32re_from_float32ne_ssse3, 4, 4, LOAD_FLOAT32NE, FLOAT_TO_S32, STORE_S32RE)
+SCONV_FUNC(s24ne_from_float32ne_ssse3, 4, 3, LOAD_FLOAT32NE, FLOAT_TO_S32, STORE_S24NE)
+SCONV_FUNC(s24re_from_float32ne_ssse3, 4, 3, LOAD_FLOAT32NE, FLOAT_TO_S32, STORE_S24RE)
+SCONV_FUNC(s24_32re_from_float32ne_ssse3, 4, 4, LOAD_FLOAT32NE, FLOAT_TO_S32, STORE_S24_32RE)
+
+SCONV_FUNC(s16re_to_s16ne_ssse3, 2, 2, " movdqu (%[a]), %%xmm0 \n\t", " pshufb %[swap16], %%xmm0 \n\t", STORE_S16NE)
+SCONV_FUNC(s32re_to_s16ne_ssse3, 4, 2, LOAD_S32RE, S32_TO_S16, STORE_S16NE)
+SCONV_FUNC(s24ne_to_s16ne_ssse3, 3, 2, LOAD_S24NE, S32_TO_S16, STORE_S16NE)
+SCONV_FUNC(s24re_to_s16ne_ssse3, 3, 2, LOAD_S24RE, S32_TO_S16, STORE_S16NE)
+SCONV_FUNC(s24_32re_to_s16ne_ssse3, 4, 2, LOAD_S24_32RE, S32_TO_S16, STORE_S16NE)
+SCONV_FUNC(float32re_to_s16ne_ssse3, 4, 2, LOAD_FLOAT32RE, FLOAT_TO_S16, STORE_S16NE)
+
+SCONV_FUNC(s32re_from_s16ne_ssse3, 2, 4, LOAD_S16NE, "", STORE_S32RE)
+SCONV_FUNC(s24ne_from_s16ne_ssse3, 2, 3, LOAD_S16NE, "", STORE_S24NE)
+SCONV_FUNC(s24re_from_s16ne_ssse3, 2, 3, LOAD_S16NE, "", STORE_S24RE)
+SCONV_FUNC(s24_32re_from_s16ne_ssse3, 2, 4, LOAD_S16NE, "", STORE_S24_32RE)
+SCONV_FUNC(float32re_from_s16ne_ssse3, 2, 4, LOAD_S16NE, S32_TO_FLOAT, STORE_FLOAT32RE)
+
+#define SET_CONVERT_FUNC(table, format, func)                              \
+    do {                                                                    \
+        if (!func##_ref)                                                    \
+            func##_ref = pa_get_convert_##table##_function(format);         \
+        pa_set_convert_##table##_function(format, (pa_convert_func_t) func); \
+    } while (0)
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
@@ -167,11 +407,54 @@ void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
         pa_log_info("Initialising SSE2 optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
         pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S16LE, s16ne_to_float32ne_sse2);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S32LE, s32ne_to_float32ne_sse2);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24_32LE, s24_32ne_to_float32ne_sse2);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S32LE, s32ne_from_float32ne_sse2);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24_32LE, s24_32ne_from_float32ne_sse2);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S32LE, s32ne_to_s16ne_sse2);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24_32LE, s24_32ne_to_s16ne_sse2);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S32LE, s32ne_from_s16ne_sse2);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24_32LE, s24_32ne_from_s16ne_sse2);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_FLOAT32LE, s16ne_to_float32ne_sse2);
     } else if (flags & PA_CPU_X86_SSE) {
         pa_log_info("Initialising SSE optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
         pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
     }
 
+    if (flags & PA_CPU_X86_SSSE3) {
+        pa_log_info("Initialising SSSE3 optimized s24 and byte swapping conversions.");
+
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S16BE, s16re_to_float32ne_ssse3);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S32BE, s32re_to_float32ne_ssse3);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24LE, s24ne_to_float32ne_ssse3);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24BE, s24re_to_float32ne_ssse3);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_S24_32BE, s24_32re_to_float32ne_ssse3);
+        SET_CONVERT_FUNC(to_float32ne, PA_SAMPLE_FLOAT32BE, float32re_to_float32ne_ssse3);
+
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S16BE, s16re_from_float32ne_ssse3);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S32BE, s32re_from_float32ne_ssse3);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24LE, s24ne_from_float32ne_ssse3);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24BE, s24re_from_float32ne_ssse3);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_S24_32BE, s24_32re_from_float32ne_ssse3);
+        SET_CONVERT_FUNC(from_float32ne, PA_SAMPLE_FLOAT32BE, float32re_to_float32ne_ssse3);
+
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S16BE, s16re_to_s16ne_ssse3);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S32BE, s32re_to_s16ne_ssse3);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24LE, s24ne_to_s16ne_ssse3);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24BE, s24re_to_s16ne_ssse3);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_S24_32BE, s24_32re_to_s16ne_ssse3);
+        SET_CONVERT_FUNC(to_s16ne, PA_SAMPLE_FLOAT32BE, float32re_to_s16ne_ssse3);
+
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S16BE, s16re_to_s16ne_ssse3);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S32BE, s32re_from_s16ne_ssse3);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24LE, s24ne_from_s16ne_ssse3);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24BE, s24re_from_s16ne_ssse3);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_S24_32BE, s24_32re_from_s16ne_ssse3);
+        SET_CONVERT_FUNC(from_s16ne, PA_SAMPLE_FLOAT32BE, float32re_from_s16ne_ssse3);
+    }
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 }
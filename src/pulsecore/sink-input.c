@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <pulse/utf8.h>
 #include <pulse/xmalloc.h>
@@ -45,6 +46,7 @@
 
 #define MEMBLOCKQ_MAXLENGTH (32*1024*1024)
 #define CONVERT_BUFFER_LENGTH (PA_PAGE_SIZE)
+#define PREMIX_BATCH_MAX 16
 
 PA_DEFINE_PUBLIC_CLASS(pa_sink_input, pa_msgobject);
 
@@ -541,6 +543,9 @@ int pa_sink_input_new(
     i->thread_info.underrun_for_sink = 0;
     i->thread_info.playing_for = 0;
     i->thread_info.direct_outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    i->thread_info.premix_group = NULL;
+    i->thread_info.premix_next = NULL;
+    pa_memchunk_reset(&i->thread_info.premix_chunk);
 
     pa_assert_se(pa_idxset_put(core->sink_inputs, i, &i->index) == 0);
     pa_assert_se(pa_idxset_put(i->sink->inputs, pa_sink_input_ref(i), NULL) == 0);
@@ -734,6 +739,9 @@ static void sink_input_free(pa_object *o) {
     if (i->thread_info.render_memblockq)
         pa_memblockq_free(i->thread_info.render_memblockq);
 
+    if (i->thread_info.premix_chunk.memblock)
+        pa_memblock_unref(i->thread_info.premix_chunk.memblock);
+
     if (i->thread_info.resampler)
         pa_resampler_free(i->thread_info.resampler);
 
@@ -832,6 +840,51 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
     return r[0];
 }
 
+/* Called from thread context */
+static int pop_input(pa_sink_input *i, size_t ilength, pa_memchunk *chunk) {
+
+    /* Data left over from mixing the input at its own rate comes
+     * first */
+    if (i->thread_info.premix_chunk.memblock) {
+        *chunk = i->thread_info.premix_chunk;
+        pa_memchunk_reset(&i->thread_info.premix_chunk);
+        return 0;
+    }
+
+    return i->pop(i, ilength, chunk);
+}
+
+/* Called from thread context */
+static void drop_premix_chunk(pa_sink_input *i) {
+
+    if (i->thread_info.premix_chunk.memblock) {
+        pa_memblock_unref(i->thread_info.premix_chunk.memblock);
+        pa_memchunk_reset(&i->thread_info.premix_chunk);
+    }
+}
+
+/* Called from thread context */
+static void run_resampler(pa_sink_input *i, pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
+    uint64_t start = pa_render_profile_start();
+
+    pa_resampler_run(r, in, out);
+    pa_render_profile_stop(&i->thread_info.resampler_profile, start);
+}
+
+/* Called from thread context */
+static bool set_resampler_volume(pa_sink_input *i, bool nvfs) {
+    pa_cvolume v;
+
+    if (!nvfs)
+        return pa_resampler_set_volume(i->thread_info.resampler, &i->thread_info.soft_volume);
+
+    /* The resampler only takes the volume if it doesn't remap, so
+     * the input and sink channels are the same */
+    pa_sw_cvolume_multiply(&v, &i->thread_info.soft_volume, &i->volume_factor_sink);
+
+    return pa_resampler_set_volume(i->thread_info.resampler, &v);
+}
+
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
     bool do_volume_adj_here, need_volume_factor_sink;
@@ -839,6 +892,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
     size_t ilength_full;
+    uint64_t start;
 
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
@@ -851,6 +905,8 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     pa_log_debug("peek");
 #endif
 
+    start = pa_render_profile_start();
+
     block_size_max_sink_input = i->thread_info.resampler ?
         pa_resampler_max_block_size(i->thread_info.resampler) :
         pa_frame_align(pa_mempool_block_size_max(i->core->mempool), &i->sample_spec);
@@ -894,7 +950,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
          * with data from the implementor. */
 
         if (i->thread_info.state == PA_SINK_INPUT_CORKED ||
-            i->pop(i, ilength, &tchunk) < 0) {
+            pop_input(i, ilength, &tchunk) < 0) {
 
             /* OK, we're corked or the implementor didn't give us any
              * data, so let's just hand out silence */
@@ -921,6 +977,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
         while (tchunk.length > 0) {
             pa_memchunk wchunk;
             bool nvfs = need_volume_factor_sink;
+            bool resampler_volume = false;
 
             wchunk = tchunk;
             pa_memblock_ref(wchunk.memblock);
@@ -930,9 +987,9 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
             /* It might be necessary to adjust the volume here */
             if (do_volume_adj_here && !volume_is_norm) {
-                pa_memchunk_make_writable(&wchunk, 0);
 
                 if (i->thread_info.muted) {
+                    pa_memchunk_make_writable(&wchunk, 0);
                     pa_silence_memchunk(&wchunk, &i->thread_info.sample_spec);
                     nvfs = false;
 
@@ -943,11 +1000,23 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                      * post and the pre volume adjustment into one */
 
                     pa_sw_cvolume_multiply(&v, &i->thread_info.soft_volume, &i->volume_factor_sink);
+                    pa_memchunk_make_writable(&wchunk, 0);
                     pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &v);
                     nvfs = false;
 
-                } else
+                } else if (i->thread_info.resampler && set_resampler_volume(i, nvfs)) {
+
+                    /* The resampler applies both volumes while
+                     * converting its output, no need to touch the
+                     * data here */
+
+                    resampler_volume = true;
+                    nvfs = false;
+
+                } else {
+                    pa_memchunk_make_writable(&wchunk, 0);
                     pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &i->thread_info.soft_volume);
+                }
             }
 
             if (!i->thread_info.resampler) {
@@ -960,7 +1029,16 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
-                pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+
+                if (nvfs && pa_resampler_set_volume(i->thread_info.resampler, &i->volume_factor_sink)) {
+                    resampler_volume = true;
+                    nvfs = false;
+                }
+
+                run_resampler(i, i->thread_info.resampler, &wchunk, &rchunk);
+
+                if (resampler_volume)
+                    pa_resampler_set_volume(i->thread_info.resampler, NULL);
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -1010,6 +1088,212 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
     else
         *volume = i->thread_info.soft_volume;
+
+    pa_render_profile_stop(&i->thread_info.peek_profile, start);
+}
+
+/* Called from thread context */
+static bool premix_readable(pa_sink_input *i) {
+    pa_sink_input *m;
+
+    for (m = i; m; m = m->thread_info.premix_next)
+        if (!pa_memblockq_is_readable(m->thread_info.render_memblockq))
+            return false;
+
+    return true;
+}
+
+/* Called from thread context */
+static void premix_volume(pa_sink_input *i, pa_cvolume *volume) {
+
+    /* The volume factor is in the sink's channel map, so it can only be
+     * applied before resampling if the channel maps are the same. The
+     * sink doesn't group inputs for which that would be necessary. */
+    if (!pa_cvolume_is_norm(&i->volume_factor_sink) &&
+        pa_channel_map_equal(&i->channel_map, &i->sink->channel_map))
+        pa_sw_cvolume_multiply(volume, &i->thread_info.soft_volume, &i->volume_factor_sink);
+    else
+        *volume = i->thread_info.soft_volume;
+}
+
+/* Called from thread context. i is the first of a group of inputs,
+ * linked by thread_info.premix_next, that have the same sample spec and
+ * channel map. Their data is mixed at their own rate in float32 with
+ * their volumes applied and then converted to the sink's sample spec by
+ * resampler. The result ends up in the render queue of i, the render
+ * queues of the other members are advanced with silence so that they
+ * stay in step for dropping and rewinding. */
+void pa_sink_input_peek_premix(pa_sink_input *i, pa_resampler *resampler, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
+    pa_mix_info info[PREMIX_BATCH_MAX];
+    pa_sink_input *m;
+    size_t block_size_max_sink;
+    size_t ifs, ffs;
+    size_t nframes, nframes_full;
+    uint64_t start;
+
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+    pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
+    pa_assert(pa_frame_aligned(slength, &i->sink->sample_spec));
+    pa_assert(resampler);
+    pa_assert(chunk);
+    pa_assert(volume);
+
+    start = pa_render_profile_start();
+
+    ifs = pa_frame_size(&i->sample_spec);
+    ffs = pa_frame_size(pa_resampler_input_sample_spec(resampler));
+
+    block_size_max_sink = pa_frame_align(pa_mempool_block_size_max(i->core->mempool), &i->sink->sample_spec);
+
+    /* Default buffer size */
+    if (slength <= 0)
+        slength = pa_frame_align(CONVERT_BUFFER_LENGTH, &i->sink->sample_spec);
+
+    if (slength > block_size_max_sink)
+        slength = block_size_max_sink;
+
+    nframes = pa_resampler_request(resampler, slength) / ffs;
+
+    if (nframes <= 0)
+        nframes = CONVERT_BUFFER_LENGTH / ifs;
+
+    nframes_full = nframes;
+    nframes = PA_MIN(nframes, pa_resampler_max_block_size(resampler) / ffs);
+
+    for (m = i; m; m = m->thread_info.premix_next)
+        m->thread_info.premix_silent = false;
+
+    while (!premix_readable(i)) {
+        pa_memchunk fchunk, rchunk;
+        size_t n = nframes;
+        unsigned k = 0;
+        float *data;
+
+        /* Make sure every member that is still playing has some data
+         * at hand */
+        for (m = i; m; m = m->thread_info.premix_next) {
+
+            if (!m->thread_info.premix_chunk.memblock && !m->thread_info.premix_silent) {
+
+                if (m->thread_info.state == PA_SINK_INPUT_CORKED ||
+                    m->pop(m, nframes * ifs, &m->thread_info.premix_chunk) < 0) {
+
+                    pa_memchunk_reset(&m->thread_info.premix_chunk);
+                    pa_atomic_store(&m->thread_info.drained, 1);
+                    m->thread_info.playing_for = 0;
+                    m->thread_info.premix_silent = true;
+                    continue;
+                }
+
+                pa_atomic_store(&m->thread_info.drained, 0);
+
+                pa_assert(m->thread_info.premix_chunk.length > 0);
+                pa_assert(m->thread_info.premix_chunk.memblock);
+                pa_assert(pa_frame_aligned(m->thread_info.premix_chunk.length, &m->sample_spec));
+
+                m->thread_info.underrun_for = 0;
+                m->thread_info.underrun_for_sink = 0;
+                m->thread_info.playing_for += m->thread_info.premix_chunk.length;
+            }
+
+            if (m->thread_info.premix_chunk.memblock) {
+                n = PA_MIN(n, m->thread_info.premix_chunk.length / ifs);
+                k++;
+            }
+        }
+
+        if (k <= 0) {
+
+            /* OK, none of the members gave us any data, so let's just
+             * hand out silence */
+            for (m = i; m; m = m->thread_info.premix_next) {
+                pa_memblockq_seek(m->thread_info.render_memblockq, (int64_t) slength, PA_SEEK_RELATIVE, true);
+
+                if (m->thread_info.underrun_for != (uint64_t) -1) {
+                    m->thread_info.underrun_for += nframes_full * ifs;
+                    m->thread_info.underrun_for_sink += slength;
+                }
+            }
+            break;
+        }
+
+        fchunk.memblock = pa_memblock_new(i->core->mempool, n * ffs);
+        fchunk.index = 0;
+        fchunk.length = n * ffs;
+
+        data = pa_memblock_acquire(fchunk.memblock);
+        memset(data, 0, fchunk.length);
+
+        k = 0;
+        for (m = i; m; m = m->thread_info.premix_next) {
+            pa_memchunk *c = &m->thread_info.premix_chunk;
+
+            if (!c->memblock) {
+                /* This one ran dry, it's silent for this block */
+                if (m->thread_info.underrun_for != (uint64_t) -1) {
+                    m->thread_info.underrun_for += n * ifs;
+                    m->thread_info.underrun_for_sink += pa_resampler_result(resampler, n * ffs);
+                }
+                continue;
+            }
+
+            if (!m->thread_info.muted) {
+                info[k].chunk = *c;
+                premix_volume(m, &info[k].volume);
+
+                if (++k >= PREMIX_BATCH_MAX) {
+                    pa_mix_add_float32ne(info, k, data, n * ifs, &i->sample_spec);
+                    k = 0;
+                }
+            }
+        }
+
+        if (k > 0)
+            pa_mix_add_float32ne(info, k, data, n * ifs, &i->sample_spec);
+
+        pa_memblock_release(fchunk.memblock);
+
+        /* Everything that was mixed has been consumed */
+        for (m = i; m; m = m->thread_info.premix_next) {
+            pa_memchunk *c = &m->thread_info.premix_chunk;
+
+            if (!c->memblock)
+                continue;
+
+            c->index += n * ifs;
+            c->length -= n * ifs;
+
+            if (c->length <= 0) {
+                pa_memblock_unref(c->memblock);
+                pa_memchunk_reset(c);
+            }
+        }
+
+        run_resampler(i, resampler, &fchunk, &rchunk);
+        pa_memblock_unref(fchunk.memblock);
+
+        if (rchunk.memblock) {
+            pa_memblockq_push_align(i->thread_info.render_memblockq, &rchunk);
+
+            for (m = i->thread_info.premix_next; m; m = m->thread_info.premix_next)
+                pa_memblockq_seek(m->thread_info.render_memblockq, (int64_t) rchunk.length, PA_SEEK_RELATIVE, true);
+
+            pa_memblock_unref(rchunk.memblock);
+        }
+    }
+
+    pa_assert_se(pa_memblockq_peek(i->thread_info.render_memblockq, chunk) >= 0);
+
+    pa_assert(chunk->length > 0);
+    pa_assert(chunk->memblock);
+
+    if (chunk->length > block_size_max_sink)
+        chunk->length = block_size_max_sink;
+
+    /* The volumes were applied while mixing */
+    pa_cvolume_reset(volume, i->sink->sample_spec.channels);
+    pa_render_profile_stop(&i->thread_info.peek_profile, start);
 }
 
 /* Called from thread context */
@@ -1071,6 +1355,7 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
          * data from implementor the next time peek() is called */
 
         pa_memblockq_flush_write(i->thread_info.render_memblockq, true);
+        drop_premix_chunk(i);
 
     } else if (i->thread_info.rewrite_nbytes > 0) {
         size_t max_rewrite, amount;
@@ -1088,11 +1373,15 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
         if (amount > 0) {
             pa_log_debug("Have to rewind %lu bytes on implementor.", (unsigned long) amount);
 
-            /* Tell the implementor */
+            /* Tell the implementor. Data that was popped for mixing
+             * at the input's own rate but wasn't used yet has to go
+             * back, too. */
             if (i->process_rewind)
-                i->process_rewind(i, amount);
+                i->process_rewind(i, amount + i->thread_info.premix_chunk.length);
             called = true;
 
+            drop_premix_chunk(i);
+
             /* Convert back to sink domain */
             if (i->thread_info.resampler)
                 amount = pa_resampler_result(i->thread_info.resampler, amount);
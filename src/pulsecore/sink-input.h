@@ -243,12 +243,29 @@ struct pa_sink_input {
         /* We maintain a history of resampled audio data here. */
         pa_memblockq *render_memblockq;
 
+        /* When the sink mixes this input with others at their own rate
+         * before resampling (see pa_sink_input_peek_premix()), this is
+         * the group it was mixed in during the last render pass and the
+         * next member of that group. premix_chunk holds data that was
+         * popped in the input's sample spec but not yet mixed,
+         * premix_silent marks inputs that ran dry during the current
+         * render pass. */
+        pa_sink_premix_group *premix_group;
+        pa_sink_input *premix_next;
+        pa_memchunk premix_chunk;
+        bool premix_silent:1;
+
         pa_sink_input *sync_prev, *sync_next;
 
         /* The requested latency for the sink */
         pa_usec_t requested_sink_latency;
 
         pa_hashmap *direct_outputs;
+
+        /* Time spent in pa_sink_input_peek(), and the part of it that
+         * was spent resampling */
+        pa_render_profile peek_profile;
+        pa_render_profile resampler_profile;
     } thread_info;
 
     void *userdata;
@@ -397,6 +414,7 @@ pa_usec_t pa_sink_input_get_requested_latency(pa_sink_input *i);
 /* To be used exclusively by the sink driver IO thread */
 
 void pa_sink_input_peek(pa_sink_input *i, size_t length, pa_memchunk *chunk, pa_cvolume *volume);
+void pa_sink_input_peek_premix(pa_sink_input *i, pa_resampler *resampler, size_t length, pa_memchunk *chunk, pa_cvolume *volume);
 void pa_sink_input_drop(pa_sink_input *i, size_t length);
 void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in the sink's sample spec */);
 void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */);
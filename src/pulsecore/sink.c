@@ -54,6 +54,7 @@
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
 #define DEFAULT_FIXED_LATENCY (250*PA_USEC_PER_MSEC)
+#define PREMIX_GROUPS_MAX 8
 
 PA_DEFINE_PUBLIC_CLASS(pa_sink, pa_msgobject);
 
@@ -64,6 +65,22 @@ struct pa_sink_volume_change {
     PA_LLIST_FIELDS(pa_sink_volume_change);
 };
 
+/* Inputs that need the same conversion to the sink's sample spec are
+ * mixed in float32 at their own rate and then go through this group's
+ * resampler together, see fill_mix_info() */
+struct pa_sink_premix_group {
+    pa_resampler *resampler;
+
+    /* The input whose render queue receives the resampled mix in the
+     * current render pass, NULL if the group isn't used */
+    pa_sink_input *leader;
+
+    /* Set when the mix has to be redone on the next rewind */
+    bool rewrite:1;
+
+    PA_LLIST_FIELDS(pa_sink_premix_group);
+};
+
 struct sink_message_set_port {
     pa_device_port *port;
     int ret;
@@ -71,6 +88,8 @@ struct sink_message_set_port {
 
 static void sink_free(pa_object *s);
 
+static void premix_group_free(pa_sink *s, pa_sink_premix_group *g);
+
 static void pa_sink_volume_change_push(pa_sink *s);
 static void pa_sink_volume_change_flush(pa_sink *s);
 static void pa_sink_volume_change_rewind(pa_sink *s, size_t nbytes);
@@ -327,8 +346,12 @@ pa_sink* pa_sink_new(
     s->thread_info.rtpoll = NULL;
     s->thread_info.inputs = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL,
                                                 (pa_free_cb_t) pa_sink_input_unref);
+    s->thread_info.mix_info = NULL;
+    s->thread_info.n_mix_info = 0;
     s->thread_info.soft_volume =  s->soft_volume;
     s->thread_info.soft_muted = s->muted;
+    s->thread_info.premix_resampling = core->premix_resampling;
+    PA_LLIST_HEAD_INIT(pa_sink_premix_group, s->thread_info.premix_groups);
     s->thread_info.state = s->state;
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = false;
@@ -735,6 +758,10 @@ static void sink_free(pa_object *o) {
 
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs);
+    pa_xfree(s->thread_info.mix_info);
+
+    while (s->thread_info.premix_groups)
+        premix_group_free(s, s->thread_info.premix_groups);
 
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
@@ -988,6 +1015,195 @@ size_t pa_sink_process_input_underruns(pa_sink *s, size_t left_to_play) {
     return left_to_play - result;
 }
 
+/* Called from IO thread context */
+static void premix_group_free(pa_sink *s, pa_sink_premix_group *g) {
+    pa_assert(s);
+    pa_assert(g);
+
+    PA_LLIST_REMOVE(pa_sink_premix_group, s->thread_info.premix_groups, g);
+    pa_resampler_free(g->resampler);
+    pa_xfree(g);
+}
+
+/* Called from IO thread context */
+static bool premix_eligible(pa_sink *s, pa_sink_input *i) {
+
+    if (!i->thread_info.resampler || i->thread_info.state != PA_SINK_INPUT_RUNNING)
+        return false;
+
+    /* The rate of these may change at any time */
+    if (pa_resampler_get_flags(i->thread_info.resampler) & PA_RESAMPLER_VARIABLE_RATE)
+        return false;
+
+    /* Direct outputs want to see the data of this input alone */
+    if (!pa_hashmap_isempty(i->thread_info.direct_outputs))
+        return false;
+
+    /* See premix_volume() in sink-input.c */
+    if (!pa_cvolume_is_norm(&i->volume_factor_sink) &&
+        !pa_channel_map_equal(&i->channel_map, &s->channel_map))
+        return false;
+
+    return true;
+}
+
+/* Called from IO thread context. The group's resampler takes float32,
+ * so the sample format of the inputs doesn't matter for it. */
+static bool premix_same_conversion(pa_resampler *a, pa_resampler *b, bool ignore_format) {
+    const pa_sample_spec *ass = pa_resampler_input_sample_spec(a);
+    const pa_sample_spec *bss = pa_resampler_input_sample_spec(b);
+
+    return
+        (ignore_format || ass->format == bss->format) &&
+        ass->rate == bss->rate &&
+        ass->channels == bss->channels &&
+        pa_channel_map_equal(pa_resampler_input_channel_map(a), pa_resampler_input_channel_map(b)) &&
+        pa_resampler_get_method(a) == pa_resampler_get_method(b) &&
+        pa_resampler_get_flags(a) == pa_resampler_get_flags(b);
+}
+
+/* Called from IO thread context */
+static pa_sink_premix_group *premix_group_get(pa_sink *s, pa_sink_input *i) {
+    pa_sink_premix_group *g;
+    pa_resampler *r = i->thread_info.resampler;
+    pa_sample_spec fss;
+
+    PA_LLIST_FOREACH(g, s->thread_info.premix_groups) {
+        if (g->leader)
+            continue;
+
+        if (premix_same_conversion(g->resampler, r, true) &&
+            pa_sample_spec_equal(pa_resampler_output_sample_spec(g->resampler), &s->sample_spec) &&
+            pa_channel_map_equal(pa_resampler_output_channel_map(g->resampler), &s->channel_map))
+            return g;
+    }
+
+    fss = *pa_resampler_input_sample_spec(r);
+    fss.format = PA_SAMPLE_FLOAT32NE;
+
+    g = pa_xnew0(pa_sink_premix_group, 1);
+
+    if (!(g->resampler = pa_resampler_new(
+                  s->core->mempool,
+                  &fss, pa_resampler_input_channel_map(r),
+                  &s->sample_spec, &s->channel_map,
+                  s->core->lfe_crossover_freq,
+                  pa_resampler_get_method(r),
+                  pa_resampler_get_flags(r)))) {
+        pa_xfree(g);
+        return NULL;
+    }
+
+    PA_LLIST_PREPEND(pa_sink_premix_group, s->thread_info.premix_groups, g);
+
+    pa_log_debug("Created premix group for %u Hz, %u channels on sink %s.", fss.rate, fss.channels, s->name);
+
+    return g;
+}
+
+/* Called from IO thread context. Puts the inputs that need the same
+ * conversion into groups. The first input of each group in the
+ * iteration order of thread_info.inputs becomes its leader, so it is
+ * peeked before the other members. */
+static void premix_assign_groups(pa_sink *s) {
+    pa_sink_input *heads[PREMIX_GROUPS_MAX], *tails[PREMIX_GROUPS_MAX];
+    unsigned sizes[PREMIX_GROUPS_MAX];
+    unsigned n_heads = 0, k;
+    pa_sink_premix_group *g, *n;
+    pa_sink_input *i, *next;
+    void *state;
+
+    PA_LLIST_FOREACH(g, s->thread_info.premix_groups)
+        g->leader = NULL;
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+        i->thread_info.premix_group = NULL;
+        i->thread_info.premix_next = NULL;
+
+        if (!premix_eligible(s, i))
+            continue;
+
+        for (k = 0; k < n_heads; k++)
+            if (premix_same_conversion(heads[k]->thread_info.resampler, i->thread_info.resampler, false)) {
+                tails[k]->thread_info.premix_next = i;
+                tails[k] = i;
+                sizes[k]++;
+                break;
+            }
+
+        if (k >= n_heads && n_heads < PREMIX_GROUPS_MAX) {
+            heads[n_heads] = tails[n_heads] = i;
+            sizes[n_heads] = 1;
+            n_heads++;
+        }
+    }
+
+    for (k = 0; k < n_heads; k++) {
+
+        /* A single input is better off with its own resampler */
+        if (sizes[k] < 2 || !(g = premix_group_get(s, heads[k]))) {
+            for (i = heads[k]; i; i = next) {
+                next = i->thread_info.premix_next;
+                i->thread_info.premix_next = NULL;
+            }
+            continue;
+        }
+
+        g->leader = heads[k];
+
+        for (i = heads[k]; i; i = i->thread_info.premix_next)
+            i->thread_info.premix_group = g;
+    }
+
+    PA_LLIST_FOREACH_SAFE(g, n, s->thread_info.premix_groups)
+        if (!g->leader)
+            premix_group_free(s, g);
+}
+
+/* Called from IO thread context. If one member of a group needs to
+ * rewrite data, the mix in the leader's render queue has to be redone
+ * for all members. */
+static void premix_process_rewind(pa_sink *s, size_t nbytes) {
+    pa_sink_premix_group *g;
+    pa_sink_input *i;
+    void *state;
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        if (i->thread_info.premix_group && i->thread_info.rewrite_nbytes != 0)
+            i->thread_info.premix_group->rewrite = true;
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+        size_t total_nbytes;
+
+        if (!(g = i->thread_info.premix_group) || !g->rewrite)
+            continue;
+
+        if (i->thread_info.rewrite_nbytes != (size_t) -1) {
+            total_nbytes = nbytes + pa_memblockq_get_length(i->thread_info.render_memblockq);
+            i->thread_info.rewrite_nbytes = pa_resampler_request(i->thread_info.resampler, total_nbytes);
+        }
+    }
+
+    PA_LLIST_FOREACH(g, s->thread_info.premix_groups)
+        if (g->rewrite) {
+            pa_resampler_reset(g->resampler);
+            g->rewrite = false;
+        }
+}
+
+/* Called from IO thread context. The data of i might still be part of
+ * the mix in the render queue of its group's leader. */
+static void premix_remove_input(pa_sink *s, pa_sink_input *i) {
+    pa_sink_premix_group *g;
+
+    if (!(g = i->thread_info.premix_group))
+        return;
+
+    g->rewrite = true;
+    i->thread_info.premix_group = NULL;
+    i->thread_info.premix_next = NULL;
+}
+
 /* Called from IO thread context */
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     pa_sink_input *i;
@@ -1013,6 +1229,9 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
             pa_sink_volume_change_rewind(s, nbytes);
     }
 
+    if (s->thread_info.premix_groups)
+        premix_process_rewind(s, nbytes);
+
     PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
         pa_sink_input_assert_ref(i);
         pa_sink_input_process_rewind(i, nbytes);
@@ -1024,6 +1243,34 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     }
 }
 
+/* Called from IO thread context */
+static pa_mix_info *get_mix_info(pa_sink *s, pa_mix_info *stack_info, unsigned *maxinfo) {
+    unsigned n;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+    pa_assert(stack_info);
+    pa_assert(maxinfo);
+
+    n = pa_hashmap_size(s->thread_info.inputs);
+
+    if (PA_LIKELY(n <= MAX_MIX_CHANNELS)) {
+        *maxinfo = MAX_MIX_CHANNELS;
+        return stack_info;
+    }
+
+    /* pa_mix() has no limit on the number of streams, so make room for
+     * all of them. The array is kept for the following render passes. */
+    if (n > s->thread_info.n_mix_info) {
+        pa_xfree(s->thread_info.mix_info);
+        s->thread_info.n_mix_info = PA_MAX(n, 2 * s->thread_info.n_mix_info);
+        s->thread_info.mix_info = pa_xnew(pa_mix_info, s->thread_info.n_mix_info);
+    }
+
+    *maxinfo = s->thread_info.n_mix_info;
+    return s->thread_info.mix_info;
+}
+
 /* Called from IO thread context */
 static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
     pa_sink_input *i;
@@ -1035,10 +1282,20 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (s->thread_info.premix_resampling)
+        premix_assign_groups(s);
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
+        pa_sink_premix_group *g;
+
         pa_sink_input_assert_ref(i);
 
-        pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
+        /* The leader carries the mix of its group, the other members
+         * only have silence in their render queues */
+        if ((g = i->thread_info.premix_group) && g->leader == i)
+            pa_sink_input_peek_premix(i, g->resampler, *length, &info->chunk, &info->volume);
+        else
+            pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
 
         if (mixlength == 0 || info->chunk.length < mixlength)
             mixlength = info->chunk.length;
@@ -1064,6 +1321,22 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     return n;
 }
 
+/* Called from IO thread context */
+static size_t mix_inputs(pa_sink *s, pa_mix_info *info, unsigned n, void *data, size_t length) {
+    uint64_t start;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+
+    start = pa_render_profile_start();
+
+    length = pa_mix(info, n, data, length, &s->sample_spec, &s->thread_info.soft_volume, s->thread_info.soft_muted);
+
+    pa_render_profile_stop(&s->thread_info.mix_profile, start);
+
+    return length;
+}
+
 /* Called from IO thread context */
 static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result) {
     pa_sink_input *i;
@@ -1164,9 +1437,10 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
 
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
-    unsigned n;
+    pa_mix_info info_stack[MAX_MIX_CHANNELS], *info;
+    unsigned n, maxinfo;
     size_t block_size_max;
+    uint64_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1185,6 +1459,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     }
 
     pa_sink_ref(s);
+    start = pa_render_profile_start();
 
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
@@ -1195,7 +1470,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = get_mix_info(s, info_stack, &maxinfo);
+    n = fill_mix_info(s, &length, info, maxinfo);
 
     if (n == 0) {
 
@@ -1232,11 +1508,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
         result->memblock = pa_memblock_new(s->core->mempool, length);
 
         ptr = pa_memblock_acquire(result->memblock);
-        result->length = pa_mix(info, n,
-                                ptr, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        result->length = mix_inputs(s, info, n, ptr, length);
         pa_memblock_release(result->memblock);
 
         result->index = 0;
@@ -1244,14 +1516,16 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     inputs_drop(s, info, n, result);
 
+    pa_render_profile_stop(&s->thread_info.render_profile, start);
     pa_sink_unref(s);
 }
 
 /* Called from IO thread context */
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
-    unsigned n;
+    pa_mix_info info_stack[MAX_MIX_CHANNELS], *info;
+    unsigned n, maxinfo;
     size_t length, block_size_max;
+    uint64_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1270,6 +1544,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     }
 
     pa_sink_ref(s);
+    start = pa_render_profile_start();
 
     length = target->length;
     block_size_max = pa_mempool_block_size_max(s->core->mempool);
@@ -1278,7 +1553,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = get_mix_info(s, info_stack, &maxinfo);
+    n = fill_mix_info(s, &length, info, maxinfo);
 
     if (n == 0) {
         if (target->length > length)
@@ -1318,17 +1594,14 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         ptr = pa_memblock_acquire(target->memblock);
 
-        target->length = pa_mix(info, n,
-                                (uint8_t*) ptr + target->index, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        target->length = mix_inputs(s, info, n, (uint8_t*) ptr + target->index, length);
 
         pa_memblock_release(target->memblock);
     }
 
     inputs_drop(s, info, n, target);
 
+    pa_render_profile_stop(&s->thread_info.render_profile, start);
     pa_sink_unref(s);
 }
 
@@ -2558,6 +2831,8 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
                 i->thread_info.sync_next = NULL;
             }
 
+            premix_remove_input(s, i);
+
             pa_hashmap_remove_and_free(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index));
             pa_sink_invalidate_requested_latency(s, true);
             pa_sink_request_rewind(s, (size_t) -1);
@@ -2638,6 +2913,8 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(i->thread_info.attached);
             i->thread_info.attached = false;
 
+            premix_remove_input(s, i);
+
             /* Let's remove the sink input ...*/
             pa_hashmap_remove_and_free(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index));
 
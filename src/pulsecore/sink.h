@@ -41,6 +41,7 @@
 #include <pulsecore/device-port.h>
 #include <pulsecore/card.h>
 #include <pulsecore/queue.h>
+#include <pulsecore/render-profile.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/sink-input.h>
 
@@ -254,11 +255,21 @@ struct pa_sink {
         pa_sink_state_t state;
         pa_hashmap *inputs;
 
+        /* Used instead of the on-stack array when there are more
+         * inputs to mix than fit there. Grown on demand. */
+        struct pa_mix_info *mix_info;
+        unsigned n_mix_info;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
         bool soft_muted:1;
 
+        /* Inputs with identical conversions are mixed at their own
+         * rate and resampled once per group, see fill_mix_info() */
+        bool premix_resampling:1;
+        PA_LLIST_HEAD(pa_sink_premix_group, premix_groups);
+
         /* The requested latency is used for dynamic latency
          * sinks. For fixed latency sinks it is always identical to
          * the fixed_latency. See below. */
@@ -304,6 +315,11 @@ struct pa_sink {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Time spent in pa_sink_render() and pa_sink_render_into(), and
+         * in mixing the inputs, see pa_render_profile_start() */
+        pa_render_profile render_profile;
+        pa_render_profile mix_profile;
     } thread_info;
 
     void *userdata;
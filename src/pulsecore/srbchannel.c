@@ -24,57 +24,11 @@
 #include "srbchannel.h"
 
 #include <pulsecore/atomic.h>
+#include <pulsecore/ringbuffer.h>
 #include <pulse/xmalloc.h>
 
 /* #define DEBUG_SRBCHANNEL */
 
-/* This ringbuffer might be useful in other contexts too, but
- * right now it's only used inside the srbchannel, so let's keep it here
- * for the time being. */
-typedef struct pa_ringbuffer pa_ringbuffer;
-
-struct pa_ringbuffer {
-    pa_atomic_t *count; /* amount of data in the buffer */
-    int capacity;
-    uint8_t *memory;
-    int readindex, writeindex;
-};
-
-static void *pa_ringbuffer_peek(pa_ringbuffer *r, int *count) {
-    int c = pa_atomic_load(r->count);
-
-    if (r->readindex + c > r->capacity)
-        *count = r->capacity - r->readindex;
-    else
-        *count = c;
-
-    return r->memory + r->readindex;
-}
-
-/* Returns true only if the buffer was completely full before the drop. */
-static bool pa_ringbuffer_drop(pa_ringbuffer *r, int count) {
-    bool b = pa_atomic_sub(r->count, count) >= r->capacity;
-
-    r->readindex += count;
-    r->readindex %= r->capacity;
-
-    return b;
-}
-
-static void *pa_ringbuffer_begin_write(pa_ringbuffer *r, int *count) {
-    int c = pa_atomic_load(r->count);
-
-    *count = PA_MIN(r->capacity - r->writeindex, r->capacity - c);
-
-    return r->memory + r->writeindex;
-}
-
-static void pa_ringbuffer_end_write(pa_ringbuffer *r, int count) {
-    pa_atomic_add(r->count, count);
-    r->writeindex += count;
-    r->writeindex %= r->capacity;
-}
-
 struct pa_srbchannel {
     pa_ringbuffer rb_read, rb_write;
     pa_fdsem *sem_read, *sem_write;
@@ -86,6 +40,11 @@ struct pa_srbchannel {
     pa_io_event *read_event;
     pa_defer_event *defer_event;
     pa_mainloop_api *mainloop;
+
+    /* While in a batch, writes only set signal_pending, and the other
+     * side is woken up once at the end */
+    bool batch:1;
+    bool signal_pending:1;
 };
 
 /* We always listen to sem_read, and always signal on sem_write.
@@ -120,14 +79,47 @@ size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
         data = (uint8_t*) data + towrite;
         l -= towrite;
     }
+    /* In a batch, the other side is woken up at the end, unless the buffer
+     * ran full and it needs to start reading right away */
+    if (sr->batch && l == 0) {
+        sr->signal_pending = true;
+        return written;
+    }
+
 #ifdef DEBUG_SRBCHANNEL
     pa_log("Wrote %d bytes to srbchannel, signalling fdsem", (int) written);
 #endif
 
+    sr->signal_pending = false;
     pa_fdsem_post(sr->sem_write);
     return written;
 }
 
+void pa_srbchannel_begin_batch(pa_srbchannel *sr) {
+    pa_assert(sr);
+
+    sr->batch = true;
+}
+
+void pa_srbchannel_end_batch(pa_srbchannel *sr) {
+    pa_assert(sr);
+
+    if (!sr->batch)
+        return;
+
+    sr->batch = false;
+
+    if (!sr->signal_pending)
+        return;
+
+#ifdef DEBUG_SRBCHANNEL
+    pa_log("Batch written to srbchannel, signalling fdsem");
+#endif
+
+    sr->signal_pending = false;
+    pa_fdsem_post(sr->sem_write);
+}
+
 size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
     size_t isread = 0;
 
@@ -360,6 +352,9 @@ void pa_srbchannel_free(pa_srbchannel *sr)
 #endif
     pa_assert(sr);
 
+    /* Whatever is left in the buffer should still be read */
+    pa_srbchannel_end_batch(sr);
+
     if (sr->defer_event)
         sr->mainloop->defer_free(sr->defer_event);
     if (sr->read_event)
@@ -45,6 +45,12 @@ void pa_srbchannel_export(pa_srbchannel *sr, pa_srbchannel_template *t);
 size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l);
 size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l);
 
+/* Writes between these two calls wake up the other side only once, when
+ * the batch ends (or when the buffer runs full), so that it can read all
+ * of them in one go. end_batch() without a batch does nothing. */
+void pa_srbchannel_begin_batch(pa_srbchannel *sr);
+void pa_srbchannel_end_batch(pa_srbchannel *sr);
+
 /* Set the callback function that is called whenever data becomes available for reading.
  * It can also be called if the output buffer was full and can now be written to.
  *
@@ -22,6 +22,8 @@
 #include <config.h>
 #endif
 
+#include <math.h>
+
 #include <pulsecore/macro.h>
 #include <pulsecore/g711.h>
 #include <pulsecore/endianmacros.h>
@@ -242,6 +244,32 @@ static void pa_volume_s24_32re_c(uint32_t *samples, const int32_t *volumes, unsi
     }
 }
 
+static void pa_volume_s16ne_from_float32ne_c(unsigned n, const float *a, int16_t *b, const float *volumes, unsigned channels) {
+    unsigned channel;
+
+    for (channel = 0; n > 0; n--) {
+        float v = *(a++) * volumes[channel] * (1 << 15);
+
+        *(b++) = (int16_t) PA_CLAMP_UNLIKELY(lrintf(v), -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void pa_volume_s32ne_from_float32ne_c(unsigned n, const float *a, int32_t *b, const float *volumes, unsigned channels) {
+    unsigned channel;
+
+    for (channel = 0; n > 0; n--) {
+        float v = *(a++) * volumes[channel] * (1U << 31);
+
+        *(b++) = (int32_t) PA_CLAMP_UNLIKELY(llrintf(v), -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
 static pa_do_volume_func_t do_volume_table[] = {
     [PA_SAMPLE_U8]        = (pa_do_volume_func_t) pa_volume_u8_c,
     [PA_SAMPLE_ALAW]      = (pa_do_volume_func_t) pa_volume_alaw_c,
@@ -269,3 +297,21 @@ void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func) {
 
     do_volume_table[f] = func;
 }
+
+static pa_do_volume_from_float32ne_func_t do_volume_from_float32ne_table[] = {
+    [PA_SAMPLE_S16NE]     = (pa_do_volume_from_float32ne_func_t) pa_volume_s16ne_from_float32ne_c,
+    [PA_SAMPLE_S32NE]     = (pa_do_volume_from_float32ne_func_t) pa_volume_s32ne_from_float32ne_c,
+    [PA_SAMPLE_MAX]       = NULL
+};
+
+pa_do_volume_from_float32ne_func_t pa_get_volume_from_float32ne_func(pa_sample_format_t f) {
+    pa_assert(pa_sample_format_valid(f));
+
+    return do_volume_from_float32ne_table[f];
+}
+
+void pa_set_volume_from_float32ne_func(pa_sample_format_t f, pa_do_volume_from_float32ne_func_t func) {
+    pa_assert(pa_sample_format_valid(f));
+
+    do_volume_from_float32ne_table[f] = func;
+}
@@ -0,0 +1,191 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-arm.h"
+#include "sample-util.h"
+
+#include <arm_neon.h>
+
+/* Like the SSE versions, these process 8 samples per iteration, with the
+ * volume index stepping through a multiple of the channel count that is at
+ * least 8. The rest is left to the generic functions. */
+
+static pa_do_volume_func_t volume_float32ne_ref, volume_s32ne_ref, volume_s24ne_ref, volume_s24_32ne_ref;
+static pa_do_volume_from_float32ne_func_t volume_s16ne_from_float32ne_ref, volume_s32ne_from_float32ne_ref;
+
+static unsigned volume_stride(unsigned channels) {
+    return ((8 + channels - 1) / channels) * channels;
+}
+
+static void pa_volume_float32ne_neon(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(float), stride = volume_stride(channels), channel = 0;
+
+    for (; n >= 8; n -= 8, samples += 8) {
+        vst1q_f32(samples, vmulq_f32(vld1q_f32(samples), vld1q_f32(volumes + channel)));
+        vst1q_f32(samples + 4, vmulq_f32(vld1q_f32(samples + 4), vld1q_f32(volumes + channel + 4)));
+
+        if ((channel += 8) >= stride)
+            channel -= stride;
+    }
+
+    if (n)
+        volume_float32ne_ref(samples, volumes + channel % channels, channels, n * sizeof(float));
+}
+
+/* The 64 bit product is shifted, saturated and narrowed in one go, exactly
+ * like the C version does it */
+static inline int32x4_t volume_s32(int32x4_t s, const int32_t *volumes) {
+    int32x4_t v = vld1q_s32(volumes);
+    int64x2_t lo = vmull_s32(vget_low_s32(s), vget_low_s32(v));
+    int64x2_t hi = vmull_s32(vget_high_s32(s), vget_high_s32(v));
+
+    return vcombine_s32(vqshrn_n_s64(lo, 16), vqshrn_n_s64(hi, 16));
+}
+
+static void pa_volume_s32ne_neon(int32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(int32_t), stride = volume_stride(channels), channel = 0;
+
+    for (; n >= 8; n -= 8, samples += 8) {
+        vst1q_s32(samples, volume_s32(vld1q_s32(samples), volumes + channel));
+        vst1q_s32(samples + 4, volume_s32(vld1q_s32(samples + 4), volumes + channel + 4));
+
+        if ((channel += 8) >= stride)
+            channel -= stride;
+    }
+
+    if (n)
+        volume_s32ne_ref(samples, volumes + channel % channels, channels, n * sizeof(int32_t));
+}
+
+static inline uint32x4_t volume_s24_32(uint32x4_t s, const int32_t *volumes) {
+    int32x4_t t = volume_s32(vreinterpretq_s32_u32(vshlq_n_u32(s, 8)), volumes);
+
+    return vshrq_n_u32(vreinterpretq_u32_s32(t), 8);
+}
+
+static void pa_volume_s24_32ne_neon(uint32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / sizeof(uint32_t), stride = volume_stride(channels), channel = 0;
+
+    for (; n >= 8; n -= 8, samples += 8) {
+        vst1q_u32(samples, volume_s24_32(vld1q_u32(samples), volumes + channel));
+        vst1q_u32(samples + 4, volume_s24_32(vld1q_u32(samples + 4), volumes + channel + 4));
+
+        if ((channel += 8) >= stride)
+            channel -= stride;
+    }
+
+    if (n)
+        volume_s24_32ne_ref(samples, volumes + channel % channels, channels, n * sizeof(uint32_t));
+}
+
+#ifndef WORDS_BIGENDIAN
+/* The three bytes of 8 samples are loaded into separate registers, and
+ * widened to the upper 24 bits of 8 dwords */
+static void pa_volume_s24ne_neon(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned n = length / 3, stride = volume_stride(channels), channel = 0;
+
+    for (; n >= 8; n -= 8, samples += 24) {
+        uint8x8x3_t b = vld3_u8(samples);
+        uint16x8_t lo = vshll_n_u8(b.val[0], 8);
+        uint16x8_t hi = vorrq_u16(vmovl_u8(b.val[1]), vshll_n_u8(b.val[2], 8));
+        uint16x8x2_t s = vzipq_u16(lo, hi);
+        int32x4_t t0, t1;
+
+        t0 = volume_s32(vreinterpretq_s32_u16(s.val[0]), volumes + channel);
+        t1 = volume_s32(vreinterpretq_s32_u16(s.val[1]), volumes + channel + 4);
+
+        s = vuzpq_u16(vreinterpretq_u16_s32(t0), vreinterpretq_u16_s32(t1));
+        b.val[0] = vshrn_n_u16(s.val[0], 8);
+        b.val[1] = vmovn_u16(s.val[1]);
+        b.val[2] = vshrn_n_u16(s.val[1], 8);
+        vst3_u8(samples, b);
+
+        if ((channel += 8) >= stride)
+            channel -= stride;
+    }
+
+    if (n)
+        volume_s24ne_ref(samples, volumes + channel % channels, channels, n * 3);
+}
+#endif
+
+/* The conversions saturate, and round like pa_convert_func_init_neon()'s
+ * do, which may be off by one from lrintf() */
+static void pa_volume_s16ne_from_float32ne_neon(unsigned n, const float *a, int16_t *b, const float *volumes, unsigned channels) {
+    unsigned stride = volume_stride(channels), channel = 0;
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        float32x4_t f0 = vmulq_f32(vld1q_f32(a), vld1q_f32(volumes + channel));
+        float32x4_t f1 = vmulq_f32(vld1q_f32(a + 4), vld1q_f32(volumes + channel + 4));
+
+        vst1q_s16(b, vcombine_s16(vqrshrn_n_s32(vcvtq_n_s32_f32(f0, 31), 16),
+                                  vqrshrn_n_s32(vcvtq_n_s32_f32(f1, 31), 16)));
+
+        if ((channel += 8) >= stride)
+            channel -= stride;
+    }
+
+    if (n)
+        volume_s16ne_from_float32ne_ref(n, a, b, volumes + channel % channels, channels);
+}
+
+static void pa_volume_s32ne_from_float32ne_neon(unsigned n, const float *a, int32_t *b, const float *volumes, unsigned channels) {
+    unsigned stride = volume_stride(channels), channel = 0;
+
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        float32x4_t f0 = vmulq_f32(vld1q_f32(a), vld1q_f32(volumes + channel));
+        float32x4_t f1 = vmulq_f32(vld1q_f32(a + 4), vld1q_f32(volumes + channel + 4));
+
+        vst1q_s32(b, vcvtq_n_s32_f32(f0, 31));
+        vst1q_s32(b + 4, vcvtq_n_s32_f32(f1, 31));
+
+        if ((channel += 8) >= stride)
+            channel -= stride;
+    }
+
+    if (n)
+        volume_s32ne_from_float32ne_ref(n, a, b, volumes + channel % channels, channels);
+}
+
+void pa_volume_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized float32, s32 and s24 volume functions.");
+
+    if (!volume_float32ne_ref) {
+        volume_float32ne_ref = pa_get_volume_func(PA_SAMPLE_FLOAT32NE);
+        volume_s32ne_ref = pa_get_volume_func(PA_SAMPLE_S32NE);
+        volume_s24ne_ref = pa_get_volume_func(PA_SAMPLE_S24NE);
+        volume_s24_32ne_ref = pa_get_volume_func(PA_SAMPLE_S24_32NE);
+        volume_s16ne_from_float32ne_ref = pa_get_volume_from_float32ne_func(PA_SAMPLE_S16NE);
+        volume_s32ne_from_float32ne_ref = pa_get_volume_from_float32ne_func(PA_SAMPLE_S32NE);
+    }
+
+    pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_neon);
+    pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_neon);
+    pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_neon);
+#ifndef WORDS_BIGENDIAN
+    pa_set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_neon);
+#endif
+    pa_set_volume_from_float32ne_func(PA_SAMPLE_S16NE, (pa_do_volume_from_float32ne_func_t) pa_volume_s16ne_from_float32ne_neon);
+    pa_set_volume_from_float32ne_func(PA_SAMPLE_S32NE, (pa_do_volume_from_float32ne_func_t) pa_volume_s32ne_from_float32ne_neon);
+}
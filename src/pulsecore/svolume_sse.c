@@ -249,6 +249,547 @@ static void pa_volume_s16re_sse2(int16_t *samples, const int32_t *volumes, unsig
     );
 }
 
+
+/* The functions below process 8 samples per iteration. The volume of the
+ * first of them is at volumes[channel], where channel steps through a
+ * multiple of the channel count that is at least 8, so that the volumes
+ * can always be loaded as a whole vector from the padded array. What is
+ * left over is done by the generic function, starting with the volume of
+ * the channel we arrived at. */
+#define MOD_ADD_STRIDE(a) \
+      " add $"#a", %[channel]        \n\t" /* channel += inc          */ \
+      " mov %[channel], %[temp]      \n\t"                               \
+      " sub %[stride], %[temp]       \n\t" /* tmp = channel - stride  */ \
+      " cmovae %[temp], %[channel]   \n\t" /* if (tmp >= 0) channel = tmp */
+
+static unsigned volume_stride(unsigned channels) {
+    return ((8 + channels - 1) / channels) * channels;
+}
+
+static pa_do_volume_func_t volume_float32ne_ref, volume_s32ne_ref, volume_s24ne_ref, volume_s24_32ne_ref;
+static pa_do_volume_from_float32ne_func_t volume_s16ne_from_float32ne_ref, volume_s32ne_from_float32ne_ref;
+
+static const PA_DECLARE_ALIGNED (16, float, s16_scale[4]) = { 0x8000, 0x8000, 0x8000, 0x8000 };
+static const PA_DECLARE_ALIGNED (16, float, s16_min[4]) = { -0x8000, -0x8000, -0x8000, -0x8000 };
+static const PA_DECLARE_ALIGNED (16, float, s16_max[4]) = { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF };
+static const PA_DECLARE_ALIGNED (16, float, s32_scale[4]) = { 2147483648.0f, 2147483648.0f, 2147483648.0f, 2147483648.0f };
+
+/* The 32 bit formats are scaled in double precision, which is exact as long
+ * as the product of sample and 16.16 volume fits the 53 bit mantissa. The
+ * floor() of the C version's shift is done by rounding to nearest after
+ * subtracting just less than one half. Louder volumes are left to the
+ * generic function. */
+#define S32_VOLUME_MAX (1 << 22)
+
+static const PA_DECLARE_ALIGNED (16, double, s32_bias[2]) = { -0.5 + 1.0 / (1 << 17), -0.5 + 1.0 / (1 << 17) };
+static const PA_DECLARE_ALIGNED (16, double, s32_min[2]) = { -2147483648.0, -2147483648.0 };
+static const PA_DECLARE_ALIGNED (16, double, s32_max[2]) = { 2147483647.0, 2147483647.0 };
+
+/* Unpacks 4 s24 samples to the upper 24 bits of 4 dwords, and back */
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24_unpack[16]) = {
+    0x80, 0, 1, 2, 0x80, 3, 4, 5, 0x80, 6, 7, 8, 0x80, 9, 10, 11
+};
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24_pack[16]) = {
+    1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, 0x80, 0x80, 0x80, 0x80
+};
+
+static bool setup_double_volumes(double *dv, const int32_t *volumes, unsigned channels, unsigned stride) {
+    unsigned c;
+
+    for (c = 0; c < channels; c++)
+        if (volumes[c] >= S32_VOLUME_MAX)
+            return false;
+
+    for (c = 0; c < stride + 8; c++)
+        dv[c] = volumes[c % channels] * (1.0 / 0x10000);
+
+    return true;
+}
+
+static void pa_volume_float32ne_sse2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    pa_reg_x86 channel = 0, temp, blocks = length / 32;
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            "1:                                         \n\t"
+            " movups (%[volumes],%[channel],4), %%xmm0  \n\t"
+            " movups 16(%[volumes],%[channel],4), %%xmm1 \n\t"
+            " movups (%[samples]), %%xmm2               \n\t"
+            " movups 16(%[samples]), %%xmm3             \n\t"
+            " mulps %%xmm0, %%xmm2                      \n\t"
+            " mulps %%xmm1, %%xmm3                      \n\t"
+            " movups %%xmm2, (%[samples])               \n\t"
+            " movups %%xmm3, 16(%[samples])             \n\t"
+            " add $32, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            : [samples] "+r" (samples), [channel] "+r" (channel), [temp] "=&r" (temp)
+            : [volumes] "r" (volumes), [end] "rm" (samples + blocks * 8),
+              [stride] "rm" ((pa_reg_x86) volume_stride(channels))
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+    }
+
+    if (length % 32)
+        volume_float32ne_ref(samples, volumes + channel % channels, channels, length % 32);
+}
+
+#define VOLUME_S32_SSE2(o)                    /* xmm0: 4 samples -> xmm1 */ \
+      " cvtdq2pd %%xmm0, %%xmm1              \n\t"                          \
+      " pshufd $0xee, %%xmm0, %%xmm0         \n\t"                          \
+      " cvtdq2pd %%xmm0, %%xmm0              \n\t"                          \
+      " movupd "#o"(%[dv],%[channel],8), %%xmm2 \n\t"                       \
+      " movupd "#o"+16(%[dv],%[channel],8), %%xmm3 \n\t"                    \
+      " mulpd %%xmm2, %%xmm1                 \n\t"                          \
+      " mulpd %%xmm3, %%xmm0                 \n\t"                          \
+      " addpd %%xmm5, %%xmm1                 \n\t"                          \
+      " addpd %%xmm5, %%xmm0                 \n\t"                          \
+      " maxpd %%xmm6, %%xmm1                 \n\t"                          \
+      " maxpd %%xmm6, %%xmm0                 \n\t"                          \
+      " minpd %%xmm7, %%xmm1                 \n\t"                          \
+      " minpd %%xmm7, %%xmm0                 \n\t"                          \
+      " cvtpd2dq %%xmm1, %%xmm1              \n\t"                          \
+      " cvtpd2dq %%xmm0, %%xmm0              \n\t"                          \
+      " punpcklqdq %%xmm0, %%xmm1            \n\t"
+
+#define VOLUME_S32_LOAD_CONSTANTS_SSE2 \
+      " movapd %[bias], %%xmm5               \n\t" \
+      " movapd %[min], %%xmm6                \n\t" \
+      " movapd %[max], %%xmm7                \n\t"
+
+#define VOLUME_S32_OPERANDS(e) \
+      : [samples] "+r" (samples), [channel] "+r" (channel), [temp] "=&r" (temp) \
+      : [dv] "r" (dv), [end] "rm" (e), [stride] "rm" ((pa_reg_x86) stride),    \
+        [bias] "m" (*s32_bias), [min] "m" (*s32_min), [max] "m" (*s32_max)
+
+static void pa_volume_s32ne_sse2(int32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    double dv[PA_CHANNELS_MAX + 16];
+    unsigned stride = volume_stride(channels);
+    pa_reg_x86 channel = 0, temp, blocks = length / 32;
+
+    if (!setup_double_volumes(dv, volumes, channels, stride)) {
+        volume_s32ne_ref(samples, volumes, channels, length);
+        return;
+    }
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            VOLUME_S32_LOAD_CONSTANTS_SSE2
+            "1:                                         \n\t"
+            " movdqu (%[samples]), %%xmm0               \n\t"
+            VOLUME_S32_SSE2(0)
+            " movdqu %%xmm1, (%[samples])               \n\t"
+            " movdqu 16(%[samples]), %%xmm0             \n\t"
+            VOLUME_S32_SSE2(32)
+            " movdqu %%xmm1, 16(%[samples])             \n\t"
+            " add $32, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            VOLUME_S32_OPERANDS(samples + blocks * 8)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    if (length % 32)
+        volume_s32ne_ref(samples, volumes + channel % channels, channels, length % 32);
+}
+
+static void pa_volume_s24_32ne_sse2(uint32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    double dv[PA_CHANNELS_MAX + 16];
+    unsigned stride = volume_stride(channels);
+    pa_reg_x86 channel = 0, temp, blocks = length / 32;
+
+    if (!setup_double_volumes(dv, volumes, channels, stride)) {
+        volume_s24_32ne_ref(samples, volumes, channels, length);
+        return;
+    }
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            VOLUME_S32_LOAD_CONSTANTS_SSE2
+            "1:                                         \n\t"
+            " movdqu (%[samples]), %%xmm0               \n\t"
+            " pslld $8, %%xmm0                          \n\t"
+            VOLUME_S32_SSE2(0)
+            " psrld $8, %%xmm1                          \n\t"
+            " movdqu %%xmm1, (%[samples])               \n\t"
+            " movdqu 16(%[samples]), %%xmm0             \n\t"
+            " pslld $8, %%xmm0                          \n\t"
+            VOLUME_S32_SSE2(32)
+            " psrld $8, %%xmm1                          \n\t"
+            " movdqu %%xmm1, 16(%[samples])             \n\t"
+            " add $32, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            VOLUME_S32_OPERANDS(samples + blocks * 8)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    if (length % 32)
+        volume_s24_32ne_ref(samples, volumes + channel % channels, channels, length % 32);
+}
+
+/* 16 bytes are loaded for every 4 samples, so the last 4 bytes are left to
+ * the generic function */
+static void pa_volume_s24ne_ssse3(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    double dv[PA_CHANNELS_MAX + 16];
+    unsigned stride = volume_stride(channels);
+    pa_reg_x86 channel = 0, temp, blocks = length >= 4 ? (length - 4) / 24 : 0;
+
+    if (!setup_double_volumes(dv, volumes, channels, stride)) {
+        volume_s24ne_ref(samples, volumes, channels, length);
+        return;
+    }
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            VOLUME_S32_LOAD_CONSTANTS_SSE2
+            " movdqa %[unpack], %%xmm4                  \n\t"
+            "1:                                         \n\t"
+            " movdqu (%[samples]), %%xmm0               \n\t"
+            " pshufb %%xmm4, %%xmm0                     \n\t"
+            VOLUME_S32_SSE2(0)
+            " pshufb %[pack], %%xmm1                    \n\t"
+            " movq %%xmm1, (%[samples])                 \n\t"
+            " psrldq $8, %%xmm1                         \n\t"
+            " movd %%xmm1, 8(%[samples])                \n\t"
+            " movdqu 12(%[samples]), %%xmm0             \n\t"
+            " pshufb %%xmm4, %%xmm0                     \n\t"
+            VOLUME_S32_SSE2(32)
+            " pshufb %[pack], %%xmm1                    \n\t"
+            " movq %%xmm1, 12(%[samples])               \n\t"
+            " psrldq $8, %%xmm1                         \n\t"
+            " movd %%xmm1, 20(%[samples])               \n\t"
+            " add $24, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            VOLUME_S32_OPERANDS(samples + blocks * 24),
+              [unpack] "m" (*s24_unpack), [pack] "m" (*s24_pack)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    length -= blocks * 24;
+    if (length)
+        volume_s24ne_ref(samples, volumes + channel % channels, channels, length);
+}
+
+static void pa_volume_s16ne_from_float32ne_sse2(unsigned n, const float *a, int16_t *b, const float *volumes, unsigned channels) {
+    pa_reg_x86 channel = 0, temp, blocks = n / 8;
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            " movaps %[scale], %%xmm5                   \n\t"
+            " movaps %[min], %%xmm6                     \n\t"
+            " movaps %[max], %%xmm7                     \n\t"
+            "1:                                         \n\t"
+            " movups (%[a]), %%xmm0                     \n\t"
+            " movups 16(%[a]), %%xmm1                   \n\t"
+            " movups (%[volumes],%[channel],4), %%xmm2  \n\t"
+            " movups 16(%[volumes],%[channel],4), %%xmm3 \n\t"
+            " mulps %%xmm2, %%xmm0                      \n\t"
+            " mulps %%xmm3, %%xmm1                      \n\t"
+            " mulps %%xmm5, %%xmm0                      \n\t"
+            " mulps %%xmm5, %%xmm1                      \n\t"
+            " maxps %%xmm6, %%xmm0                      \n\t" /* clamp before converting, */
+            " maxps %%xmm6, %%xmm1                      \n\t" /* large values would wrap */
+            " minps %%xmm7, %%xmm0                      \n\t"
+            " minps %%xmm7, %%xmm1                      \n\t"
+            " cvtps2dq %%xmm0, %%xmm0                   \n\t"
+            " cvtps2dq %%xmm1, %%xmm1                   \n\t"
+            " packssdw %%xmm1, %%xmm0                   \n\t"
+            " movdqu %%xmm0, (%[b])                     \n\t"
+            " add $32, %[a]                             \n\t"
+            " add $16, %[b]                             \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[a]                          \n\t"
+            " jb 1b                                     \n\t"
+            : [a] "+r" (a), [b] "+r" (b), [channel] "+r" (channel), [temp] "=&r" (temp)
+            : [volumes] "r" (volumes), [end] "rm" (a + blocks * 8),
+              [stride] "rm" ((pa_reg_x86) volume_stride(channels)),
+              [scale] "m" (*s16_scale), [min] "m" (*s16_min), [max] "m" (*s16_max)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    if (n % 8)
+        volume_s16ne_from_float32ne_ref(n % 8, a, b, volumes + channel % channels, channels);
+}
+
+/* cvtps2dq returns 0x80000000 for everything out of range. For positive
+ * values that is corrected to 0x7fffffff by xoring with the comparison. */
+static void pa_volume_s32ne_from_float32ne_sse2(unsigned n, const float *a, int32_t *b, const float *volumes, unsigned channels) {
+    pa_reg_x86 channel = 0, temp, blocks = n / 8;
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            " movaps %[scale], %%xmm5                   \n\t"
+            "1:                                         \n\t"
+            " movups (%[a]), %%xmm0                     \n\t"
+            " movups 16(%[a]), %%xmm1                   \n\t"
+            " movups (%[volumes],%[channel],4), %%xmm2  \n\t"
+            " movups 16(%[volumes],%[channel],4), %%xmm3 \n\t"
+            " mulps %%xmm2, %%xmm0                      \n\t"
+            " mulps %%xmm3, %%xmm1                      \n\t"
+            " mulps %%xmm5, %%xmm0                      \n\t"
+            " mulps %%xmm5, %%xmm1                      \n\t"
+            " movaps %%xmm5, %%xmm2                     \n\t"
+            " movaps %%xmm5, %%xmm3                     \n\t"
+            " cmpleps %%xmm0, %%xmm2                    \n\t" /* 2^31 <= v */
+            " cmpleps %%xmm1, %%xmm3                    \n\t"
+            " cvtps2dq %%xmm0, %%xmm0                   \n\t"
+            " cvtps2dq %%xmm1, %%xmm1                   \n\t"
+            " pxor %%xmm2, %%xmm0                       \n\t"
+            " pxor %%xmm3, %%xmm1                       \n\t"
+            " movdqu %%xmm0, (%[b])                     \n\t"
+            " movdqu %%xmm1, 16(%[b])                   \n\t"
+            " add $32, %[a]                             \n\t"
+            " add $32, %[b]                             \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[a]                          \n\t"
+            " jb 1b                                     \n\t"
+            : [a] "+r" (a), [b] "+r" (b), [channel] "+r" (channel), [temp] "=&r" (temp)
+            : [volumes] "r" (volumes), [end] "rm" (a + blocks * 8),
+              [stride] "rm" ((pa_reg_x86) volume_stride(channels)),
+              [scale] "m" (*s32_scale)
+            : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm5"
+        );
+    }
+
+    if (n % 8)
+        volume_s32ne_from_float32ne_ref(n % 8, a, b, volumes + channel % channels, channels);
+}
+
+/* The AVX versions do the same in 256 bit registers. The integer work stays
+ * in 128 bit registers, so none of them needs AVX2. */
+
+static void pa_volume_float32ne_avx(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    pa_reg_x86 channel = 0, temp, blocks = length / 32;
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            "1:                                         \n\t"
+            " vmovups (%[volumes],%[channel],4), %%ymm0 \n\t"
+            " vmulps (%[samples]), %%ymm0, %%ymm0       \n\t"
+            " vmovups %%ymm0, (%[samples])              \n\t"
+            " add $32, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            " vzeroupper                                \n\t"
+            : [samples] "+r" (samples), [channel] "+r" (channel), [temp] "=&r" (temp)
+            : [volumes] "r" (volumes), [end] "rm" (samples + blocks * 8),
+              [stride] "rm" ((pa_reg_x86) volume_stride(channels))
+            : "memory", "cc", "xmm0"
+        );
+    }
+
+    if (length % 32)
+        volume_float32ne_ref(samples, volumes + channel % channels, channels, length % 32);
+}
+
+#define VOLUME_S32_AVX(o, r)                  /* xmm<r>: 4 samples -> xmm<r> */ \
+      " vcvtdq2pd %%xmm"#r", %%ymm"#r"       \n\t"                             \
+      " vmulpd "#o"(%[dv],%[channel],8), %%ymm"#r", %%ymm"#r" \n\t"            \
+      " vaddpd %%ymm5, %%ymm"#r", %%ymm"#r"  \n\t"                             \
+      " vmaxpd %%ymm6, %%ymm"#r", %%ymm"#r"  \n\t"                             \
+      " vminpd %%ymm7, %%ymm"#r", %%ymm"#r"  \n\t"                             \
+      " vcvtpd2dq %%ymm"#r", %%xmm"#r"       \n\t"
+
+#define VOLUME_S32_LOAD_CONSTANTS_AVX \
+      " vbroadcastsd %[bias], %%ymm5         \n\t" \
+      " vbroadcastsd %[min], %%ymm6          \n\t" \
+      " vbroadcastsd %[max], %%ymm7          \n\t"
+
+static void pa_volume_s32ne_avx(int32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    double dv[PA_CHANNELS_MAX + 16];
+    unsigned stride = volume_stride(channels);
+    pa_reg_x86 channel = 0, temp, blocks = length / 32;
+
+    if (!setup_double_volumes(dv, volumes, channels, stride)) {
+        volume_s32ne_ref(samples, volumes, channels, length);
+        return;
+    }
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            VOLUME_S32_LOAD_CONSTANTS_AVX
+            "1:                                         \n\t"
+            " vmovdqu (%[samples]), %%xmm0              \n\t"
+            " vmovdqu 16(%[samples]), %%xmm1            \n\t"
+            VOLUME_S32_AVX(0, 0)
+            VOLUME_S32_AVX(32, 1)
+            " vmovdqu %%xmm0, (%[samples])              \n\t"
+            " vmovdqu %%xmm1, 16(%[samples])            \n\t"
+            " add $32, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            " vzeroupper                                \n\t"
+            VOLUME_S32_OPERANDS(samples + blocks * 8)
+            : "memory", "cc", "xmm0", "xmm1", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    if (length % 32)
+        volume_s32ne_ref(samples, volumes + channel % channels, channels, length % 32);
+}
+
+static void pa_volume_s24_32ne_avx(uint32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    double dv[PA_CHANNELS_MAX + 16];
+    unsigned stride = volume_stride(channels);
+    pa_reg_x86 channel = 0, temp, blocks = length / 32;
+
+    if (!setup_double_volumes(dv, volumes, channels, stride)) {
+        volume_s24_32ne_ref(samples, volumes, channels, length);
+        return;
+    }
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            VOLUME_S32_LOAD_CONSTANTS_AVX
+            "1:                                         \n\t"
+            " vmovdqu (%[samples]), %%xmm0              \n\t"
+            " vmovdqu 16(%[samples]), %%xmm1            \n\t"
+            " vpslld $8, %%xmm0, %%xmm0                 \n\t"
+            " vpslld $8, %%xmm1, %%xmm1                 \n\t"
+            VOLUME_S32_AVX(0, 0)
+            VOLUME_S32_AVX(32, 1)
+            " vpsrld $8, %%xmm0, %%xmm0                 \n\t"
+            " vpsrld $8, %%xmm1, %%xmm1                 \n\t"
+            " vmovdqu %%xmm0, (%[samples])              \n\t"
+            " vmovdqu %%xmm1, 16(%[samples])            \n\t"
+            " add $32, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            " vzeroupper                                \n\t"
+            VOLUME_S32_OPERANDS(samples + blocks * 8)
+            : "memory", "cc", "xmm0", "xmm1", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    if (length % 32)
+        volume_s24_32ne_ref(samples, volumes + channel % channels, channels, length % 32);
+}
+
+static void pa_volume_s24ne_avx(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    double dv[PA_CHANNELS_MAX + 16];
+    unsigned stride = volume_stride(channels);
+    pa_reg_x86 channel = 0, temp, blocks = length >= 4 ? (length - 4) / 24 : 0;
+
+    if (!setup_double_volumes(dv, volumes, channels, stride)) {
+        volume_s24ne_ref(samples, volumes, channels, length);
+        return;
+    }
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            VOLUME_S32_LOAD_CONSTANTS_AVX
+            " vmovdqa %[unpack], %%xmm3                 \n\t"
+            " vmovdqa %[pack], %%xmm4                   \n\t"
+            "1:                                         \n\t"
+            " vmovdqu (%[samples]), %%xmm0              \n\t"
+            " vmovdqu 12(%[samples]), %%xmm1            \n\t"
+            " vpshufb %%xmm3, %%xmm0, %%xmm0            \n\t"
+            " vpshufb %%xmm3, %%xmm1, %%xmm1            \n\t"
+            VOLUME_S32_AVX(0, 0)
+            VOLUME_S32_AVX(32, 1)
+            " vpshufb %%xmm4, %%xmm0, %%xmm0            \n\t"
+            " vpshufb %%xmm4, %%xmm1, %%xmm1            \n\t"
+            " vmovq %%xmm0, (%[samples])                \n\t"
+            " vpextrd $2, %%xmm0, 8(%[samples])         \n\t"
+            " vmovq %%xmm1, 12(%[samples])              \n\t"
+            " vpextrd $2, %%xmm1, 20(%[samples])        \n\t"
+            " add $24, %[samples]                       \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[samples]                    \n\t"
+            " jb 1b                                     \n\t"
+            " vzeroupper                                \n\t"
+            VOLUME_S32_OPERANDS(samples + blocks * 24),
+              [unpack] "m" (*s24_unpack), [pack] "m" (*s24_pack)
+            : "memory", "cc", "xmm0", "xmm1", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    length -= blocks * 24;
+    if (length)
+        volume_s24ne_ref(samples, volumes + channel % channels, channels, length);
+}
+
+static void pa_volume_s16ne_from_float32ne_avx(unsigned n, const float *a, int16_t *b, const float *volumes, unsigned channels) {
+    pa_reg_x86 channel = 0, temp, blocks = n / 8;
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            " vbroadcastss %[scale], %%ymm5             \n\t"
+            " vbroadcastss %[min], %%ymm6               \n\t"
+            " vbroadcastss %[max], %%ymm7               \n\t"
+            "1:                                         \n\t"
+            " vmovups (%[a]), %%ymm0                    \n\t"
+            " vmulps (%[volumes],%[channel],4), %%ymm0, %%ymm0 \n\t"
+            " vmulps %%ymm5, %%ymm0, %%ymm0             \n\t"
+            " vmaxps %%ymm6, %%ymm0, %%ymm0             \n\t"
+            " vminps %%ymm7, %%ymm0, %%ymm0             \n\t"
+            " vcvtps2dq %%ymm0, %%ymm0                  \n\t"
+            " vextractf128 $1, %%ymm0, %%xmm1           \n\t"
+            " vpackssdw %%xmm1, %%xmm0, %%xmm0          \n\t"
+            " vmovdqu %%xmm0, (%[b])                    \n\t"
+            " add $32, %[a]                             \n\t"
+            " add $16, %[b]                             \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[a]                          \n\t"
+            " jb 1b                                     \n\t"
+            " vzeroupper                                \n\t"
+            : [a] "+r" (a), [b] "+r" (b), [channel] "+r" (channel), [temp] "=&r" (temp)
+            : [volumes] "r" (volumes), [end] "rm" (a + blocks * 8),
+              [stride] "rm" ((pa_reg_x86) volume_stride(channels)),
+              [scale] "m" (*s16_scale), [min] "m" (*s16_min), [max] "m" (*s16_max)
+            : "memory", "cc", "xmm0", "xmm1", "xmm5", "xmm6", "xmm7"
+        );
+    }
+
+    if (n % 8)
+        volume_s16ne_from_float32ne_ref(n % 8, a, b, volumes + channel % channels, channels);
+}
+
+static void pa_volume_s32ne_from_float32ne_avx(unsigned n, const float *a, int32_t *b, const float *volumes, unsigned channels) {
+    pa_reg_x86 channel = 0, temp, blocks = n / 8;
+
+    if (blocks > 0) {
+        __asm__ __volatile__ (
+            " vbroadcastss %[scale], %%ymm5             \n\t"
+            "1:                                         \n\t"
+            " vmovups (%[a]), %%ymm0                    \n\t"
+            " vmulps (%[volumes],%[channel],4), %%ymm0, %%ymm0 \n\t"
+            " vmulps %%ymm5, %%ymm0, %%ymm0             \n\t"
+            " vcmpleps %%ymm0, %%ymm5, %%ymm1           \n\t" /* 2^31 <= v */
+            " vcvtps2dq %%ymm0, %%ymm0                  \n\t"
+            " vxorps %%ymm1, %%ymm0, %%ymm0             \n\t"
+            " vmovdqu %%ymm0, (%[b])                    \n\t"
+            " add $32, %[a]                             \n\t"
+            " add $32, %[b]                             \n\t"
+            MOD_ADD_STRIDE(8)
+            " cmp %[end], %[a]                          \n\t"
+            " jb 1b                                     \n\t"
+            " vzeroupper                                \n\t"
+            : [a] "+r" (a), [b] "+r" (b), [channel] "+r" (channel), [temp] "=&r" (temp)
+            : [volumes] "r" (volumes), [end] "rm" (a + blocks * 8),
+              [stride] "rm" ((pa_reg_x86) volume_stride(channels)),
+              [scale] "m" (*s32_scale)
+            : "memory", "cc", "xmm0", "xmm1", "xmm5"
+        );
+    }
+
+    if (n % 8)
+        volume_s32ne_from_float32ne_ref(n % 8, a, b, volumes + channel % channels, channels);
+}
+
 #endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
 
 void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
@@ -259,5 +800,36 @@ void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
         pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_sse2);
         pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_sse2);
     }
+
+    if (!volume_float32ne_ref) {
+        volume_float32ne_ref = pa_get_volume_func(PA_SAMPLE_FLOAT32NE);
+        volume_s32ne_ref = pa_get_volume_func(PA_SAMPLE_S32NE);
+        volume_s24ne_ref = pa_get_volume_func(PA_SAMPLE_S24NE);
+        volume_s24_32ne_ref = pa_get_volume_func(PA_SAMPLE_S24_32NE);
+        volume_s16ne_from_float32ne_ref = pa_get_volume_from_float32ne_func(PA_SAMPLE_S16NE);
+        volume_s32ne_from_float32ne_ref = pa_get_volume_from_float32ne_func(PA_SAMPLE_S32NE);
+    }
+
+    if (flags & PA_CPU_X86_AVX) {
+        pa_log_info("Initialising AVX optimized float32, s32 and s24 volume functions.");
+
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_avx);
+        pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_avx);
+        pa_set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_avx);
+        pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_avx);
+        pa_set_volume_from_float32ne_func(PA_SAMPLE_S16NE, (pa_do_volume_from_float32ne_func_t) pa_volume_s16ne_from_float32ne_avx);
+        pa_set_volume_from_float32ne_func(PA_SAMPLE_S32NE, (pa_do_volume_from_float32ne_func_t) pa_volume_s32ne_from_float32ne_avx);
+    } else if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized float32, s32 and s24 volume functions.");
+
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_sse2);
+        pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_sse2);
+        pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_sse2);
+        pa_set_volume_from_float32ne_func(PA_SAMPLE_S16NE, (pa_do_volume_from_float32ne_func_t) pa_volume_s16ne_from_float32ne_sse2);
+        pa_set_volume_from_float32ne_func(PA_SAMPLE_S32NE, (pa_do_volume_from_float32ne_func_t) pa_volume_s32ne_from_float32ne_sse2);
+
+        if (flags & PA_CPU_X86_SSSE3)
+            pa_set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_ssse3);
+    }
 #endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
 }
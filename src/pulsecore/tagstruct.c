@@ -36,6 +36,7 @@
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/packet.h>
 
 #include "tagstruct.h"
 
@@ -51,7 +52,8 @@ struct pa_tagstruct {
     enum {
         PA_TAGSTRUCT_FIXED, /* The tagstruct does not own the data, buffer was provided by caller. */
         PA_TAGSTRUCT_DYNAMIC, /* Buffer owned by tagstruct, data must be freed. */
-        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to dynamic if needed. */
+        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to pooled or dynamic if needed. */
+        PA_TAGSTRUCT_POOLED, /* Data points to a packet pool buffer. Will change to dynamic if needed. */
     } type;
     union {
         uint8_t appended[MAX_APPENDED_SIZE];
@@ -73,6 +75,28 @@ pa_tagstruct *pa_tagstruct_new(void) {
     return t;
 }
 
+pa_tagstruct *pa_tagstruct_new_sized(size_t size_hint) {
+    pa_tagstruct *t;
+
+    if (size_hint <= MAX_APPENDED_SIZE)
+        return pa_tagstruct_new();
+
+    if (!(t = pa_flist_pop(PA_STATIC_FLIST_GET(tagstructs))))
+        t = pa_xnew(pa_tagstruct, 1);
+    t->length = t->rindex = 0;
+
+    if (size_hint <= PA_PACKET_POOL_BUFFER_SIZE) {
+        t->data = pa_packet_buffer_new();
+        t->allocated = PA_PACKET_POOL_BUFFER_SIZE;
+        t->type = PA_TAGSTRUCT_POOLED;
+    } else {
+        t->data = pa_xmalloc(t->allocated = size_hint);
+        t->type = PA_TAGSTRUCT_DYNAMIC;
+    }
+
+    return t;
+}
+
 pa_tagstruct *pa_tagstruct_new_fixed(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
@@ -93,24 +117,77 @@ void pa_tagstruct_free(pa_tagstruct*t) {
 
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
         pa_xfree(t->data);
+    else if (t->type == PA_TAGSTRUCT_POOLED)
+        pa_packet_buffer_free(t->data);
     if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
         pa_xfree(t);
 }
 
-static inline void extend(pa_tagstruct*t, size_t l) {
+pa_packet *pa_tagstruct_free_to_packet(pa_tagstruct *t) {
+    pa_packet *packet;
+
     pa_assert(t);
-    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
+    pa_assert(t->length > 0);
+
+    /* Hand over our buffer where we can, only small ones are copied */
+    switch (t->type) {
+        case PA_TAGSTRUCT_POOLED:
+            packet = pa_packet_new_pooled(t->data, t->length);
+            break;
+        case PA_TAGSTRUCT_DYNAMIC:
+            packet = pa_packet_new_dynamic(t->data, t->length);
+            break;
+        default:
+            packet = pa_packet_new_data(t->data, t->length);
+            break;
+    }
 
-    if (t->length+l <= t->allocated)
+    t->type = PA_TAGSTRUCT_FIXED;
+    pa_tagstruct_free(t);
+
+    return packet;
+}
+
+static void grow(pa_tagstruct *t, size_t l) {
+    size_t n;
+    uint8_t *data;
+
+    if (t->type == PA_TAGSTRUCT_APPENDED && t->length + l <= PA_PACKET_POOL_BUFFER_SIZE) {
+        data = pa_packet_buffer_new();
+        memcpy(data, t->data, t->length);
+        t->data = data;
+        t->allocated = PA_PACKET_POOL_BUFFER_SIZE;
+        t->type = PA_TAGSTRUCT_POOLED;
         return;
+    }
+
+    /* Grow geometrically, large replies are built from many small writes */
+    n = PA_MAX(t->length + l + GROW_TAG_SIZE, t->allocated * 2);
 
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
-        t->data = pa_xrealloc(t->data, t->allocated = t->length + l + GROW_TAG_SIZE);
-    else if (t->type == PA_TAGSTRUCT_APPENDED) {
+        t->data = pa_xrealloc(t->data, n);
+    else {
+        data = pa_xmalloc(n);
+        memcpy(data, t->data, t->length);
+
+        if (t->type == PA_TAGSTRUCT_POOLED)
+            pa_packet_buffer_free(t->data);
+
+        t->data = data;
         t->type = PA_TAGSTRUCT_DYNAMIC;
-        t->data = pa_xmalloc(t->allocated = t->length + l + GROW_TAG_SIZE);
-        memcpy(t->data, t->per_type.appended, t->length);
     }
+
+    t->allocated = n;
+}
+
+static inline void extend(pa_tagstruct*t, size_t l) {
+    pa_assert(t);
+    pa_assert(t->type != PA_TAGSTRUCT_FIXED);
+
+    if (PA_LIKELY(t->length+l <= t->allocated))
+        return;
+
+    grow(t, l);
 }
 
 static void write_u8(pa_tagstruct *t, uint8_t u) {
@@ -31,6 +31,7 @@
 #include <pulse/proplist.h>
 
 #include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
 
 typedef struct pa_tagstruct pa_tagstruct;
 
@@ -61,9 +62,16 @@ enum {
 };
 
 pa_tagstruct *pa_tagstruct_new(void);
+/* Like pa_tagstruct_new(), but starts out with room for about size_hint
+ * bytes, taken from the packet buffer pool if they fit */
+pa_tagstruct *pa_tagstruct_new_sized(size_t size_hint);
 pa_tagstruct *pa_tagstruct_new_fixed(const uint8_t* data, size_t length);
 void pa_tagstruct_free(pa_tagstruct*t);
 
+/* Frees the tagstruct and returns a packet with its data. The buffer is
+ * passed on to the packet instead of copying it unless it is small. */
+pa_packet *pa_tagstruct_free_to_packet(pa_tagstruct *t);
+
 int pa_tagstruct_eof(pa_tagstruct*t);
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l);
 
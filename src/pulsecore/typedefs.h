@@ -28,6 +28,7 @@ typedef struct pa_core pa_core;
 typedef struct pa_device_port pa_device_port;
 typedef struct pa_sink pa_sink;
 typedef struct pa_sink_volume_change pa_sink_volume_change;
+typedef struct pa_sink_premix_group pa_sink_premix_group;
 typedef struct pa_sink_input pa_sink_input;
 typedef struct pa_source pa_source;
 typedef struct pa_source_volume_change pa_source_volume_change;
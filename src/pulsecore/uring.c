@@ -0,0 +1,915 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <linux/io_uring.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/refcnt.h>
+
+#include "uring.h"
+
+#define N_ENTRIES 1024
+#define N_CQ_ENTRIES 8192
+
+/* Must be a power of two */
+#define N_RECV_BUFFERS 256
+#define RECV_BUFFER_SIZE (16*1024)
+#define RECV_BUFFER_GROUP 0
+
+/* Below this, copying into the socket buffer is cheaper than pinning the
+ * pages and waiting for the notification */
+#define ZEROCOPY_MIN (16*1024)
+
+/* The user_data of cancellation requests is the operation with this bit
+ * set, operations are at least pointer aligned */
+#define CANCEL_TAG ((uint64_t) 1)
+
+typedef enum op_type {
+    OP_RECV,
+    OP_SEND
+} op_type_t;
+
+struct pa_uring_op {
+    pa_uring *uring;
+    op_type_t type;
+    int fd;
+
+    pa_uring_cb_t callback;
+    void *userdata;
+
+    /* For sends */
+    const void *data;
+    size_t length;
+    bool zerocopy:1;
+
+    /* The result of a zero-copy send, reported once the kernel is done
+     * with the buffer */
+    int32_t result;
+    bool have_result:1;
+    bool notif_pending:1;
+
+    /* The final callback has been called */
+    bool done:1;
+    bool cancelled:1;
+    bool cancel_pending:1;
+
+    /* A receive that ran out of buffers and is waiting for some to be
+     * given back */
+    bool starved:1;
+
+    PA_LLIST_FIELDS(pa_uring_op);
+};
+
+struct pa_uring {
+    PA_REFCNT_DECLARE;
+
+    pa_mainloop_api *mainloop;
+    pa_io_event *io_event;
+    pa_defer_event *defer_event;
+    int fd;
+
+    /* The submission queue. The kernel consumes entries up to the tail we
+     * publish when we call io_uring_enter(), everything between its head
+     * and our local tail is still ours. */
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head, *sq_tail, *sq_flags, *sq_array;
+    unsigned sq_mask, sq_entries, sq_local_tail;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* The completion queue, may share its mapping with the submission
+     * queue */
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head, *cq_tail, cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* The receive buffers, handed to the kernel through a buffer ring */
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint8_t *recv_buffers;
+    uint16_t buf_tail;
+
+    /* The send buffers, registered with the kernel if possible */
+    uint8_t *send_buffers;
+    size_t send_buffer_size, send_buffers_size;
+    unsigned n_send_buffers;
+    unsigned *free_send_buffers;
+    unsigned n_free_send_buffers;
+    bool send_buffers_registered;
+
+    /* Cleared when the kernel or the socket turns out to not support
+     * zero-copy sends */
+    bool zerocopy;
+
+    PA_LLIST_HEAD(pa_uring_op, starved);
+    PA_LLIST_HEAD(pa_uring_flush_item, flush_items);
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static unsigned n_unsubmitted(pa_uring *u) {
+    return u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static int submit(pa_uring *u) {
+    unsigned n;
+
+    pa_assert(u);
+
+    if ((n = n_unsubmitted(u)) <= 0)
+        return 0;
+
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (uring_enter(u->fd, n, 0, 0) < 0) {
+
+        /* EAGAIN and EBUSY mean the kernel is short on memory or has
+         * completions it couldn't post yet, we try again after reaping */
+        if (errno != EAGAIN && errno != EBUSY && errno != EINTR)
+            pa_log("io_uring_enter() failed: %s", pa_cstrerror(errno));
+
+        return -1;
+    }
+
+    return 0;
+}
+
+static struct io_uring_sqe *get_sqe(pa_uring *u) {
+    struct io_uring_sqe *sqe;
+
+    pa_assert(u);
+
+    if (n_unsubmitted(u) >= u->sq_entries) {
+        submit(u);
+
+        if (n_unsubmitted(u) >= u->sq_entries) {
+            pa_log_warn("io_uring submission queue is full.");
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    sqe = &u->sqes[u->sq_local_tail & u->sq_mask];
+    u->sq_local_tail++;
+
+    memset(sqe, 0, sizeof(*sqe));
+
+    u->mainloop->defer_enable(u->defer_event, 1);
+
+    return sqe;
+}
+
+static pa_uring_op *op_new(pa_uring *u, op_type_t type, int fd, pa_uring_cb_t cb, void *userdata) {
+    pa_uring_op *op;
+
+    op = pa_xnew0(pa_uring_op, 1);
+    op->uring = pa_uring_ref(u);
+    op->type = type;
+    op->fd = fd;
+    op->callback = cb;
+    op->userdata = userdata;
+
+    return op;
+}
+
+static void op_maybe_free(pa_uring_op *op) {
+    pa_uring *u;
+
+    pa_assert(op);
+
+    if (!op->done || op->cancel_pending)
+        return;
+
+    u = op->uring;
+    pa_xfree(op);
+    pa_uring_unref(u);
+}
+
+static void op_finish(pa_uring_op *op, int32_t res) {
+    pa_assert(op);
+    pa_assert(!op->done);
+
+    op->done = true;
+    op->callback(op, res, 0, true, op->userdata);
+
+    op_maybe_free(op);
+}
+
+static int submit_recv(pa_uring_op *op) {
+    struct io_uring_sqe *sqe;
+
+    pa_assert(op);
+    pa_assert(op->type == OP_RECV);
+
+    if (!(sqe = get_sqe(op->uring)))
+        return -1;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = op->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = (uint64_t) (uintptr_t) op;
+
+    return 0;
+}
+
+static int submit_send(pa_uring_op *op) {
+    pa_uring *u = op->uring;
+    struct io_uring_sqe *sqe;
+    int buffer;
+
+    pa_assert(op);
+    pa_assert(op->type == OP_SEND);
+
+    if (!(sqe = get_sqe(u)))
+        return -1;
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = op->fd;
+    sqe->addr = (uint64_t) (uintptr_t) op->data;
+    sqe->len = (uint32_t) op->length;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t) (uintptr_t) op;
+
+    /* op->zerocopy is only set for data in a registered buffer */
+    buffer = op->zerocopy ? (int) (((const uint8_t*) op->data - u->send_buffers) / u->send_buffer_size) : -1;
+
+    if ((op->zerocopy = op->zerocopy && u->zerocopy)) {
+        sqe->opcode = IORING_OP_SEND_ZC;
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = (uint16_t) buffer;
+    }
+
+    return 0;
+}
+
+static void dispatch_recv(pa_uring_op *op, const struct io_uring_cqe *cqe) {
+    pa_uring *u = op->uring;
+
+    if (cqe->res > 0) {
+        unsigned buffer;
+
+        pa_assert(cqe->flags & IORING_CQE_F_BUFFER);
+        buffer = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+        /* Nobody is interested in the data anymore */
+        if (op->cancelled)
+            pa_uring_put_recv_buffer(u, buffer);
+        else
+            op->callback(op, cqe->res, buffer, false, op->userdata);
+    }
+
+    if (cqe->flags & IORING_CQE_F_MORE)
+        return;
+
+    if (op->cancelled)
+        op_finish(op, -ECANCELED);
+
+    else if (cqe->res == -ENOBUFS) {
+        op->starved = true;
+        PA_LLIST_PREPEND(pa_uring_op, u->starved, op);
+
+    } else if (cqe->res > 0) {
+        /* The kernel may end a multishot receive at any time, for example
+         * when the completion queue overflowed */
+        if (submit_recv(op) < 0)
+            op_finish(op, -errno);
+
+    } else
+        op_finish(op, cqe->res);
+}
+
+/* A zero-copy send completes twice, once with the result and once the
+ * kernel doesn't need the buffer anymore. The latter may come first. */
+static void dispatch_send(pa_uring_op *op, const struct io_uring_cqe *cqe) {
+    pa_uring *u = op->uring;
+
+    if (cqe->flags & IORING_CQE_F_NOTIF) {
+        op->notif_pending = false;
+
+        if (op->have_result)
+            op_finish(op, op->result);
+
+        return;
+    }
+
+    if (cqe->flags & IORING_CQE_F_MORE)
+        op->notif_pending = true;
+
+    if (op->zerocopy && !op->cancelled && (cqe->res == -EOPNOTSUPP || cqe->res == -EINVAL)) {
+        /* TCP can do it, but not every socket type */
+        if (u->zerocopy)
+            pa_log_info("Zero-copy sends not supported, copying from now on: %s", pa_cstrerror(-cqe->res));
+
+        u->zerocopy = false;
+        op->zerocopy = false;
+
+        if (submit_send(op) >= 0)
+            return;
+
+        op->result = -errno;
+    } else
+        op->result = cqe->res;
+
+    op->have_result = true;
+
+    if (!op->notif_pending)
+        op_finish(op, op->result);
+}
+
+static void dispatch(pa_uring *u, const struct io_uring_cqe *cqe) {
+    pa_uring_op *op;
+
+    pa_assert(u);
+    pa_assert(cqe);
+
+    if (cqe->user_data & CANCEL_TAG) {
+        op = (pa_uring_op*) (uintptr_t) (cqe->user_data & ~CANCEL_TAG);
+        op->cancel_pending = false;
+        op_maybe_free(op);
+        return;
+    }
+
+    op = (pa_uring_op*) (uintptr_t) cqe->user_data;
+    pa_assert(op);
+
+    if (op->type == OP_RECV)
+        dispatch_recv(op, cqe);
+    else
+        dispatch_send(op, cqe);
+}
+
+static void reap(pa_uring *u) {
+    bool overflow_flushed = false;
+
+    pa_assert(u);
+
+    pa_uring_ref(u);
+
+    for (;;) {
+        unsigned head, tail;
+
+        head = *u->cq_head;
+        tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            /* Completions that didn't fit into the queue are kept by the
+             * kernel and are only moved over when we enter it */
+            if (overflow_flushed || !(__atomic_load_n(u->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW))
+                break;
+
+            uring_enter(u->fd, 0, 0, IORING_ENTER_GETEVENTS);
+            overflow_flushed = true;
+            continue;
+        }
+
+        while (head != tail) {
+            struct io_uring_cqe cqe;
+
+            /* Give the slot back before dispatching, the callbacks may
+             * cause more completions to be posted */
+            cqe = u->cqes[head & u->cq_mask];
+            head++;
+            __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+            dispatch(u, &cqe);
+        }
+
+        overflow_flushed = false;
+    }
+
+    pa_uring_unref(u);
+}
+
+static void io_cb(pa_mainloop_api *m, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    pa_uring *u = userdata;
+
+    pa_assert(u);
+    pa_assert(u->io_event == e);
+
+    reap(u);
+}
+
+static void defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
+    pa_uring *u = userdata;
+    pa_uring_flush_item *i;
+
+    pa_assert(u);
+    pa_assert(u->defer_event == e);
+
+    pa_uring_ref(u);
+
+    while ((i = u->flush_items)) {
+        PA_LLIST_REMOVE(pa_uring_flush_item, u->flush_items, i);
+        i->queued = false;
+
+        i->callback(i);
+    }
+
+    if (submit(u) < 0) {
+        /* The main loop doesn't poll while defer events are enabled, so we
+         * have to make room ourselves */
+        reap(u);
+        submit(u);
+    }
+
+    if (n_unsubmitted(u) <= 0 && !u->flush_items)
+        m->defer_enable(e, 0);
+
+    pa_uring_unref(u);
+}
+
+static int map_rings(pa_uring *u, const struct io_uring_params *p) {
+    unsigned i;
+
+    u->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+        u->sq_ring_size = u->cq_ring_size = PA_MAX(u->sq_ring_size, u->cq_ring_size);
+
+    if ((u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING)) == MAP_FAILED) {
+        u->sq_ring = NULL;
+        return -1;
+    }
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+        u->cq_ring = u->sq_ring;
+    else if ((u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+        u->cq_ring = NULL;
+        return -1;
+    }
+
+    u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    if ((u->sqes = mmap(NULL, u->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES)) == MAP_FAILED) {
+        u->sqes = NULL;
+        return -1;
+    }
+
+    u->sq_head = (unsigned*) ((uint8_t*) u->sq_ring + p->sq_off.head);
+    u->sq_tail = (unsigned*) ((uint8_t*) u->sq_ring + p->sq_off.tail);
+    u->sq_flags = (unsigned*) ((uint8_t*) u->sq_ring + p->sq_off.flags);
+    u->sq_array = (unsigned*) ((uint8_t*) u->sq_ring + p->sq_off.array);
+    u->sq_mask = *(unsigned*) ((uint8_t*) u->sq_ring + p->sq_off.ring_mask);
+    u->sq_entries = p->sq_entries;
+    u->sq_local_tail = *u->sq_tail;
+
+    u->cq_head = (unsigned*) ((uint8_t*) u->cq_ring + p->cq_off.head);
+    u->cq_tail = (unsigned*) ((uint8_t*) u->cq_ring + p->cq_off.tail);
+    u->cq_mask = *(unsigned*) ((uint8_t*) u->cq_ring + p->cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*) ((uint8_t*) u->cq_ring + p->cq_off.cqes);
+
+    /* We always fill the entries in order, so the indirection array can be
+     * set up once */
+    for (i = 0; i < u->sq_entries; i++)
+        u->sq_array[i] = i;
+
+    return 0;
+}
+
+static int setup_recv_buffers(pa_uring *u) {
+    struct io_uring_buf_reg reg;
+    unsigned i;
+
+    u->buf_ring_size = PA_PAGE_ALIGN(N_RECV_BUFFERS * sizeof(struct io_uring_buf));
+    if ((u->buf_ring = mmap(NULL, u->buf_ring_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        u->buf_ring = NULL;
+        return -1;
+    }
+
+    u->recv_buffers = pa_xmalloc(N_RECV_BUFFERS * RECV_BUFFER_SIZE);
+
+    pa_zero(reg);
+    reg.ring_addr = (uint64_t) (uintptr_t) u->buf_ring;
+    reg.ring_entries = N_RECV_BUFFERS;
+    reg.bgid = RECV_BUFFER_GROUP;
+
+    if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return -1;
+
+    for (i = 0; i < N_RECV_BUFFERS; i++)
+        pa_uring_put_recv_buffer(u, i);
+
+    return 0;
+}
+
+static void setup_send_buffers(pa_uring *u, size_t send_buffer_size, unsigned n_send_buffers) {
+    struct iovec *iov;
+    unsigned i;
+
+    u->send_buffer_size = PA_PAGE_ALIGN(send_buffer_size);
+    u->n_send_buffers = n_send_buffers;
+    u->send_buffers_size = u->send_buffer_size * n_send_buffers;
+
+    if ((u->send_buffers = mmap(NULL, u->send_buffers_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        u->send_buffers = NULL;
+        u->n_send_buffers = 0;
+        return;
+    }
+
+    u->free_send_buffers = pa_xnew(unsigned, n_send_buffers);
+    for (i = 0; i < n_send_buffers; i++)
+        u->free_send_buffers[u->n_free_send_buffers++] = n_send_buffers - 1 - i;
+
+    iov = pa_xnew(struct iovec, n_send_buffers);
+    for (i = 0; i < n_send_buffers; i++) {
+        iov[i].iov_base = u->send_buffers + i * u->send_buffer_size;
+        iov[i].iov_len = u->send_buffer_size;
+    }
+
+    /* Registering pins the memory, which counts against RLIMIT_MEMLOCK on
+     * older kernels. We can live without it. */
+    if (uring_register(u->fd, IORING_REGISTER_BUFFERS, iov, n_send_buffers) < 0)
+        pa_log_info("Failed to register io_uring send buffers, sending without them: %s", pa_cstrerror(errno));
+    else
+        u->send_buffers_registered = true;
+
+    pa_xfree(iov);
+}
+
+static int wait_cqe(pa_uring *u, struct io_uring_cqe *cqe) {
+    unsigned head = *u->cq_head;
+
+    while (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+        if (uring_enter(u->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            return -1;
+
+    *cqe = u->cqes[head & u->cq_mask];
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/* Multishot receives need Linux 6.0. Since the kernel only tells about
+ * unsupported flags once the operation runs we try it on a socket pair. */
+static int probe(pa_uring *u) {
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe cqe;
+    bool recv_ok = false;
+    int fds[2], r = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, fds) < 0)
+        return -1;
+
+    pa_assert_se(write(fds[1], "x", 1) == 1);
+
+    /* Hanging up ends the receive after the first round */
+    pa_close(fds[1]);
+
+    pa_assert_se(sqe = get_sqe(u));
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fds[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = 1;
+
+    if (submit(u) < 0)
+        goto finish;
+
+    do {
+        if (wait_cqe(u, &cqe) < 0)
+            goto finish;
+
+        if (cqe.res > 0) {
+            recv_ok = true;
+            pa_uring_put_recv_buffer(u, cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+    } while (cqe.flags & IORING_CQE_F_MORE);
+
+    if (!recv_ok)
+        pa_log_info("io_uring doesn't support multishot receives: %s", pa_cstrerror(cqe.res < 0 ? -cqe.res : EINVAL));
+    else
+        r = 0;
+
+finish:
+    pa_close(fds[0]);
+
+    return r;
+}
+
+static void uring_free(pa_uring *u) {
+    pa_assert(u);
+    pa_assert(!u->starved);
+    pa_assert(!u->flush_items);
+
+    if (u->io_event)
+        u->mainloop->io_free(u->io_event);
+
+    if (u->defer_event)
+        u->mainloop->defer_free(u->defer_event);
+
+    /* Closing the ring also drops the buffer registrations */
+    if (u->fd >= 0)
+        pa_close(u->fd);
+
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+
+    if (u->cq_ring && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+
+    if (u->sq_ring)
+        munmap(u->sq_ring, u->sq_ring_size);
+
+    if (u->buf_ring)
+        munmap(u->buf_ring, u->buf_ring_size);
+
+    if (u->send_buffers)
+        munmap(u->send_buffers, u->send_buffers_size);
+
+    pa_xfree(u->recv_buffers);
+    pa_xfree(u->free_send_buffers);
+    pa_xfree(u);
+}
+
+pa_uring *pa_uring_new(pa_mainloop_api *m, size_t send_buffer_size, unsigned n_send_buffers) {
+    struct io_uring_params p;
+    pa_uring *u;
+
+    pa_assert(m);
+    pa_assert(send_buffer_size > 0);
+    pa_assert(n_send_buffers > 0);
+
+    u = pa_xnew0(pa_uring, 1);
+    PA_REFCNT_INIT(u);
+    u->mainloop = m;
+
+    pa_zero(p);
+    p.flags = IORING_SETUP_CQSIZE|IORING_SETUP_SUBMIT_ALL;
+    p.cq_entries = N_CQ_ENTRIES;
+
+    if ((u->fd = uring_setup(N_ENTRIES, &p)) < 0 && errno == EINVAL) {
+        /* IORING_SETUP_SUBMIT_ALL is Linux 5.18 */
+        pa_zero(p);
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = N_CQ_ENTRIES;
+        u->fd = uring_setup(N_ENTRIES, &p);
+    }
+
+    if (u->fd < 0) {
+        pa_log_info("io_uring_setup() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    pa_make_fd_cloexec(u->fd);
+
+    if (map_rings(u, &p) < 0) {
+        pa_log_info("Failed to map io_uring rings: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    u->defer_event = m->defer_new(m, defer_cb, u);
+    m->defer_enable(u->defer_event, 0);
+
+    if (setup_recv_buffers(u) < 0) {
+        pa_log_info("Failed to set up io_uring receive buffers: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    setup_send_buffers(u, send_buffer_size, n_send_buffers);
+    u->zerocopy = u->send_buffers_registered;
+
+    if (probe(u) < 0)
+        goto fail;
+
+    m->defer_enable(u->defer_event, 0);
+    u->io_event = m->io_new(m, u->fd, PA_IO_EVENT_INPUT, io_cb, u);
+
+    pa_log_debug("Using io_uring with %u receive buffers of %u bytes and %u %ssend buffers of %lu bytes.",
+                 N_RECV_BUFFERS, RECV_BUFFER_SIZE,
+                 u->n_send_buffers, u->send_buffers_registered ? "registered " : "",
+                 (unsigned long) u->send_buffer_size);
+
+    return u;
+
+fail:
+    uring_free(u);
+    return NULL;
+}
+
+pa_uring *pa_uring_ref(pa_uring *u) {
+    pa_assert(u);
+    pa_assert(PA_REFCNT_VALUE(u) >= 1);
+
+    PA_REFCNT_INC(u);
+    return u;
+}
+
+void pa_uring_unref(pa_uring *u) {
+    pa_assert(u);
+    pa_assert(PA_REFCNT_VALUE(u) >= 1);
+
+    if (PA_REFCNT_DEC(u) <= 0)
+        uring_free(u);
+}
+
+pa_uring_op *pa_uring_recv(pa_uring *u, int fd, pa_uring_cb_t cb, void *userdata) {
+    pa_uring_op *op;
+
+    pa_assert(u);
+    pa_assert(fd >= 0);
+    pa_assert(cb);
+
+    op = op_new(u, OP_RECV, fd, cb, userdata);
+
+    if (submit_recv(op) < 0) {
+        op->done = true;
+        op_maybe_free(op);
+        return NULL;
+    }
+
+    return op;
+}
+
+const void *pa_uring_get_recv_buffer(pa_uring *u, unsigned buffer) {
+    pa_assert(u);
+    pa_assert(buffer < N_RECV_BUFFERS);
+
+    return u->recv_buffers + buffer * RECV_BUFFER_SIZE;
+}
+
+void pa_uring_put_recv_buffer(pa_uring *u, unsigned buffer) {
+    struct io_uring_buf *b;
+    pa_uring_op *op;
+
+    pa_assert(u);
+    pa_assert(buffer < N_RECV_BUFFERS);
+
+    b = &u->buf_ring->bufs[u->buf_tail & (N_RECV_BUFFERS - 1)];
+    b->addr = (uint64_t) (uintptr_t) (u->recv_buffers + buffer * RECV_BUFFER_SIZE);
+    b->len = RECV_BUFFER_SIZE;
+    b->bid = (uint16_t) buffer;
+
+    u->buf_tail++;
+    __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+
+    while ((op = u->starved)) {
+        PA_LLIST_REMOVE(pa_uring_op, u->starved, op);
+        op->starved = false;
+
+        if (submit_recv(op) < 0) {
+            op_finish(op, -errno);
+            break;
+        }
+    }
+}
+
+int pa_uring_get_send_buffer(pa_uring *u, void **data) {
+    unsigned buffer;
+
+    pa_assert(u);
+    pa_assert(data);
+
+    if (u->n_free_send_buffers <= 0)
+        return -1;
+
+    buffer = u->free_send_buffers[--u->n_free_send_buffers];
+    *data = u->send_buffers + buffer * u->send_buffer_size;
+
+    return (int) buffer;
+}
+
+void pa_uring_put_send_buffer(pa_uring *u, unsigned buffer) {
+    pa_assert(u);
+    pa_assert(buffer < u->n_send_buffers);
+    pa_assert(u->n_free_send_buffers < u->n_send_buffers);
+
+    u->free_send_buffers[u->n_free_send_buffers++] = buffer;
+}
+
+size_t pa_uring_get_send_buffer_size(pa_uring *u) {
+    pa_assert(u);
+
+    return u->send_buffer_size;
+}
+
+pa_uring_op *pa_uring_send(pa_uring *u, int fd, int buffer, const void *data, size_t l, pa_uring_cb_t cb, void *userdata) {
+    pa_uring_op *op;
+
+    pa_assert(u);
+    pa_assert(fd >= 0);
+    pa_assert(buffer < (int) u->n_send_buffers);
+    pa_assert(data);
+    pa_assert(l > 0);
+    pa_assert(cb);
+
+    op = op_new(u, OP_SEND, fd, cb, userdata);
+    op->data = data;
+    op->length = l;
+
+    if (buffer >= 0 && u->send_buffers_registered) {
+        pa_assert((const uint8_t*) data >= u->send_buffers + buffer * u->send_buffer_size);
+        pa_assert((const uint8_t*) data + l <= u->send_buffers + (buffer + 1) * u->send_buffer_size);
+
+        op->zerocopy = l >= ZEROCOPY_MIN;
+    }
+
+    if (submit_send(op) < 0) {
+        op->done = true;
+        op_maybe_free(op);
+        return NULL;
+    }
+
+    return op;
+}
+
+void pa_uring_cancel(pa_uring_op *op) {
+    struct io_uring_sqe *sqe;
+
+    pa_assert(op);
+    pa_assert(!op->done);
+
+    if (op->cancelled)
+        return;
+
+    op->cancelled = true;
+
+    if (op->starved) {
+        PA_LLIST_REMOVE(pa_uring_op, op->uring->starved, op);
+        op->starved = false;
+
+        op_finish(op, -ECANCELED);
+        return;
+    }
+
+    /* If we can't get the request out, the operation ends whenever the
+     * socket does, and we drop the data received until then */
+    if (!(sqe = get_sqe(op->uring)))
+        return;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t) (uintptr_t) op;
+    sqe->user_data = (uint64_t) (uintptr_t) op | CANCEL_TAG;
+
+    op->cancel_pending = true;
+}
+
+void pa_uring_queue_flush(pa_uring *u, pa_uring_flush_item *item) {
+    pa_assert(u);
+    pa_assert(item);
+    pa_assert(item->callback);
+
+    if (item->queued)
+        return;
+
+    PA_LLIST_PREPEND(pa_uring_flush_item, u->flush_items, item);
+    item->queued = true;
+
+    u->mainloop->defer_enable(u->defer_event, 1);
+}
+
+void pa_uring_dequeue_flush(pa_uring *u, pa_uring_flush_item *item) {
+    pa_assert(u);
+    pa_assert(item);
+
+    if (!item->queued)
+        return;
+
+    PA_LLIST_REMOVE(pa_uring_flush_item, u->flush_items, item);
+    item->queued = false;
+}
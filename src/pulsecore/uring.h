@@ -0,0 +1,87 @@
+#ifndef foopulseuringhfoo
+#define foopulseuringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include <pulse/mainloop-api.h>
+#include <pulsecore/llist.h>
+
+/* A minimal io_uring for socket IO in a main loop thread. Receives are
+ * multishot receives into a shared set of provided buffers, sends go out
+ * from a set of registered buffers of a fixed size, large ones without
+ * copying. All submissions made
+ * during one main loop iteration are handed to the kernel with a single
+ * syscall, and completions are dispatched from an io event on the ring.
+ *
+ * pa_uring_new() returns NULL if the kernel lacks any of the features we
+ * need, callers are expected to fall back to plain read()/write() then. */
+
+typedef struct pa_uring pa_uring;
+typedef struct pa_uring_op pa_uring_op;
+
+/* For receives, res > 0 comes with a buffer that has to be given back
+ * with pa_uring_put_recv_buffer() later. After a call with final set,
+ * the operation is gone. Receives end with final set and res == 0 on
+ * EOF, and with a negative errno value on failure or cancellation. For
+ * sends, res is the number of bytes sent or a negative errno value, and
+ * final is always set. */
+typedef void (*pa_uring_cb_t)(pa_uring_op *op, int32_t res, unsigned buffer, bool final, void *userdata);
+
+/* Called right before the pending submissions are handed to the kernel,
+ * for users that want to batch small writes. The item is dequeued before
+ * the callback is called. */
+typedef struct pa_uring_flush_item pa_uring_flush_item;
+struct pa_uring_flush_item {
+    void (*callback)(pa_uring_flush_item *item);
+    void *userdata;
+    bool queued;
+    PA_LLIST_FIELDS(pa_uring_flush_item);
+};
+
+pa_uring *pa_uring_new(pa_mainloop_api *m, size_t send_buffer_size, unsigned n_send_buffers);
+pa_uring *pa_uring_ref(pa_uring *u);
+void pa_uring_unref(pa_uring *u);
+
+/* Receives keep going until they are cancelled or the socket is closed
+ * by the peer. If we run out of receive buffers they are restarted once
+ * buffers are given back. */
+pa_uring_op *pa_uring_recv(pa_uring *u, int fd, pa_uring_cb_t cb, void *userdata);
+const void *pa_uring_get_recv_buffer(pa_uring *u, unsigned buffer);
+void pa_uring_put_recv_buffer(pa_uring *u, unsigned buffer);
+
+/* Returns a send buffer index, or -1 if all are in use */
+int pa_uring_get_send_buffer(pa_uring *u, void **data);
+void pa_uring_put_send_buffer(pa_uring *u, unsigned buffer);
+size_t pa_uring_get_send_buffer_size(pa_uring *u);
+
+/* Sends l bytes from send buffer index buffer at the given offset. If
+ * buffer is -1, data points to memory that has to stay valid until the
+ * send completed. */
+pa_uring_op *pa_uring_send(pa_uring *u, int fd, int buffer, const void *data, size_t l, pa_uring_cb_t cb, void *userdata);
+
+/* The callback is called once more with final set after this, possibly
+ * from within this function */
+void pa_uring_cancel(pa_uring_op *op);
+
+void pa_uring_queue_flush(pa_uring *u, pa_uring_flush_item *item);
+void pa_uring_dequeue_flush(pa_uring *u, pa_uring_flush_item *item);
+
+#endif
@@ -26,12 +26,14 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/resource.h>
 
 #include <check.h>
 
 #include <pulse/pulseaudio.h>
 #include <pulse/mainloop.h>
 
+#include <pulsecore/core-util.h>
 #include <pulsecore/sink.h>
 
 /* Set the number of streams such that it allows two simultaneous instances of
@@ -50,6 +52,17 @@
 #define NTESTS 1000
 #define SAMPLE_HZ 44100
 
+/* With --idle-clients [N], this is a benchmark of the daemon's main loop
+ * instead: it keeps N clients connected that don't do anything, and
+ * measures the round trip time of requests on one more connection. The
+ * daemon needs to allow that many clients and fds, for example with
+ * max-connections=2048 for module-native-protocol-unix and with
+ * rlimit-nofile = 8192 in daemon.conf. Compare runs with the daemon
+ * started with and without PULSE_NO_EPOLL set. */
+#define IDLE_CLIENTS_DEFAULT 1024
+#define IDLE_CONNECTS_PENDING 16
+#define ROUND_TRIPS 5000
+
 static pa_context *context = NULL;
 static pa_stream *streams[NSTREAMS];
 static pa_threaded_mainloop *mainloop = NULL;
@@ -195,6 +208,126 @@ static void context_state_callback(pa_context *c, void *userdata) {
     }
 }
 
+static uint32_t n_idle_clients = 0;
+static unsigned n_idle_ready = 0;
+
+static void idle_context_state_callback(pa_context *c, void *userdata) {
+    fail_unless(c != NULL);
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            n_idle_ready++;
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+
+        default:
+            break;
+    }
+}
+
+static void server_info_callback(pa_context *c, const pa_server_info *i, void *userdata) {
+    bool *done = userdata;
+
+    fail_unless(i != NULL);
+    *done = true;
+}
+
+static int usec_compare(const void *a, const void *b) {
+    const pa_usec_t *x = a, *y = b;
+
+    return *x < *y ? -1 : (*x > *y ? 1 : 0);
+}
+
+START_TEST (idle_clients_benchmark) {
+    pa_mainloop *m;
+    pa_mainloop_api *api;
+    pa_context **contexts, *busy;
+    pa_usec_t start, total = 0, *rtt;
+    struct rlimit rl;
+    unsigned i, n;
+
+    /* Every client needs at least its socket and usually a memfd */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        (void) setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    m = pa_mainloop_new();
+    fail_unless(m != NULL);
+    api = pa_mainloop_get_api(m);
+
+    /* The last one is the one that does the requests */
+    n = n_idle_clients + 1;
+    contexts = pa_xnew0(pa_context*, n);
+
+    start = pa_rtclock_now();
+
+    /* Don't overflow the listen backlog of the daemon */
+    for (i = 0; i < n || n_idle_ready < n; ) {
+
+        if (i < n && i - n_idle_ready < IDLE_CONNECTS_PENDING) {
+            char name[64];
+
+            snprintf(name, sizeof(name), "idle client #%u", i);
+            contexts[i] = pa_context_new(api, name);
+            fail_unless(contexts[i] != NULL);
+
+            pa_context_set_state_callback(contexts[i], idle_context_state_callback, NULL);
+            fail_unless(pa_context_connect(contexts[i], NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0);
+            i++;
+            continue;
+        }
+
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+    }
+
+    fprintf(stderr, "Connected %u clients in %llu ms.\n", n,
+            (unsigned long long) ((pa_rtclock_now() - start) / PA_USEC_PER_MSEC));
+
+    busy = contexts[n - 1];
+    rtt = pa_xnew(pa_usec_t, ROUND_TRIPS);
+
+    for (i = 0; i < ROUND_TRIPS; i++) {
+        pa_operation *o;
+        bool done = false;
+
+        start = pa_rtclock_now();
+
+        o = pa_context_get_server_info(busy, server_info_callback, &done);
+        fail_unless(o != NULL);
+
+        while (!done)
+            fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+        pa_operation_unref(o);
+
+        rtt[i] = pa_rtclock_now() - start;
+        total += rtt[i];
+    }
+
+    qsort(rtt, ROUND_TRIPS, sizeof(pa_usec_t), usec_compare);
+
+    fprintf(stderr, "%u idle clients, %u round trips: avg %llu us, median %llu us, 99%% %llu us, max %llu us\n",
+            n_idle_clients, ROUND_TRIPS,
+            (unsigned long long) (total / ROUND_TRIPS),
+            (unsigned long long) rtt[ROUND_TRIPS / 2],
+            (unsigned long long) rtt[ROUND_TRIPS * 99 / 100],
+            (unsigned long long) rtt[ROUND_TRIPS - 1]);
+
+    for (i = 0; i < n; i++) {
+        pa_context_disconnect(contexts[i]);
+        pa_context_unref(contexts[i]);
+    }
+
+    pa_xfree(rtt);
+    pa_xfree(contexts);
+    pa_mainloop_free(m);
+}
+END_TEST
+
 START_TEST (connect_stress_test) {
     int i;
 
@@ -220,9 +353,22 @@ int main(int argc, char *argv[]) {
 
     bname = argv[0];
 
+    if (argc > 1 && pa_streq(argv[1], "--idle-clients")) {
+        n_idle_clients = IDLE_CLIENTS_DEFAULT;
+
+        if (argc > 2 && (pa_atou(argv[2], &n_idle_clients) < 0 || n_idle_clients < 1)) {
+            fprintf(stderr, "Invalid number of idle clients: %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+    }
+
     s = suite_create("Connect Stress");
     tc = tcase_create("connectstress");
-    tcase_add_test(tc, connect_stress_test);
+
+    if (n_idle_clients > 0)
+        tcase_add_test(tc, idle_clients_benchmark);
+    else
+        tcase_add_test(tc, connect_stress_test);
     tcase_set_timeout(tc, 20 * 60);
     suite_add_tcase(s, tc);
 
@@ -21,8 +21,11 @@
 
 #include <check.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/mix.h>
@@ -32,6 +35,7 @@
 #define SAMPLES 1028
 #define TIMES 1000
 #define TIMES2 100
+#define MAX_STREAMS 20
 
 static void acquire_mix_streams(pa_mix_info streams[], unsigned nstreams) {
     unsigned i;
@@ -47,104 +51,149 @@ static void release_mix_streams(pa_mix_info streams[], unsigned nstreams) {
         pa_memblock_release(streams[i].chunk.memblock);
 }
 
+static void fill_mix_samples(void *samples, pa_sample_format_t format, unsigned nsamples) {
+    unsigned i;
+
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        float *f = samples;
+
+        for (i = 0; i < nsamples; i++)
+            f[i] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+    } else
+        pa_random(samples, nsamples * pa_sample_size_of_format(format));
+}
+
 static void run_mix_test(
         pa_do_mix_func_t func,
         pa_do_mix_func_t orig_func,
+        pa_sample_format_t format,
         int align,
+        unsigned nstreams,
         int channels,
         bool correct,
         bool perf) {
 
-    PA_DECLARE_ALIGNED(8, int16_t, in0[SAMPLES * 4]) = { 0 };
-    PA_DECLARE_ALIGNED(8, int16_t, in1[SAMPLES * 4]) = { 0 };
-    PA_DECLARE_ALIGNED(8, int16_t, out[SAMPLES * 4]) = { 0 };
-    PA_DECLARE_ALIGNED(8, int16_t, out_ref[SAMPLES * 4]) = { 0 };
-    int16_t *samples0, *samples1;
-    int16_t *samples, *samples_ref;
+    uint8_t *in[MAX_STREAMS], *out, *out_ref;
+    uint8_t *samples_in[MAX_STREAMS], *samples, *samples_ref;
+    size_t ss, size;
     int nsamples;
     pa_mempool *pool;
-    pa_memchunk c0, c1;
-    pa_mix_info m[2];
+    pa_mix_info m[MAX_STREAMS];
+    unsigned k;
     int i;
 
-    pa_assert(channels == 1 || channels == 2 || channels == 4);
+    pa_assert(nstreams >= 2 && nstreams <= MAX_STREAMS);
+    pa_assert(format == PA_SAMPLE_S16NE || format == PA_SAMPLE_S32NE || format == PA_SAMPLE_FLOAT32NE);
+
+    ss = pa_sample_size_of_format(format);
 
     /* Force sample alignment as requested */
-    samples0 = in0 + (8 - align);
-    samples1 = in1 + (8 - align);
-    samples = out + (8 - align);
-    samples_ref = out_ref + (8 - align);
     nsamples = channels * (SAMPLES - (8 - align));
+    size = nsamples * ss;
 
     fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
 
-    pa_random(samples0, nsamples * sizeof(int16_t));
-    c0.memblock = pa_memblock_new_fixed(pool, samples0, nsamples * sizeof(int16_t), false);
-    c0.length = pa_memblock_get_length(c0.memblock);
-    c0.index = 0;
-
-    pa_random(samples1, nsamples * sizeof(int16_t));
-    c1.memblock = pa_memblock_new_fixed(pool, samples1, nsamples * sizeof(int16_t), false);
-    c1.length = pa_memblock_get_length(c1.memblock);
-    c1.index = 0;
-
-    m[0].chunk = c0;
-    m[0].volume.channels = channels;
-    for (i = 0; i < channels; i++) {
-        m[0].volume.values[i] = PA_VOLUME_NORM;
-        m[0].linear[i].i = 0x5555;
-    }
+    for (k = 0; k < nstreams; k++) {
+        in[k] = pa_xmalloc((SAMPLES * channels + 8) * ss);
+        samples_in[k] = in[k] + (8 - align) * ss;
+        fill_mix_samples(samples_in[k], format, nsamples);
+
+        m[k].chunk.memblock = pa_memblock_new_fixed(pool, samples_in[k], size, false);
+        m[k].chunk.length = size;
+        m[k].chunk.index = 0;
+
+        m[k].volume.channels = channels;
+        for (i = 0; i < channels; i++) {
+            m[k].volume.values[i] = PA_VOLUME_NORM;
 
-    m[1].chunk = c1;
-    m[1].volume.channels = channels;
-    for (i = 0; i < channels; i++) {
-        m[1].volume.values[i] = PA_VOLUME_NORM;
-        m[1].linear[i].i = 0x6789;
+            /* include volumes above 0 dB to exercise clipping */
+            if (format == PA_SAMPLE_FLOAT32NE)
+                m[k].linear[i].f = (float) rand() / RAND_MAX * 1.5f;
+            else
+                m[k].linear[i].i = rand() % 0x18000;
+        }
     }
 
+    out = pa_xmalloc0((SAMPLES * channels + 8) * ss);
+    out_ref = pa_xmalloc0((SAMPLES * channels + 8) * ss);
+    samples = out + (8 - align) * ss;
+    samples_ref = out_ref + (8 - align) * ss;
+
     if (correct) {
-        acquire_mix_streams(m, 2);
-        orig_func(m, 2, channels, samples_ref, nsamples * sizeof(int16_t));
-        release_mix_streams(m, 2);
+        acquire_mix_streams(m, nstreams);
+        orig_func(m, nstreams, channels, samples_ref, size);
+        release_mix_streams(m, nstreams);
 
-        acquire_mix_streams(m, 2);
-        func(m, 2, channels, samples, nsamples * sizeof(int16_t));
-        release_mix_streams(m, 2);
+        acquire_mix_streams(m, nstreams);
+        func(m, nstreams, channels, samples, size);
+        release_mix_streams(m, nstreams);
 
         for (i = 0; i < nsamples; i++) {
-            if (samples[i] != samples_ref[i]) {
-                pa_log_debug("Correctness test failed: align=%d, channels=%d", align, channels);
-                pa_log_debug("%d: %hd != %04hd (%hd + %hd)\n",
-                    i,
-                    samples[i], samples_ref[i],
-                    samples0[i], samples1[i]);
+            if (memcmp(samples + i * ss, samples_ref + i * ss, ss) != 0) {
+                pa_log_debug("Correctness test failed: format=%s, align=%d, streams=%u, channels=%d",
+                    pa_sample_format_to_string(format), align, nstreams, channels);
+                if (format == PA_SAMPLE_S16NE)
+                    pa_log_debug("%d: %hd != %04hd (%hd + %hd)\n", i,
+                        ((int16_t *) samples)[i], ((int16_t *) samples_ref)[i],
+                        ((int16_t *) samples_in[0])[i], ((int16_t *) samples_in[1])[i]);
+                else if (format == PA_SAMPLE_S32NE)
+                    pa_log_debug("%d: %d != %d (%d + %d)\n", i,
+                        ((int32_t *) samples)[i], ((int32_t *) samples_ref)[i],
+                        ((int32_t *) samples_in[0])[i], ((int32_t *) samples_in[1])[i]);
+                else
+                    pa_log_debug("%d: %.24f != %.24f (%.24f + %.24f)\n", i,
+                        ((float *) samples)[i], ((float *) samples_ref)[i],
+                        ((float *) samples_in[0])[i], ((float *) samples_in[1])[i]);
                 ck_abort();
             }
         }
     }
 
     if (perf) {
-        pa_log_debug("Testing %d-channel mixing performance with %d sample alignment", channels, align);
+        pa_log_debug("Testing %s %u-stream %d-channel mixing performance with %d sample alignment",
+            pa_sample_format_to_string(format), nstreams, channels, align);
 
-        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
-            acquire_mix_streams(m, 2);
-            func(m, 2, channels, samples, nsamples * sizeof(int16_t));
-            release_mix_streams(m, 2);
+        PA_RUNTIME_TEST_RUN_START("func", TIMES * 2 / nstreams, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            func(m, nstreams, channels, samples, size);
+            release_mix_streams(m, nstreams);
         } PA_RUNTIME_TEST_RUN_STOP
 
-        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
-            acquire_mix_streams(m, 2);
-            orig_func(m, 2, channels, samples_ref, nsamples * sizeof(int16_t));
-            release_mix_streams(m, 2);
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES * 2 / nstreams, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            orig_func(m, nstreams, channels, samples_ref, size);
+            release_mix_streams(m, nstreams);
         } PA_RUNTIME_TEST_RUN_STOP
     }
 
-    pa_memblock_unref(c0.memblock);
-    pa_memblock_unref(c1.memblock);
+    for (k = 0; k < nstreams; k++) {
+        pa_memblock_unref(m[k].chunk.memblock);
+        pa_xfree(in[k]);
+    }
+
+    pa_xfree(out);
+    pa_xfree(out_ref);
 
     pa_mempool_unref(pool);
 }
 
+/* Checks func against orig_func for all channel counts and alignments and
+ * benchmarks the common cases */
+static void run_mix_tests(pa_do_mix_func_t func, pa_do_mix_func_t orig_func, pa_sample_format_t format) {
+    int channels, align;
+
+    for (channels = 1; channels <= 8; channels++)
+        for (align = 0; align < 8; align++) {
+            run_mix_test(func, orig_func, format, align, 2, channels, true, false);
+            run_mix_test(func, orig_func, format, align, 5, channels, true, false);
+        }
+
+    run_mix_test(func, orig_func, format, 7, 2, 2, true, true);
+    run_mix_test(func, orig_func, format, 7, 2, 6, true, true);
+    run_mix_test(func, orig_func, format, 7, MAX_STREAMS, 2, true, true);
+    run_mix_test(func, orig_func, format, 7, MAX_STREAMS, 6, true, true);
+}
+
 START_TEST (mix_special_test) {
     pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_do_mix_func_t orig_func, special_func;
@@ -158,13 +207,13 @@ START_TEST (mix_special_test) {
     special_func = pa_get_mix_func(PA_SAMPLE_S16NE);
 
     pa_log_debug("Checking special mix (s16, stereo)");
-    run_mix_test(special_func, orig_func, 7, 2, true, true);
+    run_mix_test(special_func, orig_func, PA_SAMPLE_S16NE, 7, 2, 2, true, true);
 
     pa_log_debug("Checking special mix (s16, 4-channel)");
-    run_mix_test(special_func, orig_func, 7, 4, true, true);
+    run_mix_test(special_func, orig_func, PA_SAMPLE_S16NE, 7, 2, 4, true, true);
 
     pa_log_debug("Checking special mix (s16, mono)");
-    run_mix_test(special_func, orig_func, 7, 1, true, true);
+    run_mix_test(special_func, orig_func, PA_SAMPLE_S16NE, 7, 2, 1, true, true);
 }
 END_TEST
 
@@ -185,17 +234,76 @@ START_TEST (mix_neon_test) {
     neon_func = pa_get_mix_func(PA_SAMPLE_S16NE);
 
     pa_log_debug("Checking NEON mix (s16, stereo)");
-    run_mix_test(neon_func, orig_func, 7, 2, true, true);
+    run_mix_test(neon_func, orig_func, PA_SAMPLE_S16NE, 7, 2, 2, true, true);
 
     pa_log_debug("Checking NEON mix (s16, 4-channel)");
-    run_mix_test(neon_func, orig_func, 7, 4, true, true);
+    run_mix_test(neon_func, orig_func, PA_SAMPLE_S16NE, 7, 2, 4, true, true);
 
     pa_log_debug("Checking NEON mix (s16, mono)");
-    run_mix_test(neon_func, orig_func, 7, 1, true, true);
+    run_mix_test(neon_func, orig_func, PA_SAMPLE_S16NE, 7, 2, 1, true, true);
 }
 END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+#if defined (__i386__) || defined (__amd64__)
+static void run_x86_mix_tests(pa_cpu_x86_flag_t flags) {
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    pa_do_mix_func_t orig_func[3], x86_func[3];
+    const pa_sample_format_t formats[3] = { PA_SAMPLE_S16NE, PA_SAMPLE_S32NE, PA_SAMPLE_FLOAT32NE };
+    unsigned i;
+
+    pa_mix_func_init(&cpu_info);
+    for (i = 0; i < 3; i++)
+        orig_func[i] = pa_get_mix_func(formats[i]);
+
+    pa_mix_func_init_sse(flags);
+    for (i = 0; i < 3; i++)
+        x86_func[i] = pa_get_mix_func(formats[i]);
+
+    for (i = 0; i < 3; i++) {
+        if (x86_func[i] == orig_func[i]) {
+            pa_log_info("No optimized %s mixing. Skipping", pa_sample_format_to_string(formats[i]));
+            continue;
+        }
+
+        pa_log_debug("Checking optimized mix (%s)", pa_sample_format_to_string(formats[i]));
+        run_mix_tests(x86_func[i], orig_func[i], formats[i]);
+    }
+
+    pa_mix_func_init(&cpu_info);
+}
+
+START_TEST (mix_sse_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    pa_log_debug("Checking SSE mixing");
+    run_x86_mix_tests(flags & ~(PA_CPU_X86_AVX | PA_CPU_X86_AVX2));
+}
+END_TEST
+
+START_TEST (mix_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    pa_log_debug("Checking AVX2 mixing");
+    run_x86_mix_tests(flags);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -211,6 +319,10 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, mix_special_test);
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, mix_neon_test);
+#endif
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, mix_sse_test);
+    tcase_add_test(tc, mix_avx2_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
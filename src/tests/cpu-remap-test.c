@@ -21,6 +21,8 @@
 
 #include <check.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu.h>
 #include <pulsecore/random.h>
@@ -33,6 +35,9 @@
 #define TIMES 1000
 #define TIMES2 100
 
+/* The C remapping, saved before any test installs optimized ones */
+static pa_init_remap_func_t generic_init_remap_func;
+
 static void run_remap_test_float(
         pa_remap_t *remap_func,
         pa_remap_t *remap_orig,
@@ -223,6 +228,71 @@ static void remap_init_test_channels(
     remap_test_channels(&remap_func, &remap_orig);
 }
 
+/* A downmix or upmix matrix with coefficients that are left out, scaled
+ * below and above 0.5, and added unscaled */
+static void setup_remap_matrix(
+    pa_remap_t *m,
+    pa_sample_format_t f,
+    unsigned in_channels,
+    unsigned out_channels) {
+
+    unsigned i, o;
+
+    m->format = f;
+    m->i_ss.channels = in_channels;
+    m->o_ss.channels = out_channels;
+    m->do_remap = NULL;
+    m->state = NULL;
+
+    for (o = 0; o < out_channels; o++) {
+        for (i = 0; i < in_channels; i++) {
+            float vol = ((o * 3 + i * 5) % 6) * 0.25f;
+
+            m->map_table_f[o][i] = vol;
+            m->map_table_i[o][i] = (int32_t) (vol * 0x10000);
+        }
+    }
+}
+
+static void remap_init_test_matrix(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels,
+        bool perf) {
+
+    pa_remap_t remap_orig, remap_func;
+    int align;
+
+    setup_remap_matrix(&remap_orig, f, in_channels, out_channels);
+    orig_init_func(&remap_orig);
+
+    setup_remap_matrix(&remap_func, f, in_channels, out_channels);
+    init_func(&remap_func);
+
+    if (!remap_func.do_remap || remap_func.do_remap == remap_orig.do_remap) {
+        pa_log_warn("No remapping function, abort test");
+        return;
+    }
+
+    for (align = 0; align < 4; align++) {
+        switch (f) {
+        case PA_SAMPLE_FLOAT32NE:
+            run_remap_test_float(&remap_func, &remap_orig, align, true, perf && align == 3);
+            break;
+        case PA_SAMPLE_S16NE:
+            run_remap_test_s16(&remap_func, &remap_orig, align, true, perf && align == 3);
+            break;
+        default:
+            pa_assert_not_reached();
+        }
+    }
+
+    pa_xfree(remap_orig.state);
+    pa_xfree(remap_func.state);
+}
+
 static void remap_init2_test_channels(
         pa_sample_format_t f,
         unsigned in_channels,
@@ -323,6 +393,80 @@ START_TEST (remap_sse2_test) {
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
 }
 END_TEST
+
+/* The matrix remappers, with the given CPU flags. The common downmixes
+ * are benchmarked. */
+static void remap_matrix_test(pa_cpu_x86_flag_t flags, const char *name) {
+    static const unsigned float_layouts[][2] = {
+        { 2, 2 }, { 3, 2 }, { 4, 2 }, { 6, 2 }, { 8, 2 },
+        { 2, 4 }, { 6, 4 }, { 8, 4 }, { 6, 3 }, { 4, 6 }, { 6, 8 }, { 8, 8 }, { 5, 7 }
+    };
+    static const unsigned s16_layouts[][2] = {
+        { 2, 2 }, { 3, 2 }, { 4, 2 }, { 6, 2 }, { 8, 2 }, { 2, 4 }, { 6, 4 }, { 8, 4 }
+    };
+    pa_init_remap_func_t init_func, orig_init_func;
+    unsigned i;
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_sse(flags);
+    init_func = pa_get_init_remap_func();
+    pa_set_init_remap_func(orig_init_func);
+
+    for (i = 0; i < PA_ELEMENTSOF(float_layouts); i++) {
+        unsigned n_ic = float_layouts[i][0], n_oc = float_layouts[i][1];
+
+        pa_log_debug("Checking %s remap (float, %u->%u matrix)", name, n_ic, n_oc);
+        remap_init_test_matrix(init_func, generic_init_remap_func, PA_SAMPLE_FLOAT32NE, n_ic, n_oc,
+            (n_ic == 6 || n_ic == 8) && (n_oc == 2 || n_oc == 4));
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(s16_layouts); i++) {
+        unsigned n_ic = s16_layouts[i][0], n_oc = s16_layouts[i][1];
+
+        pa_log_debug("Checking %s remap (s16, %u->%u matrix)", name, n_ic, n_oc);
+        remap_init_test_matrix(init_func, generic_init_remap_func, PA_SAMPLE_S16NE, n_ic, n_oc,
+            n_ic == 6 || n_ic == 8);
+    }
+}
+
+START_TEST (remap_matrix_sse2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    remap_matrix_test(flags & ~(PA_CPU_X86_SSE3 | PA_CPU_X86_SSSE3 | PA_CPU_X86_AVX | PA_CPU_X86_AVX2), "SSE2");
+}
+END_TEST
+
+START_TEST (remap_matrix_sse3_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_SSE3)) {
+        pa_log_info("SSE3 not supported. Skipping");
+        return;
+    }
+
+    remap_matrix_test(flags & ~(PA_CPU_X86_AVX | PA_CPU_X86_AVX2), "SSE3");
+}
+END_TEST
+
+START_TEST (remap_matrix_avx_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX)) {
+        pa_log_info("AVX not supported. Skipping");
+        return;
+    }
+
+    remap_matrix_test(flags, "AVX");
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -403,6 +547,8 @@ int main(int argc, char *argv[]) {
     if (!getenv("MAKE_CHECK"))
         pa_log_set_level(PA_LOG_DEBUG);
 
+    generic_init_remap_func = pa_get_init_remap_func();
+
     s = suite_create("CPU");
 
     tc = tcase_create("remap");
@@ -410,6 +556,9 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, remap_mmx_test);
     tcase_add_test(tc, remap_sse2_test);
+    tcase_add_test(tc, remap_matrix_sse2_test);
+    tcase_add_test(tc, remap_matrix_sse3_test);
+    tcase_add_test(tc, remap_matrix_avx_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
@@ -20,9 +20,13 @@
 #endif
 
 #include <check.h>
+#include <math.h>
+
+#include <pulse/sample.h>
 
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/sconv.h>
@@ -134,6 +138,143 @@ static void run_conv_test_s16_to_float(
 }
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+static const pa_sample_format_t conv_formats[] = {
+    PA_SAMPLE_S16LE, PA_SAMPLE_S16BE, PA_SAMPLE_S32LE, PA_SAMPLE_S32BE,
+    PA_SAMPLE_S24LE, PA_SAMPLE_S24BE, PA_SAMPLE_S24_32LE, PA_SAMPLE_S24_32BE,
+    PA_SAMPLE_FLOAT32LE, PA_SAMPLE_FLOAT32BE,
+};
+
+/* The four tables, and the format on the other side of each of them */
+static const struct {
+    pa_convert_func_t (*get)(pa_sample_format_t f);
+    pa_sample_format_t format;
+    bool to;
+} conv_tables[] = {
+    { pa_get_convert_to_float32ne_function, PA_SAMPLE_FLOAT32NE, true },
+    { pa_get_convert_from_float32ne_function, PA_SAMPLE_FLOAT32NE, false },
+    { pa_get_convert_to_s16ne_function, PA_SAMPLE_S16NE, true },
+    { pa_get_convert_from_s16ne_function, PA_SAMPLE_S16NE, false },
+};
+
+typedef struct conv_funcs {
+    pa_convert_func_t funcs[PA_ELEMENTSOF(conv_tables)][PA_SAMPLE_MAX];
+} conv_funcs;
+
+static void get_conv_funcs(conv_funcs *c) {
+    unsigned t, k;
+
+    for (t = 0; t < PA_ELEMENTSOF(conv_tables); t++)
+        for (k = 0; k < PA_ELEMENTSOF(conv_formats); k++)
+            c->funcs[t][conv_formats[k]] = conv_tables[t].get(conv_formats[k]);
+}
+
+static void fill_samples(pa_sample_format_t f, void *p, int nsamples) {
+    int i;
+
+    if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE) {
+        float *floats = p;
+
+        for (i = 0; i < nsamples; i++) {
+            floats[i] = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+
+            if (f == PA_SAMPLE_FLOAT32RE)
+                PA_WRITE_FLOAT32RE(floats + i, floats[i]);
+        }
+    } else
+        pa_random(p, nsamples * pa_sample_size_of_format(f));
+}
+
+/* Converts samples from format a to format b. Unless exact results are
+ * expected, samples may differ by one step of b, compared after converting
+ * them to floats with to_float. */
+static void run_conv_test(
+        pa_sample_format_t a_format,
+        pa_sample_format_t b_format,
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        pa_convert_func_t to_float,
+        int align,
+        bool exact,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(16, uint8_t, a_buf[SAMPLES * 4]);
+    PA_DECLARE_ALIGNED(16, uint8_t, b_buf[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(16, uint8_t, b_ref_buf[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(16, float, f[SAMPLES]);
+    PA_DECLARE_ALIGNED(16, float, f_ref[SAMPLES]);
+    size_t a_size = pa_sample_size_of_format(a_format), b_size = pa_sample_size_of_format(b_format);
+    uint8_t *a, *b, *b_ref;
+    int i, nsamples;
+
+    /* Force sample alignment as requested */
+    a = a_buf + (8 - align) * a_size;
+    b = b_buf + (8 - align) * b_size;
+    b_ref = b_ref_buf + (8 - align) * b_size;
+    nsamples = SAMPLES - (8 - align);
+
+    fill_samples(a_format, a, nsamples);
+
+    if (correct) {
+        float tolerance = b_format == PA_SAMPLE_S16NE || b_format == PA_SAMPLE_S16RE ?
+            1.0f / (1 << 15) : 1.0f / (1 << 23);
+
+        orig_func(nsamples, a, b_ref);
+        func(nsamples, a, b);
+
+        if (memcmp(b, b_ref, nsamples * b_size) != 0) {
+            to_float(nsamples, b, f);
+            to_float(nsamples, b_ref, f_ref);
+
+            for (i = 0; i < nsamples; i++) {
+                if (exact ? memcmp(b + i * b_size, b_ref + i * b_size, b_size) != 0 :
+                            fabsf(f[i] - f_ref[i]) > tolerance * 1.01f) {
+                    pa_log_debug("Correctness test failed: %s -> %s, align=%d",
+                                 pa_sample_format_to_string(a_format), pa_sample_format_to_string(b_format), align);
+                    pa_log_debug("%d: %.24f != %.24f\n", i, f[i], f_ref[i]);
+                    ck_abort();
+                }
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s -> %s sconv performance with %d sample alignment",
+                     pa_sample_format_to_string(a_format), pa_sample_format_to_string(b_format), align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, a, b);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, a, b_ref);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+/* Checks every conversion that differs between funcs and orig_funcs */
+static void run_conv_formats_tests(const conv_funcs *funcs, const conv_funcs *orig_funcs, bool exact) {
+    unsigned t, k;
+    int i;
+
+    for (t = 0; t < PA_ELEMENTSOF(conv_tables); t++) {
+        for (k = 0; k < PA_ELEMENTSOF(conv_formats); k++) {
+            pa_sample_format_t f = conv_formats[k], a_format, b_format;
+            pa_convert_func_t func = funcs->funcs[t][f], orig_func = orig_funcs->funcs[t][f];
+
+            if (func == orig_func || f == conv_tables[t].format)
+                continue;
+
+            a_format = conv_tables[t].to ? f : conv_tables[t].format;
+            b_format = conv_tables[t].to ? conv_tables[t].format : f;
+
+            for (i = 0; i < 8; i++)
+                run_conv_test(a_format, b_format, func, orig_func, orig_funcs->funcs[0][b_format],
+                              i, exact, true, i == 7);
+        }
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (sconv_sse2_test) {
     pa_cpu_x86_flag_t flags = 0;
@@ -188,6 +329,26 @@ START_TEST (sconv_sse_test) {
     run_conv_test_float_to_s16(sse_func, orig_func, 7, true, true);
 }
 END_TEST
+
+START_TEST (sconv_formats_sse_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    conv_funcs orig_funcs, sse_funcs;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    get_conv_funcs(&orig_funcs);
+    pa_convert_func_init_sse(flags);
+    get_conv_funcs(&sse_funcs);
+
+    pa_log_debug("Checking SSE2/SSSE3 sconv (all formats)");
+    run_conv_formats_tests(&sse_funcs, &orig_funcs, true);
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -230,6 +391,26 @@ START_TEST (sconv_neon_test) {
     run_conv_test_s16_to_float(neon_to_func, orig_to_func, 7, true, true);
 }
 END_TEST
+
+START_TEST (sconv_formats_neon_test) {
+    pa_cpu_arm_flag_t flags = 0;
+    conv_funcs orig_funcs, neon_funcs;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    get_conv_funcs(&orig_funcs);
+    pa_convert_func_init_neon(flags);
+    get_conv_funcs(&neon_funcs);
+
+    pa_log_debug("Checking NEON sconv (all formats)");
+    run_conv_formats_tests(&neon_funcs, &orig_funcs, false);
+}
+END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
 int main(int argc, char *argv[]) {
@@ -247,9 +428,11 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, sconv_sse2_test);
     tcase_add_test(tc, sconv_sse_test);
+    tcase_add_test(tc, sconv_formats_sse_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, sconv_neon_test);
+    tcase_add_test(tc, sconv_formats_neon_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
@@ -19,6 +19,7 @@
 #include <config.h>
 #endif
 
+#include <math.h>
 #include <check.h>
 
 #include <pulsecore/cpu-arm.h>
@@ -100,6 +101,227 @@ static void run_volume_test(
     }
 }
 
+/* For the float32, s32 and s24 volume functions */
+static void run_volume_format_test(
+        pa_sample_format_t format,
+        pa_do_volume_func_t func,
+        pa_do_volume_func_t orig_func,
+        int align,
+        int channels,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, s[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_ref[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_orig[SAMPLES * 4]) = { 0 };
+    int32_t volumes[channels + PA_VOLUME_PADDING];
+    float fvolumes[channels + PA_VOLUME_PADDING];
+    void *v;
+    uint8_t *samples, *samples_ref, *samples_orig;
+    size_t ss = pa_sample_size_of_format(format);
+    int i, padding, nsamples, size;
+
+    /* Force sample alignment as requested */
+    samples = s + (8 - align) * ss;
+    samples_ref = s_ref + (8 - align) * ss;
+    samples_orig = s_orig + (8 - align) * ss;
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    size = nsamples * ss;
+
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        for (i = 0; i < nsamples; i++)
+            ((float *) samples)[i] = 2.4f * rand() / (float) RAND_MAX - 1.2f;
+    } else
+        pa_random(samples, size);
+
+    memcpy(samples_ref, samples, size);
+    memcpy(samples_orig, samples, size);
+
+    /* Up to twice the normal volume, so that clamping is covered */
+    for (i = 0; i < channels; i++) {
+        double linear = pa_sw_volume_to_linear(PA_CLAMP_VOLUME((pa_volume_t)(rand() >> 14)));
+
+        volumes[i] = (int32_t) lrint(linear * 0x10000);
+        fvolumes[i] = (float) linear;
+    }
+    for (padding = 0; padding < PA_VOLUME_PADDING; padding++, i++) {
+        volumes[i] = volumes[padding];
+        fvolumes[i] = fvolumes[padding];
+    }
+
+    v = format == PA_SAMPLE_FLOAT32NE ? (void *) fvolumes : (void *) volumes;
+
+    if (correct) {
+        orig_func(samples_ref, v, channels, size);
+        func(samples, v, channels, size);
+
+        for (i = 0; i < size; i++) {
+            if (samples[i] != samples_ref[i]) {
+                pa_log_debug("Correctness test failed: format=%s, align=%d, channels=%d",
+                        pa_sample_format_to_string(format), align, channels);
+                pa_log_debug("byte %d: %02x != %02x (%02x)\n", i, samples[i], samples_ref[i], samples_orig[i]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s svolume %dch performance with %d sample alignment",
+                pa_sample_format_to_string(format), channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            func(samples, v, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            orig_func(samples_ref, v, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(memcmp(samples_ref, samples, size) == 0);
+    }
+}
+
+static void run_volume_from_float32ne_test(
+        pa_sample_format_t format,
+        pa_do_volume_from_float32ne_func_t func,
+        pa_do_volume_from_float32ne_func_t orig_func,
+        int align,
+        int channels,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, float, f[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(8, int32_t, s[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(8, int32_t, s_ref[SAMPLES]) = { 0 };
+    float volumes[channels + PA_VOLUME_PADDING];
+    float *floats;
+    void *samples, *samples_ref;
+    int i, padding, nsamples;
+
+    /* Force sample alignment as requested */
+    floats = f + (8 - align);
+    samples = s + (8 - align);
+    samples_ref = s_ref + (8 - align);
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+
+    for (i = 0; i < nsamples; i++)
+        floats[i] = 2.4f * rand() / (float) RAND_MAX - 1.2f;
+
+    for (i = 0; i < channels; i++)
+        volumes[i] = (float) pa_sw_volume_to_linear(PA_CLAMP_VOLUME((pa_volume_t)(rand() >> 14)));
+    for (padding = 0; padding < PA_VOLUME_PADDING; padding++, i++)
+        volumes[i] = volumes[padding];
+
+    if (correct) {
+        orig_func(nsamples, floats, samples_ref, volumes, channels);
+        func(nsamples, floats, samples, volumes, channels);
+
+        /* Optimized functions may round differently */
+        for (i = 0; i < nsamples; i++) {
+            int64_t a, b;
+
+            if (format == PA_SAMPLE_S16NE) {
+                a = ((int16_t *) samples)[i];
+                b = ((int16_t *) samples_ref)[i];
+            } else {
+                a = ((int32_t *) samples)[i];
+                b = ((int32_t *) samples_ref)[i];
+            }
+
+            if (llabs(a - b) > 1) {
+                pa_log_debug("Correctness test failed: format=%s, align=%d, channels=%d",
+                        pa_sample_format_to_string(format), align, channels);
+                pa_log_debug("%d: %" PRId64 " != %" PRId64 " (%.9f * %.9f)\n", i, a, b,
+                        floats[i], volumes[i % channels]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s svolume from float32ne %dch performance with %d sample alignment",
+                pa_sample_format_to_string(format), channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, floats, samples, volumes, channels);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, floats, samples_ref, volumes, channels);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+static const pa_sample_format_t volume_formats[] = {
+    PA_SAMPLE_FLOAT32NE,
+    PA_SAMPLE_S32NE,
+    PA_SAMPLE_S24NE,
+    PA_SAMPLE_S24_32NE
+};
+
+static const pa_sample_format_t volume_from_float32ne_formats[] = {
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_S32NE
+};
+
+typedef struct volume_funcs {
+    pa_do_volume_func_t volume[PA_ELEMENTSOF(volume_formats)];
+    pa_do_volume_from_float32ne_func_t from_float32ne[PA_ELEMENTSOF(volume_from_float32ne_formats)];
+} volume_funcs;
+
+static void get_volume_funcs(volume_funcs *funcs) {
+    unsigned k;
+
+    for (k = 0; k < PA_ELEMENTSOF(volume_formats); k++)
+        funcs->volume[k] = pa_get_volume_func(volume_formats[k]);
+
+    for (k = 0; k < PA_ELEMENTSOF(volume_from_float32ne_formats); k++)
+        funcs->from_float32ne[k] = pa_get_volume_from_float32ne_func(volume_from_float32ne_formats[k]);
+}
+
+/* Checks and benchmarks all functions that were replaced */
+static void run_volume_formats_tests(const volume_funcs *funcs, const volume_funcs *orig_funcs) {
+    unsigned k;
+    int i, j;
+
+    for (k = 0; k < PA_ELEMENTSOF(volume_formats); k++) {
+        pa_sample_format_t f = volume_formats[k];
+
+        if (funcs->volume[k] == orig_funcs->volume[k])
+            continue;
+
+        pa_log_debug("Checking %s svolume", pa_sample_format_to_string(f));
+        for (i = 1; i <= 8; i++) {
+            for (j = 0; j < 7; j++)
+                run_volume_format_test(f, funcs->volume[k], orig_funcs->volume[k], j, i, true, false);
+        }
+        run_volume_format_test(f, funcs->volume[k], orig_funcs->volume[k], 7, 1, true, true);
+        run_volume_format_test(f, funcs->volume[k], orig_funcs->volume[k], 7, 2, true, true);
+        run_volume_format_test(f, funcs->volume[k], orig_funcs->volume[k], 7, 6, true, true);
+    }
+
+    for (k = 0; k < PA_ELEMENTSOF(volume_from_float32ne_formats); k++) {
+        pa_sample_format_t f = volume_from_float32ne_formats[k];
+
+        if (funcs->from_float32ne[k] == orig_funcs->from_float32ne[k])
+            continue;
+
+        pa_log_debug("Checking %s svolume from float32ne", pa_sample_format_to_string(f));
+        for (i = 1; i <= 8; i++) {
+            for (j = 0; j < 7; j++)
+                run_volume_from_float32ne_test(f, funcs->from_float32ne[k], orig_funcs->from_float32ne[k], j, i, true, false);
+        }
+        run_volume_from_float32ne_test(f, funcs->from_float32ne[k], orig_funcs->from_float32ne[k], 7, 1, true, true);
+        run_volume_from_float32ne_test(f, funcs->from_float32ne[k], orig_funcs->from_float32ne[k], 7, 2, true, true);
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (svolume_mmx_test) {
     pa_do_volume_func_t orig_func, mmx_func;
@@ -154,6 +376,37 @@ START_TEST (svolume_sse_test) {
     run_volume_test(sse_func, orig_func, 7, 3, true, true);
 }
 END_TEST
+
+START_TEST (svolume_formats_sse_test) {
+    volume_funcs orig_funcs, sse_funcs, avx_funcs;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    get_volume_funcs(&orig_funcs);
+    pa_volume_func_init_sse(flags & ~(PA_CPU_X86_AVX | PA_CPU_X86_AVX2));
+    get_volume_funcs(&sse_funcs);
+
+    pa_log_debug("Checking SSE2 float32, s32 and s24 svolume");
+    run_volume_formats_tests(&sse_funcs, &orig_funcs);
+
+    if (!(flags & PA_CPU_X86_AVX)) {
+        pa_log_info("AVX not supported. Skipping");
+        return;
+    }
+
+    pa_volume_func_init_sse(flags);
+    get_volume_funcs(&avx_funcs);
+
+    pa_log_debug("Checking AVX float32, s32 and s24 svolume");
+    run_volume_formats_tests(&avx_funcs, &orig_funcs);
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__)
@@ -183,6 +436,28 @@ START_TEST (svolume_arm_test) {
     run_volume_test(arm_func, orig_func, 7, 3, true, true);
 }
 END_TEST
+
+#ifdef HAVE_NEON
+START_TEST (svolume_formats_neon_test) {
+    volume_funcs orig_funcs, neon_funcs;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    get_volume_funcs(&orig_funcs);
+    pa_volume_func_init_neon(flags);
+    get_volume_funcs(&neon_funcs);
+
+    pa_log_debug("Checking NEON float32, s32 and s24 svolume");
+    run_volume_formats_tests(&neon_funcs, &orig_funcs);
+}
+END_TEST
+#endif /* HAVE_NEON */
 #endif /* defined (__arm__) && defined (__linux__) */
 
 START_TEST (svolume_orc_test) {
@@ -230,9 +505,13 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, svolume_mmx_test);
     tcase_add_test(tc, svolume_sse_test);
+    tcase_add_test(tc, svolume_formats_sse_test);
 #endif
 #if defined (__arm__) && defined (__linux__)
     tcase_add_test(tc, svolume_arm_test);
+#ifdef HAVE_NEON
+    tcase_add_test(tc, svolume_formats_neon_test);
+#endif
 #endif
     tcase_add_test(tc, svolume_orc_test);
     tcase_set_timeout(tc, 120);
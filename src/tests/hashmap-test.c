@@ -0,0 +1,449 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/flist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "runtime-test-util.h"
+
+#define N_ENTRIES 5000
+
+static char **make_keys(unsigned n) {
+    char **keys;
+    unsigned i;
+
+    keys = pa_xnew(char *, n);
+
+    for (i = 0; i < n; i++)
+        keys[i] = pa_sprintf_malloc("application.process.key-%u", i);
+
+    return keys;
+}
+
+static void free_keys(char **keys, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        pa_xfree(keys[i]);
+
+    pa_xfree(keys);
+}
+
+START_TEST (hashmap_test) {
+    pa_hashmap *h;
+    char **keys;
+    const void *key;
+    void *state, *v;
+    unsigned i;
+
+    keys = make_keys(N_ENTRIES);
+    h = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        fail_unless(pa_hashmap_put(h, keys[i], PA_UINT_TO_PTR(i + 1)) == 0);
+
+    fail_unless(pa_hashmap_put(h, keys[0], NULL) < 0);
+    fail_unless(pa_hashmap_size(h) == N_ENTRIES);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        fail_unless(pa_hashmap_get(h, keys[i]) == PA_UINT_TO_PTR(i + 1));
+
+    fail_unless(pa_hashmap_get(h, "no-such-key") == NULL);
+
+    /* Iteration is in insertion order, and removing the current entry
+     * while iterating is allowed */
+    i = 0;
+    PA_HASHMAP_FOREACH_KV(key, v, h, state) {
+        fail_unless(key == keys[i]);
+        fail_unless(v == PA_UINT_TO_PTR(i + 1));
+
+        if (i % 3 != 0)
+            fail_unless(pa_hashmap_remove(h, key) == v);
+
+        i++;
+    }
+    fail_unless(i == N_ENTRIES);
+
+    fail_unless(pa_hashmap_size(h) == (N_ENTRIES + 2) / 3);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        fail_unless(pa_hashmap_get(h, keys[i]) == (i % 3 == 0 ? PA_UINT_TO_PTR(i + 1) : NULL));
+
+    i = N_ENTRIES - 1;
+    PA_HASHMAP_FOREACH_BACKWARDS(v, h, state) {
+        while (i % 3 != 0)
+            i--;
+        fail_unless(v == PA_UINT_TO_PTR(i + 1));
+        i--;
+    }
+
+    /* Shrink down to a single entry and grow again */
+    while (pa_hashmap_size(h) > 1)
+        pa_hashmap_steal_first(h);
+
+    fail_unless(pa_hashmap_first(h) == pa_hashmap_last(h));
+    fail_unless(pa_hashmap_get(h, keys[(N_ENTRIES - 1) / 3 * 3]) != NULL);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        if (pa_hashmap_put(h, keys[i], PA_UINT_TO_PTR(i + 1)) < 0)
+            fail_unless(i == (N_ENTRIES - 1) / 3 * 3);
+
+    fail_unless(pa_hashmap_size(h) == N_ENTRIES);
+
+    for (i = 0; i < N_ENTRIES; i++)
+        fail_unless(pa_hashmap_get(h, keys[i]) == PA_UINT_TO_PTR(i + 1));
+
+    pa_hashmap_free(h);
+    free_keys(keys, N_ENTRIES);
+}
+END_TEST
+
+START_TEST (idxset_test) {
+    pa_idxset *s;
+    char **keys;
+    uint32_t idx, first;
+    void *v;
+    unsigned i;
+
+    keys = make_keys(N_ENTRIES);
+    s = pa_idxset_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+    for (i = 0; i < N_ENTRIES; i++) {
+        fail_unless(pa_idxset_put(s, keys[i], &idx) == 0);
+        fail_unless(idx == i);
+    }
+
+    fail_unless(pa_idxset_put(s, keys[7], &idx) < 0);
+    fail_unless(idx == 7);
+
+    for (i = 0; i < N_ENTRIES; i++) {
+        fail_unless(pa_idxset_get_by_index(s, i) == keys[i]);
+        fail_unless(pa_idxset_get_by_data(s, keys[i], &idx) == keys[i]);
+        fail_unless(idx == i);
+    }
+
+    fail_unless(pa_idxset_get_by_index(s, N_ENTRIES) == NULL);
+
+    for (i = 0; i < N_ENTRIES; i += 2)
+        fail_unless(pa_idxset_remove_by_index(s, i) == keys[i]);
+
+    for (i = 1; i < N_ENTRIES; i += 4)
+        fail_unless(pa_idxset_remove_by_data(s, keys[i], &idx) == keys[i] && idx == i);
+
+    i = 3;
+    PA_IDXSET_FOREACH(v, s, idx) {
+        fail_unless(idx == i);
+        fail_unless(v == keys[i]);
+        i += 4;
+    }
+
+    /* pa_idxset_next() continues after entries that are gone */
+    idx = 4;
+    fail_unless(pa_idxset_next(s, &idx) == keys[7]);
+
+    first = PA_IDXSET_INVALID;
+    fail_unless(pa_idxset_rrobin(s, &first) == keys[3]);
+
+    /* New entries get new indexes */
+    fail_unless(pa_idxset_put(s, keys[0], &idx) == 0);
+    fail_unless(idx == N_ENTRIES);
+    fail_unless(pa_idxset_get_by_index(s, N_ENTRIES) == keys[0]);
+    fail_unless(pa_idxset_get_by_index(s, 0) == NULL);
+
+    pa_idxset_free(s, NULL);
+    free_keys(keys, N_ENTRIES);
+}
+END_TEST
+
+/* Random puts and removals on both containers, checked against a bitmap.
+ * This exercises growing, shrinking and the backward shift on removal
+ * with long probe sequences. */
+START_TEST (random_test) {
+    pa_hashmap *h;
+    pa_idxset *s;
+    bool *present;
+    uint32_t *indexes;
+    unsigned i, j;
+
+    h = pa_hashmap_new(NULL, NULL);
+    s = pa_idxset_new(NULL, NULL);
+    present = pa_xnew0(bool, N_ENTRIES);
+    indexes = pa_xnew(uint32_t, N_ENTRIES);
+
+    srand(0);
+
+    for (i = 0; i < 100 * N_ENTRIES; i++) {
+        unsigned k = (unsigned) rand() % N_ENTRIES;
+        void *key = PA_UINT_TO_PTR(k + 1);
+
+        if (rand() % 3 != 0) {
+            if (present[k])
+                fail_unless(pa_hashmap_put(h, key, key) < 0);
+            else {
+                fail_unless(pa_hashmap_put(h, key, key) == 0);
+                fail_unless(pa_idxset_put(s, key, &indexes[k]) == 0);
+                present[k] = true;
+            }
+        } else {
+            fail_unless(pa_hashmap_remove(h, key) == (present[k] ? key : NULL));
+
+            if (present[k]) {
+                fail_unless(pa_idxset_get_by_index(s, indexes[k]) == key);
+                fail_unless(pa_idxset_remove_by_data(s, key, NULL) == key);
+                present[k] = false;
+            }
+        }
+
+        if (i % N_ENTRIES == 0) {
+            unsigned n = 0;
+
+            for (j = 0; j < N_ENTRIES; j++) {
+                void *v = PA_UINT_TO_PTR(j + 1);
+
+                fail_unless(pa_hashmap_get(h, v) == (present[j] ? v : NULL));
+                fail_unless(pa_idxset_get_by_data(s, v, NULL) == (present[j] ? v : NULL));
+                n += present[j];
+            }
+
+            fail_unless(pa_hashmap_size(h) == n);
+            fail_unless(pa_idxset_size(s) == n);
+        }
+    }
+
+    pa_hashmap_remove_all(h);
+    pa_idxset_remove_all(s, NULL);
+    fail_unless(pa_hashmap_isempty(h));
+    fail_unless(pa_idxset_isempty(s));
+
+    pa_hashmap_free(h);
+    pa_idxset_free(s, NULL);
+    pa_xfree(present);
+    pa_xfree(indexes);
+}
+END_TEST
+
+/* The previous implementation: a fixed number of buckets with chained
+ * entries. Kept here for comparison only. */
+
+#define CHAINED_NBUCKETS 127
+
+struct chained_entry {
+    void *key;
+    void *value;
+
+    struct chained_entry *bucket_next, *bucket_previous;
+    struct chained_entry *iterate_next, *iterate_previous;
+};
+
+typedef struct chained_hashmap {
+    pa_hash_func_t hash_func;
+    pa_compare_func_t compare_func;
+
+    struct chained_entry *buckets[CHAINED_NBUCKETS];
+    struct chained_entry *iterate_list_head, *iterate_list_tail;
+} chained_hashmap;
+
+PA_STATIC_FLIST_DECLARE(chained_entries, 0, pa_xfree);
+
+static struct chained_entry *chained_scan(chained_hashmap *h, unsigned hash, const void *key) {
+    struct chained_entry *e;
+
+    for (e = h->buckets[hash]; e; e = e->bucket_next)
+        if (h->compare_func(e->key, key) == 0)
+            return e;
+
+    return NULL;
+}
+
+static int chained_put(chained_hashmap *h, void *key, void *value) {
+    struct chained_entry *e;
+    unsigned hash = h->hash_func(key) % CHAINED_NBUCKETS;
+
+    if (chained_scan(h, hash, key))
+        return -1;
+
+    if (!(e = pa_flist_pop(PA_STATIC_FLIST_GET(chained_entries))))
+        e = pa_xnew(struct chained_entry, 1);
+
+    e->key = key;
+    e->value = value;
+
+    e->bucket_next = h->buckets[hash];
+    e->bucket_previous = NULL;
+    if (h->buckets[hash])
+        h->buckets[hash]->bucket_previous = e;
+    h->buckets[hash] = e;
+
+    e->iterate_previous = h->iterate_list_tail;
+    e->iterate_next = NULL;
+    if (h->iterate_list_tail)
+        h->iterate_list_tail->iterate_next = e;
+    else
+        h->iterate_list_head = e;
+    h->iterate_list_tail = e;
+
+    return 0;
+}
+
+static void *chained_get(chained_hashmap *h, const void *key) {
+    struct chained_entry *e;
+
+    if (!(e = chained_scan(h, h->hash_func(key) % CHAINED_NBUCKETS, key)))
+        return NULL;
+
+    return e->value;
+}
+
+static void *chained_remove(chained_hashmap *h, const void *key) {
+    struct chained_entry *e;
+    unsigned hash = h->hash_func(key) % CHAINED_NBUCKETS;
+    void *value;
+
+    if (!(e = chained_scan(h, hash, key)))
+        return NULL;
+
+    if (e->iterate_next)
+        e->iterate_next->iterate_previous = e->iterate_previous;
+    else
+        h->iterate_list_tail = e->iterate_previous;
+
+    if (e->iterate_previous)
+        e->iterate_previous->iterate_next = e->iterate_next;
+    else
+        h->iterate_list_head = e->iterate_next;
+
+    if (e->bucket_next)
+        e->bucket_next->bucket_previous = e->bucket_previous;
+
+    if (e->bucket_previous)
+        e->bucket_previous->bucket_next = e->bucket_next;
+    else
+        h->buckets[hash] = e->bucket_next;
+
+    value = e->value;
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(chained_entries), e) < 0)
+        pa_xfree(e);
+
+    return value;
+}
+
+static void run_benchmark(const char *what, pa_hash_func_t hash_func, pa_compare_func_t compare_func, void **keys, unsigned n) {
+    char label[64];
+    unsigned i, times;
+
+    /* Aim for roughly the same amount of lookups for every size */
+    times = PA_MAX(100000 / n, 1U);
+
+    pa_log_debug("Benchmarking %s with %u entries", what, n);
+
+    pa_snprintf(label, sizeof(label), "chained put+get+remove");
+    PA_RUNTIME_TEST_RUN_START(label, times, n > 10000 ? 1 : 5) {
+        chained_hashmap *h = pa_xnew0(chained_hashmap, 1);
+
+        h->hash_func = hash_func;
+        h->compare_func = compare_func;
+
+        for (i = 0; i < n; i++)
+            chained_put(h, keys[i], keys[i]);
+        for (i = 0; i < n; i++)
+            pa_assert_se(chained_get(h, keys[i]) == keys[i]);
+        for (i = 0; i < n; i++)
+            pa_assert_se(chained_remove(h, keys[i]) == keys[i]);
+
+        pa_xfree(h);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_snprintf(label, sizeof(label), "hashmap put+get+remove");
+    PA_RUNTIME_TEST_RUN_START(label, times, n > 10000 ? 1 : 5) {
+        pa_hashmap *h = pa_hashmap_new(hash_func, compare_func);
+
+        for (i = 0; i < n; i++)
+            pa_hashmap_put(h, keys[i], keys[i]);
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_hashmap_get(h, keys[i]) == keys[i]);
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_hashmap_remove(h, keys[i]) == keys[i]);
+
+        pa_hashmap_free(h);
+    } PA_RUNTIME_TEST_RUN_STOP
+}
+
+START_TEST (hashmap_benchmark) {
+    unsigned sizes[] = { 10, 100, 1000, 10000, 100000 };
+    void **indexes;
+    char **keys;
+    unsigned i, n, max_n;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    /* Chain walks with many entries are slow, don't hold up make check */
+    max_n = getenv("MAKE_CHECK") ? 1000 : 100000;
+
+    keys = make_keys(max_n);
+    indexes = pa_xnew(void *, max_n);
+
+    for (i = 0; i < max_n; i++)
+        indexes[i] = PA_UINT32_TO_PTR(i);
+
+    for (n = 0; n < PA_ELEMENTSOF(sizes) && sizes[n] <= max_n; n++) {
+        run_benchmark("string keys", pa_idxset_string_hash_func, pa_idxset_string_compare_func, (void **) keys, sizes[n]);
+        run_benchmark("consecutive indexes", pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, indexes, sizes[n]);
+    }
+
+    pa_xfree(indexes);
+    free_keys(keys, max_n);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Hashmap");
+    tc = tcase_create("hashmap");
+    tcase_add_test(tc, hashmap_test);
+    tcase_add_test(tc, idxset_test);
+    tcase_add_test(tc, random_test);
+    tcase_add_test(tc, hashmap_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -120,6 +120,220 @@ START_TEST (mainloop_test) {
 }
 END_TEST
 
+#ifndef GLIB_MAIN_LOOP
+
+#define N_TIME_EVENTS 200
+#define N_PIPES 64
+
+static pa_time_event *time_events[N_TIME_EVENTS];
+static pa_usec_t last_time;
+static unsigned n_time_events_fired, n_restarts;
+
+static void time_order_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    pa_usec_t t = pa_timeval_load(tv);
+    unsigned i = PA_PTR_TO_UINT(userdata);
+
+    fail_unless(t >= last_time);
+    last_time = t;
+
+    fail_unless(time_events[i] == e);
+    time_events[i] = NULL;
+    n_time_events_fired++;
+
+    /* Free an event that hasn't fired yet */
+    if (i % 10 == 0 && time_events[i + 1]) {
+        a->time_free(time_events[i + 1]);
+        time_events[i + 1] = NULL;
+    }
+}
+
+static void time_restart_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval ntv;
+
+    /* Restarting with a time in the past must not make the mainloop spin
+     * in dispatch_timeout(), it just fires again in the next iteration */
+    if (++n_restarts < 10)
+        a->time_restart(e, pa_timeval_rtstore(&ntv, 1, true));
+}
+
+static void time_quit_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    a->quit(a, 0);
+}
+
+START_TEST (time_order_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_time_event *restart_event, *quit_event;
+    struct timeval tv;
+    pa_usec_t now;
+    unsigned i, n_expected = 0;
+
+    m = pa_mainloop_new();
+    fail_if(!m);
+    a = pa_mainloop_get_api(m);
+
+    now = pa_rtclock_now();
+
+    for (i = 0; i < N_TIME_EVENTS; i++)
+        time_events[i] = a->time_new(a, pa_timeval_rtstore(&tv, now + (i * 37 % N_TIME_EVENTS) * 100, true), time_order_cb, PA_UINT_TO_PTR(i));
+
+    for (i = 0; i < N_TIME_EVENTS; i++) {
+        if (i % 7 == 0)
+            a->time_restart(time_events[i], pa_timeval_rtstore(&tv, now + 30 * PA_USEC_PER_MSEC + i, true));
+        else if (i % 5 == 0) {
+            a->time_free(time_events[i]);
+            time_events[i] = NULL;
+        } else if (i % 13 == 0)
+            a->time_restart(time_events[i], NULL);
+    }
+
+    restart_event = a->time_new(a, pa_timeval_rtstore(&tv, now, true), time_restart_cb, NULL);
+    quit_event = a->time_new(a, pa_timeval_rtstore(&tv, now + 50 * PA_USEC_PER_MSEC, true), time_quit_cb, NULL);
+
+    pa_mainloop_run(m, NULL);
+
+    fail_unless(n_restarts == 10);
+
+    for (i = 0; i < N_TIME_EVENTS; i++) {
+        if (!time_events[i])
+            continue;
+
+        /* Only the disabled ones are left */
+        fail_unless(i % 13 == 0 && i % 7 != 0 && i % 5 != 0);
+        a->time_free(time_events[i]);
+        n_expected++;
+    }
+
+    fail_unless(n_time_events_fired > 0);
+    fail_unless(n_time_events_fired + n_expected < N_TIME_EVENTS);
+
+    a->time_free(restart_event);
+    a->time_free(quit_event);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+static int pipes[N_PIPES][2];
+static pa_io_event *io_events[N_PIPES];
+static unsigned n_io_events_fired;
+
+static void io_churn_cb(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned i = PA_PTR_TO_UINT(userdata);
+    char c;
+
+    fail_unless(io_events[i] == e);
+    fail_unless(pipes[i][0] == fd);
+    fail_unless(read(fd, &c, 1) == 1);
+    fail_unless(c == (char) i);
+
+    a->io_free(e);
+    io_events[i] = NULL;
+
+    /* Replace every other event by a new one on the next pipe, which
+     * becomes readable only afterwards */
+    if (i % 2 == 0 && i + 1 < N_PIPES) {
+        fail_unless(!io_events[i + 1]);
+        io_events[i + 1] = a->io_new(a, pipes[i + 1][0], PA_IO_EVENT_INPUT, io_churn_cb, PA_UINT_TO_PTR(i + 1));
+        c = (char) (i + 1);
+        fail_unless(write(pipes[i + 1][1], &c, 1) == 1);
+    }
+
+    if (++n_io_events_fired == N_PIPES)
+        a->quit(a, 0);
+}
+
+START_TEST (io_churn_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    unsigned i;
+
+    m = pa_mainloop_new();
+    fail_if(!m);
+    a = pa_mainloop_get_api(m);
+
+    for (i = 0; i < N_PIPES; i++) {
+        fail_unless(pa_pipe_cloexec(pipes[i]) == 0);
+
+        if (i % 2 == 0) {
+            char c = (char) i;
+
+            io_events[i] = a->io_new(a, pipes[i][0], PA_IO_EVENT_INPUT, io_churn_cb, PA_UINT_TO_PTR(i));
+            fail_unless(write(pipes[i][1], &c, 1) == 1);
+        }
+    }
+
+    pa_mainloop_run(m, NULL);
+
+    fail_unless(n_io_events_fired == N_PIPES);
+
+    for (i = 0; i < N_PIPES; i++) {
+        fail_unless(!io_events[i]);
+        pa_close_pipe(pipes[i]);
+    }
+
+    pa_mainloop_free(m);
+}
+END_TEST
+
+static unsigned n_shared_fired[3];
+
+static void io_shared_cb(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    fail_unless(f & PA_IO_EVENT_INPUT);
+    n_shared_fired[PA_PTR_TO_UINT(userdata)]++;
+}
+
+/* Several io events on the same fd, and an fd that is closed before its
+ * io event is freed while it is still open elsewhere. Both need special
+ * care with epoll. */
+START_TEST (io_shared_fd_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_io_event *e0, *e1, *e2;
+    int p[2], q[2], d, i;
+    char c = 'x';
+
+    m = pa_mainloop_new();
+    fail_if(!m);
+    a = pa_mainloop_get_api(m);
+
+    fail_unless(pa_pipe_cloexec(p) == 0);
+    fail_unless(pa_pipe_cloexec(q) == 0);
+
+    e0 = a->io_new(a, p[0], PA_IO_EVENT_INPUT, io_shared_cb, PA_UINT_TO_PTR(0));
+    e1 = a->io_new(a, p[0], PA_IO_EVENT_INPUT, io_shared_cb, PA_UINT_TO_PTR(1));
+    fail_unless(write(p[1], &c, 1) == 1);
+
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == 2);
+    fail_unless(n_shared_fired[0] == 1 && n_shared_fired[1] == 1);
+
+    /* The other one must keep working */
+    a->io_free(e0);
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+    fail_unless(n_shared_fired[0] == 1 && n_shared_fired[1] == 2);
+
+    e2 = a->io_new(a, q[0], PA_IO_EVENT_INPUT, io_shared_cb, PA_UINT_TO_PTR(2));
+    fail_unless(write(q[1], &c, 1) == 1);
+    fail_unless((d = dup(q[0])) >= 0);
+    pa_close(q[0]);
+    a->io_free(e2);
+
+    for (i = 0; i < 5; i++)
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+
+    fail_unless(n_shared_fired[1] == 7);
+    fail_unless(n_shared_fired[2] == 0);
+
+    a->io_free(e1);
+    pa_mainloop_free(m);
+
+    pa_close_pipe(p);
+    pa_close(q[1]);
+    pa_close(d);
+}
+END_TEST
+
+#endif /* GLIB_MAIN_LOOP */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -129,6 +343,11 @@ int main(int argc, char *argv[]) {
     s = suite_create("MainLoop");
     tc = tcase_create("mainloop");
     tcase_add_test(tc, mainloop_test);
+#ifndef GLIB_MAIN_LOOP
+    tcase_add_test(tc, time_order_test);
+    tcase_add_test(tc, io_churn_test);
+    tcase_add_test(tc, io_shared_fd_test);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
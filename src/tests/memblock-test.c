@@ -20,16 +20,23 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/log.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/macro.h>
 
+#define N_THREADS 4
+#define N_BLOCKS 32
+#define N_ROUNDS 20000
+
 static void release_cb(pa_memimport *i, uint32_t block_id, void *userdata) {
     pa_log("%s: Imported block %u is released.", (char*) userdata, block_id);
 }
@@ -38,6 +45,16 @@ static void revoke_cb(pa_memexport *e, uint32_t block_id, void *userdata) {
     pa_log("%s: Exported block %u is revoked.", (char*) userdata, block_id);
 }
 
+/* Grows right away, like the main thread does */
+static void grow_cb(pa_mempool *p, void *userdata) {
+    pa_mempool_grow(p);
+}
+
+/* Only notes the request, like an IO thread does */
+static void grow_later_cb(pa_mempool *p, void *userdata) {
+    (*(unsigned *) userdata)++;
+}
+
 static void print_stats(pa_mempool *p, const char *text) {
     const pa_mempool_stat*s = pa_mempool_get_stat(p);
 
@@ -52,6 +69,13 @@ static void print_stats(pa_mempool *p, const char *text) {
                  "\texported_size = %u\n"
                  "\tn_too_large_for_pool = %u\n"
                  "\tn_pool_full = %u\n"
+                 "\tpool_footprint_size = %u\n"
+                 "\tn_slabs = %u\n"
+                 "\tpool_size = %u\n"
+                 "\tn_segments = %u\n"
+                 "\tpool_used_size = %u\n"
+                 "\tpool_used_size_max = %u\n"
+                 "\tn_fallback = %u\n"
                  "}",
            text,
            (unsigned) pa_atomic_load(&s->n_allocated),
@@ -63,7 +87,14 @@ static void print_stats(pa_mempool *p, const char *text) {
            (unsigned) pa_atomic_load(&s->imported_size),
            (unsigned) pa_atomic_load(&s->exported_size),
            (unsigned) pa_atomic_load(&s->n_too_large_for_pool),
-           (unsigned) pa_atomic_load(&s->n_pool_full));
+           (unsigned) pa_atomic_load(&s->n_pool_full),
+           (unsigned) pa_atomic_load(&s->pool_footprint_size),
+           (unsigned) pa_atomic_load(&s->n_slabs),
+           (unsigned) pa_atomic_load(&s->pool_size),
+           (unsigned) pa_atomic_load(&s->n_segments),
+           (unsigned) pa_atomic_load(&s->pool_used_size),
+           (unsigned) pa_atomic_load(&s->pool_used_size_max),
+           (unsigned) pa_atomic_load(&s->n_fallback));
 }
 
 START_TEST (memblock_test) {
@@ -176,6 +207,294 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+struct thread_data {
+    pa_mempool *pool;
+    unsigned id;
+    bool ok;
+};
+
+/* Allocates and frees blocks of mostly small, varying sizes, like
+ * packets coming from clients, and checks they don't overlap */
+static void alloc_thread(void *userdata) {
+    struct thread_data *d = userdata;
+    pa_memblock *blocks[N_BLOCKS];
+    uint32_t rand = d->id;
+    unsigned i, j;
+
+    d->ok = true;
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        for (j = 0; j < N_BLOCKS; j++) {
+            size_t length;
+            uint8_t *x;
+
+            rand = rand * 1103515245 + 12345;
+            length = (rand >> 16) % 2048 + 16;
+
+            /* Once in a while something large */
+            if (j == 0)
+                length = 16 * 1024;
+
+            /* Mark both ends, that's enough to notice overlaps */
+            pa_assert_se(blocks[j] = pa_memblock_new(d->pool, length));
+            x = pa_memblock_acquire(blocks[j]);
+            memset(x, (int) (d->id * N_BLOCKS + j), 16);
+            memset(x + length - 16, (int) (d->id * N_BLOCKS + j), 16);
+            pa_memblock_release(blocks[j]);
+        }
+
+        for (j = 0; j < N_BLOCKS; j++) {
+            uint8_t *x = pa_memblock_acquire(blocks[j]);
+            size_t k, length = pa_memblock_get_length(blocks[j]);
+
+            for (k = 0; k < 16; k++)
+                if (x[k] != (uint8_t) (d->id * N_BLOCKS + j) ||
+                    x[length - 16 + k] != (uint8_t) (d->id * N_BLOCKS + j))
+                    d->ok = false;
+
+            pa_memblock_release(blocks[j]);
+            pa_memblock_unref(blocks[j]);
+        }
+    }
+}
+
+START_TEST (memblock_threads_test) {
+    pa_mempool *pool;
+    struct thread_data data[N_THREADS];
+    pa_thread *threads[N_THREADS];
+    pa_usec_t start, stop;
+    unsigned i;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    fail_unless(pool != NULL);
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_THREADS; i++) {
+        data[i].pool = pool;
+        data[i].id = i;
+        fail_unless((threads[i] = pa_thread_new("alloc", alloc_thread, &data[i])) != NULL);
+    }
+
+    for (i = 0; i < N_THREADS; i++) {
+        pa_thread_free(threads[i]);
+        fail_unless(data[i].ok);
+    }
+
+    stop = pa_rtclock_now();
+
+    pa_log_info("%u threads: %0.2f allocations per usec",
+                N_THREADS, (double) N_THREADS * N_ROUNDS * N_BLOCKS / (double) (stop - start));
+
+    print_stats(pool, "threads");
+
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_allocated) == 0);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->pool_footprint_size) == 0);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool)->n_pool_full) == 0);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+START_TEST (memblock_footprint_test) {
+    pa_mempool *pool;
+    pa_memblock *blocks[256];
+    const pa_mempool_stat *stat;
+    unsigned i, used, footprint;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(pool != NULL);
+    stat = pa_mempool_get_stat(pool);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, 100)) != NULL);
+
+    used = (unsigned) pa_atomic_load(&stat->allocated_size);
+    footprint = (unsigned) pa_atomic_load(&stat->pool_footprint_size);
+
+    pa_log_info("%u small blocks: %u bytes used, %u bytes of the pool taken, %0.1f%% efficiency",
+                (unsigned) PA_ELEMENTSOF(blocks), used, footprint, 100.0 * used / footprint);
+
+    /* Small blocks share slots */
+    fail_unless(footprint < PA_ELEMENTSOF(blocks) * pa_mempool_block_size_max(pool) / 16);
+    fail_unless(pa_atomic_load(&stat->n_slabs) > 0);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    fail_unless(pa_atomic_load(&stat->pool_footprint_size) == 0);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+START_TEST (memblock_grow_test) {
+    pa_mempool *pool_a, *pool_b;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    pa_memblock *blocks[24], *mb_b;
+    const pa_mempool_stat *stat;
+    size_t slot, initial_size;
+    unsigned i;
+
+    slot = PA_PAGE_ALIGN(64*1024);
+
+    pool_a = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 8 * slot, true);
+    fail_unless(pool_a != NULL);
+    pool_b = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(pool_b != NULL);
+
+    stat = pa_mempool_get_stat(pool_a);
+    initial_size = (size_t) pa_atomic_load(&stat->pool_size);
+    fail_unless(initial_size >= 8 * slot && initial_size < 9 * slot);
+
+    pa_mempool_set_max_size(pool_a, 0);
+    pa_mempool_set_grow_callback(pool_a, grow_cb, NULL);
+
+    /* Three times the initial size fits into the grown pool */
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++) {
+        uint8_t *d;
+
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool_a, pa_mempool_block_size_max(pool_a))) != NULL);
+
+        d = pa_memblock_acquire(blocks[i]);
+        memset(d, (int) i, pa_memblock_get_length(blocks[i]));
+        pa_memblock_release(blocks[i]);
+    }
+
+    print_stats(pool_a, "grown");
+
+    fail_unless(pa_atomic_load(&stat->n_segments) > 0);
+    fail_unless((size_t) pa_atomic_load(&stat->pool_size) > initial_size);
+    fail_unless(pa_atomic_load(&stat->n_fallback) == 0);
+    fail_unless(pa_mempool_get_segment_generation(pool_a) > 0);
+
+    /* Blocks from grown segments can be shared like any other */
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+    fail_unless(import_b != NULL);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i += 7) {
+        pa_mem_type_t mem_type;
+        uint32_t id, shm_id;
+        size_t offset, size;
+        uint8_t *d;
+
+        fail_unless(pa_memexport_put(export_a, blocks[i], &mem_type, &id, &shm_id, &offset, &size) >= 0);
+
+        mb_b = pa_memimport_get(import_b, mem_type, id, shm_id, offset, size, false);
+        fail_unless(mb_b != NULL);
+
+        d = pa_memblock_acquire(mb_b);
+        fail_unless(d[0] == i && d[size - 1] == i);
+        pa_memblock_release(mb_b);
+        pa_memblock_unref(mb_b);
+    }
+
+    pa_memimport_free(import_b);
+    pa_memexport_free(export_a);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    /* Unused segments are given back */
+    pa_mempool_vacuum(pool_a);
+
+    print_stats(pool_a, "vacuumed");
+
+    fail_unless(pa_atomic_load(&stat->n_segments) == 0);
+    fail_unless((size_t) pa_atomic_load(&stat->pool_size) == initial_size);
+    fail_unless(pa_atomic_load(&stat->pool_used_size) == 0);
+    fail_unless((size_t) pa_atomic_load(&stat->pool_used_size_max) >= PA_ELEMENTSOF(blocks) * slot);
+
+    pa_mempool_unref(pool_a);
+    pa_mempool_unref(pool_b);
+}
+END_TEST
+
+/* Allocating threads only ask for the pool to grow, and do so before
+ * it runs full */
+START_TEST (memblock_grow_later_test) {
+    pa_mempool *pool;
+    pa_memblock *blocks[10];
+    const pa_mempool_stat *stat;
+    unsigned i, n_requests = 0;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 8 * PA_PAGE_ALIGN(64*1024), true);
+    fail_unless(pool != NULL);
+    stat = pa_mempool_get_stat(pool);
+
+    pa_mempool_set_max_size(pool, 0);
+    pa_mempool_set_grow_callback(pool, grow_later_cb, &n_requests);
+
+    /* Fill the initial pool. The request comes early, and only once
+     * while it is outstanding. */
+    for (i = 0; i < 8; i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+
+    fail_unless(n_requests == 1);
+    fail_unless(pa_atomic_load(&stat->n_segments) == 0);
+
+    fail_unless(pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool)) == NULL);
+    fail_unless(n_requests == 1);
+
+    /* What the main thread does in response */
+    pa_mempool_grow(pool);
+    fail_unless(pa_atomic_load(&stat->n_segments) == 1);
+
+    for (i = 8; i < PA_ELEMENTSOF(blocks); i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+
+    fail_unless(n_requests == 2);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_mempool_vacuum(pool);
+    fail_unless(pa_atomic_load(&stat->n_segments) == 0);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+#ifdef HAVE_MEMFD
+/* Segments whose memfd was handed out to clients are kept */
+START_TEST (memblock_grow_memfd_test) {
+    pa_mempool *pool;
+    pa_memblock *blocks[16];
+    const pa_mempool_stat *stat;
+    uint32_t shm_id;
+    unsigned i;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_SHARED_MEMFD, 8 * PA_PAGE_ALIGN(64*1024), true);
+    fail_unless(pool != NULL);
+    stat = pa_mempool_get_stat(pool);
+
+    pa_mempool_set_max_size(pool, 0);
+    pa_mempool_set_grow_callback(pool, grow_cb, NULL);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, pa_mempool_block_size_max(pool))) != NULL);
+
+    fail_unless(pa_atomic_load(&stat->n_segments) > 1);
+    fail_unless(pa_mempool_get_segment_memfd_fd(pool, 0, &shm_id) >= 0);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_mempool_vacuum(pool);
+
+    print_stats(pool, "vacuumed");
+
+    fail_unless(pa_atomic_load(&stat->n_segments) == 1);
+    fail_unless(pa_mempool_get_segment_memfd_fd(pool, 0, &shm_id) >= 0);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+#endif
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -188,6 +507,14 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_threads_test);
+    tcase_add_test(tc, memblock_footprint_test);
+    tcase_add_test(tc, memblock_grow_test);
+    tcase_add_test(tc, memblock_grow_later_test);
+#ifdef HAVE_MEMFD
+    tcase_add_test(tc, memblock_grow_memfd_test);
+#endif
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
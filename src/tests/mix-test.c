@@ -32,6 +32,7 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
+#include <pulsecore/sconv.h>
 
 /* PA_SAMPLE_U8 */
 static const uint8_t u8_result[3][10] = {
@@ -342,6 +343,121 @@ START_TEST (mix_test) {
 }
 END_TEST
 
+#define MANY_STREAMS (PA_MIX_DIRECT_STREAMS_MAX + 8)
+
+/* Mix the same two streams as above together with lots of muted ones,
+ * which needs more streams than pa_mix() mixes directly */
+START_TEST (mix_many_test) {
+    pa_mempool *pool;
+    pa_sample_spec a;
+    pa_cvolume v;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    a.channels = 1;
+    a.rate = 44100;
+
+    v.channels = a.channels;
+    v.values[0] = pa_sw_volume_from_linear(0.9);
+
+    for (a.format = 0; a.format < PA_SAMPLE_MAX; a.format ++) {
+        pa_memchunk i, j, k;
+        pa_mix_info m[MANY_STREAMS];
+        unsigned n;
+        void *ptr;
+
+        pa_log_debug("=== mixing %u streams: %s\n", MANY_STREAMS, pa_sample_format_to_string(a.format));
+
+        i.memblock = generate_block(pool, &a);
+        i.length = pa_memblock_get_length(i.memblock);
+        i.index = 0;
+
+        j = i;
+        pa_memblock_ref(j.memblock);
+        pa_memchunk_make_writable(&j, 0);
+        pa_volume_memchunk(&j, &a, &v);
+
+        for (n = 0; n < MANY_STREAMS; n++) {
+            m[n].chunk = n == MANY_STREAMS / 2 ? j : i;
+            m[n].volume.values[0] = n == 0 || n == MANY_STREAMS / 2 ? PA_VOLUME_NORM : PA_VOLUME_MUTED;
+            m[n].volume.channels = a.channels;
+        }
+
+        k.memblock = pa_memblock_new(pool, i.length);
+        k.length = i.length;
+        k.index = 0;
+
+        ptr = pa_memblock_acquire_chunk(&k);
+        pa_mix(m, MANY_STREAMS, ptr, k.length, &a, NULL, false);
+        pa_memblock_release(k.memblock);
+
+        compare_block(&a, &k, 2);
+
+        pa_memblock_unref(i.memblock);
+        pa_memblock_unref(j.memblock);
+        pa_memblock_unref(k.memblock);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+START_TEST (mix_add_float32ne_test) {
+    pa_mempool *pool;
+    pa_sample_spec a;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    a.channels = 1;
+    a.rate = 44100;
+
+    for (a.format = 0; a.format < PA_SAMPLE_MAX; a.format ++) {
+        pa_memchunk i;
+        pa_mix_info m[2];
+        void *d;
+        float f_in[10], sum[10], expected;
+        unsigned n;
+
+        pa_log_debug("=== adding to float32ne: %s\n", pa_sample_format_to_string(a.format));
+
+        i.memblock = generate_block(pool, &a);
+        i.length = pa_memblock_get_length(i.memblock);
+        i.index = 0;
+
+        d = pa_memblock_acquire_chunk(&i);
+        pa_get_convert_to_float32ne_function(a.format)(10, d, f_in);
+        pa_memblock_release(i.memblock);
+
+        m[0].chunk = i;
+        m[0].volume.values[0] = PA_VOLUME_NORM;
+        m[0].volume.channels = a.channels;
+        m[1].chunk = i;
+        m[1].volume.values[0] = pa_sw_volume_from_linear(0.5);
+        m[1].volume.channels = a.channels;
+
+        for (n = 0; n < 10; n++)
+            sum[n] = 1.0f;
+
+        pa_mix_add_float32ne(m, 2, sum, i.length, &a);
+
+        for (n = 0; n < 10; n++) {
+            expected = 1.0f + f_in[n] * (1.0f + (float) pa_sw_volume_to_linear(m[1].volume.values[0]));
+            fail_unless(fabsf(sum[n] - expected) <= 1e-6f);
+        }
+
+        pa_memblock_unref(i.memblock);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -351,6 +467,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Mix");
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_test);
+    tcase_add_test(tc, mix_many_test);
+    tcase_add_test(tc, mix_add_float32ne_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,218 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Plays silence on 64 streams of one connection for a while, like a game
+ * engine or a DAW would, and prints how much was written and how much
+ * CPU time that took. Watch the server with e.g. 'perf stat' or
+ * 'pidstat -w' meanwhile to see its wakeups. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/mainloop.h>
+
+#define NSTREAMS 64
+#define DEFAULT_SECONDS 10
+
+static pa_context *context = NULL;
+static pa_stream *streams[NSTREAMS];
+static pa_mainloop_api *mainloop_api = NULL;
+
+static int n_streams_ready = 0;
+static uint64_t n_writes = 0;
+static uint64_t n_bytes = 0;
+static pa_usec_t duration = DEFAULT_SECONDS * PA_USEC_PER_SEC;
+static pa_usec_t start_time = 0;
+
+static const pa_sample_spec sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 48000,
+    .channels = 2
+};
+
+/* Short buffers, so that the streams ask for data often */
+static const pa_buffer_attr buffer_attr = {
+    .maxlength = (uint32_t) -1,
+    .tlength = 48 * 4 * 20, /* 20 ms */
+    .prebuf = (uint32_t) -1,
+    .minreq = 48 * 4 * 5, /* 5 ms */
+    .fragsize = (uint32_t) -1
+};
+
+static void quit(int ret) {
+    mainloop_api->quit(mainloop_api, ret);
+}
+
+static void stream_write_callback(pa_stream *s, size_t length, void *userdata) {
+    void *data;
+
+    if (pa_stream_begin_write(s, &data, &length) < 0) {
+        fprintf(stderr, "pa_stream_begin_write() failed: %s\n", pa_strerror(pa_context_errno(context)));
+        quit(1);
+        return;
+    }
+
+    memset(data, 0, length);
+
+    if (pa_stream_write(s, data, length, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+        fprintf(stderr, "pa_stream_write() failed: %s\n", pa_strerror(pa_context_errno(context)));
+        quit(1);
+        return;
+    }
+
+    n_writes++;
+    n_bytes += length;
+}
+
+static void time_event_callback(pa_mainloop_api *m, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    quit(0);
+}
+
+static void stream_state_callback(pa_stream *s, void *userdata) {
+    switch (pa_stream_get_state(s)) {
+        case PA_STREAM_UNCONNECTED:
+        case PA_STREAM_CREATING:
+        case PA_STREAM_TERMINATED:
+            break;
+
+        case PA_STREAM_READY:
+            if (++n_streams_ready >= NSTREAMS) {
+                fprintf(stderr, "All %d streams ready, running for %0.1f s.\n", NSTREAMS, (double) duration / PA_USEC_PER_SEC);
+
+                /* Only count from here on */
+                n_writes = n_bytes = 0;
+                start_time = pa_rtclock_now();
+                pa_context_rttime_new(context, start_time + duration, time_event_callback, NULL);
+            }
+            break;
+
+        default:
+        case PA_STREAM_FAILED:
+            fprintf(stderr, "Stream error: %s\n", pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+            quit(1);
+    }
+}
+
+static void context_state_callback(pa_context *c, void *userdata) {
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+            break;
+
+        case PA_CONTEXT_READY: {
+            int i;
+
+            for (i = 0; i < NSTREAMS; i++) {
+                char name[64];
+
+                snprintf(name, sizeof(name), "stream #%i", i);
+
+                if (!(streams[i] = pa_stream_new(c, name, &sample_spec, NULL))) {
+                    fprintf(stderr, "pa_stream_new() failed: %s\n", pa_strerror(pa_context_errno(c)));
+                    quit(1);
+                    return;
+                }
+
+                pa_stream_set_state_callback(streams[i], stream_state_callback, NULL);
+                pa_stream_set_write_callback(streams[i], stream_write_callback, NULL);
+                pa_stream_connect_playback(streams[i], NULL, &buffer_attr, PA_STREAM_ADJUST_LATENCY, NULL, NULL);
+            }
+
+            break;
+        }
+
+        case PA_CONTEXT_TERMINATED:
+            quit(0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            quit(1);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m = NULL;
+    struct rusage ru;
+    int i, ret = 1;
+
+    if (argc > 1) {
+        int seconds = atoi(argv[1]);
+
+        if (seconds <= 0) {
+            fprintf(stderr, "Usage: %s [SECONDS]\n", argv[0]);
+            return 1;
+        }
+
+        duration = (pa_usec_t) seconds * PA_USEC_PER_SEC;
+    }
+
+    m = pa_mainloop_new();
+    mainloop_api = pa_mainloop_get_api(m);
+
+    context = pa_context_new(mainloop_api, argv[0]);
+    pa_context_set_state_callback(context, context_state_callback, NULL);
+
+    if (pa_context_connect(context, NULL, 0, NULL) < 0) {
+        fprintf(stderr, "pa_context_connect() failed.\n");
+        goto quit;
+    }
+
+    if (pa_mainloop_run(m, &ret) < 0)
+        fprintf(stderr, "pa_mainloop_run() failed.\n");
+
+    if (ret == 0 && start_time > 0) {
+        pa_usec_t elapsed = pa_rtclock_now() - start_time;
+
+        getrusage(RUSAGE_SELF, &ru);
+
+        printf("Streams:      %d\n"
+               "Elapsed:      %0.3f s\n"
+               "Writes:       %llu (%0.1f/s)\n"
+               "Bytes:        %llu (%0.1f KiB/s)\n"
+               "CPU (user):   %0.3f s\n"
+               "CPU (system): %0.3f s\n"
+               "Context switches (voluntary/involuntary): %li/%li\n",
+               NSTREAMS,
+               (double) elapsed / PA_USEC_PER_SEC,
+               (unsigned long long) n_writes, (double) n_writes * PA_USEC_PER_SEC / elapsed,
+               (unsigned long long) n_bytes, (double) n_bytes * PA_USEC_PER_SEC / elapsed / 1024,
+               ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6,
+               ru.ru_nvcsw, ru.ru_nivcsw);
+    }
+
+quit:
+    for (i = 0; i < NSTREAMS; i++)
+        if (streams[i])
+            pa_stream_unref(streams[i]);
+
+    pa_context_unref(context);
+    pa_mainloop_free(m);
+
+    return ret;
+}
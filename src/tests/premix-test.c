@@ -0,0 +1,349 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Renders two streams that need the same resampling through a sink that
+ * mixes them before resampling and through one that resamples each on
+ * its own, rewrites part of one stream, and checks that both sinks come
+ * up with the same output. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/macro.h>
+
+#define SINK_RATE 48000
+#define INPUT_RATE 44100
+#define BLOCK_FRAMES 1024
+#define N_BLOCKS 16
+#define REWIND_FRAMES 512
+
+enum {
+    SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    SINK_MESSAGE_REWRITE
+};
+
+/* A sine generator, so that rewound data can be produced again */
+struct generator {
+    double freq;
+    double amplitude;
+    uint64_t pos;
+};
+
+struct test_sink {
+    pa_sink *sink;
+    pa_rtpoll *rtpoll;
+    pa_thread_mq thread_mq;
+    pa_thread *thread;
+
+    pa_sink_input *inputs[2];
+    struct generator generators[2];
+
+    float *output;
+    size_t n_output;
+};
+
+static pa_mainloop *mainloop = NULL;
+
+static const pa_sample_spec sink_spec = {
+    .format = PA_SAMPLE_FLOAT32NE,
+    .rate = SINK_RATE,
+    .channels = 2
+};
+
+static const pa_sample_spec input_spec = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = INPUT_RATE,
+    .channels = 2
+};
+
+/* Called from IO thread context */
+static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct generator *g = i->userdata;
+    size_t frame_size = pa_frame_size(&i->sample_spec);
+    size_t n_frames;
+    int16_t *d;
+    unsigned c;
+
+    n_frames = PA_MAX(nbytes / frame_size, (size_t) 1);
+
+    chunk->memblock = pa_memblock_new(i->sink->core->mempool, n_frames * frame_size);
+    chunk->index = 0;
+    chunk->length = n_frames * frame_size;
+
+    d = pa_memblock_acquire(chunk->memblock);
+
+    for (; n_frames > 0; n_frames--, g->pos++)
+        for (c = 0; c < i->sample_spec.channels; c++)
+            *(d++) = (int16_t) lrint(g->amplitude * sin(2 * M_PI * g->freq * (double) g->pos / INPUT_RATE + c));
+
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+/* Called from IO thread context */
+static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    struct generator *g = i->userdata;
+    uint64_t n_frames = nbytes / pa_frame_size(&i->sample_spec);
+
+    pa_assert(n_frames <= g->pos);
+    g->pos -= n_frames;
+}
+
+static void sink_input_kill_cb(pa_sink_input *i) {
+}
+
+/* Called from IO thread context */
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+    struct test_sink *t = s->userdata;
+
+    switch (code) {
+
+        case SINK_MESSAGE_RENDER:
+            /* Like a driver, handle outstanding rewind requests before
+             * rendering. Nothing was played yet, so there is nothing
+             * to rewind either. */
+            pa_sink_process_rewind(s, 0);
+            pa_sink_render_full(s, (size_t) offset, data);
+            return 0;
+
+        case SINK_MESSAGE_REWRITE: {
+            size_t nbytes;
+            unsigned k;
+
+            /* Have the given input, or all of them, rewrite everything
+             * they can, then pretend that the last REWIND_FRAMES
+             * rendered weren't played */
+            for (k = 0; k < 2; k++)
+                if (!data || data == t->inputs[k])
+                    pa_sink_input_request_rewind(t->inputs[k], 0, true, false, false);
+
+            nbytes = PA_MIN(s->thread_info.rewind_nbytes, REWIND_FRAMES * pa_frame_size(&s->sample_spec));
+            pa_sink_process_rewind(s, nbytes);
+
+            return (int) nbytes;
+        }
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void thread_func(void *userdata) {
+    struct test_sink *t = userdata;
+
+    pa_thread_mq_install(&t->thread_mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(t->rtpoll)) < 0)
+            pa_assert_not_reached();
+
+        if (ret == 0)
+            break;
+    }
+}
+
+static void test_sink_init(struct test_sink *t, pa_core *core, const char *name, bool premix) {
+    pa_sink_new_data data;
+    pa_channel_map map;
+    unsigned k;
+
+    pa_zero(*t);
+    pa_channel_map_init_stereo(&map);
+
+    t->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&t->thread_mq, core->mainloop, t->rtpoll);
+
+    /* Sinks pick this up when they are created */
+    core->premix_resampling = premix;
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, name);
+    pa_sink_new_data_set_sample_spec(&data, &sink_spec);
+    pa_sink_new_data_set_channel_map(&data, &map);
+    fail_unless((t->sink = pa_sink_new(core, &data, 0)) != NULL);
+    pa_sink_new_data_done(&data);
+
+    t->sink->parent.process_msg = sink_process_msg;
+    t->sink->userdata = t;
+
+    pa_sink_set_asyncmsgq(t->sink, t->thread_mq.inq);
+    pa_sink_set_rtpoll(t->sink, t->rtpoll);
+    pa_sink_set_max_rewind(t->sink, 4 * BLOCK_FRAMES * pa_frame_size(&sink_spec));
+    pa_sink_set_max_request(t->sink, BLOCK_FRAMES * pa_frame_size(&sink_spec));
+
+    fail_unless((t->thread = pa_thread_new(name, thread_func, t)) != NULL);
+
+    pa_sink_put(t->sink);
+
+    for (k = 0; k < 2; k++) {
+        pa_sink_input_new_data idata;
+        pa_cvolume v;
+
+        t->generators[k].freq = k == 0 ? 440 : 1000;
+        t->generators[k].amplitude = k == 0 ? 0x3000 : 0x2000;
+
+        pa_sink_input_new_data_init(&idata);
+        idata.driver = __FILE__;
+        pa_sink_input_new_data_set_sink(&idata, t->sink, false);
+        pa_sink_input_new_data_set_sample_spec(&idata, &input_spec);
+        pa_sink_input_new_data_set_channel_map(&idata, &map);
+        pa_sink_input_new_data_set_volume(&idata, pa_cvolume_set(&v, 2, k == 0 ? PA_VOLUME_NORM : pa_sw_volume_from_linear(0.5)));
+
+        fail_unless(pa_sink_input_new(&t->inputs[k], core, &idata) >= 0);
+        pa_sink_input_new_data_done(&idata);
+
+        t->inputs[k]->pop = sink_input_pop_cb;
+        t->inputs[k]->process_rewind = sink_input_process_rewind_cb;
+        t->inputs[k]->kill = sink_input_kill_cb;
+        t->inputs[k]->userdata = &t->generators[k];
+
+        pa_sink_input_put(t->inputs[k]);
+    }
+
+    t->output = pa_xnew(float, N_BLOCKS * 2 * BLOCK_FRAMES * sink_spec.channels);
+}
+
+static void test_sink_done(struct test_sink *t) {
+    unsigned k;
+
+    for (k = 0; k < 2; k++) {
+        pa_sink_input_unlink(t->inputs[k]);
+        pa_sink_input_unref(t->inputs[k]);
+    }
+
+    pa_sink_unlink(t->sink);
+
+    pa_asyncmsgq_send(t->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(t->thread);
+    pa_thread_mq_done(&t->thread_mq);
+
+    pa_sink_unref(t->sink);
+    pa_rtpoll_free(t->rtpoll);
+
+    pa_xfree(t->output);
+}
+
+static void test_sink_render(struct test_sink *t, unsigned n_blocks) {
+    size_t block_size = BLOCK_FRAMES * pa_frame_size(&sink_spec);
+
+    for (; n_blocks > 0; n_blocks--) {
+        pa_memchunk chunk;
+
+        pa_asyncmsgq_send(t->thread_mq.inq, PA_MSGOBJECT(t->sink), SINK_MESSAGE_RENDER, &chunk, (int64_t) block_size, NULL);
+        fail_unless(chunk.length == block_size);
+
+        memcpy(t->output + t->n_output, pa_memblock_acquire_chunk(&chunk), block_size);
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+
+        t->n_output += BLOCK_FRAMES * sink_spec.channels;
+
+        /* Dispatch whatever the IO thread sent us */
+        while (pa_mainloop_iterate(mainloop, 0, NULL) > 0)
+            ;
+    }
+}
+
+static void test_sink_rewrite(struct test_sink *t, pa_sink_input *i) {
+    int nbytes;
+
+    nbytes = pa_asyncmsgq_send(t->thread_mq.inq, PA_MSGOBJECT(t->sink), SINK_MESSAGE_REWRITE, i, 0, NULL);
+    fail_unless(nbytes == REWIND_FRAMES * (int) pa_frame_size(&sink_spec));
+
+    t->n_output -= REWIND_FRAMES * sink_spec.channels;
+}
+
+START_TEST (premix_rewind_test) {
+    pa_core *core;
+    struct test_sink grouped, single;
+    size_t n;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((mainloop = pa_mainloop_new()) != NULL);
+    fail_unless((core = pa_core_new(pa_mainloop_get_api(mainloop), false, false, 0)) != NULL);
+
+    test_sink_init(&grouped, core, "grouped", true);
+    test_sink_init(&single, core, "single", false);
+
+    test_sink_render(&grouped, N_BLOCKS);
+    test_sink_render(&single, N_BLOCKS);
+
+    /* The second stream changes its mind about what it played. In the
+     * group both streams have to be rewritten for that, which is what
+     * the other sink is asked to do explicitly. */
+    grouped.generators[1].amplitude = single.generators[1].amplitude = 0x1000;
+
+    test_sink_rewrite(&grouped, grouped.inputs[1]);
+    test_sink_rewrite(&single, NULL);
+
+    test_sink_render(&grouped, N_BLOCKS);
+    test_sink_render(&single, N_BLOCKS);
+
+    fail_unless(grouped.n_output == single.n_output);
+
+    for (n = 0; n < grouped.n_output; n++)
+        fail_unless(fabsf(grouped.output[n] - single.output[n]) <= 1e-3f,
+                    "Sample %zu differs: %f vs %f", n, grouped.output[n], single.output[n]);
+
+    test_sink_done(&grouped);
+    test_sink_done(&single);
+
+    pa_core_unref(core);
+    pa_mainloop_free(mainloop);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Premix");
+    tc = tcase_create("premix");
+    tcase_add_test(tc, premix_rewind_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/tagstruct.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/memblock.h>
+
+/* Fills a tagstruct with n u32 values and a trailing u64 */
+static void fill_tagstruct(pa_tagstruct *t, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        pa_tagstruct_putu32(t, i);
+
+    pa_tagstruct_putu64(t, n);
+}
+
+static void check_tagstruct(pa_tagstruct *t, unsigned n) {
+    unsigned i;
+    uint32_t u;
+    uint64_t l;
+
+    for (i = 0; i < n; i++) {
+        fail_unless(pa_tagstruct_getu32(t, &u) == 0);
+        fail_unless(u == i);
+    }
+
+    fail_unless(pa_tagstruct_getu64(t, &l) == 0);
+    fail_unless(l == n);
+    fail_unless(pa_tagstruct_eof(t));
+}
+
+START_TEST (tagstruct_packet_test) {
+    /* Appended, pooled and dynamic storage, and the transitions between
+     * them while writing */
+    unsigned counts[] = { 1, 20, 100, 800, 1000, 5000 };
+    size_t hints[] = { 0, 64, 1000, PA_PACKET_POOL_BUFFER_SIZE, 100000 };
+    unsigned i, j;
+
+    for (i = 0; i < PA_ELEMENTSOF(counts); i++)
+        for (j = 0; j < PA_ELEMENTSOF(hints); j++) {
+            pa_tagstruct *t;
+            pa_packet *packet;
+            const uint8_t *data;
+            size_t length;
+
+            t = pa_tagstruct_new_sized(hints[j]);
+            fill_tagstruct(t, counts[i]);
+            fail_unless(pa_tagstruct_data(t, &length) != NULL);
+            fail_unless(length == counts[i] * 5 + 9);
+
+            packet = pa_tagstruct_free_to_packet(t);
+            data = pa_packet_data(packet, &length);
+            fail_unless(length == counts[i] * 5 + 9);
+
+            t = pa_tagstruct_new_fixed(data, length);
+            check_tagstruct(t, counts[i]);
+            pa_tagstruct_free(t);
+
+            pa_packet_unref(packet);
+        }
+
+    /* Tagstructs that are freed without being sent */
+    for (i = 0; i < PA_ELEMENTSOF(counts); i++) {
+        pa_tagstruct *t = pa_tagstruct_new();
+
+        fill_tagstruct(t, counts[i]);
+        pa_tagstruct_free(t);
+    }
+}
+END_TEST
+
+static unsigned packets_received;
+static size_t packets_length;
+
+static void packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    size_t plen;
+
+    pa_packet_data(packet, &plen);
+    fail_unless(packets_length == plen);
+
+    packets_received++;
+}
+
+/* Sends npackets tagstructs that look like a reply with n extra u32
+ * values, keeping at most window of them in flight */
+static void run_benchmark(const char *name, unsigned n, unsigned npackets, pa_mainloop *ml, pa_pstream *p1, pa_pstream *p2) {
+    const unsigned window = 64;
+    unsigned sent = 0, i;
+    pa_usec_t start, stop;
+
+    packets_received = 0;
+    packets_length = 10 + n * 5;
+    pa_pstream_set_receive_packet_callback(p2, packet_received, NULL);
+
+    start = pa_rtclock_now();
+
+    while (packets_received < npackets) {
+        while (sent < npackets && sent - packets_received < window) {
+            pa_tagstruct *t = pa_tagstruct_new_sized(packets_length);
+
+            pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+            pa_tagstruct_putu32(t, sent);
+            for (i = 0; i < n; i++)
+                pa_tagstruct_putu32(t, i);
+
+            pa_pstream_send_tagstruct(p1, t);
+            sent++;
+        }
+
+        pa_mainloop_iterate(ml, 1, NULL);
+    }
+
+    stop = pa_rtclock_now();
+
+    pa_log_info("%s (%zu bytes): %0.0f packets per second", name, packets_length,
+                (double) npackets * PA_USEC_PER_SEC / PA_MAX(stop - start, 1U));
+}
+
+START_TEST (pstream_benchmark) {
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    unsigned npackets;
+    int fds[2];
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    npackets = getenv("MAKE_CHECK") ? 10000 : 500000;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    /* Sizes of REQUEST, GET_LATENCY replies and a typical info reply */
+    run_benchmark("request", 1, npackets, ml, p1, p2);
+    run_benchmark("latency reply", 16, npackets, ml, p1, p2);
+    run_benchmark("info reply", 300, npackets / 4, ml, p1, p2);
+    run_benchmark("large reply", 2000, npackets / 20, ml, p1, p2);
+
+    pa_pstream_unlink(p1);
+    pa_pstream_unref(p1);
+    pa_pstream_unlink(p2);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("pstream");
+    tc = tcase_create("pstream");
+    tcase_add_test(tc, tagstruct_packet_test);
+    tcase_add_test(tc, pstream_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
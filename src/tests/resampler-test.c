@@ -22,6 +22,8 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <math.h>
+#include <string.h>
 
 #include <pulse/pulseaudio.h>
 
@@ -37,6 +39,7 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/cpu.h>
 
 static void dump_block(const char *label, const pa_sample_spec *ss, const pa_memchunk *chunk) {
     void *d;
@@ -263,10 +266,16 @@ static void help(const char *argv0) {
            "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
            "      --resample-method=METHOD        Resample method (defaults to auto)\n"
            "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+           "      --benchmark                     Compare quality and CPU usage of the resample methods\n"
            "\n"
            "If the formats are not specified, the test performs all formats combinations,\n"
            "back and forth.\n"
            "\n"
+           "The benchmark resamples sine waves between common rates with all supported\n"
+           "methods, or only with the one given, and prints the signal to noise ratio and\n"
+           "the total harmonic distortion of the output along with the time it took to\n"
+           "resample SECONDS seconds of stereo audio.\n"
+           "\n"
            "Sample type must be one of s16le, s16be, u8, float32le, float32be, ulaw, alaw,\n"
            "s24le, s24be, s24-32le, s24-32be, s32le, s32be (defaults to s16ne)\n"
            "\n"
@@ -284,9 +293,342 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_BENCHMARK
 };
 
+/* Least squares fit of a sine wave of the given frequency, returns the
+ * amplitude and subtracts the sine wave from the data */
+static double remove_tone(double *d, unsigned n, double freq, unsigned rate) {
+    double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0, det, a, b;
+    double w = 2 * M_PI * freq / rate;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        double si = sin(w * i), ci = cos(w * i);
+
+        ss += si * si;
+        cc += ci * ci;
+        sc += si * ci;
+        xs += d[i] * si;
+        xc += d[i] * ci;
+    }
+
+    det = ss * cc - sc * sc;
+    a = (xs * cc - xc * sc) / det;
+    b = (xc * ss - xs * sc) / det;
+
+    for (i = 0; i < n; i++)
+        d[i] -= a * sin(w * i) + b * cos(w * i);
+
+    return sqrt(a * a + b * b);
+}
+
+static double power(const double *d, unsigned n) {
+    double sum = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        sum += d[i] * d[i];
+
+    return sum / n;
+}
+
+/* Resamples one second of a stereo sine wave and measures the output of the
+ * first channel. The noise includes the harmonics, i.e. it is THD+N. */
+static void measure_tone(pa_mempool *pool, pa_resample_method_t method, unsigned from, unsigned to,
+                         double freq, double *snr, double *thd) {
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, from, 2 }, b = { PA_SAMPLE_FLOAT32NE, to, 2 };
+    pa_resampler *resampler;
+    pa_memchunk i, j;
+    double *out, amplitude, harmonics = 0;
+    unsigned k, n, skip;
+    float *d;
+
+    pa_assert_se(resampler = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, 0));
+
+    i.memblock = pa_memblock_new(pool, pa_usec_to_bytes(PA_USEC_PER_SEC, &a));
+    i.length = pa_memblock_get_length(i.memblock);
+    i.index = 0;
+
+    d = pa_memblock_acquire(i.memblock);
+    for (k = 0; k < from; k++)
+        d[2 * k] = d[2 * k + 1] = (float) (0.5 * sin(2 * M_PI * freq * k / from));
+    pa_memblock_release(i.memblock);
+
+    pa_resampler_run(resampler, &i, &j);
+
+    /* Leave out the start, where the filters settle */
+    n = j.length / pa_frame_size(&b);
+    skip = to / 20;
+    pa_assert_se(n > 2 * skip);
+    n -= 2 * skip;
+
+    out = pa_xnew(double, n);
+    d = pa_memblock_acquire_chunk(&j);
+    for (k = 0; k < n; k++)
+        out[k] = d[2 * (k + skip)];
+    pa_memblock_release(j.memblock);
+
+    amplitude = remove_tone(out, n, freq, to);
+    for (k = 2; k <= 5 && k * freq < to / 2; k++) {
+        double h = remove_tone(out, n, k * freq, to);
+        harmonics += h * h;
+    }
+
+    *snr = 10 * log10((amplitude * amplitude / 2) / (power(out, n) + harmonics / 2));
+    *thd = harmonics > 0 ? 10 * log10(harmonics / (amplitude * amplitude)) : -INFINITY;
+
+    pa_xfree(out);
+    pa_memblock_unref(i.memblock);
+    pa_memblock_unref(j.memblock);
+    pa_resampler_free(resampler);
+}
+
+static pa_usec_t measure_cpu(pa_mempool *pool, pa_resample_method_t method, unsigned from, unsigned to, int seconds) {
+    pa_sample_spec a = { PA_SAMPLE_FLOAT32NE, from, 2 }, b = { PA_SAMPLE_FLOAT32NE, to, 2 };
+    pa_resampler *resampler;
+    pa_memchunk i, j;
+    pa_usec_t ts;
+
+    pa_assert_se(resampler = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, 0));
+
+    /* 10ms blocks, like a sink would ask for */
+    i.memblock = pa_memblock_new(pool, pa_usec_to_bytes(10 * PA_USEC_PER_MSEC, &a));
+    i.length = pa_memblock_get_length(i.memblock);
+    i.index = 0;
+    pa_silence_memchunk(&i, &a);
+
+    ts = pa_rtclock_now();
+    for (seconds *= 100; seconds > 0; seconds--) {
+        pa_resampler_run(resampler, &i, &j);
+        if (j.memblock)
+            pa_memblock_unref(j.memblock);
+    }
+    ts = pa_rtclock_now() - ts;
+
+    pa_memblock_unref(i.memblock);
+    pa_resampler_free(resampler);
+
+    return ts;
+}
+
+static void benchmark(pa_mempool *pool, pa_resample_method_t only, int seconds) {
+    static const unsigned rates[][2] = {
+        { 44100, 48000 }, { 48000, 44100 }, { 48000, 16000 }, { 16000, 48000 }
+    };
+    pa_resample_method_t method;
+    unsigned k;
+
+    printf("%-24s %-14s %10s %9s %9s %9s\n", "method", "rates", "cpu (ms)", "snr 1k", "thd 1k", "snr high");
+
+    for (k = 0; k < PA_ELEMENTSOF(rates); k++) {
+        unsigned from = rates[k][0], to = rates[k][1];
+
+        for (method = 0; method < PA_RESAMPLER_MAX; method++) {
+            double snr, thd, snr_high, unused;
+            char buf[32];
+
+            if (only != PA_RESAMPLER_AUTO && method != only)
+                continue;
+
+            if (!pa_resample_method_supported(method) || method == PA_RESAMPLER_AUTO ||
+                method == PA_RESAMPLER_COPY || method == PA_RESAMPLER_PEAKS)
+                continue;
+
+            measure_tone(pool, method, from, to, 1000, &snr, &thd);
+            measure_tone(pool, method, from, to, 0.4 * PA_MIN(from, to), &snr_high, &unused);
+
+            pa_snprintf(buf, sizeof(buf), "%u->%u", from, to);
+            printf("%-24s %-14s %10.1f %9.1f %9.1f %9.1f\n", pa_resample_method_to_string(method), buf,
+                   (double) measure_cpu(pool, method, from, to, seconds) / PA_USEC_PER_MSEC, snr, thd, snr_high);
+        }
+    }
+}
+
+/* Fills a block with a sine wave of a different frequency on each channel,
+ * close to full scale so that the conversions clamp after resampling */
+static pa_memblock* generate_tones(pa_mempool *pool, const pa_sample_spec *ss, unsigned n_frames) {
+    pa_memblock *r;
+    void *d;
+    unsigned k, c;
+
+    pa_assert(ss->format == PA_SAMPLE_S16NE || ss->format == PA_SAMPLE_S32NE);
+
+    pa_assert_se(r = pa_memblock_new(pool, n_frames * pa_frame_size(ss)));
+    d = pa_memblock_acquire(r);
+
+    for (k = 0; k < n_frames; k++)
+        for (c = 0; c < ss->channels; c++) {
+            double v = 0.95 * sin(2 * M_PI * (440 + 300 * c) * k / ss->rate);
+
+            if (ss->format == PA_SAMPLE_S16NE)
+                ((int16_t *) d)[k * ss->channels + c] = (int16_t) lrint(v * 0x7FFF);
+            else
+                ((int32_t *) d)[k * ss->channels + c] = (int32_t) lrint(v * 0x7FFFFFFF);
+        }
+
+    pa_memblock_release(r);
+
+    return r;
+}
+
+/* Resamples the whole block, block_size bytes at a time, and returns the
+ * output in one block */
+static pa_memblock* resample_block(pa_mempool *pool, pa_resampler *r, pa_memblock *in, size_t block_size) {
+    size_t length, offset, n = 0, size = 0;
+    uint8_t *data = NULL;
+    pa_memchunk i, j;
+
+    length = pa_memblock_get_length(in);
+
+    for (offset = 0; offset < length; offset += i.length) {
+        i.memblock = in;
+        i.index = offset;
+        i.length = PA_MIN(block_size, length - offset);
+
+        pa_resampler_run(r, &i, &j);
+        if (!j.memblock)
+            continue;
+
+        if (n + j.length > size) {
+            size = PA_MAX(2 * size, n + j.length);
+            data = pa_xrealloc(data, size);
+        }
+
+        memcpy(data + n, pa_memblock_acquire_chunk(&j), j.length);
+        pa_memblock_release(j.memblock);
+        pa_memblock_unref(j.memblock);
+
+        n += j.length;
+    }
+
+    pa_assert_se(n > 0);
+
+    return pa_memblock_new_malloced(pool, data, n);
+}
+
+static bool blocks_equal(const char *label, pa_memblock *a, pa_memblock *b) {
+    bool equal;
+
+    if (pa_memblock_get_length(a) != pa_memblock_get_length(b)) {
+        pa_log_error("%s: %zu vs %zu bytes", label, pa_memblock_get_length(a), pa_memblock_get_length(b));
+        return false;
+    }
+
+    equal = memcmp(pa_memblock_acquire(a), pa_memblock_acquire(b), pa_memblock_get_length(a)) == 0;
+    pa_memblock_release(a);
+    pa_memblock_release(b);
+
+    if (!equal)
+        pa_log_error("%s: output differs", label);
+
+    return equal;
+}
+
+/* The resampler merges the format conversion with the channel remapping
+ * when the remapping only moves channels around, and runs large blocks
+ * through all stages in tiles. Neither may change the output: compare it
+ * with what separate resamplers for each stage produce, and with what the
+ * same resampler produces from blocks that are too small to be tiled. */
+static bool check_fused_and_tiled(pa_mempool *pool) {
+    static const struct {
+        pa_sample_format_t format;
+        unsigned from_rate, to_rate;
+        pa_channel_map from_map, to_map;
+        pa_resample_flags_t flags;
+    } tests[] = {
+        /* Swapped channels, arranged while converting to float */
+        { PA_SAMPLE_S16NE, 44100, 48000,
+          { 2, { PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT } },
+          { 2, { PA_CHANNEL_POSITION_FRONT_RIGHT, PA_CHANNEL_POSITION_FRONT_LEFT } }, 0 },
+        /* The rear channels are dropped while converting to float */
+        { PA_SAMPLE_S32NE, 48000, 44100,
+          { 4, { PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT,
+                 PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT } },
+          { 2, { PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT } }, PA_RESAMPLER_NO_REMIX },
+        /* Silent rear channels are added while converting from float */
+        { PA_SAMPLE_S16NE, 48000, 44100,
+          { 2, { PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT } },
+          { 4, { PA_CHANNEL_POSITION_FRONT_RIGHT, PA_CHANNEL_POSITION_FRONT_LEFT,
+                 PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT } }, PA_RESAMPLER_NO_REMIX },
+        /* Mono is copied to both channels while converting from float */
+        { PA_SAMPLE_S32NE, 44100, 48000,
+          { 1, { PA_CHANNEL_POSITION_MONO } },
+          { 2, { PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT } }, 0 },
+    };
+    bool ok = true;
+    unsigned k;
+
+    for (k = 0; k < PA_ELEMENTSOF(tests); k++) {
+        pa_sample_spec a, b, fa, fb;
+        pa_resampler *fused, *stages[3];
+        pa_memblock *in, *out, *tiled, *staged[3];
+        size_t block_size;
+        char label[64];
+        unsigned s;
+
+        a.format = b.format = tests[k].format;
+        a.rate = tests[k].from_rate;
+        b.rate = tests[k].to_rate;
+        a.channels = tests[k].from_map.channels;
+        b.channels = tests[k].to_map.channels;
+
+        fa = a;
+        fb = b;
+        fa.format = fb.format = PA_SAMPLE_FLOAT32NE;
+
+        pa_assert_se(fused = pa_resampler_new(pool, &a, &tests[k].from_map, &b, &tests[k].to_map, 0,
+                                              PA_RESAMPLER_POLYPHASE, tests[k].flags));
+
+        /* Conversion, remapping and resampling, and conversion again */
+        pa_assert_se(stages[0] = pa_resampler_new(pool, &a, &tests[k].from_map, &fa, &tests[k].from_map, 0,
+                                                  PA_RESAMPLER_POLYPHASE, tests[k].flags));
+        pa_assert_se(stages[1] = pa_resampler_new(pool, &fa, &tests[k].from_map, &fb, &tests[k].to_map, 0,
+                                                  PA_RESAMPLER_POLYPHASE, tests[k].flags));
+        pa_assert_se(stages[2] = pa_resampler_new(pool, &fb, &tests[k].to_map, &b, &tests[k].to_map, 0,
+                                                  PA_RESAMPLER_POLYPHASE, tests[k].flags));
+
+        in = generate_tones(pool, &a, a.rate);
+
+        /* Small enough to stay below the tile size */
+        block_size = 256 * pa_frame_size(&a);
+
+        out = resample_block(pool, fused, in, block_size);
+
+        staged[0] = resample_block(pool, stages[0], in, block_size);
+        for (s = 1; s < 3; s++)
+            staged[s] = resample_block(pool, stages[s], staged[s - 1], 256 * pa_frame_size(pa_resampler_input_sample_spec(stages[s])));
+
+        pa_snprintf(label, sizeof(label), "%s %u ch -> %u ch fused", pa_sample_format_to_string(a.format),
+                    a.channels, b.channels);
+        ok = blocks_equal(label, out, staged[2]) && ok;
+
+        /* All at once, from the start */
+        pa_resampler_free(fused);
+        pa_assert_se(fused = pa_resampler_new(pool, &a, &tests[k].from_map, &b, &tests[k].to_map, 0,
+                                              PA_RESAMPLER_POLYPHASE, tests[k].flags));
+        tiled = resample_block(pool, fused, in, pa_memblock_get_length(in));
+
+        pa_snprintf(label, sizeof(label), "%s %u ch -> %u ch tiled", pa_sample_format_to_string(a.format),
+                    a.channels, b.channels);
+        ok = blocks_equal(label, out, tiled) && ok;
+
+        pa_memblock_unref(in);
+        pa_memblock_unref(out);
+        pa_memblock_unref(tiled);
+
+        for (s = 0; s < 3; s++) {
+            pa_memblock_unref(staged[s]);
+            pa_resampler_free(stages[s]);
+        }
+
+        pa_resampler_free(fused);
+    }
+
+    return ok;
+}
+
 static void dump_resample_methods(void) {
     int i;
 
@@ -300,7 +642,8 @@ int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    bool all_formats = true;
+    bool all_formats = true, run_benchmark = false;
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_resample_method_t method;
     int seconds;
     unsigned crossover_freq = 120;
@@ -318,6 +661,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"benchmark",             0, NULL, ARG_BENCHMARK},
         {NULL,                    0, NULL, 0}
     };
 
@@ -359,6 +703,10 @@ int main(int argc, char *argv[]) {
                 ret = 0;
                 goto quit;
 
+            case ARG_BENCHMARK:
+                run_benchmark = true;
+                break;
+
             case ARG_FROM_CHANNELS:
                 a.channels = (uint8_t) atoi(optarg);
                 break;
@@ -406,6 +754,14 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
 
+    /* Use the same optimized functions as the daemon */
+    pa_cpu_init(&cpu_info);
+
+    if (run_benchmark) {
+        benchmark(pool, method, seconds);
+        goto quit;
+    }
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -439,6 +795,11 @@ int main(int argc, char *argv[]) {
         goto quit;
     }
 
+    if (!check_fused_and_tiled(pool)) {
+        ret = 1;
+        goto quit;
+    }
+
     for (a.format = 0; a.format < PA_SAMPLE_MAX; a.format ++) {
         for (b.format = 0; b.format < PA_SAMPLE_MAX; b.format ++) {
             pa_resampler *forth, *back;
@@ -0,0 +1,179 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/util.h>
+#include <pulsecore/ringbuffer.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define CAPACITY 1021
+#define TOTAL (1024*1024)
+
+/* Deliberately odd sizes, so that reads and writes wrap around at
+ * different places */
+#define WRITE_MAX 97
+#define READ_MAX 61
+
+static pa_atomic_t count;
+static uint8_t memory[CAPACITY];
+
+static uint8_t pattern(unsigned i) {
+    return (uint8_t) (i * 7 + (i >> 8));
+}
+
+static void producer(void *userdata) {
+    pa_ringbuffer r;
+    unsigned i = 0, n = 0;
+
+    r.count = &count;
+    r.capacity = CAPACITY;
+    r.memory = memory;
+    r.readindex = r.writeindex = 0;
+
+    while (i < TOTAL) {
+        uint8_t *p;
+        int l, j;
+
+        p = pa_ringbuffer_begin_write(&r, &l);
+        if (l == 0) {
+            pa_thread_yield();
+            continue;
+        }
+
+        l = PA_MIN(l, (int) (n++ % WRITE_MAX) + 1);
+        l = PA_MIN(l, (int) (TOTAL - i));
+
+        for (j = 0; j < l; j++)
+            p[j] = pattern(i++);
+
+        pa_ringbuffer_end_write(&r, l);
+    }
+}
+
+static void consumer(void *userdata) {
+    pa_ringbuffer r;
+    unsigned i = 0, n = 0;
+
+    r.count = &count;
+    r.capacity = CAPACITY;
+    r.memory = memory;
+    r.readindex = r.writeindex = 0;
+
+    while (i < TOTAL) {
+        const uint8_t *p;
+        int l, j;
+
+        p = pa_ringbuffer_peek(&r, &l);
+        if (l == 0) {
+            pa_thread_yield();
+            continue;
+        }
+
+        l = PA_MIN(l, (int) (n++ % READ_MAX) + 1);
+
+        for (j = 0; j < l; j++)
+            if (p[j] != pattern(i++)) {
+                pa_log_error("Mismatch at byte %u", i - 1);
+                fail();
+            }
+
+        pa_ringbuffer_drop(&r, l);
+    }
+}
+
+START_TEST (ringbuffer_test) {
+    pa_thread *t1, *t2;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_atomic_store(&count, 0);
+
+    t1 = pa_thread_new("producer", producer, NULL);
+    fail_unless(t1 != NULL);
+    t2 = pa_thread_new("consumer", consumer, NULL);
+    fail_unless(t2 != NULL);
+
+    pa_thread_free(t1);
+    pa_thread_free(t2);
+
+    fail_unless(pa_atomic_load(&count) == 0);
+}
+END_TEST
+
+START_TEST (ringbuffer_full_test) {
+    pa_ringbuffer r;
+    int l;
+
+    pa_atomic_store(&count, 0);
+    r.count = &count;
+    r.capacity = CAPACITY;
+    r.memory = memory;
+    r.readindex = r.writeindex = 0;
+
+    pa_ringbuffer_begin_write(&r, &l);
+    fail_unless(l == CAPACITY);
+    pa_ringbuffer_end_write(&r, CAPACITY);
+
+    pa_ringbuffer_begin_write(&r, &l);
+    fail_unless(l == 0);
+
+    pa_ringbuffer_peek(&r, &l);
+    fail_unless(l == CAPACITY);
+    fail_unless(pa_ringbuffer_drop(&r, 10));
+    fail_unless(!pa_ringbuffer_drop(&r, 10));
+
+    pa_ringbuffer_begin_write(&r, &l);
+    fail_unless(l == 20);
+
+    /* The readable data wraps around now */
+    pa_ringbuffer_end_write(&r, 20);
+    pa_ringbuffer_peek(&r, &l);
+    fail_unless(l == CAPACITY - 20);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Ringbuffer");
+    tc = tcase_create("ringbuffer");
+    tcase_add_test(tc, ringbuffer_test);
+    tcase_add_test(tc, ringbuffer_full_test);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
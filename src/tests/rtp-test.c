@@ -0,0 +1,584 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/arpa-inet.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/poll.h>
+
+#include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
+
+#include "../modules/rtp/rtp.h"
+#include "../modules/rtp/jitterbuffer.h"
+
+#define MTU 1280
+#define PACKETS_PER_ROUND 48
+#define PAYLOAD 127
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16BE,
+    .rate = 48000,
+    .channels = 2
+};
+
+/* A socket bound to some port on the loopback interface */
+static int bound_socket(struct sockaddr_in *sa) {
+    socklen_t salen = sizeof(*sa);
+    int fd, one = 1, rcvbuf = 4*1024*1024;
+
+    pa_zero(*sa);
+    sa->sin_family = AF_INET;
+    sa->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa->sin_port = 0;
+
+    fail_unless((fd = pa_socket_cloexec(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    fail_unless(bind(fd, (struct sockaddr*) sa, sizeof(*sa)) == 0);
+    fail_unless(getsockname(fd, (struct sockaddr*) sa, &salen) == 0);
+    fail_unless(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) == 0);
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    return fd;
+}
+
+/* A connected sender and a receiver socket on the loopback interface */
+static void socket_pair(int *send_fd, int *recv_fd) {
+    struct sockaddr_in sa;
+
+    *recv_fd = bound_socket(&sa);
+
+    fail_unless((*send_fd = pa_socket_cloexec(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    fail_unless(connect(*send_fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+}
+
+static pa_memblockq *queue_new(void) {
+    return pa_memblockq_new("rtp-test memblockq", 0, 2 * PACKETS_PER_ROUND * MTU, 0, &ss, 0, 0, 0, NULL);
+}
+
+/* One round worth of data, byte i of the round is i % 251 */
+static pa_memblock *round_block_new(pa_mempool *pool) {
+    pa_memblock *b;
+    uint8_t *d;
+    size_t i;
+
+    b = pa_memblock_new(pool, PACKETS_PER_ROUND * MTU);
+    d = pa_memblock_acquire(b);
+    for (i = 0; i < PACKETS_PER_ROUND * MTU; i++)
+        d[i] = (uint8_t) (i % 251);
+    pa_memblock_release(b);
+
+    return b;
+}
+
+static void send_round(pa_rtp_context *c, pa_memblockq *q, pa_memblock *b) {
+    pa_memchunk chunk;
+
+    chunk.memblock = b;
+    chunk.index = 0;
+    chunk.length = pa_memblock_get_length(b);
+
+    fail_unless(pa_memblockq_push(q, &chunk) == 0);
+    fail_unless(pa_rtp_send(c, MTU, q) == 0);
+    fail_unless(pa_memblockq_get_length(q) == 0);
+}
+
+/* Receives one packet, waiting up to a second for it to arrive */
+static int recv_one(pa_rtp_context *c, pa_mempool *pool, pa_memchunk *chunk, struct timeval *tv) {
+    struct pollfd p;
+
+    for (;;) {
+        if (pa_rtp_recv_pending(c))
+            return pa_rtp_recv(c, chunk, pool, tv);
+
+        p.fd = c->fd;
+        p.events = POLLIN;
+        p.revents = 0;
+
+        if (poll(&p, 1, 1000) <= 0)
+            return -1;
+
+        if (pa_rtp_recv(c, chunk, pool, tv) == 0)
+            return 0;
+    }
+}
+
+static void roundtrip(unsigned send_batch, unsigned recv_batch) {
+    pa_mempool *pool;
+    pa_memblockq *q;
+    pa_memblock *b;
+    pa_rtp_context sc, rc;
+    int send_fd, recv_fd;
+    unsigned i, rounds = 3;
+    uint16_t sequence;
+    uint32_t timestamp;
+
+    pa_log_debug("Round trip with send batch %u, receive batch %u", send_batch, recv_batch);
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    q = queue_new();
+    b = round_block_new(pool);
+
+    socket_pair(&send_fd, &recv_fd);
+    pa_rtp_context_init_send(&sc, send_fd, 0x12345678, PAYLOAD, pa_frame_size(&ss));
+    pa_rtp_context_init_recv(&rc, recv_fd, pa_frame_size(&ss));
+    fail_unless(pa_rtp_context_set_batch(&sc, send_batch) == 0);
+    fail_unless(pa_rtp_context_set_batch(&rc, recv_batch) == 0);
+
+    sequence = sc.sequence;
+    timestamp = sc.timestamp;
+
+    for (i = 0; i < rounds; i++)
+        send_round(&sc, q, b);
+
+    for (i = 0; i < rounds * PACKETS_PER_ROUND; i++) {
+        pa_memchunk chunk;
+        struct timeval tv;
+        const uint8_t *d;
+        size_t offset, j;
+
+        fail_unless(recv_one(&rc, pool, &chunk, &tv) == 0);
+
+        fail_unless(rc.payload == PAYLOAD);
+        fail_unless(rc.ssrc == 0x12345678);
+        fail_unless(rc.sequence == (uint16_t) (sequence + i));
+        fail_unless(rc.timestamp == timestamp + i * (MTU / pa_frame_size(&ss)));
+        fail_unless(tv.tv_sec != 0);
+        fail_unless(chunk.length == MTU);
+
+        offset = (i % PACKETS_PER_ROUND) * MTU;
+        d = pa_memblock_acquire_chunk(&chunk);
+        for (j = 0; j < chunk.length; j++)
+            fail_unless(d[j] == (uint8_t) ((offset + j) % 251));
+        pa_memblock_release(chunk.memblock);
+
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    fail_unless(!pa_rtp_recv_pending(&rc));
+
+    pa_rtp_context_destroy(&sc);
+    pa_rtp_context_destroy(&rc);
+    pa_memblock_unref(b);
+    pa_memblockq_free(q);
+    pa_mempool_unref(pool);
+}
+
+START_TEST (rtp_roundtrip_test) {
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    roundtrip(1, 1);
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+    roundtrip(1, 16);
+    roundtrip(16, 1);
+    roundtrip(16, 16);
+    roundtrip(PA_RTP_BATCH_MAX, PA_RTP_BATCH_MAX);
+    roundtrip(7, 5);
+#endif
+}
+END_TEST
+
+static pa_usec_t cpu_time(void) {
+    struct rusage ru;
+
+    pa_assert_se(getrusage(RUSAGE_SELF, &ru) == 0);
+
+    return pa_timeval_load(&ru.ru_utime) + pa_timeval_load(&ru.ru_stime);
+}
+
+/* Sends and receives a number of packets over loopback and reports the
+ * packet rate as well as the CPU time that one 48 kHz stereo S16 stream
+ * at the default MTU (150 packets per second) would cost */
+static void benchmark(unsigned batch, unsigned rounds) {
+    pa_mempool *pool;
+    pa_memblockq *q;
+    pa_memblock *b;
+    pa_rtp_context sc, rc;
+    int send_fd, recv_fd;
+    unsigned i, j, received = 0;
+    pa_usec_t start, stop, cpu_start, cpu_stop;
+    double pps, stream_pps, cpu_per_packet;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    q = queue_new();
+    b = round_block_new(pool);
+
+    socket_pair(&send_fd, &recv_fd);
+    pa_rtp_context_init_send(&sc, send_fd, 0, PAYLOAD, pa_frame_size(&ss));
+    pa_rtp_context_init_recv(&rc, recv_fd, pa_frame_size(&ss));
+    fail_unless(pa_rtp_context_set_batch(&sc, batch) == 0);
+    fail_unless(pa_rtp_context_set_batch(&rc, batch) == 0);
+
+    start = pa_rtclock_now();
+    cpu_start = cpu_time();
+
+    for (i = 0; i < rounds; i++) {
+        send_round(&sc, q, b);
+
+        for (j = 0; j < PACKETS_PER_ROUND; j++) {
+            pa_memchunk chunk;
+            struct timeval tv;
+
+            if (recv_one(&rc, pool, &chunk, &tv) < 0)
+                break;
+
+            pa_memblock_unref(chunk.memblock);
+            received++;
+        }
+    }
+
+    stop = pa_rtclock_now();
+    cpu_stop = cpu_time();
+
+    pps = (double) received * PA_USEC_PER_SEC / (double) PA_MAX(stop - start, 1U);
+    stream_pps = (double) pa_bytes_per_second(&ss) / MTU;
+    cpu_per_packet = (double) (cpu_stop - cpu_start) / (double) PA_MAX(received, 1U);
+
+    pa_log_debug("batch %2u: %u/%u packets, %.0f packets/s, %.2f usec CPU/packet, %.4f%% CPU per stream",
+                 batch, received, rounds * PACKETS_PER_ROUND, pps, cpu_per_packet,
+                 cpu_per_packet * stream_pps / PA_USEC_PER_SEC * 100);
+
+    /* Loopback shouldn't drop anything with the receive buffer we asked for */
+    fail_unless(received == rounds * PACKETS_PER_ROUND);
+
+    pa_rtp_context_destroy(&sc);
+    pa_rtp_context_destroy(&rc);
+    pa_memblock_unref(b);
+    pa_memblockq_free(q);
+    pa_mempool_unref(pool);
+}
+
+START_TEST (rtp_benchmark) {
+    unsigned rounds = getenv("MAKE_CHECK") ? 50 : 2000;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    benchmark(1, rounds);
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+    benchmark(4, rounds);
+    benchmark(16, rounds);
+    benchmark(PA_RTP_BATCH_MAX, rounds);
+#endif
+}
+END_TEST
+
+#define JB_PACKETS 120
+#define JB_FRAMES (MTU / 4)
+
+/* Forwards the packets arriving on fd to sa in the order given by order[],
+ * packets that don't show up in there are dropped */
+static void inject(int fd, const struct sockaddr_in *sa, const int *order, unsigned n_order) {
+    static uint8_t packets[JB_PACKETS][MTU + 12];
+    ssize_t lengths[JB_PACKETS];
+    unsigned i;
+
+    for (i = 0; i < JB_PACKETS; i++) {
+        struct pollfd p;
+
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+
+        fail_unless(poll(&p, 1, 1000) == 1);
+        fail_unless((lengths[i] = recv(fd, packets[i], sizeof(packets[i]), 0)) == MTU + 12);
+    }
+
+    for (i = 0; i < n_order; i++)
+        fail_unless(sendto(fd, packets[order[i]], (size_t) lengths[order[i]], 0, (const struct sockaddr*) sa, sizeof(*sa)) == lengths[order[i]]);
+}
+
+START_TEST (jitter_buffer_test) {
+    pa_mempool *pool;
+    pa_memblockq *q;
+    pa_rtp_context sc, rc;
+    pa_jitter_buffer *jb;
+    pa_jitter_buffer_stats stats;
+    pa_convert_func_t to_float, from_float;
+    struct sockaddr_in recv_sa, inj_sa;
+    int send_fd, inj_fd, recv_fd;
+    int order[JB_PACKETS];
+    unsigned i, n_order = 0, arrival;
+    float *ref, *out;
+    bool *have;
+    uint32_t ts0, next_ts;
+    bool first = true;
+    const pa_usec_t packet_usec = pa_bytes_to_usec(MTU, &ss);
+    double step_max = 0, conceal_energy = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    pa_assert_se(to_float = pa_get_convert_to_float32ne_function(ss.format));
+    pa_assert_se(from_float = pa_get_convert_from_float32ne_function(ss.format));
+
+    /* Sender -> injector -> receiver */
+    recv_fd = bound_socket(&recv_sa);
+    inj_fd = bound_socket(&inj_sa);
+    fail_unless((send_fd = pa_socket_cloexec(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    fail_unless(connect(send_fd, (struct sockaddr*) &inj_sa, sizeof(inj_sa)) == 0);
+
+    pa_rtp_context_init_send(&sc, send_fd, 0, PAYLOAD, pa_frame_size(&ss));
+    pa_rtp_context_init_recv(&rc, recv_fd, pa_frame_size(&ss));
+
+    /* A 440 Hz sine, and what it looks like after a trip through S16 */
+    ref = pa_xnew(float, JB_PACKETS * JB_FRAMES * 2);
+    out = pa_xnew0(float, JB_PACKETS * JB_FRAMES * 2);
+    have = pa_xnew0(bool, JB_PACKETS * JB_FRAMES);
+
+    q = pa_memblockq_new("rtp-test memblockq", 0, JB_PACKETS * MTU, 0, &ss, 0, 0, 0, NULL);
+
+    for (i = 0; i < JB_PACKETS; i++) {
+        pa_memchunk chunk;
+        unsigned j;
+        void *d;
+
+        for (j = 0; j < JB_FRAMES; j++) {
+            double t = (double) (i * JB_FRAMES + j) / ss.rate;
+
+            ref[(i * JB_FRAMES + j) * 2] = (float) (0.5 * sin(2 * M_PI * 440 * t));
+            ref[(i * JB_FRAMES + j) * 2 + 1] = (float) (0.5 * cos(2 * M_PI * 440 * t));
+        }
+
+        chunk.memblock = pa_memblock_new(pool, MTU);
+        chunk.index = 0;
+        chunk.length = MTU;
+
+        d = pa_memblock_acquire(chunk.memblock);
+        from_float(JB_FRAMES * 2, ref + i * JB_FRAMES * 2, d);
+        to_float(JB_FRAMES * 2, d, ref + i * JB_FRAMES * 2);
+        pa_memblock_release(chunk.memblock);
+
+        pa_memblockq_push(q, &chunk);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    /* Drop 20, 50 and 51, swap 30/31 and 70/71, and delay 90 so much
+     * that it will have been concealed when it arrives */
+    for (i = 0; i < JB_PACKETS; i++) {
+        if (i == 20 || i == 50 || i == 51 || i == 90)
+            continue;
+
+        if (i == 30 || i == 70)
+            order[n_order++] = (int) i + 1;
+        else if (i == 31 || i == 71)
+            order[n_order++] = (int) i - 1;
+        else
+            order[n_order++] = (int) i;
+
+        if (i == 100)
+            order[n_order++] = 90;
+    }
+
+    fail_unless(pa_rtp_send(&sc, MTU, q) == 0);
+    inject(inj_fd, &recv_sa, order, n_order);
+
+    jb = pa_jitter_buffer_new(pool, &ss, 20 * PA_USEC_PER_MSEC);
+
+    for (arrival = 0; arrival < n_order; arrival++) {
+        pa_memchunk chunk;
+        struct timeval tv;
+        uint32_t timestamp;
+        /* Packets arrive in real time */
+        pa_usec_t now = arrival * packet_usec;
+
+        fail_unless(recv_one(&rc, pool, &chunk, &tv) == 0);
+
+        if (first) {
+            ts0 = next_ts = rc.timestamp;
+            first = false;
+        }
+
+        pa_jitter_buffer_put(jb, rc.sequence, rc.timestamp, &chunk, now);
+        pa_memblock_unref(chunk.memblock);
+
+        while (pa_jitter_buffer_get(jb, now, &chunk, &timestamp) >= 0) {
+            size_t frames = chunk.length / pa_frame_size(&ss), pos = timestamp - ts0;
+
+            /* Everything is handed out in order without holes */
+            fail_unless(timestamp == next_ts);
+            fail_unless(pos + frames <= JB_PACKETS * JB_FRAMES);
+            next_ts += (uint32_t) frames;
+
+            to_float((unsigned) frames * 2, (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index, out + pos * 2);
+            pa_memblock_release(chunk.memblock);
+            pa_memblock_unref(chunk.memblock);
+
+            for (i = 0; i < frames; i++)
+                have[pos + i] = true;
+        }
+    }
+
+    pa_jitter_buffer_get_stats(jb, &stats);
+    pa_log_debug("%llu received, %llu lost, %llu late, %llu duplicate, %llu concealed frames, jitter %0.2f ms",
+                 (unsigned long long) stats.received, (unsigned long long) stats.lost,
+                 (unsigned long long) stats.late, (unsigned long long) stats.duplicate,
+                 (unsigned long long) stats.concealed_frames,
+                 (double) pa_jitter_buffer_get_jitter(jb) / PA_USEC_PER_MSEC);
+
+    fail_unless(stats.received == n_order);
+    fail_unless(stats.lost == 4);
+    fail_unless(stats.late == 1);
+    fail_unless(stats.duplicate == 0);
+    fail_unless(stats.concealed_frames == 4 * JB_FRAMES);
+    fail_unless(pa_jitter_buffer_get_jitter(jb) > 0);
+
+    /* The last packet stays behind in case the one before it is late */
+    for (i = 0; i < (JB_PACKETS - 1) * JB_FRAMES; i++)
+        fail_unless(have[i]);
+
+    for (i = 0; i < (JB_PACKETS - 1) * JB_FRAMES; i++) {
+        unsigned packet = i / JB_FRAMES, j = i % JB_FRAMES;
+        bool concealed = packet == 20 || packet == 50 || packet == 51 || packet == 90;
+        bool crossfaded = (packet == 21 || packet == 52 || packet == 91) && j < 120;
+
+        if (i > 0) {
+            double step = fabs(out[i * 2] - out[(i - 1) * 2]);
+            step_max = PA_MAX(step_max, step);
+        }
+
+        if (concealed)
+            conceal_energy += out[i * 2] * out[i * 2] + out[i * 2 + 1] * out[i * 2 + 1];
+        else if (!crossfaded) {
+            /* Reordered packets are recovered exactly */
+            fail_unless(out[i * 2] == ref[i * 2]);
+            fail_unless(out[i * 2 + 1] == ref[i * 2 + 1]);
+        }
+    }
+
+    /* The sine moves by at most 0.029 per frame. Concealment should follow
+     * it without clicks and shouldn't just be silence. */
+    pa_log_debug("Largest step %0.4f, concealment RMS %0.4f", step_max, sqrt(conceal_energy / (4 * JB_FRAMES * 2)));
+    fail_unless(step_max < 0.1);
+    fail_unless(sqrt(conceal_energy / (4 * JB_FRAMES * 2)) > 0.3);
+
+    pa_jitter_buffer_free(jb);
+    pa_memblockq_free(q);
+    pa_rtp_context_destroy(&sc);
+    pa_rtp_context_destroy(&rc);
+    pa_assert_se(pa_close(inj_fd) == 0);
+    pa_xfree(ref);
+    pa_xfree(out);
+    pa_xfree(have);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* Feeds n packets of silence with consecutive sequence numbers and
+ * returns how many come out again */
+static unsigned jitter_buffer_feed(pa_jitter_buffer *jb, pa_mempool *pool, uint16_t sequence, uint32_t timestamp, unsigned n, pa_usec_t *now) {
+    unsigned i, out = 0;
+
+    for (i = 0; i < n; i++) {
+        pa_memchunk chunk;
+        uint32_t ts;
+
+        chunk.memblock = pa_memblock_new(pool, MTU);
+        chunk.index = 0;
+        chunk.length = MTU;
+        pa_silence_memchunk(&chunk, &ss);
+
+        pa_jitter_buffer_put(jb, (uint16_t) (sequence + i), timestamp + i * JB_FRAMES, &chunk, *now);
+        pa_memblock_unref(chunk.memblock);
+
+        while (pa_jitter_buffer_get(jb, *now, &chunk, &ts) >= 0) {
+            pa_memblock_unref(chunk.memblock);
+            out++;
+        }
+
+        *now += pa_bytes_to_usec(MTU, &ss);
+    }
+
+    return out;
+}
+
+START_TEST (jitter_buffer_restart_test) {
+    pa_mempool *pool;
+    pa_jitter_buffer *jb;
+    pa_jitter_buffer_stats stats;
+    pa_usec_t now = 0;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    jb = pa_jitter_buffer_new(pool, &ss, 20 * PA_USEC_PER_MSEC);
+
+    fail_unless(jitter_buffer_feed(jb, pool, 1000, 50000, 10, &now) == 10);
+
+    /* A restarted sender jumps back, that is no reason to drop it */
+    fail_unless(jitter_buffer_feed(jb, pool, 100, 1000, 10, &now) == 10);
+
+    /* Nor is jumping back across the wraparound */
+    fail_unless(jitter_buffer_feed(jb, pool, 65000, 2000, 10, &now) == 10);
+
+    /* A few packets back is just late */
+    fail_unless(jitter_buffer_feed(jb, pool, 65005, 2000 + 5 * JB_FRAMES, 1, &now) == 0);
+
+    pa_jitter_buffer_reset(jb);
+    fail_unless(jitter_buffer_feed(jb, pool, 7, 3000, 10, &now) == 10);
+
+    pa_jitter_buffer_get_stats(jb, &stats);
+    fail_unless(stats.late == 1);
+    fail_unless(stats.lost == 0);
+
+    pa_jitter_buffer_free(jb);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("RTP");
+    tc = tcase_create("rtp");
+    tcase_add_test(tc, rtp_roundtrip_test);
+    tcase_add_test(tc, rtp_benchmark);
+    tcase_add_test(tc, jitter_buffer_test);
+    tcase_add_test(tc, jitter_buffer_restart_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,9 +21,14 @@
 
 #include <check.h>
 #include <signal.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/rtpoll.h>
 
 static int before(pa_rtpoll_item *i) {
@@ -82,6 +87,99 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+static pa_rtpoll_item *new_pipe_item(pa_rtpoll *p, int fd) {
+    pa_rtpoll_item *i;
+    struct pollfd *pollfd;
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NEVER, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = fd;
+    pollfd->events = POLLIN;
+
+    return i;
+}
+
+static short get_revents(pa_rtpoll_item *i) {
+    return pa_rtpoll_item_get_pollfd(i, NULL)->revents;
+}
+
+/* Checks the fd and timer bookkeeping, which is different for the epoll
+ * backend. Run this with PULSE_NO_EPOLL set to test plain ppoll(). */
+START_TEST (rtpoll_events_test) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *i, *j;
+    int a[2], b[2];
+    pa_usec_t start;
+    char c = 'x';
+
+    fail_unless(pipe(a) == 0);
+    fail_unless(pipe(b) == 0);
+
+    p = pa_rtpoll_new();
+    i = new_pipe_item(p, a[0]);
+
+    /* Nothing to read, the timer has to wake us up */
+    start = pa_rtclock_now();
+    pa_rtpoll_set_timer_relative(p, 20 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(pa_rtclock_now() - start >= 20 * PA_USEC_PER_MSEC);
+    fail_unless(get_revents(i) == 0);
+
+    /* A timer in the past fires right away */
+    pa_rtpoll_set_timer_absolute(p, 1);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+
+    /* Readable fd, the timer must not be reported */
+    fail_unless(pa_write(a[1], &c, 1, NULL) == 1);
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(i) == POLLIN);
+    fail_unless(pa_read(a[0], &c, 1, NULL) == 1);
+
+    /* Change the fd of an existing item */
+    pa_rtpoll_item_get_pollfd(i, NULL)->fd = b[0];
+    fail_unless(pa_write(b[1], &c, 1, NULL) == 1);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(get_revents(i) == POLLIN);
+    fail_unless(pa_read(b[0], &c, 1, NULL) == 1);
+
+    /* Nothing readable anymore, revents must be cleared again */
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(i) == 0);
+
+    /* Two items listening on the same fd */
+    j = new_pipe_item(p, b[0]);
+    fail_unless(pa_write(b[1], &c, 1, NULL) == 1);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(get_revents(i) == POLLIN);
+    fail_unless(get_revents(j) == POLLIN);
+    fail_unless(pa_read(b[0], &c, 1, NULL) == 1);
+
+    pa_rtpoll_item_free(j);
+    pa_rtpoll_item_free(i);
+
+    /* Disabled timer, and the write end gone */
+    i = new_pipe_item(p, a[0]);
+    pa_close(a[1]);
+    pa_rtpoll_set_timer_disabled(p);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(i) & POLLHUP);
+
+    pa_rtpoll_item_free(i);
+    pa_rtpoll_free(p);
+
+    pa_close(a[0]);
+    pa_close(b[0]);
+    pa_close(b[1]);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -91,6 +189,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_events_test);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
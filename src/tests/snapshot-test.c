@@ -0,0 +1,488 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Checks pa_context_get_snapshot() against the get_*_info calls: full
+ * snapshots, deltas after changes and removals, the fallback to a full
+ * snapshot once the daemon dropped the tombstones a delta would need, and
+ * the field masks. Loads and unloads null sinks, so it needs a running
+ * daemon. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+#define MAX_ENTRIES 256
+
+/* More load and unload cycles of a null sink (a module, a sink and its
+ * monitor source) than the daemon keeps tombstones for, twice over */
+#define PRUNE_CYCLES 700
+
+struct entry {
+    pa_subscription_event_type_t facility;
+    uint32_t index;
+    bool removed;
+
+    char *name;
+    char *argument;
+    pa_cvolume volume;
+    pa_proplist *proplist;
+    uint32_t n_ports;
+    uint32_t n_formats;
+    pa_usec_t latency;
+    pa_usec_t configured_latency;
+};
+
+struct snapshot {
+    uint64_t generation;
+    bool full;
+    bool done;
+
+    struct entry entries[MAX_ENTRIES];
+    unsigned n_entries;
+};
+
+static pa_mainloop *mainloop = NULL;
+static pa_context *context = NULL;
+
+static void wait_for(bool *done) {
+    while (!*done)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+}
+
+static void wait_for_operation(pa_operation *o) {
+    fail_unless(o != NULL);
+
+    while (pa_operation_get_state(o) == PA_OPERATION_RUNNING)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+
+    fail_unless(pa_operation_get_state(o) == PA_OPERATION_DONE);
+    pa_operation_unref(o);
+}
+
+static void entry_set_sink(struct entry *en, const pa_sink_info *i) {
+    en->index = i->index;
+    en->name = pa_xstrdup(i->name);
+    en->volume = i->volume;
+    en->proplist = pa_proplist_copy(i->proplist);
+    en->n_ports = i->n_ports;
+    en->n_formats = i->n_formats;
+    en->latency = i->latency;
+    en->configured_latency = i->configured_latency;
+}
+
+static void entry_set_module(struct entry *en, const pa_module_info *i) {
+    en->index = i->index;
+    en->name = pa_xstrdup(i->name);
+    en->argument = pa_xstrdup(i->argument);
+    en->proplist = pa_proplist_copy(i->proplist);
+}
+
+static void entry_done(struct entry *en) {
+    pa_xfree(en->name);
+    pa_xfree(en->argument);
+
+    if (en->proplist)
+        pa_proplist_free(en->proplist);
+}
+
+static void snapshot_done(struct snapshot *s) {
+    unsigned k;
+
+    for (k = 0; k < s->n_entries; k++)
+        entry_done(&s->entries[k]);
+
+    s->n_entries = 0;
+}
+
+static void snapshot_cb(pa_context *c, const pa_snapshot_info *s, const pa_snapshot_entry *e, int eol, void *userdata) {
+    struct snapshot *r = userdata;
+    struct entry *en;
+
+    fail_unless(eol >= 0);
+    fail_unless(s != NULL);
+
+    if (eol) {
+        r->generation = s->generation;
+        r->full = s->full;
+        r->done = true;
+        return;
+    }
+
+    fail_unless(r->n_entries < MAX_ENTRIES);
+    en = &r->entries[r->n_entries++];
+
+    pa_zero(*en);
+    en->facility = e->facility;
+    en->removed = e->removed;
+
+    if (e->removed) {
+        fail_unless(!e->sink && !e->source && !e->sink_input && !e->source_output && !e->client && !e->module);
+        en->index = e->index;
+        return;
+    }
+
+    switch (e->facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            fail_unless(e->sink != NULL);
+            entry_set_sink(en, e->sink);
+            break;
+
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            fail_unless(e->module != NULL);
+            entry_set_module(en, e->module);
+            break;
+
+        default:
+            ck_abort();
+    }
+
+    fail_unless(en->index == e->index);
+}
+
+static void get_snapshot(struct snapshot *s, pa_snapshot_fields_t fields, uint64_t since) {
+    pa_zero(*s);
+
+    pa_operation_unref(pa_context_get_snapshot(context, PA_SUBSCRIPTION_MASK_SINK|PA_SUBSCRIPTION_MASK_MODULE,
+                                               fields, since, snapshot_cb, s));
+    wait_for(&s->done);
+}
+
+static const struct entry *find_entry(const struct snapshot *s, pa_subscription_event_type_t facility, uint32_t idx) {
+    unsigned k;
+
+    for (k = 0; k < s->n_entries; k++)
+        if (s->entries[k].facility == facility && s->entries[k].index == idx)
+            return &s->entries[k];
+
+    return NULL;
+}
+
+static void sink_list_cb(pa_context *c, const pa_sink_info *i, int eol, void *userdata) {
+    struct snapshot *s = userdata;
+
+    fail_unless(eol >= 0);
+
+    if (eol) {
+        s->done = true;
+        return;
+    }
+
+    fail_unless(s->n_entries < MAX_ENTRIES);
+    s->entries[s->n_entries].facility = PA_SUBSCRIPTION_EVENT_SINK;
+    entry_set_sink(&s->entries[s->n_entries++], i);
+}
+
+static void module_list_cb(pa_context *c, const pa_module_info *i, int eol, void *userdata) {
+    struct snapshot *s = userdata;
+
+    fail_unless(eol >= 0);
+
+    if (eol) {
+        s->done = true;
+        return;
+    }
+
+    fail_unless(s->n_entries < MAX_ENTRIES);
+    s->entries[s->n_entries].facility = PA_SUBSCRIPTION_EVENT_MODULE;
+    entry_set_module(&s->entries[s->n_entries++], i);
+}
+
+/* What the get_*_info_list calls report, in the same form */
+static void get_info_lists(struct snapshot *s) {
+    pa_zero(*s);
+
+    pa_operation_unref(pa_context_get_sink_info_list(context, sink_list_cb, s));
+    wait_for(&s->done);
+
+    s->done = false;
+    pa_operation_unref(pa_context_get_module_info_list(context, module_list_cb, s));
+    wait_for(&s->done);
+}
+
+static void index_cb(pa_context *c, uint32_t idx, void *userdata) {
+    uint32_t *r = userdata;
+
+    fail_unless(idx != PA_INVALID_INDEX);
+    *r = idx;
+}
+
+static void sink_index_cb(pa_context *c, const pa_sink_info *i, int eol, void *userdata) {
+    uint32_t *r = userdata;
+
+    fail_unless(eol >= 0);
+
+    if (i)
+        *r = i->index;
+}
+
+static uint32_t load_null_sink(const char *name, uint32_t *sink_index) {
+    char *args;
+    uint32_t idx = PA_INVALID_INDEX;
+
+    args = pa_sprintf_malloc("sink_name=%s", name);
+    wait_for_operation(pa_context_load_module(context, "module-null-sink", args, index_cb, &idx));
+    pa_xfree(args);
+
+    if (sink_index) {
+        *sink_index = PA_INVALID_INDEX;
+        wait_for_operation(pa_context_get_sink_info_by_name(context, name, sink_index_cb, sink_index));
+        fail_unless(*sink_index != PA_INVALID_INDEX);
+    }
+
+    return idx;
+}
+
+static void unload_module(uint32_t idx) {
+    wait_for_operation(pa_context_unload_module(context, idx, NULL, NULL));
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    bool *ready = userdata;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            *ready = true;
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+
+        default:
+            break;
+    }
+}
+
+static void connect_context(void) {
+    bool ready = false;
+
+    fail_unless((mainloop = pa_mainloop_new()) != NULL);
+    fail_unless((context = pa_context_new(pa_mainloop_get_api(mainloop), "snapshot-test")) != NULL);
+
+    pa_context_set_state_callback(context, context_state_cb, &ready);
+    fail_unless(pa_context_connect(context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0);
+    wait_for(&ready);
+}
+
+static void disconnect_context(void) {
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(mainloop);
+}
+
+START_TEST (snapshot_full_test) {
+    struct snapshot *s, *lists;
+    unsigned k;
+
+    connect_context();
+
+    s = pa_xnew(struct snapshot, 1);
+    lists = pa_xnew(struct snapshot, 1);
+
+    get_info_lists(lists);
+
+    /* All fields, the records must parse the same as the info replies */
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_ALL, 0);
+    fail_unless(s->full);
+    fail_unless(s->generation != 0);
+    fail_unless(s->n_entries == lists->n_entries);
+
+    for (k = 0; k < lists->n_entries; k++) {
+        const struct entry *a = &lists->entries[k], *b;
+
+        fail_unless((b = find_entry(s, a->facility, a->index)) != NULL);
+        fail_unless(!b->removed);
+        fail_unless(pa_streq(a->name, b->name));
+        fail_unless(pa_safe_streq(a->argument, b->argument));
+        fail_unless(pa_proplist_equal(a->proplist, b->proplist));
+
+        if (a->facility == PA_SUBSCRIPTION_EVENT_SINK) {
+            fail_unless(pa_cvolume_equal(&a->volume, &b->volume));
+            fail_unless(a->n_ports == b->n_ports);
+            fail_unless(a->n_formats == b->n_formats);
+            fail_unless(a->configured_latency == b->configured_latency);
+        }
+    }
+
+    snapshot_done(s);
+
+    /* No optional fields, the records must still parse */
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, 0);
+    fail_unless(s->full);
+    fail_unless(s->n_entries == lists->n_entries);
+
+    for (k = 0; k < lists->n_entries; k++) {
+        const struct entry *a = &lists->entries[k], *b;
+
+        fail_unless((b = find_entry(s, a->facility, a->index)) != NULL);
+        fail_unless(pa_streq(a->name, b->name));
+        fail_unless(pa_proplist_isempty(b->proplist));
+
+        if (a->facility == PA_SUBSCRIPTION_EVENT_SINK) {
+            fail_unless(pa_cvolume_equal(&a->volume, &b->volume));
+            fail_unless(b->n_ports == 0);
+            fail_unless(b->n_formats == 0);
+            fail_unless(b->latency == 0);
+            fail_unless(b->configured_latency == 0);
+        }
+    }
+
+    snapshot_done(s);
+    snapshot_done(lists);
+    pa_xfree(s);
+    pa_xfree(lists);
+
+    disconnect_context();
+}
+END_TEST
+
+START_TEST (snapshot_delta_test) {
+    struct snapshot *s;
+    uint32_t module, sink;
+    uint64_t generation;
+    const struct entry *en;
+    pa_cvolume v;
+
+    connect_context();
+
+    s = pa_xnew(struct snapshot, 1);
+
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, 0);
+    generation = s->generation;
+    snapshot_done(s);
+
+    /* Nothing changed */
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, generation);
+    fail_unless(!s->full);
+    fail_unless(s->generation == generation);
+    fail_unless(s->n_entries == 0);
+    snapshot_done(s);
+
+    /* New objects */
+    module = load_null_sink("snapshot_test", &sink);
+
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, generation);
+    fail_unless(!s->full);
+    fail_unless(s->generation > generation);
+    fail_unless(s->n_entries == 2);
+    fail_unless((en = find_entry(s, PA_SUBSCRIPTION_EVENT_MODULE, module)) != NULL);
+    fail_unless(!en->removed);
+    fail_unless((en = find_entry(s, PA_SUBSCRIPTION_EVENT_SINK, sink)) != NULL);
+    fail_unless(!en->removed);
+    fail_unless(pa_streq(en->name, "snapshot_test"));
+    generation = s->generation;
+    snapshot_done(s);
+
+    /* A change, only the object that changed comes with it */
+    wait_for_operation(pa_context_set_sink_volume_by_index(context, sink, pa_cvolume_set(&v, 2, PA_VOLUME_NORM / 2), NULL, NULL));
+
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, generation);
+    fail_unless(!s->full);
+    fail_unless(s->generation > generation);
+    fail_unless(s->n_entries == 1);
+    fail_unless((en = find_entry(s, PA_SUBSCRIPTION_EVENT_SINK, sink)) != NULL);
+    fail_unless(!en->removed);
+    fail_unless(pa_cvolume_equal(&en->volume, &v));
+    generation = s->generation;
+    snapshot_done(s);
+
+    /* Removals */
+    unload_module(module);
+
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, generation);
+    fail_unless(!s->full);
+    fail_unless(s->n_entries == 2);
+    fail_unless((en = find_entry(s, PA_SUBSCRIPTION_EVENT_MODULE, module)) != NULL);
+    fail_unless(en->removed);
+    fail_unless((en = find_entry(s, PA_SUBSCRIPTION_EVENT_SINK, sink)) != NULL);
+    fail_unless(en->removed);
+    snapshot_done(s);
+
+    /* A generation from the future, e.g. from before a daemon restart */
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, s->generation + 1);
+    fail_unless(s->full);
+    fail_unless(find_entry(s, PA_SUBSCRIPTION_EVENT_SINK, sink) == NULL);
+    snapshot_done(s);
+
+    pa_xfree(s);
+
+    disconnect_context();
+}
+END_TEST
+
+START_TEST (snapshot_prune_test) {
+    struct snapshot *s;
+    uint64_t generation;
+    unsigned k;
+
+    connect_context();
+
+    s = pa_xnew(struct snapshot, 1);
+
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, 0);
+    generation = s->generation;
+    snapshot_done(s);
+
+    for (k = 0; k < PRUNE_CYCLES; k++)
+        unload_module(load_null_sink("snapshot_prune_test", NULL));
+
+    /* The daemon can't tell anymore what was removed since then */
+    get_snapshot(s, PA_SNAPSHOT_FIELDS_NONE, generation);
+    fail_unless(s->full);
+    fail_unless(s->generation > generation);
+
+    for (k = 0; k < s->n_entries; k++)
+        fail_unless(!s->entries[k].removed);
+
+    snapshot_done(s);
+    pa_xfree(s);
+
+    disconnect_context();
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Snapshot");
+    tc = tcase_create("snapshot");
+    tcase_add_test(tc, snapshot_full_test);
+    tcase_add_test(tc, snapshot_delta_test);
+    tcase_add_test(tc, snapshot_prune_test);
+    tcase_set_timeout(tc, 5 * 60);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -80,6 +80,44 @@ static void packet_test(unsigned npackets, size_t plength, pa_mainloop *ml, pa_p
     pa_packet_unref(packet);
 }
 
+/* Queue up a burst of packets before running the mainloop, like a client
+ * writing to many streams at once, so that they go out in one batch */
+static void packet_burst_test(unsigned nbursts, unsigned npackets, size_t plength, pa_mainloop *ml, pa_pstream *p1, pa_pstream *p2) {
+    pa_packet *packet = pa_packet_new(plength);
+    unsigned i, j;
+    unsigned psum = 0, totalsum = 0;
+    uint8_t *pdata;
+    size_t plen;
+
+    pa_log_info("Sending %d bursts of %d packets of length %zd", nbursts, npackets, plength);
+    packets_received = 0;
+    packets_checksum = 0;
+    packets_length = plength;
+    pa_pstream_set_receive_packet_callback(p2, packet_received, NULL);
+
+    pdata = (uint8_t *) pa_packet_data(packet, &plen);
+    for (i = 0; i < plen; i++) {
+        pdata[i] = i;
+        psum += pdata[i];
+    }
+
+    for (i = 0; i < nbursts; i++) {
+        for (j = 0; j < npackets; j++) {
+            pa_pstream_send_packet(p1, packet, NULL);
+            totalsum += psum;
+        }
+
+        pa_mainloop_iterate(ml, 0, NULL);
+    }
+
+    while (packets_received < nbursts * npackets)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    fail_unless(packets_checksum == totalsum);
+    pa_log_debug("Correct checksum received (%d)", packets_checksum);
+    pa_packet_unref(packet);
+}
+
 START_TEST (srbchannel_test) {
 
     int pipefd[4];
@@ -114,6 +152,10 @@ START_TEST (srbchannel_test) {
     packet_test(250, 5, ml, p1, p2);
     packet_test(10, 1234567, ml, p1, p2);
 
+    packet_burst_test(50, 64, 20, ml, p1, p2);
+    /* These bursts don't fit into the ringbuffer at once */
+    packet_burst_test(5, 64, 4096, ml, p1, p2);
+
     pa_pstream_unref(p1);
     pa_pstream_unref(p2);
     pa_mempool_unref(mp);
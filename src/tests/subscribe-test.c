@@ -0,0 +1,305 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Checks how the daemon merges subscription events that are held back with
+ * pa_context_subscribe_with_options(). Loads and unloads null sinks, so it
+ * needs a running daemon. The window is as long as possible, events only
+ * get through when the test subscribes again. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+#define WINDOW_USEC (10 * PA_USEC_PER_SEC)
+#define MAX_EVENTS 64
+
+struct event {
+    pa_subscription_event_type_t type;
+    uint32_t index;
+
+    bool has_state;
+    char *name;
+    pa_cvolume volume;
+    bool has_proplist;
+};
+
+static pa_mainloop *mainloop = NULL;
+static pa_context *context = NULL;
+
+static struct event events[MAX_EVENTS];
+static unsigned n_events = 0;
+
+/* Events received before the last subscribe request was acknowledged */
+static unsigned n_events_at_ack = 0;
+
+static void wait_for(bool *done) {
+    while (!*done)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+}
+
+static void wait_for_operation(pa_operation *o) {
+    fail_unless(o != NULL);
+
+    while (pa_operation_get_state(o) == PA_OPERATION_RUNNING)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+
+    fail_unless(pa_operation_get_state(o) == PA_OPERATION_DONE);
+    pa_operation_unref(o);
+}
+
+static void clear_events(void) {
+    unsigned k;
+
+    for (k = 0; k < n_events; k++)
+        pa_xfree(events[k].name);
+
+    n_events = 0;
+}
+
+static void subscribe_state_cb(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, const pa_snapshot_entry *e, void *userdata) {
+    struct event *ev;
+
+    fail_unless(n_events < MAX_EVENTS);
+    ev = &events[n_events++];
+
+    pa_zero(*ev);
+    ev->type = t;
+    ev->index = idx;
+
+    if (!e)
+        return;
+
+    fail_unless(e->facility == (t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK));
+    fail_unless(e->index == idx);
+    fail_unless(!e->removed);
+
+    ev->has_state = true;
+
+    if (e->sink) {
+        ev->name = pa_xstrdup(e->sink->name);
+        ev->volume = e->sink->volume;
+        ev->has_proplist = pa_proplist_size(e->sink->proplist) > 0;
+    } else if (e->module)
+        ev->name = pa_xstrdup(e->module->name);
+}
+
+static void success_cb(pa_context *c, int success, void *userdata) {
+    bool *done = userdata;
+
+    fail_unless(success);
+    *done = true;
+}
+
+static void subscribe_success_cb(pa_context *c, int success, void *userdata) {
+    n_events_at_ack = n_events;
+    success_cb(c, success, userdata);
+}
+
+static void index_cb(pa_context *c, uint32_t idx, void *userdata) {
+    uint32_t *r = userdata;
+
+    fail_unless(idx != PA_INVALID_INDEX);
+    *r = idx;
+}
+
+static void sink_index_cb(pa_context *c, const pa_sink_info *i, int eol, void *userdata) {
+    uint32_t *r = userdata;
+
+    fail_unless(eol >= 0);
+
+    if (i)
+        *r = i->index;
+}
+
+/* Subscribing again flushes what is held back, before the request is
+ * acknowledged */
+static void subscribe(void) {
+    bool done = false;
+
+    pa_operation_unref(pa_context_subscribe_with_options(context,
+                                                         PA_SUBSCRIPTION_MASK_SINK|PA_SUBSCRIPTION_MASK_MODULE,
+                                                         WINDOW_USEC, true, PA_SNAPSHOT_FIELDS_PROPLIST,
+                                                         subscribe_success_cb, &done));
+    wait_for(&done);
+}
+
+static uint32_t load_null_sink(const char *name, uint32_t *sink_index) {
+    char *args;
+    uint32_t idx = PA_INVALID_INDEX;
+
+    args = pa_sprintf_malloc("sink_name=%s", name);
+    wait_for_operation(pa_context_load_module(context, "module-null-sink", args, index_cb, &idx));
+    pa_xfree(args);
+
+    *sink_index = PA_INVALID_INDEX;
+    wait_for_operation(pa_context_get_sink_info_by_name(context, name, sink_index_cb, sink_index));
+    fail_unless(*sink_index != PA_INVALID_INDEX);
+
+    return idx;
+}
+
+static void set_sink_volume(const char *name, pa_volume_t v) {
+    pa_cvolume cv;
+
+    pa_cvolume_set(&cv, 2, v);
+    wait_for_operation(pa_context_set_sink_volume_by_name(context, name, &cv, NULL, NULL));
+}
+
+/* Returns the only event for the given object, NULL if there is none */
+static const struct event *find_event(pa_subscription_event_type_t facility, uint32_t idx) {
+    const struct event *r = NULL;
+    unsigned k;
+
+    for (k = 0; k < n_events; k++) {
+        if ((events[k].type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) != facility || events[k].index != idx)
+            continue;
+
+        fail_unless(r == NULL, "More than one event for object %u", idx);
+        r = &events[k];
+    }
+
+    return r;
+}
+
+/* Position of the event in the order of arrival */
+static unsigned event_position(const struct event *ev) {
+    return (unsigned) (ev - events);
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    bool *ready = userdata;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            *ready = true;
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+
+        default:
+            break;
+    }
+}
+
+START_TEST (subscribe_merge_test) {
+    uint32_t module_a, sink_a, module_b, sink_b;
+    const struct event *ev, *mev;
+    pa_cvolume v;
+    bool ready = false;
+
+    fail_unless((mainloop = pa_mainloop_new()) != NULL);
+    fail_unless((context = pa_context_new(pa_mainloop_get_api(mainloop), "subscribe-test")) != NULL);
+
+    pa_context_set_state_callback(context, context_state_cb, &ready);
+    fail_unless(pa_context_connect(context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0);
+    wait_for(&ready);
+
+    pa_context_set_subscribe_state_callback(context, subscribe_state_cb, NULL);
+    subscribe();
+    clear_events();
+
+    /* A new sink that changes a couple of times shows up once, with its
+     * final state. One that is gone again doesn't show up at all. */
+    module_a = load_null_sink("subscribe_test_a", &sink_a);
+    set_sink_volume("subscribe_test_a", PA_VOLUME_NORM / 2);
+    set_sink_volume("subscribe_test_a", PA_VOLUME_NORM / 3);
+
+    module_b = load_null_sink("subscribe_test_b", &sink_b);
+    set_sink_volume("subscribe_test_b", PA_VOLUME_NORM / 2);
+    wait_for_operation(pa_context_unload_module(context, module_b, NULL, NULL));
+
+    fail_unless(n_events == 0, "%u events weren't held back", n_events);
+
+    subscribe();
+    fail_unless(n_events_at_ack == n_events);
+
+    fail_unless((ev = find_event(PA_SUBSCRIPTION_EVENT_SINK, sink_a)) != NULL);
+    fail_unless((ev->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW);
+    fail_unless(ev->has_state);
+    fail_unless(pa_streq(ev->name, "subscribe_test_a"));
+    fail_unless(pa_cvolume_equal(&ev->volume, pa_cvolume_set(&v, 2, PA_VOLUME_NORM / 3)));
+    fail_unless(ev->has_proplist);
+
+    /* The module is announced once it is loaded, which is after its sink
+     * was created */
+    fail_unless((mev = find_event(PA_SUBSCRIPTION_EVENT_MODULE, module_a)) != NULL);
+    fail_unless((mev->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW);
+    fail_unless(mev->has_state);
+    fail_unless(pa_streq(mev->name, "module-null-sink"));
+    fail_unless(event_position(ev) < event_position(mev));
+
+    fail_unless(find_event(PA_SUBSCRIPTION_EVENT_SINK, sink_b) == NULL);
+    fail_unless(find_event(PA_SUBSCRIPTION_EVENT_MODULE, module_b) == NULL);
+
+    clear_events();
+
+    /* A removal replaces a pending change and carries no state */
+    set_sink_volume("subscribe_test_a", PA_VOLUME_NORM);
+    wait_for_operation(pa_context_unload_module(context, module_a, NULL, NULL));
+
+    fail_unless(n_events == 0, "%u events weren't held back", n_events);
+
+    subscribe();
+    fail_unless(n_events_at_ack == n_events);
+
+    fail_unless((ev = find_event(PA_SUBSCRIPTION_EVENT_SINK, sink_a)) != NULL);
+    fail_unless((ev->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE);
+    fail_unless(!ev->has_state);
+
+    fail_unless((mev = find_event(PA_SUBSCRIPTION_EVENT_MODULE, module_a)) != NULL);
+    fail_unless((mev->type & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE);
+    fail_unless(!mev->has_state);
+
+    clear_events();
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(mainloop);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Subscribe");
+    tc = tcase_create("subscribe");
+    tcase_add_test(tc, subscribe_merge_test);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
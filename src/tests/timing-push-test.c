@@ -0,0 +1,481 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Connects a record stream to a minimal fake server, which acknowledges or
+ * refuses PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH and sends timing updates
+ * with chosen tags, and checks how the client handles them: it stops
+ * polling when the server pushes, ignores indexes from updates that were
+ * sent before a flush was processed, and goes back to polling when the
+ * server refuses to push. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/socket-server.h>
+#include <pulsecore/tagstruct.h>
+
+#define CHANNEL 0
+#define STREAM_INDEX 7
+
+struct server {
+    pa_socket_server *socket_server;
+    pa_mempool *pool;
+    pa_pstream *pstream;
+
+    bool refuse_timing_push;
+    bool reply_latency;
+
+    unsigned n_timing_push;
+    unsigned n_latency_requests;
+
+    uint32_t last_tag;
+    uint32_t flush_tag;
+    uint32_t last_latency_tag;
+
+    int64_t write_index;
+    int64_t read_index;
+};
+
+static pa_mainloop *mainloop = NULL;
+static pa_mainloop_api *api = NULL;
+
+static const pa_sample_spec sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 44100,
+    .channels = 2
+};
+
+static void wait_for(bool *done) {
+    while (!*done)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+}
+
+static void wait_for_operation(pa_operation *o) {
+    fail_unless(o != NULL);
+
+    while (pa_operation_get_state(o) == PA_OPERATION_RUNNING)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+
+    fail_unless(pa_operation_get_state(o) == PA_OPERATION_DONE);
+    pa_operation_unref(o);
+}
+
+static void timeout_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    bool *done = userdata;
+
+    *done = true;
+}
+
+static void run_for(pa_usec_t usec) {
+    struct timeval tv;
+    pa_time_event *e;
+    bool done = false;
+
+    e = api->time_new(api, pa_timeval_rtstore(&tv, pa_rtclock_now() + usec, true), timeout_cb, &done);
+    wait_for(&done);
+    api->time_free(e);
+}
+
+static void server_reply_create_record_stream(struct server *s, uint32_t tag) {
+    pa_tagstruct *reply;
+    pa_channel_map map;
+    pa_format_info *f;
+
+    pa_channel_map_init_stereo(&map);
+    f = pa_format_info_from_sample_spec(&sample_spec, &map);
+
+    reply = pa_tagstruct_new();
+    pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(reply, tag);
+    pa_tagstruct_putu32(reply, CHANNEL);
+    pa_tagstruct_putu32(reply, STREAM_INDEX);
+    pa_tagstruct_putu32(reply, 65536); /* maxlength */
+    pa_tagstruct_putu32(reply, 4096);  /* fragsize */
+    pa_tagstruct_put_sample_spec(reply, &sample_spec);
+    pa_tagstruct_put_channel_map(reply, &map);
+    pa_tagstruct_putu32(reply, 0);     /* source index */
+    pa_tagstruct_puts(reply, "fake_source");
+    pa_tagstruct_put_boolean(reply, false);
+    pa_tagstruct_put_usec(reply, 0);
+    pa_tagstruct_put_format_info(reply, f);
+    pa_pstream_send_tagstruct(s->pstream, reply);
+
+    pa_format_info_free(f);
+}
+
+static void server_reply_latency(struct server *s, uint32_t tag, const struct timeval *local) {
+    pa_tagstruct *reply;
+    struct timeval now;
+
+    reply = pa_tagstruct_new();
+    pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(reply, tag);
+    pa_tagstruct_put_usec(reply, 0);
+    pa_tagstruct_put_usec(reply, 0);
+    pa_tagstruct_put_boolean(reply, true);
+    pa_tagstruct_put_timeval(reply, local);
+    pa_tagstruct_put_timeval(reply, pa_gettimeofday(&now));
+    pa_tagstruct_puts64(reply, s->write_index);
+    pa_tagstruct_puts64(reply, s->read_index);
+    pa_pstream_send_tagstruct(s->pstream, reply);
+}
+
+/* A timing update as if the server had processed everything up to and
+ * including last_tag */
+static void server_push_timing(struct server *s, uint32_t last_tag) {
+    pa_tagstruct *t;
+    struct timeval now;
+
+    t = pa_tagstruct_new();
+    pa_tagstruct_putu32(t, PA_COMMAND_RECORD_STREAM_TIMING);
+    pa_tagstruct_putu32(t, (uint32_t) -1);
+    pa_tagstruct_putu32(t, CHANNEL);
+    pa_tagstruct_putu32(t, last_tag);
+    pa_tagstruct_put_usec(t, 0);
+    pa_tagstruct_put_usec(t, 0);
+    pa_tagstruct_put_boolean(t, true);
+    pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
+    pa_tagstruct_puts64(t, s->write_index);
+    pa_tagstruct_puts64(t, s->read_index);
+    pa_pstream_send_tagstruct(s->pstream, t);
+}
+
+static void server_packet_cb(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    struct server *s = userdata;
+    const uint8_t *data;
+    size_t length;
+    pa_tagstruct *t, *reply;
+    uint32_t command, tag;
+
+    data = pa_packet_data(packet, &length);
+    t = pa_tagstruct_new_fixed(data, length);
+
+    fail_unless(pa_tagstruct_getu32(t, &command) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &tag) == 0);
+
+    s->last_tag = tag;
+
+    switch (command) {
+        case PA_COMMAND_AUTH:
+            /* No shared memory */
+            reply = pa_tagstruct_new();
+            pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+            pa_tagstruct_putu32(reply, tag);
+            pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION);
+            pa_pstream_send_tagstruct(s->pstream, reply);
+            break;
+
+        case PA_COMMAND_SET_CLIENT_NAME:
+            reply = pa_tagstruct_new();
+            pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+            pa_tagstruct_putu32(reply, tag);
+            pa_tagstruct_putu32(reply, 0); /* client index */
+            pa_pstream_send_tagstruct(s->pstream, reply);
+            break;
+
+        case PA_COMMAND_CREATE_RECORD_STREAM:
+            server_reply_create_record_stream(s, tag);
+            break;
+
+        case PA_COMMAND_SET_RECORD_STREAM_TIMING_PUSH: {
+            uint32_t channel;
+            pa_usec_t interval;
+
+            fail_unless(pa_tagstruct_getu32(t, &channel) == 0);
+            fail_unless(pa_tagstruct_get_usec(t, &interval) == 0);
+            fail_unless(pa_tagstruct_eof(t));
+            fail_unless(channel == CHANNEL);
+            fail_unless(interval >= 10 * PA_USEC_PER_MSEC && interval <= 10 * PA_USEC_PER_SEC);
+
+            s->n_timing_push++;
+
+            if (s->refuse_timing_push)
+                pa_pstream_send_error(s->pstream, tag, PA_ERR_NOTSUPPORTED);
+            else
+                pa_pstream_send_simple_ack(s->pstream, tag);
+            break;
+        }
+
+        case PA_COMMAND_GET_RECORD_LATENCY: {
+            uint32_t channel;
+            struct timeval local;
+
+            fail_unless(pa_tagstruct_getu32(t, &channel) == 0);
+            fail_unless(pa_tagstruct_get_timeval(t, &local) == 0);
+            fail_unless(pa_tagstruct_eof(t));
+            fail_unless(channel == CHANNEL);
+
+            s->n_latency_requests++;
+            s->last_latency_tag = tag;
+
+            if (s->reply_latency)
+                server_reply_latency(s, tag, &local);
+            break;
+        }
+
+        case PA_COMMAND_FLUSH_RECORD_STREAM:
+            s->flush_tag = tag;
+            pa_pstream_send_simple_ack(s->pstream, tag);
+            break;
+
+        default:
+            fail_unless(false, "Unexpected command %u", command);
+    }
+
+    pa_tagstruct_free(t);
+}
+
+static void server_connection_cb(pa_socket_server *ss, pa_iochannel *io, void *userdata) {
+    struct server *s = userdata;
+
+    fail_unless(s->pstream == NULL);
+
+    s->pstream = pa_pstream_new(api, io, s->pool);
+    pa_pstream_set_receive_packet_callback(s->pstream, server_packet_cb, s);
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    bool *ready = userdata;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            *ready = true;
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+
+        default:
+            break;
+    }
+}
+
+static void stream_state_cb(pa_stream *st, void *userdata) {
+    bool *ready = userdata;
+
+    switch (pa_stream_get_state(st)) {
+        case PA_STREAM_READY:
+            *ready = true;
+            break;
+
+        case PA_STREAM_FAILED:
+            fprintf(stderr, "Stream error: %s\n", pa_strerror(pa_context_errno(pa_stream_get_context(st))));
+            ck_abort();
+
+        default:
+            break;
+    }
+}
+
+static void latency_update_cb(pa_stream *st, void *userdata) {
+    unsigned *n = userdata;
+
+    (*n)++;
+}
+
+static char *dir = NULL;
+static char *path = NULL;
+static struct server server;
+static pa_context *context = NULL;
+static pa_stream *stream = NULL;
+static unsigned n_updates = 0;
+
+static void setup(bool refuse_timing_push) {
+    char *server_string;
+    bool ready = false;
+
+    fail_unless((mainloop = pa_mainloop_new()) != NULL);
+    api = pa_mainloop_get_api(mainloop);
+
+    dir = pa_xstrdup("/tmp/timing-push-test-XXXXXX");
+    fail_unless(mkdtemp(dir) != NULL);
+    path = pa_sprintf_malloc("%s/native", dir);
+
+    pa_zero(server);
+    server.refuse_timing_push = refuse_timing_push;
+    server.reply_latency = true;
+    fail_unless((server.pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL);
+    fail_unless((server.socket_server = pa_socket_server_new_unix(api, path)) != NULL);
+    pa_socket_server_set_callback(server.socket_server, server_connection_cb, &server);
+
+    fail_unless((context = pa_context_new(api, "timing-push-test")) != NULL);
+    pa_context_set_state_callback(context, context_state_cb, &ready);
+
+    server_string = pa_sprintf_malloc("unix:%s", path);
+    fail_unless(pa_context_connect(context, server_string, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0);
+    pa_xfree(server_string);
+
+    wait_for(&ready);
+    fail_unless(pa_context_get_server_protocol_version(context) >= 32);
+
+    ready = false;
+    n_updates = 0;
+    fail_unless((stream = pa_stream_new(context, "timing-push-test", &sample_spec, NULL)) != NULL);
+    pa_stream_set_state_callback(stream, stream_state_cb, &ready);
+    pa_stream_set_latency_update_callback(stream, latency_update_cb, &n_updates);
+    fail_unless(pa_stream_connect_record(stream, NULL, NULL, PA_STREAM_AUTO_TIMING_UPDATE) >= 0);
+
+    wait_for(&ready);
+
+    /* The first reply makes the timing info valid */
+    while (!pa_stream_get_timing_info(stream))
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+
+    fail_unless(server.n_timing_push == 1);
+}
+
+static void teardown(void) {
+    pa_stream_disconnect(stream);
+    pa_stream_unref(stream);
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+
+    if (server.pstream) {
+        pa_pstream_unlink(server.pstream);
+        pa_pstream_unref(server.pstream);
+    }
+
+    pa_socket_server_unref(server.socket_server);
+    pa_mempool_unref(server.pool);
+
+    unlink(path);
+    rmdir(dir);
+    pa_xfree(path);
+    pa_xfree(dir);
+
+    pa_mainloop_free(mainloop);
+}
+
+/* Sends an update and waits for the client to handle it */
+static const pa_timing_info *push_timing(uint32_t last_tag) {
+    unsigned n = n_updates;
+
+    server_push_timing(&server, last_tag);
+
+    while (n_updates == n)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+
+    return pa_stream_get_timing_info(stream);
+}
+
+START_TEST (timing_push_test) {
+    const pa_timing_info *i;
+    unsigned n;
+
+    setup(false);
+
+    /* The client polls quickly for a bit after the stream was created,
+     * then leaves it to the server */
+    run_for(PA_USEC_PER_SEC);
+    n = server.n_latency_requests;
+    run_for(2 * PA_USEC_PER_SEC);
+    fail_unless(server.n_latency_requests == n, "Still polling: %u requests", server.n_latency_requests - n);
+
+    server.write_index = 2000;
+    server.read_index = 1000;
+    i = push_timing(server.last_tag);
+    fail_unless(!i->write_index_corrupt && i->write_index == 2000);
+    fail_unless(!i->read_index_corrupt && i->read_index == 1000);
+
+    /* A flush invalidates the read index until the server has processed
+     * it. Hold back the latency replies, so that only pushed updates can
+     * make it valid again. */
+    server.reply_latency = false;
+    wait_for_operation(pa_stream_flush(stream, NULL, NULL));
+
+    while (server.last_latency_tag <= server.flush_tag)
+        fail_unless(pa_mainloop_iterate(mainloop, 1, NULL) >= 0);
+
+    i = pa_stream_get_timing_info(stream);
+    fail_unless(i->read_index_corrupt);
+
+    /* Sent before the flush was processed: the write index is fine, the
+     * read index is not */
+    server.write_index = 3000;
+    server.read_index = 5000;
+    i = push_timing(server.flush_tag - 1);
+    fail_unless(!i->write_index_corrupt && i->write_index == 3000);
+    fail_unless(i->read_index_corrupt);
+    fail_unless(i->read_index == 1000);
+
+    /* Sent after the server processed everything the client sent */
+    i = push_timing(server.last_latency_tag);
+    fail_unless(!i->read_index_corrupt && i->read_index == 5000);
+
+    teardown();
+}
+END_TEST
+
+START_TEST (timing_push_refused_test) {
+    unsigned n;
+
+    setup(true);
+
+    /* The client keeps polling, at least every 1.5 s */
+    run_for(PA_USEC_PER_SEC);
+    n = server.n_latency_requests;
+    run_for(2 * PA_USEC_PER_SEC);
+    fail_unless(server.n_latency_requests > n);
+
+    teardown();
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Timing Push");
+    tc = tcase_create("timingpush");
+    tcase_add_test(tc, timing_push_test);
+    tcase_add_test(tc, timing_push_refused_test);
+    tcase_set_timeout(tc, 30);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
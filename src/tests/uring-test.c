@@ -0,0 +1,188 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/uring.h>
+
+static unsigned packets_received;
+static unsigned packets_checksum;
+static size_t packets_length;
+static bool died;
+
+static void packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint8_t *pdata;
+    size_t plen;
+    unsigned i;
+
+    pdata = pa_packet_data(packet, &plen);
+    fail_unless(packets_length == plen);
+
+    packets_received++;
+    for (i = 0; i < plen; i++)
+        packets_checksum += pdata[i];
+}
+
+static void die_cb(pa_pstream *p, void *userdata) {
+    died = true;
+}
+
+static void packet_test(unsigned npackets, size_t plength, pa_mainloop *ml, pa_pstream *p1, pa_pstream *p2) {
+    pa_packet *packet = pa_packet_new(plength);
+    unsigned i;
+    unsigned psum = 0, totalsum = 0;
+    uint8_t *pdata;
+    size_t plen;
+
+    pa_log_info("Sending %d packets of length %zd", npackets, plength);
+    packets_received = 0;
+    packets_checksum = 0;
+    packets_length = plength;
+    pa_pstream_set_receive_packet_callback(p2, packet_received, NULL);
+
+    pdata = (uint8_t *) pa_packet_data(packet, &plen);
+    for (i = 0; i < plen; i++) {
+        pdata[i] = i;
+        psum += pdata[i];
+    }
+
+    for (i = 0; i < npackets; i++) {
+        pa_pstream_send_packet(p1, packet, NULL);
+        totalsum += psum;
+        pa_mainloop_iterate(ml, 0, NULL);
+    }
+
+    while (packets_received < npackets)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    fail_unless(packets_checksum == totalsum);
+    pa_log_debug("Correct checksum received (%d)", packets_checksum);
+    pa_packet_unref(packet);
+}
+
+static void tcp_socketpair(int fds[2]) {
+    struct sockaddr_in sa;
+    socklen_t l = sizeof(sa);
+    int listen_fd;
+
+    pa_zero(sa);
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    fail_unless((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+    fail_unless(bind(listen_fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+    fail_unless(listen(listen_fd, 1) == 0);
+    fail_unless(getsockname(listen_fd, (struct sockaddr*) &sa, &l) == 0);
+
+    fail_unless((fds[0] = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+    fail_unless(connect(fds[0], (struct sockaddr*) &sa, sizeof(sa)) == 0);
+    fail_unless((fds[1] = accept(listen_fd, NULL, NULL)) >= 0);
+
+    pa_close(listen_fd);
+}
+
+START_TEST (uring_test) {
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    pa_uring *u;
+    int fds[2];
+
+    if (!(u = pa_uring_new(pa_mainloop_get_api(ml), pa_mempool_block_size_max(mp), 8))) {
+        pa_log_info("io_uring not available, skipping.");
+        pa_mempool_unref(mp);
+        pa_mainloop_free(ml);
+        return;
+    }
+
+    tcp_socketpair(fds);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    fail_unless(pa_iochannel_enable_uring(io2, u) == 0);
+
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    /* Receiving and sending through the ring */
+    packet_test(250, 5, ml, p1, p2);
+    packet_test(10, 1234567, ml, p1, p2);
+    packet_test(250, 5, ml, p2, p1);
+    packet_test(10, 1234567, ml, p2, p1);
+
+    /* The channel on the ring notices when the other side goes away */
+    pa_pstream_set_die_callback(p2, die_cb, NULL);
+    pa_pstream_unlink(p1);
+    pa_pstream_unref(p1);
+
+    while (!died)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    pa_pstream_unref(p2);
+
+    /* Freeing a channel on the ring with a receive posted */
+    tcp_socketpair(fds);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    fail_unless(pa_iochannel_enable_uring(io2, u) == 0);
+    pa_mainloop_iterate(ml, 0, NULL);
+    pa_iochannel_free(io2);
+    pa_close(fds[0]);
+
+    /* The ring goes away once all operations are done */
+    pa_uring_unref(u);
+    while (pa_mainloop_iterate(ml, 0, NULL) > 0)
+        ;
+
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("uring");
+    tc = tcase_create("uring");
+    tcase_add_test(tc, uring_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -175,6 +175,16 @@ static void stat_callback(pa_context *c, const pa_stat_info *i, void *userdata)
     pa_bytes_snprint(s, sizeof(s), i->scache_size);
     printf(_("Sample cache size: %s\n"), s);
 
+    if (i->pool_size > 0) {
+        char u[PA_BYTES_SNPRINT_MAX], m[PA_BYTES_SNPRINT_MAX];
+
+        pa_bytes_snprint(s, sizeof(s), i->pool_size);
+        pa_bytes_snprint(u, sizeof(u), i->pool_used_size);
+        pa_bytes_snprint(m, sizeof(m), i->pool_used_size_max);
+        printf(_("Memory pool size: %s, %s in use, %s at most.\n"), s, u, m);
+        printf(_("Memory pool fallbacks: %u\n"), i->pool_fallbacks);
+    }
+
     complete_action();
 }
 